@@ -6,6 +6,7 @@
 
 #include "morton2D.h"
 #include "morton3D.h"
+#include "morton2D_32.h"
 
 inline uint_fast32_t morton2D_32_encode(const uint_fast16_t x, const uint_fast16_t y);
 inline uint_fast64_t morton2D_64_encode(const uint_fast32_t x, const uint_fast32_t y);
@@ -17,8 +18,19 @@ inline void morton2D_64_decode(const uint_fast64_t morton, uint_fast32_t& x, uin
 inline void morton3D_32_decode(const uint_fast32_t morton, uint_fast16_t& x, uint_fast16_t& y, uint_fast16_t& z);
 inline void morton3D_64_decode(const uint_fast64_t morton, uint_fast32_t& x, uint_fast32_t& y, uint_fast32_t& z);
 
+// Signed coordinates, see morton3D_EncodeSigned (in 2D the full 16/32 bits, in 3D 10/21 bits, in two's complement)
+inline uint_fast32_t morton2D_32_encode_signed(const int_fast16_t x, const int_fast16_t y);
+inline uint_fast64_t morton2D_64_encode_signed(const int_fast32_t x, const int_fast32_t y);
+inline uint_fast32_t morton3D_32_encode_signed(const int_fast16_t x, const int_fast16_t y, const int_fast16_t z);
+inline uint_fast64_t morton3D_64_encode_signed(const int_fast32_t x, const int_fast32_t y, const int_fast32_t z);
+
+inline void morton2D_32_decode_signed(const uint_fast32_t morton, int_fast16_t& x, int_fast16_t& y);
+inline void morton2D_64_decode_signed(const uint_fast64_t morton, int_fast32_t& x, int_fast32_t& y);
+inline void morton3D_32_decode_signed(const uint_fast32_t morton, int_fast16_t& x, int_fast16_t& y, int_fast16_t& z);
+inline void morton3D_64_decode_signed(const uint_fast64_t morton, int_fast32_t& x, int_fast32_t& y, int_fast32_t& z);
+
 inline uint_fast32_t morton2D_32_encode(const uint_fast16_t x, const uint_fast16_t y) {
-	return morton2D_Encode_LUT256_shifted<uint_fast32_t, uint_fast16_t>(x, y);
+	return morton2D_32_Encode_magicbits((uint16_t)x, (uint16_t)y);
 }
 
 inline uint_fast64_t morton2D_64_encode(const uint_fast32_t x, const uint_fast32_t y) {
@@ -34,11 +46,14 @@ inline uint_fast64_t morton3D_64_encode(const uint_fast32_t x, const uint_fast32
 }
 
 inline void morton2D_32_decode(const uint_fast32_t morton, uint_fast16_t& x, uint_fast16_t& y) {
-	morton2D_Decode_for<uint_fast32_t, uint_fast16_t>(morton, x, y);
+	uint16_t x16, y16;
+	morton2D_32_Decode_magicbits((uint32_t)morton, x16, y16);
+	x = x16;
+	y = y16;
 }
 
 inline void morton2D_64_decode(const uint_fast64_t morton, uint_fast32_t& x, uint_fast32_t& y) {
-	morton2D_Decode_for<uint_fast64_t, uint_fast32_t>(morton, x, y);
+	morton2D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(morton, x, y);
 }
 
 inline void morton3D_32_decode(const uint_fast32_t morton, uint_fast16_t& x, uint_fast16_t& y, uint_fast16_t& z) {
@@ -49,4 +64,80 @@ inline void morton3D_64_decode(const uint_fast64_t morton, uint_fast32_t& x, uin
 	morton3D_Decode_LUT256_shifted<uint_fast64_t, uint_fast32_t>(morton, x, y, z);
 }
 
+inline uint_fast32_t morton2D_32_encode_signed(const int_fast16_t x, const int_fast16_t y) {
+	return morton2D_EncodeSigned<uint_fast32_t, uint_fast16_t, morton2D_Encode_LUT256_shifted<uint_fast32_t, uint_fast16_t>, 16>(x, y);
+}
+
+inline uint_fast64_t morton2D_64_encode_signed(const int_fast32_t x, const int_fast32_t y) {
+	return morton2D_EncodeSigned<uint_fast64_t, uint_fast32_t, morton2D_Encode_LUT256_shifted<uint_fast64_t, uint_fast32_t> >(x, y);
+}
+
+inline uint_fast32_t morton3D_32_encode_signed(const int_fast16_t x, const int_fast16_t y, const int_fast16_t z) {
+	return morton3D_EncodeSigned<uint_fast32_t, uint_fast16_t, morton3D_Encode_LUT256_shifted<uint_fast32_t, uint_fast16_t>, 10>(x, y, z);
+}
+
+inline uint_fast64_t morton3D_64_encode_signed(const int_fast32_t x, const int_fast32_t y, const int_fast32_t z) {
+	return morton3D_EncodeSigned<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256_shifted<uint_fast64_t, uint_fast32_t> >(x, y, z);
+}
+
+inline void morton2D_32_decode_signed(const uint_fast32_t morton, int_fast16_t& x, int_fast16_t& y) {
+	morton2D_DecodeSigned<uint_fast32_t, uint_fast16_t, morton2D_Decode_magicbits<uint_fast32_t, uint_fast16_t>, 16>(morton, x, y);
+}
+
+inline void morton2D_64_decode_signed(const uint_fast64_t morton, int_fast32_t& x, int_fast32_t& y) {
+	morton2D_DecodeSigned<uint_fast64_t, uint_fast32_t, morton2D_Decode_magicbits<uint_fast64_t, uint_fast32_t> >(morton, x, y);
+}
+
+inline void morton3D_32_decode_signed(const uint_fast32_t morton, int_fast16_t& x, int_fast16_t& y, int_fast16_t& z) {
+	morton3D_DecodeSigned<uint_fast32_t, uint_fast16_t, morton3D_Decode_LUT256_shifted<uint_fast32_t, uint_fast16_t>, 10>(morton, x, y, z);
+}
+
+inline void morton3D_64_decode_signed(const uint_fast64_t morton, int_fast32_t& x, int_fast32_t& y, int_fast32_t& z) {
+	morton3D_DecodeSigned<uint_fast64_t, uint_fast32_t, morton3D_Decode_LUT256_shifted<uint_fast64_t, uint_fast32_t> >(morton, x, y, z);
+}
+
+// EXACT-WIDTH OVERLOADS : uint16_t / uint32_t coordinates and uint32_t / uint64_t codes, which take half or a quarter
+// of the memory of the uint_fast types on x86-64 Linux (8 bytes each). They are templates so that they are only chosen
+// when all coordinates have exactly these types: other calls, e.g. with int literals, still go to the functions above,
+// and where the uint_fast types are the exact-width ones (MSVC) the functions above are chosen and nothing collides.
+template<typename coord>
+inline typename std::enable_if<std::is_same<coord, uint16_t>::value, uint32_t>::type morton2D_32_encode(const coord x, const coord y) {
+	return morton2D_32_Encode_magicbits(x, y);
+}
+
+template<typename coord>
+inline typename std::enable_if<std::is_same<coord, uint32_t>::value, uint64_t>::type morton2D_64_encode(const coord x, const coord y) {
+	return morton2D_Encode_LUT256_shifted<uint64_t, uint32_t>(x, y);
+}
+
+template<typename coord>
+inline typename std::enable_if<std::is_same<coord, uint16_t>::value, uint32_t>::type morton3D_32_encode(const coord x, const coord y, const coord z) {
+	return morton3D_Encode_LUT256_shifted<uint32_t, uint16_t>(x, y, z);
+}
+
+template<typename coord>
+inline typename std::enable_if<std::is_same<coord, uint32_t>::value, uint64_t>::type morton3D_64_encode(const coord x, const coord y, const coord z) {
+	return morton3D_Encode_LUT256_shifted<uint64_t, uint32_t>(x, y, z);
+}
+
+template<typename coord>
+inline typename std::enable_if<std::is_same<coord, uint16_t>::value>::type morton2D_32_decode(const uint32_t morton, coord& x, coord& y) {
+	morton2D_32_Decode_magicbits(morton, x, y);
+}
+
+template<typename coord>
+inline typename std::enable_if<std::is_same<coord, uint32_t>::value>::type morton2D_64_decode(const uint64_t morton, coord& x, coord& y) {
+	morton2D_Decode_magicbits<uint64_t, uint32_t>(morton, x, y);
+}
+
+template<typename coord>
+inline typename std::enable_if<std::is_same<coord, uint16_t>::value>::type morton3D_32_decode(const uint32_t morton, coord& x, coord& y, coord& z) {
+	morton3D_Decode_LUT256_shifted<uint32_t, uint16_t>(morton, x, y, z);
+}
+
+template<typename coord>
+inline typename std::enable_if<std::is_same<coord, uint32_t>::value>::type morton3D_64_decode(const uint64_t morton, coord& x, coord& y, coord& z) {
+	morton3D_Decode_LUT256_shifted<uint64_t, uint32_t>(morton, x, y, z);
+}
+
 #endif
\ No newline at end of file
@@ -3,48 +3,59 @@
 #define MORTON2D_64_H_
 
 #include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <type_traits>
 #include "morton2D_LUTs.h"
 #include "morton_common.h"
 
 template<typename morton, typename coord> inline morton morton2D_Encode_for(const coord x, const coord y);
-template<typename morton, typename coord> inline morton morton2D_Encode_magicbits(const coord x, const coord y);
+template<typename morton, typename coord> constexpr morton morton2D_Encode_magicbits(const coord x, const coord y);
 template<typename morton, typename coord> inline morton morton2D_Encode_LUT256_shifted(const coord x, const coord y);
 template<typename morton, typename coord> inline morton morton2D_Encode_LUT256_shifted_ET(const coord x, const coord y);
 template<typename morton, typename coord> inline morton morton2D_Encode_LUT256(const coord x, const coord y);
 template<typename morton, typename coord> inline morton morton2D_Encode_LUT256_ET(const coord x, const coord y);
 
+template<typename morton, typename coord> inline void morton2D_Decode_for(const morton m, coord& x, coord& y);
+template<typename morton, typename coord> inline void morton2D_Decode_magicbits(const morton m, coord& x, coord& y);
+
+template<typename morton> constexpr morton morton2D_IncX(const morton m);
+template<typename morton> constexpr morton morton2D_IncY(const morton m);
+template<typename morton> constexpr morton morton2D_DecX(const morton m);
+template<typename morton> constexpr morton morton2D_DecY(const morton m);
+template<typename morton> constexpr morton morton2D_Add(const morton a, const morton b);
+template<typename morton> constexpr morton morton2D_Sub(const morton a, const morton b);
+
 // ENCODE 2D morton code : For Loop
 template<typename morton, typename coord>
 inline morton morton2D_Encode_for(const coord x, const coord y){
 	morton answer = 0;
-	for (morton i = 0; i < sizeof(coord)*8; ++i) {
-		answer |= (x & ((morton)0x1 << i)) << (2 * i) | (y & ((morton)0x1 << i)) << ((2 * i) + 1);
+	for (unsigned int i = 0; i < sizeof(morton) * 4; ++i) { // bit i of x goes to bit 2i, bit i of y to bit 2i + 1
+		answer |= (x & ((morton)0x1 << i)) << i | (y & ((morton)0x1 << i)) << (i + 1);
 	}
 	return answer;
 }
 
-// ENCODE 3D morton code : Magic bits (helper method)
-static const uint_fast32_t encode2D_masks32[6] = {0, 0x0000FFFF, 0x00FF00FF, 0x0F0F0F0F, 0x33333333, 0x55555555};
-static const uint_fast64_t encode2D_masks64[6] = {0x00000000FFFFFFFF, 0x0000FFFF0000FFFF, 0x00FF00FF00FF00FF, 
+// ENCODE 2D morton code : Magic bits (helper method)
+static constexpr uint_fast64_t encode2D_masks32[6] = {0, 0x0000FFFF, 0x00FF00FF, 0x0F0F0F0F, 0x33333333, 0x55555555};
+static constexpr uint_fast64_t encode2D_masks64[6] = {0x00000000FFFFFFFF, 0x0000FFFF0000FFFF, 0x00FF00FF00FF00FF, 
 													0x0F0F0F0F0F0F0F0F, 0x3333333333333333, 0x5555555555555555};
 
-// ENCODE 2D morton code : Magic bits (helper method)
+// Step i (0 .. 5) shifts by 32 >> i and applies mask i, 32-bit codes skip step 0 (see morton3D_SplitBy3Step)
+template<typename morton>
+constexpr morton morton2D_SplitBy2Step(const morton x, const unsigned int i) {
+	return (i == 0 && sizeof(morton) <= 4) ? x : (x | x << (32 >> i)) & (morton)((sizeof(morton) <= 4) ? encode2D_masks32[i] : encode2D_masks64[i]);
+}
+
 template<typename morton, typename coord>
-inline morton morton2D_splitby2(const coord a){
-	const morton* masks = (sizeof(morton) <= 4) ? reinterpret_cast<const morton*>(encode2D_masks32) : reinterpret_cast<const morton*>(encode2D_masks64);
-	morton x = a;
-	if (sizeof(morton) > 4) { x = (x | x << 32) & masks[0]; }
-	x = (x | x << 16) & masks[1];
-	x = (x | x << 8) & masks[2];
-	x = (x | x << 4) & masks[3];
-	x = (x | x << 2) & masks[4];
-	x = (x | x << 1) & masks[5];
-	return x;
+constexpr morton morton2D_splitby2(const coord a){
+	return morton2D_SplitBy2Step<morton>(morton2D_SplitBy2Step<morton>(morton2D_SplitBy2Step<morton>(morton2D_SplitBy2Step<morton>(morton2D_SplitBy2Step<morton>(
+		morton2D_SplitBy2Step<morton>((morton)a, 0), 1), 2), 3), 4), 5);
 }
 
 // ENCODE 2D morton code : Magic bits
 template<typename morton, typename coord>
-inline morton morton2D_Encode_magicbits(const coord x, const coord y){
+constexpr morton morton2D_Encode_magicbits(const coord x, const coord y){
 	return morton2D_splitby2<morton, coord>(x) | (morton2D_splitby2<morton, coord>(y) << 1);
 }
 
@@ -71,27 +82,37 @@ inline morton morton2D_Encode_LUT256_shifted(const coord x, const coord y){
 }
 
 
-// Helper method for ET LUT encode
+// Helper method for ET LUT encode: index of the highest byte holding a set bit in either coordinate,
+// capped to the bytes the code holds (2 per coordinate in a 32-bit code, 4 in a 64-bit one). False if both are 0.
 template<typename morton, typename coord>
-inline morton compute2D_ET_LUT_encode(const coord c, const coord *LUT) {
+inline bool compute2D_ET_LUT_encode_steps(const coord x, const coord y, unsigned long& top) {
 	unsigned long maxbit = 0;
-	if (findFirstSetBit<coord>(c, &maxbit) == 0) { return 0; }
-	const static morton EIGHTBITMASK = 0x000000FF;
-	morton answer = LUT[c & EIGHTBITMASK];
-	unsigned int i = 8;
-	while (maxbit >= i) {
-		answer |= (LUT[(c >> i) & EIGHTBITMASK]) << i * 2;
-		i += 8;
-	}
-	return answer;
+	if (!findFirstSetBit<morton>((morton)(x | y), &maxbit)) { return false; }
+	top = std::min<unsigned long>(maxbit >> 3, (sizeof(morton) <= 4) ? 1 : 3);
+	return true;
 }
 
-// ENCODE 2D morton code: LUT preshifted
+// ENCODE 2D morton code: LUT preshifted (Early termination version)
 template<typename morton, typename coord>
 inline morton morton2D_Encode_LUT256_shifted_ET(const coord x, const coord y) {
-    morton outX = compute2D_ET_LUT_encode<morton, coord>(x, Morton2D_encode_x_256);
-    morton outY = compute2D_ET_LUT_encode<morton, coord>(y, Morton2D_encode_y_256);
-    return outY | outX;
+	unsigned long top = 0;
+	if (!compute2D_ET_LUT_encode_steps<morton, coord>(x, y, top)) { return 0; }
+	static const morton EIGHTBITMASK = 0x000000FF;
+	morton answer = 0;
+	switch (top) { // jump to the highest byte, then fall through down to byte 0
+	case 3:
+		answer = Morton2D_encode_y_256[(y >> 24) & EIGHTBITMASK] | Morton2D_encode_x_256[(x >> 24) & EIGHTBITMASK];
+		// fall through
+	case 2:
+		answer = answer << 16 | Morton2D_encode_y_256[(y >> 16) & EIGHTBITMASK] | Morton2D_encode_x_256[(x >> 16) & EIGHTBITMASK];
+		// fall through
+	case 1:
+		answer = answer << 16 | Morton2D_encode_y_256[(y >> 8) & EIGHTBITMASK] | Morton2D_encode_x_256[(x >> 8) & EIGHTBITMASK];
+		// fall through
+	default:
+		answer = answer << 16 | Morton2D_encode_y_256[y & EIGHTBITMASK] | Morton2D_encode_x_256[x & EIGHTBITMASK];
+	}
+	return answer;
 }
 
 // ENCODE 2D morton code: LUT
@@ -116,22 +137,210 @@ inline morton morton2D_Encode_LUT256(const coord x, const coord y) {
 	return answer;
 }
 
-// ENCODE 2D morton code: LUT preshifted
+// ENCODE 2D morton code: LUT (Early termination version)
 template<typename morton, typename coord>
 inline morton morton2D_Encode_LUT256_ET(const coord x, const coord y) {
-    morton outX = compute2D_ET_LUT_encode<morton, coord>(x, Morton2D_encode_x_256);
-    morton outY = compute2D_ET_LUT_encode<morton, coord>(y, Morton2D_encode_x_256);
-    return (outY << 1) | outX;
+	unsigned long top = 0;
+	if (!compute2D_ET_LUT_encode_steps<morton, coord>(x, y, top)) { return 0; }
+	static const morton EIGHTBITMASK = 0x000000FF;
+	morton answer = 0;
+	switch (top) { // jump to the highest byte, then fall through down to byte 0
+	case 3:
+		answer = (Morton2D_encode_x_256[(y >> 24) & EIGHTBITMASK]) << 1 | Morton2D_encode_x_256[(x >> 24) & EIGHTBITMASK];
+		// fall through
+	case 2:
+		answer = answer << 16 | (Morton2D_encode_x_256[(y >> 16) & EIGHTBITMASK]) << 1 | Morton2D_encode_x_256[(x >> 16) & EIGHTBITMASK];
+		// fall through
+	case 1:
+		answer = answer << 16 | (Morton2D_encode_x_256[(y >> 8) & EIGHTBITMASK]) << 1 | Morton2D_encode_x_256[(x >> 8) & EIGHTBITMASK];
+		// fall through
+	default:
+		answer = answer << 16 | (Morton2D_encode_x_256[y & EIGHTBITMASK]) << 1 | Morton2D_encode_x_256[x & EIGHTBITMASK];
+	}
+	return answer;
 }
 
 // DECODE 2D morton code : For loop
 template<typename morton, typename coord>
 inline void morton2D_Decode_for(const morton m, coord& x, coord& y) {
 	x = 0; y = 0;
-	for (morton i = 0; i <= (sizeof(m)*4); ++i) {
-		x |= (m & (1ull << 2 * i)) >> i;
-		y |= (m & (1ull << ((2 * i) + 1))) >> (i + 1);
+	for (unsigned int i = 0; i < sizeof(morton) * 4; ++i) {
+		x |= (coord)((m & ((morton)0x1 << 2 * i)) >> i);
+		y |= (coord)((m & ((morton)0x1 << ((2 * i) + 1))) >> (i + 1));
+	}
+}
+
+// DECODE 2D morton code : Magic bits (helper method). Step i (1 .. 5) shifts by 1 << (i - 1) and applies mask i,
+// 32-bit codes skip step 5.
+static constexpr uint_fast64_t decode2D_masks32[6] = {0x55555555, 0x33333333, 0x0F0F0F0F, 0x00FF00FF, 0x0000FFFF, 0};
+static constexpr uint_fast64_t decode2D_masks64[6] = {0x5555555555555555, 0x3333333333333333, 0x0F0F0F0F0F0F0F0F,
+													0x00FF00FF00FF00FF, 0x0000FFFF0000FFFF, 0x00000000FFFFFFFF};
+template<typename morton>
+constexpr morton morton2D_GetSecondBitsStep(const morton x, const unsigned int i) {
+	return (i == 5 && sizeof(morton) <= 4) ? x : (x ^ (x >> (1 << (i - 1)))) & (morton)((sizeof(morton) <= 4) ? decode2D_masks32[i] : decode2D_masks64[i]);
+}
+
+template<typename morton, typename coord>
+constexpr coord morton2D_getSecondBits(const morton m) {
+	return (coord)morton2D_GetSecondBitsStep<morton>(morton2D_GetSecondBitsStep<morton>(morton2D_GetSecondBitsStep<morton>(morton2D_GetSecondBitsStep<morton>(
+		morton2D_GetSecondBitsStep<morton>(m & (morton)((sizeof(morton) <= 4) ? decode2D_masks32[0] : decode2D_masks64[0]), 1), 2), 3), 4), 5);
+}
+
+// DECODE 2D morton code : Magic bits, one coordinate (startshift 0 for x, 1 for y)
+template<typename morton, typename coord>
+constexpr coord morton2D_DecodeCoord_magicbits(const morton m, const unsigned int startshift) {
+	return morton2D_getSecondBits<morton, coord>(m >> startshift);
+}
+
+// DECODE 2D morton code : Magic bits
+template<typename morton, typename coord>
+inline void morton2D_Decode_magicbits(const morton m, coord& x, coord& y) {
+	x = morton2D_getSecondBits<morton, coord>(m);
+	y = morton2D_getSecondBits<morton, coord>(m >> 1);
+}
+
+// ARRAYS : codes[i] = encode(x[i], y[i]) for n points, and back, with any of the methods above (in parallel when
+// OpenMP is enabled). See morton3D_EncodeArray.
+template<typename morton, typename coord, morton (*encode)(const coord, const coord) = morton2D_Encode_LUT256_shifted<morton, coord> >
+inline void morton2D_EncodeArray(const coord* x, const coord* y, const size_t n, morton* codes) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		codes[i] = encode(x[i], y[i]);
+	}
+}
+
+template<typename morton, typename coord, void (*decode)(const morton, coord&, coord&) = morton2D_Decode_magicbits<morton, coord> >
+inline void morton2D_DecodeArray(const morton* codes, const size_t n, coord* x, coord* y) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		decode(codes[i], x[i], y[i]);
+	}
+}
+
+// MORTON ARITHMETIC : work on the coordinates without decoding, by filling the bits of the
+// other axis with ones (so carries ripple through) or zeroes (so borrows ripple through)
+static constexpr uint_fast64_t morton2D_x_mask = 0x5555555555555555;
+static constexpr uint_fast64_t morton2D_y_mask = 0xAAAAAAAAAAAAAAAA;
+
+template<typename morton>
+constexpr morton morton2D_IncAxis(const morton m, const morton mask) {
+	return (((m | ~mask) + 1) & mask) | (m & ~mask);
+}
+
+template<typename morton>
+constexpr morton morton2D_DecAxis(const morton m, const morton mask) {
+	return (((m & mask) - 1) & mask) | (m & ~mask);
+}
+
+template<typename morton>
+constexpr morton morton2D_AddAxis(const morton a, const morton b, const morton mask) {
+	return ((a | ~mask) + (b & mask)) & mask;
+}
+
+template<typename morton>
+constexpr morton morton2D_SubAxis(const morton a, const morton b, const morton mask) {
+	return ((a & mask) - (b & mask)) & mask;
+}
+
+// (x+1, y)
+template<typename morton>
+constexpr morton morton2D_IncX(const morton m) { return morton2D_IncAxis<morton>(m, (morton)morton2D_x_mask); }
+// (x, y+1)
+template<typename morton>
+constexpr morton morton2D_IncY(const morton m) { return morton2D_IncAxis<morton>(m, (morton)morton2D_y_mask); }
+// (x-1, y)
+template<typename morton>
+constexpr morton morton2D_DecX(const morton m) { return morton2D_DecAxis<morton>(m, (morton)morton2D_x_mask); }
+// (x, y-1)
+template<typename morton>
+constexpr morton morton2D_DecY(const morton m) { return morton2D_DecAxis<morton>(m, (morton)morton2D_y_mask); }
+
+// (xa + xb, ya + yb)
+template<typename morton>
+constexpr morton morton2D_Add(const morton a, const morton b) {
+	return morton2D_AddAxis<morton>(a, b, (morton)morton2D_x_mask) | morton2D_AddAxis<morton>(a, b, (morton)morton2D_y_mask);
+}
+
+// (xa - xb, ya - yb)
+template<typename morton>
+constexpr morton morton2D_Sub(const morton a, const morton b) {
+	return morton2D_SubAxis<morton>(a, b, (morton)morton2D_x_mask) | morton2D_SubAxis<morton>(a, b, (morton)morton2D_y_mask);
+}
+
+// SIGNED COORDINATES : coordinates in [-2^(BITS-1), 2^(BITS-1) - 1] are offset by 2^(BITS-1), which flips their
+// sign bit and keeps their order. BITS defaults to 32 for 64-bit codes and 16 for 32-bit codes. See morton3D_EncodeSigned.
+template<typename coord, unsigned int BITS>
+inline coord morton2D_SignedOffset() { return (coord)1 << (BITS - 1); }
+
+template<typename morton, typename coord, morton (*encode)(const coord, const coord),
+	unsigned int BITS = (sizeof(morton) <= 4) ? 16 : 32>
+inline morton morton2D_EncodeSigned(const typename std::make_signed<coord>::type x, const typename std::make_signed<coord>::type y) {
+	const coord offset = morton2D_SignedOffset<coord, BITS>();
+	return encode((coord)x + offset, (coord)y + offset);
+}
+
+template<typename morton, typename coord, void (*decode)(const morton, coord&, coord&),
+	unsigned int BITS = (sizeof(morton) <= 4) ? 16 : 32>
+inline void morton2D_DecodeSigned(const morton m, typename std::make_signed<coord>::type& x, typename std::make_signed<coord>::type& y) {
+	typedef typename std::make_signed<coord>::type scoord;
+	const coord offset = morton2D_SignedOffset<coord, BITS>();
+	coord ux, uy;
+	decode(m, ux, uy);
+	x = (scoord)(ux - offset);
+	y = (scoord)(uy - offset);
+}
+
+// HIERARCHY : a code holds one quadtree level per 2 bits, root first. Level 0 is the root cell,
+// the deepest level is 32 for 64-bit codes and 16 for 32-bit codes.
+template<typename morton>
+constexpr unsigned int morton2D_maxLevel() { return (sizeof(morton) * 8) / 2; }
+
+// Deepest level at which a and b lie in the same cell (morton2D_maxLevel if a == b)
+template<typename morton>
+inline unsigned int morton2D_commonLevel(const morton a, const morton b) {
+	return morton_clz<morton>(a ^ b) / 2;
+}
+
+// Code of the minimum corner of the cell at the given level (0 .. morton2D_maxLevel) that contains code
+template<typename morton>
+constexpr morton morton2D_ancestorAtLevel(const morton code, const unsigned int level) {
+	// keep the top 2 * level bits (shifting twice, since a shift by the full width is undefined)
+	return code & ~(morton)((~(morton)0 >> level) >> level);
+}
+
+// levels[i] = morton2D_commonLevel(codes[i], codes[i + 1]) for the n - 1 neighbouring pairs of an array
+template<typename morton>
+inline void morton2D_commonLevels(const morton* codes, const size_t n, uint8_t* levels) {
+	for (size_t i = 0; i + 1 < n; ++i) {
+		levels[i] = (uint8_t)morton2D_commonLevel<morton>(codes[i], codes[i + 1]);
+	}
+}
+
+// BOX QUERIES : a box is given by the codes of its minimum and maximum corners (lo <= hi on both axes).
+// See morton3D_NextInBox.
+template<typename morton>
+inline bool morton2D_InBox(const morton code, const morton lo, const morton hi) {
+	const morton xm = (morton)morton2D_x_mask, ym = (morton)morton2D_y_mask;
+	return (code & xm) >= (lo & xm) && (code & xm) <= (hi & xm)
+		&& (code & ym) >= (lo & ym) && (code & ym) <= (hi & ym);
+}
+
+// Smallest code larger than code that lies inside the box. code has to be smaller than hi.
+template<typename morton>
+inline morton morton2D_NextInBox(const morton code, morton lo, morton hi) {
+	morton next = hi;
+	for (int bit = 2 * morton2D_maxLevel<morton>() - 1; bit >= 0; --bit) {
+		const morton b = (morton)1 << bit;
+		const morton below = (morton)(morton2D_x_mask << (bit % 2)) & (b - 1); // lower bits of the same axis
+		switch (((code & b) ? 4 : 0) | ((lo & b) ? 2 : 0) | ((hi & b) ? 1 : 0)) {
+		case 1: next = (lo & ~below) | b; hi = (hi & ~b) | below; break;
+		case 3: return lo;
+		case 4: return next;
+		case 5: lo = (lo & ~below) | b; break;
+		default: break;
+		}
 	}
+	return next;
 }
 
 #endif // MORTON2D_64_H_
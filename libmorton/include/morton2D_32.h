@@ -1,12 +1,152 @@
-// Libmorton - Methods to encode/decode 64-bit morton codes from/to 32-bit (x,y,z) coordinates
+// Libmorton - Methods to encode/decode 32-bit 2D morton codes from/to 16-bit (x,y) coordinates, in 32-bit registers
 #ifndef MORTON2D_32_H_
 #define MORTON2D_32_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include "morton2D_LUTs.h"
 
 #if _MSC_VER
 #include <intrin.h>
+#elif defined(__AVX2__) || defined(__AVX512F__) || defined(__BMI2__)
+#include <immintrin.h>
 #endif
 
-#endif // MORTON2D_32_H_
\ No newline at end of file
+// Unlike the templates of morton2D.h, these work on exact-width types with constant masks: a code is
+// the perfect shuffle of the 32-bit word (y << 16 | x), so both coordinates are spread at once in one
+// register, by 4 delta swaps (Hacker's Delight, 7-2). Decoding runs the same swaps in reverse order.
+
+// Swap the bits of v under mask with the bits shift places above them
+constexpr uint32_t morton2D_32_DeltaSwap(const uint32_t v, const unsigned int shift, const uint32_t mask) {
+	return v ^ ((v ^ (v >> shift)) & mask) ^ (((v ^ (v >> shift)) & mask) << shift);
+}
+
+constexpr uint32_t morton2D_32_Shuffle(const uint32_t v) {
+	return morton2D_32_DeltaSwap(morton2D_32_DeltaSwap(morton2D_32_DeltaSwap(morton2D_32_DeltaSwap(v, 8, 0x0000FF00), 4, 0x00F000F0), 2, 0x0C0C0C0C), 1, 0x22222222);
+}
+
+constexpr uint32_t morton2D_32_Unshuffle(const uint32_t v) {
+	return morton2D_32_DeltaSwap(morton2D_32_DeltaSwap(morton2D_32_DeltaSwap(morton2D_32_DeltaSwap(v, 1, 0x22222222), 2, 0x0C0C0C0C), 4, 0x00F000F0), 8, 0x0000FF00);
+}
+
+// ENCODE 2D 32-bit morton code : Magic bits (perfect shuffle)
+constexpr uint32_t morton2D_32_Encode_magicbits(const uint16_t x, const uint16_t y) {
+	return morton2D_32_Shuffle((uint32_t)y << 16 | x);
+}
+
+// DECODE 2D 32-bit morton code : Magic bits (perfect unshuffle)
+inline void morton2D_32_Decode_magicbits(const uint32_t m, uint16_t& x, uint16_t& y) {
+	const uint32_t v = morton2D_32_Unshuffle(m);
+	x = (uint16_t)v;
+	y = (uint16_t)(v >> 16);
+}
+
+// ENCODE 2D 32-bit morton code : LUT preshifted, with 32-bit arithmetic
+inline uint32_t morton2D_32_Encode_LUT256_shifted(const uint16_t x, const uint16_t y) {
+	return (uint32_t)(Morton2D_encode_y_256[y >> 8] | Morton2D_encode_x_256[x >> 8]) << 16
+		| (uint32_t)(Morton2D_encode_y_256[y & 0xFF] | Morton2D_encode_x_256[x & 0xFF]);
+}
+
+#if defined(__BMI2__)
+// ENCODE 2D 32-bit morton code : BMI2 bit deposit. Fast on Intel since Haswell and AMD since Zen 3;
+// PDEP and PEXT are microcoded (slow) on earlier AMD processors.
+inline uint32_t morton2D_32_Encode_BMI2(const uint16_t x, const uint16_t y) {
+	return _pdep_u32(x, 0x55555555) | _pdep_u32(y, 0xAAAAAAAA);
+}
+
+// DECODE 2D 32-bit morton code : BMI2 bit extract
+inline void morton2D_32_Decode_BMI2(const uint32_t m, uint16_t& x, uint16_t& y) {
+	x = (uint16_t)_pext_u32(m, 0x55555555);
+	y = (uint16_t)_pext_u32(m, 0xAAAAAAAA);
+}
+#endif
+
+// BATCH ENCODE / DECODE : the same shuffles on 8 codes per AVX2 register or 16 codes per AVX-512 register,
+// depending on the instruction set the code is compiled for. The scalar kernels handle the rest.
+#if defined(__AVX512F__)
+inline __m512i morton2D_32_Shuffle16(__m512i v) {
+	__m512i t;
+	t = _mm512_and_si512(_mm512_xor_si512(v, _mm512_srli_epi32(v, 8)), _mm512_set1_epi32(0x0000FF00)); v = _mm512_xor_si512(v, _mm512_xor_si512(t, _mm512_slli_epi32(t, 8)));
+	t = _mm512_and_si512(_mm512_xor_si512(v, _mm512_srli_epi32(v, 4)), _mm512_set1_epi32(0x00F000F0)); v = _mm512_xor_si512(v, _mm512_xor_si512(t, _mm512_slli_epi32(t, 4)));
+	t = _mm512_and_si512(_mm512_xor_si512(v, _mm512_srli_epi32(v, 2)), _mm512_set1_epi32(0x0C0C0C0C)); v = _mm512_xor_si512(v, _mm512_xor_si512(t, _mm512_slli_epi32(t, 2)));
+	t = _mm512_and_si512(_mm512_xor_si512(v, _mm512_srli_epi32(v, 1)), _mm512_set1_epi32(0x22222222)); v = _mm512_xor_si512(v, _mm512_xor_si512(t, _mm512_slli_epi32(t, 1)));
+	return v;
+}
+
+inline __m512i morton2D_32_Unshuffle16(__m512i v) {
+	__m512i t;
+	t = _mm512_and_si512(_mm512_xor_si512(v, _mm512_srli_epi32(v, 1)), _mm512_set1_epi32(0x22222222)); v = _mm512_xor_si512(v, _mm512_xor_si512(t, _mm512_slli_epi32(t, 1)));
+	t = _mm512_and_si512(_mm512_xor_si512(v, _mm512_srli_epi32(v, 2)), _mm512_set1_epi32(0x0C0C0C0C)); v = _mm512_xor_si512(v, _mm512_xor_si512(t, _mm512_slli_epi32(t, 2)));
+	t = _mm512_and_si512(_mm512_xor_si512(v, _mm512_srli_epi32(v, 4)), _mm512_set1_epi32(0x00F000F0)); v = _mm512_xor_si512(v, _mm512_xor_si512(t, _mm512_slli_epi32(t, 4)));
+	t = _mm512_and_si512(_mm512_xor_si512(v, _mm512_srli_epi32(v, 8)), _mm512_set1_epi32(0x0000FF00)); v = _mm512_xor_si512(v, _mm512_xor_si512(t, _mm512_slli_epi32(t, 8)));
+	return v;
+}
+static const size_t MORTON2D_32_BATCH = 16;
+#elif defined(__AVX2__)
+inline __m256i morton2D_32_Shuffle8(__m256i v) {
+	__m256i t;
+	t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 8)), _mm256_set1_epi32(0x0000FF00)); v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi32(t, 8)));
+	t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 4)), _mm256_set1_epi32(0x00F000F0)); v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi32(t, 4)));
+	t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 2)), _mm256_set1_epi32(0x0C0C0C0C)); v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi32(t, 2)));
+	t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 1)), _mm256_set1_epi32(0x22222222)); v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi32(t, 1)));
+	return v;
+}
+
+inline __m256i morton2D_32_Unshuffle8(__m256i v) {
+	__m256i t;
+	t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 1)), _mm256_set1_epi32(0x22222222)); v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi32(t, 1)));
+	t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 2)), _mm256_set1_epi32(0x0C0C0C0C)); v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi32(t, 2)));
+	t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 4)), _mm256_set1_epi32(0x00F000F0)); v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi32(t, 4)));
+	t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi32(v, 8)), _mm256_set1_epi32(0x0000FF00)); v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi32(t, 8)));
+	return v;
+}
+static const size_t MORTON2D_32_BATCH = 8;
+#else
+static const size_t MORTON2D_32_BATCH = 1;
+#endif
+
+// codes[i] = code of (x[i], y[i]). Blocks are spread over the threads when OpenMP is enabled.
+inline void morton2D_32_EncodeArray(const uint16_t* x, const uint16_t* y, const size_t n, uint32_t* codes) {
+	const size_t blocks = n / MORTON2D_32_BATCH;
+#pragma omp parallel for schedule(static)
+	for (long long b = 0; b < (long long)blocks; ++b) {
+		const size_t i = (size_t)b * MORTON2D_32_BATCH;
+#if defined(__AVX512F__)
+		const __m512i vx = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(x + i)));
+		const __m512i vy = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(y + i)));
+		_mm512_storeu_si512((void*)(codes + i), morton2D_32_Shuffle16(_mm512_or_si512(vx, _mm512_slli_epi32(vy, 16))));
+#elif defined(__AVX2__)
+		const __m256i vx = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(x + i)));
+		const __m256i vy = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(y + i)));
+		_mm256_storeu_si256((__m256i*)(codes + i), morton2D_32_Shuffle8(_mm256_or_si256(vx, _mm256_slli_epi32(vy, 16))));
+#else
+		codes[i] = morton2D_32_Encode_magicbits(x[i], y[i]);
+#endif
+	}
+	for (size_t i = blocks * MORTON2D_32_BATCH; i < n; ++i) { codes[i] = morton2D_32_Encode_magicbits(x[i], y[i]); }
+}
+
+// (x[i], y[i]) = coordinates of codes[i]
+inline void morton2D_32_DecodeArray(const uint32_t* codes, const size_t n, uint16_t* x, uint16_t* y) {
+	const size_t blocks = n / MORTON2D_32_BATCH;
+#pragma omp parallel for schedule(static)
+	for (long long b = 0; b < (long long)blocks; ++b) {
+		const size_t i = (size_t)b * MORTON2D_32_BATCH;
+#if defined(__AVX512F__)
+		const __m512i v = morton2D_32_Unshuffle16(_mm512_loadu_si512((const void*)(codes + i)));
+		_mm256_storeu_si256((__m256i*)(x + i), _mm512_cvtepi32_epi16(v));
+		_mm256_storeu_si256((__m256i*)(y + i), _mm512_cvtepi32_epi16(_mm512_srli_epi32(v, 16)));
+#elif defined(__AVX2__)
+		const __m256i v = morton2D_32_Unshuffle8(_mm256_loadu_si256((const __m256i*)(codes + i)));
+		// x0..x3 y0..y3 | x4..x7 y4..y7, then x0..x7 | y0..y7
+		const __m256i xy = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xFFFF)), _mm256_srli_epi32(v, 16)), 0xD8);
+		_mm_storeu_si128((__m128i*)(x + i), _mm256_castsi256_si128(xy));
+		_mm_storeu_si128((__m128i*)(y + i), _mm256_extracti128_si256(xy, 1));
+#else
+		morton2D_32_Decode_magicbits(codes[i], x[i], y[i]);
+#endif
+	}
+	for (size_t i = blocks * MORTON2D_32_BATCH; i < n; ++i) { morton2D_32_Decode_magicbits(codes[i], x[i], y[i]); }
+}
+
+#endif // MORTON2D_32_H_
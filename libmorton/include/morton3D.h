@@ -3,7 +3,9 @@
 #define MORTON3D_64_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include <algorithm>
+#include <type_traits>
 #include "morton3D_LUTs.h"
 #include "morton_common.h"
 
@@ -14,7 +16,7 @@ template<typename morton, typename coord> inline morton morton3D_Encode_LUT256_s
 template<typename morton, typename coord> inline morton morton3D_Encode_LUT256_shifted_ET(const coord x, const coord y, const coord z);
 template<typename morton, typename coord> inline morton morton3D_Encode_LUT256(const coord x, const coord y, const coord z);
 template<typename morton, typename coord> inline morton morton3D_Encode_LUT256_ET(const coord x, const coord y, const coord z);
-template<typename morton, typename coord> inline morton morton3D_Encode_magicbits(const coord x, const coord y, const coord z);
+template<typename morton, typename coord> constexpr morton morton3D_Encode_magicbits(const coord x, const coord y, const coord z);
 template<typename morton, typename coord> inline morton morton3D_Encode_for(const coord x, const coord y, const coord z);
 template<typename morton, typename coord> inline morton morton3D_Encode_for_ET(const coord x, const coord y, const coord z);
 
@@ -22,10 +24,22 @@ template<typename morton, typename coord> inline void morton3D_Decode_LUT256_shi
 template<typename morton, typename coord> inline void morton3D_Decode_LUT256_shifted_ET(const morton m, coord& x, coord& y, coord& z);
 template<typename morton, typename coord> inline void morton3D_Decode_LUT256(const morton m, coord& x, coord& y, coord& z);
 template<typename morton, typename coord> inline void morton3D_Decode_LUT256_ET(const morton m, coord& x, coord& y, coord& z);
+template<typename morton, typename coord> inline void morton3D_Decode_LUT4096_packed(const morton m, coord& x, coord& y, coord& z);
+template<typename morton, typename coord> inline void morton3D_Decode_LUT32768_packed(const morton m, coord& x, coord& y, coord& z);
 template<typename morton, typename coord> inline void morton3D_Decode_magicbits(const morton m, coord& x, coord& y, coord& z);
 template<typename morton, typename coord> inline void morton3D_Decode_for(const morton m, coord& x, coord& y, coord& z);
 template<typename morton, typename coord> inline void morton3D_Decode_for_ET(const morton m, coord& x, coord& y, coord& z);
 
+template<typename morton> constexpr morton morton3D_IncX(const morton m);
+template<typename morton> constexpr morton morton3D_IncY(const morton m);
+template<typename morton> constexpr morton morton3D_IncZ(const morton m);
+template<typename morton> constexpr morton morton3D_DecX(const morton m);
+template<typename morton> constexpr morton morton3D_DecY(const morton m);
+template<typename morton> constexpr morton morton3D_DecZ(const morton m);
+template<typename morton> constexpr morton morton3D_Add(const morton a, const morton b);
+template<typename morton> constexpr morton morton3D_Sub(const morton a, const morton b);
+template<typename morton> constexpr unsigned int morton3D_maxLevel();
+
 // ENCODE 3D Morton code : Pre-shifted LUT
 template<typename morton, typename coord>
 inline morton morton3D_Encode_LUT256_shifted(const coord x, const coord y, const coord z) {
@@ -48,28 +62,43 @@ inline morton morton3D_Encode_LUT256_shifted(const coord x, const coord y, const
 	return answer;
 }
 
-// Helper method for ET LUT encode
+// Helper method for ET LUT encode: index of the highest byte holding a set bit in any of the coordinates,
+// capped to the bytes the code holds (2 per coordinate in a 32-bit code, 3 in a 64-bit one). False if all are 0.
 template<typename morton, typename coord>
-inline morton compute3D_ET_LUT_encode(const coord c, const coord *LUT) {
+inline bool compute3D_ET_LUT_encode_steps(const coord x, const coord y, const coord z, unsigned long& top) {
 	unsigned long maxbit = 0;
-	if (findFirstSetBit<coord>(c, &maxbit) == 0) {return 0;}
-	const static morton EIGHTBITMASK = 0x000000FF;
-	morton answer = LUT[c & EIGHTBITMASK];
-	unsigned int i = 8;
-	while (maxbit >= i) {
-		answer |= (LUT[(c >> i) & EIGHTBITMASK]) << i*3;
-		i += 8;
-	}
-	return answer;
+	if (!findFirstSetBit<morton>((morton)(x | y | z), &maxbit)) { return false; }
+	top = min<unsigned long>(maxbit >> 3, (sizeof(morton) <= 4) ? 1 : 2);
+	return true;
 }
 
 // ENCODE 3D Morton code : Pre-shifted LUT (Early termination version)
 template<typename morton, typename coord>
 inline morton morton3D_Encode_LUT256_shifted_ET(const coord x, const coord y, const coord z) {
-	morton answer_x = compute3D_ET_LUT_encode<morton, coord>(x, Morton3D_encode_x_256);
-	morton answer_y = compute3D_ET_LUT_encode<morton, coord>(y, Morton3D_encode_y_256);
-	morton answer_z = compute3D_ET_LUT_encode<morton, coord>(z, Morton3D_encode_z_256);
-	return answer_z | answer_y | answer_x;
+	unsigned long top = 0;
+	if (!compute3D_ET_LUT_encode_steps<morton, coord>(x, y, z, top)) { return 0; }
+	const static morton EIGHTBITMASK = 0x000000FF;
+	morton answer = 0;
+	switch (top) { // jump to the highest byte, then fall through down to byte 0
+	case 2:
+		answer =
+			Morton3D_encode_z_256[(z >> 16) & EIGHTBITMASK] |
+			Morton3D_encode_y_256[(y >> 16) & EIGHTBITMASK] |
+			Morton3D_encode_x_256[(x >> 16) & EIGHTBITMASK];
+		// fall through
+	case 1:
+		answer = answer << 24 |
+			Morton3D_encode_z_256[(z >> 8) & EIGHTBITMASK] |
+			Morton3D_encode_y_256[(y >> 8) & EIGHTBITMASK] |
+			Morton3D_encode_x_256[(x >> 8) & EIGHTBITMASK];
+		// fall through
+	default:
+		answer = answer << 24 |
+			Morton3D_encode_z_256[z & EIGHTBITMASK] |
+			Morton3D_encode_y_256[y & EIGHTBITMASK] |
+			Morton3D_encode_x_256[x & EIGHTBITMASK];
+	}
+	return answer;
 }
 
 // ENCODE 3D Morton code : LUT
@@ -97,30 +126,52 @@ inline morton morton3D_Encode_LUT256(const coord x, const coord y, const coord z
 // ENCODE 3D 64-bit morton code : LUT (Early termination version)
 template<typename morton, typename coord>
 inline morton morton3D_Encode_LUT256_ET(const coord x, const coord y, const coord z) {
-	morton answer_x = compute3D_ET_LUT_encode<morton, coord>(x, Morton3D_encode_x_256);
-	morton answer_y = compute3D_ET_LUT_encode<morton, coord>(y, Morton3D_encode_x_256);
-	morton answer_z = compute3D_ET_LUT_encode<morton, coord>(z, Morton3D_encode_x_256);
-	return (answer_z << 2) | (answer_y << 1) | answer_x;
+	unsigned long top = 0;
+	if (!compute3D_ET_LUT_encode_steps<morton, coord>(x, y, z, top)) { return 0; }
+	const static morton EIGHTBITMASK = 0x000000FF;
+	morton answer = 0;
+	switch (top) { // jump to the highest byte, then fall through down to byte 0
+	case 2:
+		answer =
+			(Morton3D_encode_x_256[(z >> 16) & EIGHTBITMASK] << 2)
+			| (Morton3D_encode_x_256[(y >> 16) & EIGHTBITMASK] << 1)
+			| Morton3D_encode_x_256[(x >> 16) & EIGHTBITMASK];
+		// fall through
+	case 1:
+		answer = answer << 24 |
+			(Morton3D_encode_x_256[(z >> 8) & EIGHTBITMASK] << 2)
+			| (Morton3D_encode_x_256[(y >> 8) & EIGHTBITMASK] << 1)
+			| Morton3D_encode_x_256[(x >> 8) & EIGHTBITMASK];
+		// fall through
+	default:
+		answer = answer << 24 |
+			(Morton3D_encode_x_256[z & EIGHTBITMASK] << 2)
+			| (Morton3D_encode_x_256[y & EIGHTBITMASK] << 1)
+			| Morton3D_encode_x_256[x & EIGHTBITMASK];
+	}
+	return answer;
 }
 
 // ENCODE 3D 64-bit morton code : Magic bits (helper method)
-static const uint_fast32_t encode3D_masks32[5] = { 0, 0xff0000ff, 0x0f00f00f, 0xc30c30c3, 0x49249249};
-static const uint_fast64_t encode3D_masks64[5] = { 0xffff00000000ffff, 0x00ff0000ff0000ff, 0x100f00f00f00f00f, 0x10c30c30c30c30c3, 0x1249249249249249};
+static constexpr uint_fast64_t encode3D_masks32[5] = { 0, 0xff0000ff, 0x0f00f00f, 0xc30c30c3, 0x49249249};
+static constexpr uint_fast64_t encode3D_masks64[5] = { 0xffff00000000ffff, 0x00ff0000ff0000ff, 0x100f00f00f00f00f, 0x10c30c30c30c30c3, 0x1249249249249249};
+
+// Step i (0 .. 4) shifts by 32 >> i and applies mask i. 32-bit codes skip step 0. The steps are nested calls,
+// so that the magic bits methods are single return statements, which C++11 constexpr functions have to be.
+template<typename morton>
+constexpr morton morton3D_SplitBy3Step(const morton x, const unsigned int i) {
+	return (i == 0 && sizeof(morton) <= 4) ? x : (x | x << (32 >> i)) & (morton)((sizeof(morton) <= 4) ? encode3D_masks32[i] : encode3D_masks64[i]);
+}
+
 template<typename morton, typename coord>
-static inline morton morton3D_SplitBy3Bits(const coord a) {
-	const morton* masks = (sizeof(morton) <= 4) ? reinterpret_cast<const morton*>(encode3D_masks32) : reinterpret_cast<const morton*>(encode3D_masks64);
-	morton x = a;
-	if (sizeof(morton) > 4) { x = (x | x << 32) & masks[0];}
-	x = (x | x << 16) & masks[1];
-	x = (x | x << 8)  & masks[2];
-	x = (x | x << 4)  & masks[3];
-	x = (x | x << 2)  & masks[4];
-	return x;
+constexpr morton morton3D_SplitBy3Bits(const coord a) {
+	return morton3D_SplitBy3Step<morton>(morton3D_SplitBy3Step<morton>(morton3D_SplitBy3Step<morton>(morton3D_SplitBy3Step<morton>(
+		morton3D_SplitBy3Step<morton>((morton)a, 0), 1), 2), 3), 4);
 }
 
 // ENCODE 3D 64-bit morton code : Magic bits
 template<typename morton, typename coord>
-inline morton morton3D_Encode_magicbits(const coord x, const coord y, const coord z){
+constexpr morton morton3D_Encode_magicbits(const coord x, const coord y, const coord z){
 	return morton3D_SplitBy3Bits<morton, coord>(x) | (morton3D_SplitBy3Bits<morton, coord>(y) << 1) | (morton3D_SplitBy3Bits<morton, coord>(z) << 2);
 }
 
@@ -160,17 +211,16 @@ inline morton morton3D_Encode_for_ET(const coord x, const coord y, const coord z
 
 template<typename morton, typename coord>
 inline coord morton3D_DecodeCoord_LUT256_shifted(const morton m, const uint_fast8_t *LUT, unsigned int startshift) {
-	a = 0;
-	morton NINEBITMASK = 0x00000000000001ff;
-	a = LUT[(m >> startshift) & NINEBITMASK]
-		| (LUT[((m >> (startshift+9)) & NINEBITMASK)] << 3)
-		| (LUT[((m >> (startshift+18)) & NINEBITMASK)] << 6)
-		| (LUT[((m >> (startshift+27)) & NINEBITMASK)] << 9);
+	const morton NINEBITMASK = 0x00000000000001ff;
+	coord a = (coord)LUT[(m >> startshift) & NINEBITMASK]
+		| ((coord)LUT[((m >> (startshift+9)) & NINEBITMASK)] << 3)
+		| ((coord)LUT[((m >> (startshift+18)) & NINEBITMASK)] << 6)
+		| ((coord)LUT[((m >> (startshift+27)) & NINEBITMASK)] << 9);
 	if (sizeof(morton) > 4) {
 		a |=
-			  (LUT[((m >> (startshift+36)) & NINEBITMASK)] << 12)
-			| (LUT[((m >> (startshift+46)) & NINEBITMASK)] << 15)
-			| (LUT[((m >> (startshift+54)) & NINEBITMASK)] << 18);
+			  ((coord)LUT[((m >> (startshift+36)) & NINEBITMASK)] << 12)
+			| ((coord)LUT[((m >> (startshift+45)) & NINEBITMASK)] << 15)
+			| ((coord)LUT[((m >> (startshift+54)) & NINEBITMASK)] << 18);
 	}
 	return a;
 }
@@ -183,41 +233,41 @@ inline void morton3D_Decode_LUT256_shifted(const morton m, coord& x, coord& y, c
 	z = morton3D_DecodeCoord_LUT256_shifted<morton, coord>(m, Morton3D_decode_z_512, 0);
 }
 
+// Helper method for ET LUT decode: index of the highest 9-bit chunk of m holding a set bit, capped to the
+// chunks the full LUT methods read (4 in a 32-bit code, 7 in a 64-bit one). False if m is 0.
+template<typename morton>
+inline bool compute3D_ET_LUT_decode_steps(const morton m, unsigned long& top) {
+	unsigned long firstbit_location = 0;
+	if (!findFirstSetBit<morton>(m, &firstbit_location)) { return false; }
+	top = min<unsigned long>(firstbit_location / 9, (sizeof(morton) <= 4) ? 3 : 6);
+	return true;
+}
+
+// Helper method for ET LUT decode: shift the coordinates up by 3 bits and add the chunk of m at startshift
+template<typename morton, typename coord>
+inline void compute3D_ET_LUT_decode_chunk_shifted(const morton m, const unsigned int startshift, coord& x, coord& y, coord& z) {
+	const morton NINEBITMASK = 0x00000000000001ff;
+	const morton chunk = (m >> startshift) & NINEBITMASK;
+	x = (x << 3) | Morton3D_decode_x_512[chunk];
+	y = (y << 3) | Morton3D_decode_y_512[chunk];
+	z = (z << 3) | Morton3D_decode_z_512[chunk];
+}
+
 // DECODE 3D 64-bit morton code : Shifted LUT (Early termination version)
 template<typename morton, typename coord>
 inline void morton3D_Decode_LUT256_shifted_ET(const morton m, coord& x, coord& y, coord& z){
 	x = 0; y = 0; z = 0;
-	morton NINEBITMASK = 0x00000000000001ff;
-	unsigned long firstbit_location = 0;
-	if (!findFirstSetBit<morton>(m, &firstbit_location)) { return; }
-	x = x | Morton3D_decode_x_512[m & NINEBITMASK];
-	y = y | Morton3D_decode_y_512[m & NINEBITMASK];
-	z = z | Morton3D_decode_z_512[m & NINEBITMASK];
-	if (firstbit_location < 9) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 9) & NINEBITMASK)] << 3);
-	y = y | (Morton3D_decode_y_512[((m >> 9) & NINEBITMASK)] << 3);
-	z = z | (Morton3D_decode_z_512[((m >> 9) & NINEBITMASK)] << 3);
-	if (firstbit_location < 18) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 18) & NINEBITMASK)] << 6);
-	y = y | (Morton3D_decode_y_512[((m >> 18) & NINEBITMASK)] << 6);
-	z = z | (Morton3D_decode_z_512[((m >> 18) & NINEBITMASK)] << 6);
-	if (firstbit_location < 27) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 27) & NINEBITMASK)] << 9);
-	y = y | (Morton3D_decode_y_512[((m >> 27) & NINEBITMASK)] << 9);
-	z = z | (Morton3D_decode_z_512[((m >> 27) & NINEBITMASK)] << 9);
-	if (firstbit_location < 36) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 36) & NINEBITMASK)] << 12);
-	y = y | (Morton3D_decode_y_512[((m >> 36) & NINEBITMASK)] << 12);
-	z = z | (Morton3D_decode_z_512[((m >> 36) & NINEBITMASK)] << 12);
-	if (firstbit_location < 46) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 46) & NINEBITMASK)] << 15);
-	y = y | (Morton3D_decode_y_512[((m >> 46) & NINEBITMASK)] << 15);
-	z = z | (Morton3D_decode_z_512[((m >> 46) & NINEBITMASK)] << 15);
-	if (firstbit_location < 54) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 54) & NINEBITMASK)] << 18);
-	y = y | (Morton3D_decode_y_512[((m >> 54) & NINEBITMASK)] << 18);
-	z = z | (Morton3D_decode_z_512[((m >> 54) & NINEBITMASK)] << 18);
-	return;
+	unsigned long top = 0;
+	if (!compute3D_ET_LUT_decode_steps<morton>(m, top)) { return; }
+	switch (top) { // jump to the highest chunk, then fall through down to chunk 0
+	case 6: compute3D_ET_LUT_decode_chunk_shifted<morton, coord>(m, 54, x, y, z); // fall through
+	case 5: compute3D_ET_LUT_decode_chunk_shifted<morton, coord>(m, 45, x, y, z); // fall through
+	case 4: compute3D_ET_LUT_decode_chunk_shifted<morton, coord>(m, 36, x, y, z); // fall through
+	case 3: compute3D_ET_LUT_decode_chunk_shifted<morton, coord>(m, 27, x, y, z); // fall through
+	case 2: compute3D_ET_LUT_decode_chunk_shifted<morton, coord>(m, 18, x, y, z); // fall through
+	case 1: compute3D_ET_LUT_decode_chunk_shifted<morton, coord>(m, 9, x, y, z); // fall through
+	default: compute3D_ET_LUT_decode_chunk_shifted<morton, coord>(m, 0, x, y, z);
+	}
 }
 
 // DECODE 3D 64-bit morton code : LUT
@@ -228,56 +278,104 @@ inline void morton3D_Decode_LUT256(const morton m, coord& x, coord& y, coord& z)
 	z = morton3D_DecodeCoord_LUT256_shifted<morton, coord>(m, Morton3D_decode_x_512, 2);
 }
 
+// Helper method for ET LUT decode: shift the coordinates up by 3 bits and add the chunk of m at startshift,
+// reading all three coordinates through the x table
+template<typename morton, typename coord>
+inline void compute3D_ET_LUT_decode_chunk(const morton m, const unsigned int startshift, coord& x, coord& y, coord& z) {
+	const morton NINEBITMASK = 0x00000000000001ff;
+	x = (x << 3) | Morton3D_decode_x_512[(m >> startshift) & NINEBITMASK];
+	y = (y << 3) | Morton3D_decode_x_512[(m >> (startshift + 1)) & NINEBITMASK];
+	z = (z << 3) | Morton3D_decode_x_512[(m >> (startshift + 2)) & NINEBITMASK];
+}
+
 // DECODE 3D 64-bit morton code : LUT (Early termination version)
 template<typename morton, typename coord>
 inline void morton3D_Decode_LUT256_ET(const morton m, coord& x, coord& y, coord& z){
 	x = 0; y = 0; z = 0;
-	morton NINEBITMASK = 0x00000000000001ff;
-	unsigned long firstbit_location = 0;
-	if (!findFirstSetBit<uint_fast64_t>(m, &firstbit_location)) { return; }
-	x = x | Morton3D_decode_x_512[m & NINEBITMASK];
-	y = y | Morton3D_decode_x_512[(m >> 1) & NINEBITMASK];
-	z = z | Morton3D_decode_x_512[(m >> 2) & NINEBITMASK];
-	if (firstbit_location < 9) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 9) & NINEBITMASK)] << 3);
-	y = y | (Morton3D_decode_x_512[((m >> 10) & NINEBITMASK)] << 3);
-	z = z | (Morton3D_decode_x_512[((m >> 11) & NINEBITMASK)] << 3);
-	if (firstbit_location < 18) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 18) & NINEBITMASK)] << 6);
-	y = y | (Morton3D_decode_x_512[((m >> 19) & NINEBITMASK)] << 6);
-	z = z | (Morton3D_decode_x_512[((m >> 20) & NINEBITMASK)] << 6);
-	if (firstbit_location < 27) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 27) & NINEBITMASK)] << 9);
-	y = y | (Morton3D_decode_x_512[((m >> 28) & NINEBITMASK)] << 9);
-	z = z | (Morton3D_decode_x_512[((m >> 29) & NINEBITMASK)] << 9);
-	if (firstbit_location < 36) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 36) & NINEBITMASK)] << 12);
-	y = y | (Morton3D_decode_x_512[((m >> 37) & NINEBITMASK)] << 12);
-	z = z | (Morton3D_decode_x_512[((m >> 38) & NINEBITMASK)] << 12);
-	if (firstbit_location < 46) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 46) & NINEBITMASK)] << 15);
-	y = y | (Morton3D_decode_x_512[((m >> 47) & NINEBITMASK)] << 15);
-	z = z | (Morton3D_decode_x_512[((m >> 48) & NINEBITMASK)] << 15);
-	if (firstbit_location < 54) { return; }
-	x = x | (Morton3D_decode_x_512[((m >> 54) & NINEBITMASK)] << 18);
-	y = y | (Morton3D_decode_x_512[((m >> 55) & NINEBITMASK)] << 18);
-	z = z | (Morton3D_decode_x_512[((m >> 56) & NINEBITMASK)] << 18);
-	return;
-}
-
-static uint_fast32_t decode3D_masks32[5] = {0x49249249, 0x030c30c3, 0x0F00F00F, 0xFF0000FF, 0x0000FFFF};
-static uint_fast64_t decode3D_masks64[5] = {0x9249249249249249, 0x030c30c3030c30c3, 0xF00F00F00F00F00F, 0x00FF0000FF0000FF, 0x000000000000FFFF};
-
-// DECODE 3D 64-bit morton code : Magic bits (helper method)
+	unsigned long top = 0;
+	if (!compute3D_ET_LUT_decode_steps<morton>(m, top)) { return; }
+	switch (top) { // jump to the highest chunk, then fall through down to chunk 0
+	case 6: compute3D_ET_LUT_decode_chunk<morton, coord>(m, 54, x, y, z); // fall through
+	case 5: compute3D_ET_LUT_decode_chunk<morton, coord>(m, 45, x, y, z); // fall through
+	case 4: compute3D_ET_LUT_decode_chunk<morton, coord>(m, 36, x, y, z); // fall through
+	case 3: compute3D_ET_LUT_decode_chunk<morton, coord>(m, 27, x, y, z); // fall through
+	case 2: compute3D_ET_LUT_decode_chunk<morton, coord>(m, 18, x, y, z); // fall through
+	case 1: compute3D_ET_LUT_decode_chunk<morton, coord>(m, 9, x, y, z); // fall through
+	default: compute3D_ET_LUT_decode_chunk<morton, coord>(m, 0, x, y, z);
+	}
+}
+
+// DECODE 3D morton code : Packed LUT (helper table). Entry i holds the x, y and z bits of a chunk of BITS code
+// bits (BITS = 12 or 15) at bits 0, 21 and 42, so the entries of all chunks of a code add up to a 21:21:21 word
+// with one shift and OR each: one lookup serves all three coordinates. The 12-bit table takes 32 KB, the
+// 15-bit table 256 KB. Too big to be spelled out like the tables of morton3D_LUTs.h, they are built on first use.
+template<unsigned int BITS>
+struct morton3D_PackedDecodeTable {
+	static_assert(BITS % 3 == 0 && BITS <= 15, "Chunks hold the same number of bits of each coordinate, and at most 5");
+	uint_fast64_t entries[1 << BITS];
+	morton3D_PackedDecodeTable() {
+		for (uint_fast64_t i = 0; i < (1 << BITS); ++i) {
+			uint_fast64_t entry = 0;
+			for (unsigned int b = 0; b < BITS; ++b) { entry |= ((i >> b) & 1) << ((b % 3) * 21 + b / 3); }
+			entries[i] = entry;
+		}
+	}
+};
+
+template<unsigned int BITS>
+inline const uint_fast64_t* morton3D_PackedDecodeLUT() {
+	static const morton3D_PackedDecodeTable<BITS> table; // thread-safe initialization since C++11
+	return table.entries;
+}
+
+// DECODE 3D morton code : Packed LUT, with chunks of BITS bits (3 or 6 lookups for 12-bit chunks, 2 or 5 for 15-bit)
+template<typename morton, typename coord, unsigned int BITS>
+inline void morton3D_Decode_LUT_packed(const morton m, coord& x, coord& y, coord& z) {
+	const uint_fast64_t* LUT = morton3D_PackedDecodeLUT<BITS>();
+	const morton CHUNKMASK = (morton)((1 << BITS) - 1);
+	const morton code = (sizeof(morton) <= 4) ? m : (morton)(m & (morton)0x7FFFFFFFFFFFFFFF); // bit 63 would spill into y
+	uint_fast64_t w = 0;
+	for (unsigned int shift = 0; shift < 3 * morton3D_maxLevel<morton>(); shift += BITS) { // 30 or 63 code bits
+		w |= LUT[(code >> shift) & CHUNKMASK] << (shift / 3);
+	}
+	x = (coord)(w & 0x1FFFFF);
+	y = (coord)((w >> 21) & 0x1FFFFF);
+	z = (coord)(w >> 42);
+}
+
+// DECODE 3D morton code : Packed LUT, 4096 entries
+template<typename morton, typename coord>
+inline void morton3D_Decode_LUT4096_packed(const morton m, coord& x, coord& y, coord& z) {
+	morton3D_Decode_LUT_packed<morton, coord, 12>(m, x, y, z);
+}
+
+// DECODE 3D morton code : Packed LUT, 32768 entries
+template<typename morton, typename coord>
+inline void morton3D_Decode_LUT32768_packed(const morton m, coord& x, coord& y, coord& z) {
+	morton3D_Decode_LUT_packed<morton, coord, 15>(m, x, y, z);
+}
+
+// (the encode masks in reverse order, trimmed to 10 bits for 32-bit and 21 bits for 64-bit codes)
+static constexpr uint_fast64_t decode3D_masks32[6] = { 0x49249249, 0xc30c30c3, 0x0f00f00f, 0xff0000ff, 0x000003ff, 0 };
+static constexpr uint_fast64_t decode3D_masks64[6] = { 0x1249249249249249, 0x10c30c30c30c30c3, 0x100f00f00f00f00f, 0x001f0000ff0000ff, 0x001f00000000ffff, 0x00000000001fffff };
+
+// DECODE 3D 64-bit morton code : Magic bits (helper method). Step i (1 .. 5) shifts by 1 << i and applies mask i,
+// 32-bit codes skip step 5.
+template<typename morton>
+constexpr morton morton3D_GetThirdBitsStep(const morton x, const unsigned int i) {
+	return (i == 5 && sizeof(morton) <= 4) ? x : (x ^ (x >> (1 << i))) & (morton)((sizeof(morton) <= 4) ? decode3D_masks32[i] : decode3D_masks64[i]);
+}
+
 template<typename morton, typename coord>
-static inline coord morton3D_getThirdBits(const morton m) {
-	morton* masks = (sizeof(morton) <= 4) ? reinterpret_cast<morton*>(decode3D_masks32) : reinterpret_cast<morton*>(decode3D_masks64);
-	morton x = m & masks[0];
-	x = (x ^ (x >> 2)) & masks[1];
-	x = (x ^ (x >> 4)) & masks[2];
-	x = (x ^ (x >> 8)) & masks[3];
-	x = (x ^ (x >> 16)) & masks[4];
-	return (coord)x;
+constexpr coord morton3D_getThirdBits(const morton m) {
+	return (coord)morton3D_GetThirdBitsStep<morton>(morton3D_GetThirdBitsStep<morton>(morton3D_GetThirdBitsStep<morton>(morton3D_GetThirdBitsStep<morton>(
+		morton3D_GetThirdBitsStep<morton>(m & (morton)((sizeof(morton) <= 4) ? decode3D_masks32[0] : decode3D_masks64[0]), 1), 2), 3), 4), 5);
+}
+
+// DECODE 3D morton code : Magic bits, one coordinate (startshift 0 for x, 1 for y, 2 for z)
+template<typename morton, typename coord>
+constexpr coord morton3D_DecodeCoord_magicbits(const morton m, const unsigned int startshift) {
+	return morton3D_getThirdBits<morton, coord>(m >> startshift);
 }
 
 // DECODE 3D 64-bit morton code : Magic bits
@@ -294,7 +392,7 @@ inline void morton3D_Decode_for(const morton m, coord& x, coord& y, coord& z){
 	x = 0; y = 0; z = 0;
 	unsigned int checkbits = (sizeof(morton) <= 4) ? 10 : 21;
 
-	for (morton i = 0; i <= checkbits; ++i) {
+	for (morton i = 0; i < checkbits; ++i) {
 		x |= (m & (1ull << 3 * i)) >> ((2 * i));
 		y |= (m & (1ull << ((3 * i) + 1))) >> ((2 * i) + 1);
 		z |= (m & (1ull << ((3 * i) + 2))) >> ((2 * i) + 2);
@@ -320,4 +418,201 @@ inline void morton3D_Decode_for_ET(const morton m, coord& x, coord& y, coord& z)
 	}
 }
 
+// ARRAYS : codes[i] = encode(x[i], y[i], z[i]) for n points, and back, with any of the methods above (in parallel
+// when OpenMP is enabled). With exact-width types (uint16_t or uint32_t coordinates, uint32_t or uint64_t codes)
+// the arrays take the bytes the values need: uint_fast16_t and uint_fast32_t are 8 bytes on x86-64 Linux.
+template<typename morton, typename coord, morton (*encode)(const coord, const coord, const coord) = morton3D_Encode_LUT256_shifted<morton, coord> >
+inline void morton3D_EncodeArray(const coord* x, const coord* y, const coord* z, const size_t n, morton* codes) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		codes[i] = encode(x[i], y[i], z[i]);
+	}
+}
+
+template<typename morton, typename coord, void (*decode)(const morton, coord&, coord&, coord&) = morton3D_Decode_LUT256_shifted<morton, coord> >
+inline void morton3D_DecodeArray(const morton* codes, const size_t n, coord* x, coord* y, coord* z) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		decode(codes[i], x[i], y[i], z[i]);
+	}
+}
+
+// MORTON ARITHMETIC : work on the coordinates without decoding, by filling the bits of the
+// other axes with ones (so carries ripple through) or zeroes (so borrows ripple through)
+static constexpr uint_fast64_t morton3D_x_mask = 0x1249249249249249;
+static constexpr uint_fast64_t morton3D_y_mask = 0x2492492492492492;
+static constexpr uint_fast64_t morton3D_z_mask = 0x4924924924924924;
+
+template<typename morton>
+constexpr morton morton3D_IncAxis(const morton m, const morton mask) {
+	return (((m | ~mask) + 1) & mask) | (m & ~mask);
+}
+
+template<typename morton>
+constexpr morton morton3D_DecAxis(const morton m, const morton mask) {
+	return (((m & mask) - 1) & mask) | (m & ~mask);
+}
+
+template<typename morton>
+constexpr morton morton3D_AddAxis(const morton a, const morton b, const morton mask) {
+	return ((a | ~mask) + (b & mask)) & mask;
+}
+
+template<typename morton>
+constexpr morton morton3D_SubAxis(const morton a, const morton b, const morton mask) {
+	return ((a & mask) - (b & mask)) & mask;
+}
+
+// (x+1, y, z)
+template<typename morton>
+constexpr morton morton3D_IncX(const morton m) { return morton3D_IncAxis<morton>(m, (morton)morton3D_x_mask); }
+// (x, y+1, z)
+template<typename morton>
+constexpr morton morton3D_IncY(const morton m) { return morton3D_IncAxis<morton>(m, (morton)morton3D_y_mask); }
+// (x, y, z+1)
+template<typename morton>
+constexpr morton morton3D_IncZ(const morton m) { return morton3D_IncAxis<morton>(m, (morton)morton3D_z_mask); }
+// (x-1, y, z)
+template<typename morton>
+constexpr morton morton3D_DecX(const morton m) { return morton3D_DecAxis<morton>(m, (morton)morton3D_x_mask); }
+// (x, y-1, z)
+template<typename morton>
+constexpr morton morton3D_DecY(const morton m) { return morton3D_DecAxis<morton>(m, (morton)morton3D_y_mask); }
+// (x, y, z-1)
+template<typename morton>
+constexpr morton morton3D_DecZ(const morton m) { return morton3D_DecAxis<morton>(m, (morton)morton3D_z_mask); }
+
+// (xa + xb, ya + yb, za + zb)
+template<typename morton>
+constexpr morton morton3D_Add(const morton a, const morton b) {
+	return morton3D_AddAxis<morton>(a, b, (morton)morton3D_x_mask) | morton3D_AddAxis<morton>(a, b, (morton)morton3D_y_mask) | morton3D_AddAxis<morton>(a, b, (morton)morton3D_z_mask);
+}
+
+// (xa - xb, ya - yb, za - zb)
+template<typename morton>
+constexpr morton morton3D_Sub(const morton a, const morton b) {
+	return morton3D_SubAxis<morton>(a, b, (morton)morton3D_x_mask) | morton3D_SubAxis<morton>(a, b, (morton)morton3D_y_mask) | morton3D_SubAxis<morton>(a, b, (morton)morton3D_z_mask);
+}
+
+// SIGNED COORDINATES : coordinates in [-2^(BITS-1), 2^(BITS-1) - 1] are offset by 2^(BITS-1). On the BITS-bit
+// two's complement this flips the sign bit, so the order of the coordinates (and of the codes along each axis)
+// is kept: the most negative coordinate gets code 0. The offset is one add per coordinate on top of the unsigned
+// method, which is passed as a template argument, e.g. morton3D_EncodeSigned<uint_fast64_t, uint_fast32_t, morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t> >
+// BITS defaults to 21 for 64-bit codes and 10 for 32-bit codes. uint_fast32_t is 64 bits wide on some platforms,
+// so pass 10 explicitly when 32-bit codes are stored in it.
+template<typename coord, unsigned int BITS>
+inline coord morton3D_SignedOffset() { return (coord)1 << (BITS - 1); }
+
+template<typename morton, typename coord, morton (*encode)(const coord, const coord, const coord),
+	unsigned int BITS = (sizeof(morton) <= 4) ? 10 : 21>
+inline morton morton3D_EncodeSigned(const typename std::make_signed<coord>::type x, const typename std::make_signed<coord>::type y, const typename std::make_signed<coord>::type z) {
+	const coord offset = morton3D_SignedOffset<coord, BITS>();
+	return encode((coord)x + offset, (coord)y + offset, (coord)z + offset);
+}
+
+template<typename morton, typename coord, void (*decode)(const morton, coord&, coord&, coord&),
+	unsigned int BITS = (sizeof(morton) <= 4) ? 10 : 21>
+inline void morton3D_DecodeSigned(const morton m, typename std::make_signed<coord>::type& x, typename std::make_signed<coord>::type& y, typename std::make_signed<coord>::type& z) {
+	typedef typename std::make_signed<coord>::type scoord;
+	const coord offset = morton3D_SignedOffset<coord, BITS>();
+	coord ux, uy, uz;
+	decode(m, ux, uy, uz);
+	// unsigned subtraction wraps around for negative coordinates, the cast gives them back their sign
+	x = (scoord)(ux - offset);
+	y = (scoord)(uy - offset);
+	z = (scoord)(uz - offset);
+}
+
+// HIERARCHY : a code holds one octree level per 3 bits, root first. Level 0 is the root cell,
+// the deepest level is 21 for 64-bit codes and 10 for 32-bit codes (the unused top bits stay zero).
+template<typename morton>
+constexpr unsigned int morton3D_maxLevel() { return (sizeof(morton) * 8) / 3; }
+
+// Deepest level at which a and b lie in the same cell: the level of their lowest common ancestor
+// (morton3D_maxLevel if a == b).
+template<typename morton>
+inline unsigned int morton3D_commonLevel(const morton a, const morton b) {
+	// shift out the unused top bits and fill them in at the bottom: the argument is never zero,
+	// so the compiler drops the zero check of morton_clz, and a == b gives 3 * morton3D_maxLevel
+	const unsigned int unused_bits = sizeof(morton) * 8 - 3 * morton3D_maxLevel<morton>();
+	return morton_clz<morton>((morton)((a ^ b) << unused_bits) | (morton)(((morton)1 << unused_bits) - 1)) / 3;
+}
+
+// Code of the minimum corner of the cell at the given level (0 .. morton3D_maxLevel) that contains code
+template<typename morton>
+constexpr morton morton3D_ancestorAtLevel(const morton code, const unsigned int level) {
+	return code & ~(morton)(((morton)1 << (3 * (morton3D_maxLevel<morton>() - level))) - 1);
+}
+
+// Code of the cell at the given level that contains (x, y, z), as a 3 * level bit code: the top level bits
+// of the (morton3D_maxLevel bit) coordinates, interleaved. Equal to
+// morton3D_ancestorAtLevel(encode(x, y, z), level) >> 3 * (morton3D_maxLevel - level), but only the
+// ceil(level / 8) LUT lookups per coordinate that hold those bits are made.
+// level must be at most morton3D_maxLevel; deeper levels are clamped to it.
+template<typename morton, typename coord>
+inline morton morton3D_EncodeLevel(const coord x, const coord y, const coord z, unsigned int level) {
+	level = (level < morton3D_maxLevel<morton>()) ? level : morton3D_maxLevel<morton>();
+	const unsigned int shift = morton3D_maxLevel<morton>() - level;
+	const coord xs = x >> shift, ys = y >> shift, zs = z >> shift;
+	const static morton EIGHTBITMASK = 0x000000FF;
+	morton answer = 0;
+	for (unsigned int i = (level + 7) / 8; i-- > 0;) {
+		answer = answer << 24 |
+			Morton3D_encode_z_256[(zs >> (8 * i)) & EIGHTBITMASK] |
+			Morton3D_encode_y_256[(ys >> (8 * i)) & EIGHTBITMASK] |
+			Morton3D_encode_x_256[(xs >> (8 * i)) & EIGHTBITMASK];
+	}
+	return answer;
+}
+
+// codes[i] = morton3D_EncodeLevel(x[i], y[i], z[i], level) for n points (in parallel when OpenMP is enabled)
+template<typename morton, typename coord>
+inline void morton3D_EncodeLevels(const coord* x, const coord* y, const coord* z, const size_t n, const unsigned int level, morton* codes) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		codes[i] = morton3D_EncodeLevel<morton, coord>(x[i], y[i], z[i], level);
+	}
+}
+
+// levels[i] = morton3D_commonLevel(codes[i], codes[i + 1]) for the n - 1 neighbouring pairs of an array
+template<typename morton>
+inline void morton3D_commonLevels(const morton* codes, const size_t n, uint8_t* levels) {
+	for (size_t i = 0; i + 1 < n; ++i) {
+		levels[i] = (uint8_t)morton3D_commonLevel<morton>(codes[i], codes[i + 1]);
+	}
+}
+
+// BOX QUERIES : a box is given by the codes of its minimum and maximum corners (lo <= hi on every axis).
+// The codes inside a box are not contiguous in morton order: morton3D_NextInBox skips the gaps (the BIGMIN
+// computation of Tropf and Herzog, "Multidimensional range search in dynamically balanced trees", 1981).
+template<typename morton>
+inline bool morton3D_InBox(const morton code, const morton lo, const morton hi) {
+	const morton xm = (morton)morton3D_x_mask, ym = (morton)morton3D_y_mask, zm = (morton)morton3D_z_mask;
+	return (code & xm) >= (lo & xm) && (code & xm) <= (hi & xm)
+		&& (code & ym) >= (lo & ym) && (code & ym) <= (hi & ym)
+		&& (code & zm) >= (lo & zm) && (code & zm) <= (hi & zm);
+}
+
+// Smallest code larger than code that lies inside the box. code has to be smaller than hi.
+template<typename morton>
+inline morton morton3D_NextInBox(const morton code, morton lo, morton hi) {
+	morton next = hi;
+	for (int bit = 3 * morton3D_maxLevel<morton>() - 1; bit >= 0; --bit) {
+		const morton b = (morton)1 << bit;
+		const morton below = (morton)(morton3D_x_mask << (bit % 3)) & (b - 1); // lower bits of the same axis
+		switch (((code & b) ? 4 : 0) | ((lo & b) ? 2 : 0) | ((hi & b) ? 1 : 0)) {
+		case 1: // the box straddles this bit and code is in the lower half: the upper half starts at the
+			// candidate, keep searching in the lower half
+			next = (lo & ~below) | b;
+			hi = (hi & ~b) | below;
+			break;
+		case 3: return lo; // code is below the box on this axis
+		case 4: return next; // code is above the box on this axis
+		case 5: lo = (lo & ~below) | b; break; // code is in the upper half
+		default: break;
+		}
+	}
+	return next;
+}
+
 #endif // MORTON3D_64_H_
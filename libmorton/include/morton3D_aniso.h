@@ -0,0 +1,186 @@
+// Libmorton - Methods to encode/decode 3D morton codes with a different number of bits per axis
+#ifndef MORTON3D_ANISO_H_
+#define MORTON3D_ANISO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if _MSC_VER
+#include <intrin.h>
+#elif defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// A bit layout tells which axis each bit of the code belongs to. It is a struct with the bits per axis
+// (XBITS, YBITS, ZBITS and their sum BITS) and a constexpr axis(i), the axis (0 = x, 1 = y, 2 = z) of code bit i.
+// Any struct with these members can be used as a layout. The codes of a layout take its BITS lowest bits.
+
+// Layout with one bit of each axis per level, in x, y, z order. With LOW_ALIGNED, all axes start at level 0 and
+// the shorter ones run out first, so the top levels of a 24/24/16 code split only x and y: for a flat domain
+// of cubic cells, a quadtree above an octree. Otherwise all axes end at the top level, and the shorter ones
+// start higher up. morton3D_LevelLayout<21, 21, 21> gives the codes of morton3D_64_encode.
+template<unsigned int X, unsigned int Y, unsigned int Z, bool LOW_ALIGNED = true>
+struct morton3D_LevelLayout {
+	static const unsigned int XBITS = X, YBITS = Y, ZBITS = Z, BITS = X + Y + Z;
+	static const unsigned int LEVELS = (X > Y) ? ((X > Z) ? X : Z) : ((Y > Z) ? Y : Z);
+
+	static constexpr unsigned int bits(const unsigned int a) {
+		return (a == 0) ? X : ((a == 1) ? Y : Z);
+	}
+	// Does axis a have a bit at this level
+	static constexpr bool active(const unsigned int a, const unsigned int level) {
+		return LOW_ALIGNED ? level < bits(a) : level + bits(a) >= LEVELS;
+	}
+	static constexpr unsigned int count(const unsigned int level) {
+		return (active(0, level) ? 1 : 0) + (active(1, level) ? 1 : 0) + (active(2, level) ? 1 : 0);
+	}
+	// The n-th axis from axis a on which has a bit at this level
+	static constexpr unsigned int nth(const unsigned int n, const unsigned int level, const unsigned int a) {
+		return (a > 2) ? 3 : (active(a, level) ? ((n == 0) ? a : nth(n - 1, level, a + 1)) : nth(n, level, a + 1));
+	}
+	// Axis of bit i of the code, with the bits counted from the start of this level
+	static constexpr unsigned int axisFrom(const unsigned int i, const unsigned int level) {
+		return (level >= LEVELS) ? 3 : ((i < count(level)) ? nth(i, level, 0) : axisFrom(i - count(level), level + 1));
+	}
+	static constexpr unsigned int axis(const unsigned int i) {
+		return axisFrom(i, 0);
+	}
+};
+
+// Mask of the code bits of axis a in a layout, from bit i up
+template<typename morton, typename layout>
+constexpr morton morton3D_LayoutMask(const unsigned int a, const unsigned int i = 0) {
+	return (i >= layout::BITS) ? (morton)0 : (((layout::axis(i) == a) ? (morton)((morton)1 << i) : (morton)0) | morton3D_LayoutMask<morton, layout>(a, i + 1));
+}
+
+// Parallel suffix (Hacker's Delight, 5-2): bit i of the result is the parity of the bits of x at and below i
+template<typename morton>
+constexpr morton morton_ParallelSuffix(const morton x, const unsigned int shift = 1) {
+	return (shift >= sizeof(morton) * 8) ? x : morton_ParallelSuffix<morton>((morton)(x ^ (x << shift)), shift << 1);
+}
+
+// Move masks of the compress of mask m (Hacker's Delight, 7-4): step i moves the bits under move mask i down
+// by 2^i places. mk starts at ~m << 1, and is the mask of the bits which still have zeroes to move over.
+template<typename morton>
+constexpr morton morton_CompressMoveMask(const morton m, const morton mk, const unsigned int i, const unsigned int step) {
+	return (i == step) ? (morton)(morton_ParallelSuffix<morton>(mk) & m)
+		: morton_CompressMoveMask<morton>((morton)((m & ~(morton_ParallelSuffix<morton>(mk) & m)) | ((morton_ParallelSuffix<morton>(mk) & m) >> (1u << i))),
+			(morton)(mk & ~morton_ParallelSuffix<morton>(mk)), i + 1, step);
+}
+
+template<typename morton, typename layout>
+constexpr morton morton3D_LayoutMoveMask(const unsigned int a, const unsigned int step) {
+	return morton_CompressMoveMask<morton>(morton3D_LayoutMask<morton, layout>(a), (morton)(~morton3D_LayoutMask<morton, layout>(a) << 1), 0, step);
+}
+
+// The masks of a layout, computed once at compile time: the code bits of each axis, the low bits a coordinate
+// has, and the move masks of the 6 compress / expand steps (5 for 32-bit codes)
+template<typename morton, typename layout>
+struct morton3D_LayoutMasks {
+	static_assert(layout::BITS <= sizeof(morton) * 8, "The layout has more bits than the morton type");
+	static constexpr morton axis[3] = { morton3D_LayoutMask<morton, layout>(0), morton3D_LayoutMask<morton, layout>(1), morton3D_LayoutMask<morton, layout>(2) };
+	static constexpr morton low[3] = { (morton)(((uint_fast64_t)1 << layout::XBITS) - 1), (morton)(((uint_fast64_t)1 << layout::YBITS) - 1), (morton)(((uint_fast64_t)1 << layout::ZBITS) - 1) };
+	static constexpr morton move[3][6] = {
+		{ morton3D_LayoutMoveMask<morton, layout>(0, 0), morton3D_LayoutMoveMask<morton, layout>(0, 1), morton3D_LayoutMoveMask<morton, layout>(0, 2),
+		  morton3D_LayoutMoveMask<morton, layout>(0, 3), morton3D_LayoutMoveMask<morton, layout>(0, 4), morton3D_LayoutMoveMask<morton, layout>(0, 5) },
+		{ morton3D_LayoutMoveMask<morton, layout>(1, 0), morton3D_LayoutMoveMask<morton, layout>(1, 1), morton3D_LayoutMoveMask<morton, layout>(1, 2),
+		  morton3D_LayoutMoveMask<morton, layout>(1, 3), morton3D_LayoutMoveMask<morton, layout>(1, 4), morton3D_LayoutMoveMask<morton, layout>(1, 5) },
+		{ morton3D_LayoutMoveMask<morton, layout>(2, 0), morton3D_LayoutMoveMask<morton, layout>(2, 1), morton3D_LayoutMoveMask<morton, layout>(2, 2),
+		  morton3D_LayoutMoveMask<morton, layout>(2, 3), morton3D_LayoutMoveMask<morton, layout>(2, 4), morton3D_LayoutMoveMask<morton, layout>(2, 5) } };
+};
+template<typename morton, typename layout> constexpr morton morton3D_LayoutMasks<morton, layout>::axis[3];
+template<typename morton, typename layout> constexpr morton morton3D_LayoutMasks<morton, layout>::low[3];
+template<typename morton, typename layout> constexpr morton morton3D_LayoutMasks<morton, layout>::move[3][6];
+
+// ENCODE 3D anisotropic morton code : Magic bits (helper method). Expand step i (Hacker's Delight, 7-5) moves
+// the bits under move mask i up by 2^i places. The steps run from 5 down to 0, 32-bit codes skip step 5.
+template<typename morton, typename layout>
+constexpr morton morton3D_AnisoExpandStep(const morton v, const unsigned int a, const unsigned int i) {
+	return (i == 5 && sizeof(morton) <= 4) ? v
+		: (morton)((v & ~morton3D_LayoutMasks<morton, layout>::move[a][i]) | ((v << (1u << i)) & morton3D_LayoutMasks<morton, layout>::move[a][i]));
+}
+
+template<typename morton, typename layout, typename coord>
+constexpr morton morton3D_AnisoDeposit(const coord c, const unsigned int a) {
+	return morton3D_AnisoExpandStep<morton, layout>(morton3D_AnisoExpandStep<morton, layout>(morton3D_AnisoExpandStep<morton, layout>(
+		morton3D_AnisoExpandStep<morton, layout>(morton3D_AnisoExpandStep<morton, layout>(morton3D_AnisoExpandStep<morton, layout>(
+		(morton)c & morton3D_LayoutMasks<morton, layout>::low[a], a, 5), a, 4), a, 3), a, 2), a, 1), a, 0) & morton3D_LayoutMasks<morton, layout>::axis[a];
+}
+
+// ENCODE 3D anisotropic morton code : Magic bits
+template<typename morton, typename layout, typename coord>
+constexpr morton morton3D_EncodeAniso_magicbits(const coord x, const coord y, const coord z) {
+	return morton3D_AnisoDeposit<morton, layout, coord>(x, 0) | morton3D_AnisoDeposit<morton, layout, coord>(y, 1) | morton3D_AnisoDeposit<morton, layout, coord>(z, 2);
+}
+
+// DECODE 3D anisotropic morton code : Magic bits (helper method). Compress step i moves the bits under move
+// mask i down by 2^i places. The steps run from 0 up to 5, 32-bit codes skip step 5.
+template<typename morton, typename layout>
+constexpr morton morton3D_AnisoCompressStep(const morton v, const unsigned int a, const unsigned int i) {
+	return (i == 5 && sizeof(morton) <= 4) ? v
+		: (morton)((v & ~morton3D_LayoutMasks<morton, layout>::move[a][i]) | ((v & morton3D_LayoutMasks<morton, layout>::move[a][i]) >> (1u << i)));
+}
+
+template<typename morton, typename layout, typename coord>
+constexpr coord morton3D_AnisoExtract(const morton m, const unsigned int a) {
+	return (coord)morton3D_AnisoCompressStep<morton, layout>(morton3D_AnisoCompressStep<morton, layout>(morton3D_AnisoCompressStep<morton, layout>(
+		morton3D_AnisoCompressStep<morton, layout>(morton3D_AnisoCompressStep<morton, layout>(morton3D_AnisoCompressStep<morton, layout>(
+		m & morton3D_LayoutMasks<morton, layout>::axis[a], a, 0), a, 1), a, 2), a, 3), a, 4), a, 5);
+}
+
+// DECODE 3D anisotropic morton code : Magic bits
+template<typename morton, typename layout, typename coord>
+inline void morton3D_DecodeAniso_magicbits(const morton m, coord& x, coord& y, coord& z) {
+	x = morton3D_AnisoExtract<morton, layout, coord>(m, 0);
+	y = morton3D_AnisoExtract<morton, layout, coord>(m, 1);
+	z = morton3D_AnisoExtract<morton, layout, coord>(m, 2);
+}
+
+#if defined(__BMI2__)
+// ENCODE 3D anisotropic morton code : BMI2 bit deposit, with the axis masks of the layout
+template<typename morton, typename layout, typename coord>
+inline morton morton3D_EncodeAniso_BMI2(const coord x, const coord y, const coord z) {
+	typedef morton3D_LayoutMasks<morton, layout> masks;
+	if (sizeof(morton) <= 4) {
+		return (morton)(_pdep_u32((uint32_t)x, (uint32_t)masks::axis[0]) | _pdep_u32((uint32_t)y, (uint32_t)masks::axis[1]) | _pdep_u32((uint32_t)z, (uint32_t)masks::axis[2]));
+	}
+	return (morton)(_pdep_u64((uint64_t)x, (uint64_t)masks::axis[0]) | _pdep_u64((uint64_t)y, (uint64_t)masks::axis[1]) | _pdep_u64((uint64_t)z, (uint64_t)masks::axis[2]));
+}
+
+// DECODE 3D anisotropic morton code : BMI2 bit extract
+template<typename morton, typename layout, typename coord>
+inline void morton3D_DecodeAniso_BMI2(const morton m, coord& x, coord& y, coord& z) {
+	typedef morton3D_LayoutMasks<morton, layout> masks;
+	if (sizeof(morton) <= 4) {
+		x = (coord)_pext_u32((uint32_t)m, (uint32_t)masks::axis[0]);
+		y = (coord)_pext_u32((uint32_t)m, (uint32_t)masks::axis[1]);
+		z = (coord)_pext_u32((uint32_t)m, (uint32_t)masks::axis[2]);
+		return;
+	}
+	x = (coord)_pext_u64((uint64_t)m, (uint64_t)masks::axis[0]);
+	y = (coord)_pext_u64((uint64_t)m, (uint64_t)masks::axis[1]);
+	z = (coord)_pext_u64((uint64_t)m, (uint64_t)masks::axis[2]);
+}
+#endif
+
+// ENCODE / DECODE 3D anisotropic morton code : BMI2 when the code is compiled for it, magic bits otherwise.
+// Coordinate bits above the bits of their axis are ignored.
+template<typename morton, typename layout, typename coord>
+inline morton morton3D_EncodeAniso(const coord x, const coord y, const coord z) {
+#if defined(__BMI2__)
+	return morton3D_EncodeAniso_BMI2<morton, layout, coord>(x, y, z);
+#else
+	return morton3D_EncodeAniso_magicbits<morton, layout, coord>(x, y, z);
+#endif
+}
+
+template<typename morton, typename layout, typename coord>
+inline void morton3D_DecodeAniso(const morton m, coord& x, coord& y, coord& z) {
+#if defined(__BMI2__)
+	morton3D_DecodeAniso_BMI2<morton, layout, coord>(m, x, y, z);
+#else
+	morton3D_DecodeAniso_magicbits<morton, layout, coord>(m, x, y, z);
+#endif
+}
+
+#endif // MORTON3D_ANISO_H_
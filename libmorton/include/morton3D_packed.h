@@ -0,0 +1,201 @@
+// Libmorton - Methods to encode/decode 3D morton codes directly from/to packed coordinate words
+#ifndef MORTON3D_PACKED_H_
+#define MORTON3D_PACKED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "morton3D.h"
+
+#if _MSC_VER
+#include <intrin.h>
+#elif defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// Packed formats, with x in the lowest field :
+//   10:10:10 : x in bits 0-9, y in bits 10-19, z in bits 20-29 of a 32-bit word (bits 30-31 are ignored), 30-bit codes
+//   21:21:21 : x in bits 0-20, y in bits 21-41, z in bits 42-62 of a 64-bit word (bit 63 is ignored), 63-bit codes
+//   16-bit SoA : separate uint16_t x, y and z arrays, 48-bit codes
+// Going from a packed word to its code is a fixed permutation of its bits, so the fields are deposited straight
+// into their code positions, without unpacking them into coordinates first.
+
+// ENCODE 3D 32-bit morton code from a 10:10:10 word : Magic bits
+constexpr uint32_t morton3D_32_EncodePacked10_magicbits(const uint32_t w) {
+	return morton3D_SplitBy3Bits<uint32_t, uint32_t>(w & 0x3FF)
+		| (morton3D_SplitBy3Bits<uint32_t, uint32_t>((w >> 10) & 0x3FF) << 1)
+		| (morton3D_SplitBy3Bits<uint32_t, uint32_t>((w >> 20) & 0x3FF) << 2);
+}
+
+// DECODE 3D 32-bit morton code to a 10:10:10 word : Magic bits
+constexpr uint32_t morton3D_32_DecodePacked10_magicbits(const uint32_t m) {
+	return morton3D_getThirdBits<uint32_t, uint32_t>(m)
+		| (morton3D_getThirdBits<uint32_t, uint32_t>(m >> 1) << 10)
+		| (morton3D_getThirdBits<uint32_t, uint32_t>(m >> 2) << 20);
+}
+
+// ENCODE 3D 64-bit morton code from a 21:21:21 word : Magic bits
+constexpr uint64_t morton3D_64_EncodePacked21_magicbits(const uint64_t w) {
+	return morton3D_SplitBy3Bits<uint64_t, uint64_t>(w & 0x1FFFFF)
+		| (morton3D_SplitBy3Bits<uint64_t, uint64_t>((w >> 21) & 0x1FFFFF) << 1)
+		| (morton3D_SplitBy3Bits<uint64_t, uint64_t>((w >> 42) & 0x1FFFFF) << 2);
+}
+
+// DECODE 3D 64-bit morton code to a 21:21:21 word : Magic bits
+constexpr uint64_t morton3D_64_DecodePacked21_magicbits(const uint64_t m) {
+	return morton3D_getThirdBits<uint64_t, uint64_t>(m)
+		| (morton3D_getThirdBits<uint64_t, uint64_t>(m >> 1) << 21)
+		| (morton3D_getThirdBits<uint64_t, uint64_t>(m >> 2) << 42);
+}
+
+#if defined(__BMI2__)
+// ENCODE 3D 32-bit morton code from a 10:10:10 word : BMI2 bit deposit, one per field. As for morton2D_32.h,
+// PDEP and PEXT are only fast on Intel since Haswell and AMD since Zen 3.
+inline uint32_t morton3D_32_EncodePacked10_BMI2(const uint32_t w) {
+	return _pdep_u32(w, 0x09249249) | _pdep_u32(w >> 10, 0x12492492) | _pdep_u32(w >> 20, 0x24924924);
+}
+
+// DECODE 3D 32-bit morton code to a 10:10:10 word : BMI2 bit extract
+inline uint32_t morton3D_32_DecodePacked10_BMI2(const uint32_t m) {
+	return _pext_u32(m, 0x09249249) | (_pext_u32(m, 0x12492492) << 10) | (_pext_u32(m, 0x24924924) << 20);
+}
+
+// ENCODE 3D 64-bit morton code from a 21:21:21 word : BMI2 bit deposit
+inline uint64_t morton3D_64_EncodePacked21_BMI2(const uint64_t w) {
+	return _pdep_u64(w, 0x1249249249249249) | _pdep_u64(w >> 21, 0x2492492492492492) | _pdep_u64(w >> 42, 0x4924924924924924);
+}
+
+// DECODE 3D 64-bit morton code to a 21:21:21 word : BMI2 bit extract
+inline uint64_t morton3D_64_DecodePacked21_BMI2(const uint64_t m) {
+	return _pext_u64(m, 0x1249249249249249) | (_pext_u64(m, 0x2492492492492492) << 21) | (_pext_u64(m, 0x4924924924924924) << 42);
+}
+
+// ENCODE 3D 64-bit morton code from 16-bit coordinates : BMI2 bit deposit
+inline uint64_t morton3D_64_Encode16_BMI2(const uint16_t x, const uint16_t y, const uint16_t z) {
+	return _pdep_u64(x, 0x1249249249249249) | _pdep_u64(y, 0x2492492492492492) | _pdep_u64(z, 0x4924924924924924);
+}
+
+// DECODE 3D 64-bit morton code to 16-bit coordinates : BMI2 bit extract
+inline void morton3D_64_Decode16_BMI2(const uint64_t m, uint16_t& x, uint16_t& y, uint16_t& z) {
+	x = (uint16_t)_pext_u64(m, 0x1249249249249249);
+	y = (uint16_t)_pext_u64(m, 0x2492492492492492);
+	z = (uint16_t)_pext_u64(m, 0x4924924924924924);
+}
+#endif
+
+// Single words : BMI2 when the code is compiled for it, otherwise the methods morton.h uses for these widths
+inline uint32_t morton3D_32_EncodePacked10(const uint32_t w) {
+#if defined(__BMI2__)
+	return morton3D_32_EncodePacked10_BMI2(w);
+#else
+	return morton3D_32_EncodePacked10_magicbits(w);
+#endif
+}
+
+inline uint32_t morton3D_32_DecodePacked10(const uint32_t m) {
+#if defined(__BMI2__)
+	return morton3D_32_DecodePacked10_BMI2(m);
+#else
+	return morton3D_32_DecodePacked10_magicbits(m);
+#endif
+}
+
+inline uint64_t morton3D_64_EncodePacked21(const uint64_t w) {
+#if defined(__BMI2__)
+	return morton3D_64_EncodePacked21_BMI2(w);
+#else
+	return morton3D_Encode_LUT256_shifted<uint64_t, uint32_t>((uint32_t)(w & 0x1FFFFF), (uint32_t)((w >> 21) & 0x1FFFFF), (uint32_t)((w >> 42) & 0x1FFFFF));
+#endif
+}
+
+inline uint64_t morton3D_64_DecodePacked21(const uint64_t m) {
+#if defined(__BMI2__)
+	return morton3D_64_DecodePacked21_BMI2(m);
+#else
+	return morton3D_64_DecodePacked21_magicbits(m);
+#endif
+}
+
+// BATCH ENCODE / DECODE : the compiler vectorizes the magic bits loops, which beats one PDEP/PEXT per field
+// from AVX2 on for 32-bit codes (8 per register), and from AVX-512 on for 64-bit codes (8 per register).
+// Below that, the BMI2 kernels are used when available, and 64-bit codes are encoded with the preshifted LUTs
+// when they are not. Spread over the threads when OpenMP is enabled.
+
+// codes[i] = code of the 10:10:10 word words[i]
+inline void morton3D_32_EncodePacked10Array(const uint32_t* words, const size_t n, uint32_t* codes) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+#if defined(__BMI2__) && !defined(__AVX2__)
+		codes[i] = morton3D_32_EncodePacked10_BMI2(words[i]);
+#else
+		codes[i] = morton3D_32_EncodePacked10_magicbits(words[i]);
+#endif
+	}
+}
+
+// words[i] = 10:10:10 word of codes[i]
+inline void morton3D_32_DecodePacked10Array(const uint32_t* codes, const size_t n, uint32_t* words) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+#if defined(__BMI2__) && !defined(__AVX2__)
+		words[i] = morton3D_32_DecodePacked10_BMI2(codes[i]);
+#else
+		words[i] = morton3D_32_DecodePacked10_magicbits(codes[i]);
+#endif
+	}
+}
+
+// codes[i] = code of the 21:21:21 word words[i]
+inline void morton3D_64_EncodePacked21Array(const uint64_t* words, const size_t n, uint64_t* codes) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+#if defined(__BMI2__) && !defined(__AVX512F__)
+		codes[i] = morton3D_64_EncodePacked21_BMI2(words[i]);
+#elif !defined(__AVX512F__)
+		codes[i] = morton3D_Encode_LUT256_shifted<uint64_t, uint32_t>((uint32_t)(words[i] & 0x1FFFFF), (uint32_t)((words[i] >> 21) & 0x1FFFFF), (uint32_t)((words[i] >> 42) & 0x1FFFFF));
+#else
+		codes[i] = morton3D_64_EncodePacked21_magicbits(words[i]);
+#endif
+	}
+}
+
+// words[i] = 21:21:21 word of codes[i]
+inline void morton3D_64_DecodePacked21Array(const uint64_t* codes, const size_t n, uint64_t* words) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+#if defined(__BMI2__) && !defined(__AVX512F__)
+		words[i] = morton3D_64_DecodePacked21_BMI2(codes[i]);
+#else
+		words[i] = morton3D_64_DecodePacked21_magicbits(codes[i]);
+#endif
+	}
+}
+
+// codes[i] = code of (x[i], y[i], z[i]), from 16-bit SoA arrays
+inline void morton3D_64_EncodeSoA16Array(const uint16_t* x, const uint16_t* y, const uint16_t* z, const size_t n, uint64_t* codes) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+#if defined(__BMI2__) && !defined(__AVX512F__)
+		codes[i] = morton3D_64_Encode16_BMI2(x[i], y[i], z[i]);
+#elif !defined(__AVX512F__)
+		codes[i] = morton3D_Encode_LUT256_shifted<uint64_t, uint16_t>(x[i], y[i], z[i]);
+#else
+		codes[i] = morton3D_Encode_magicbits<uint64_t, uint16_t>(x[i], y[i], z[i]);
+#endif
+	}
+}
+
+// (x[i], y[i], z[i]) = coordinates of codes[i], to 16-bit SoA arrays
+inline void morton3D_64_DecodeSoA16Array(const uint64_t* codes, const size_t n, uint16_t* x, uint16_t* y, uint16_t* z) {
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+#if defined(__BMI2__) && !defined(__AVX512F__)
+		morton3D_64_Decode16_BMI2(codes[i], x[i], y[i], z[i]);
+#else
+		x[i] = morton3D_getThirdBits<uint64_t, uint16_t>(codes[i]);
+		y[i] = morton3D_getThirdBits<uint64_t, uint16_t>(codes[i] >> 1);
+		z[i] = morton3D_getThirdBits<uint64_t, uint16_t>(codes[i] >> 2);
+#endif
+	}
+}
+
+#endif // MORTON3D_PACKED_H_
@@ -0,0 +1,240 @@
+// Libmorton - Dense 2D/3D arrays stored in morton order (Z-tiled)
+#ifndef MORTON_ARRAY_H_
+#define MORTON_ARRAY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include "morton.h"
+
+// A grid is stored in rectangular bricks of 2^bits[a] elements along each axis a, where 2^bits[a] is the
+// largest power of two that fits in the extent of that axis. Each axis thus holds one or two bricks, padded
+// to less than twice its extent. Inside a brick, elements follow the Z-order curve of the brick: the bits of
+// the coordinates are interleaved from the lowest level up, and an axis drops out of the interleaving once
+// its bits run out (a 4096 x 4096 x 4 grid is one brick, z takes part in its lowest 2 levels only). The
+// bricks follow each other in row-major order.
+// A cube with a power-of-two side is a single brick: offsets are then plain morton codes, and the
+// morton3D_Inc/Dec helpers move between neighbours.
+//
+// The offset of an element is the sum of one table entry per axis, so it costs three lookups.
+
+// offsets[v] = part of the offset of coordinate v along axis a. dims axes with the given bits, stride:
+// distance between two bricks along the axis.
+inline void morton_BrickAxisOffsets(const uint_fast32_t extent, const unsigned int a, const unsigned int* bits, const unsigned int dims,
+	const uint_fast64_t stride, std::vector<uint_fast64_t>& offsets) {
+	unsigned int position[32]; // where bit j of the coordinate goes inside the brick
+	for (unsigned int j = 0; j < bits[a]; ++j) {
+		position[j] = 0;
+		for (unsigned int b = 0; b < dims; ++b) { position[j] += std::min(bits[b], j) + ((b < a && bits[b] > j) ? 1 : 0); }
+	}
+	const uint_fast32_t mask = ((uint_fast32_t)1 << bits[a]) - 1;
+	offsets.resize(extent);
+	for (uint_fast32_t v = 0; v < extent; ++v) {
+		uint_fast64_t spread = 0;
+		for (unsigned int j = 0; j < bits[a]; ++j) { spread |= (uint_fast64_t)(((v & mask) >> j) & 1) << position[j]; }
+		offsets[v] = (uint_fast64_t)(v >> bits[a]) * stride + spread;
+	}
+}
+
+class MortonBrickLayout3D {
+public:
+	MortonBrickLayout3D(const uint_fast32_t w = 0, const uint_fast32_t h = 0, const uint_fast32_t d = 0) : elements(0) {
+		const uint_fast32_t extent[3] = { w, h, d };
+		for (unsigned int a = 0; a < 3; ++a) {
+			bits[a] = 0;
+			bricks[a] = 0;
+			axis[a].clear();
+		}
+		if (w == 0 || h == 0 || d == 0) { return; }
+		for (unsigned int a = 0; a < 3; ++a) {
+			while (bits[a] < 21 && ((uint_fast32_t)2 << bits[a]) <= extent[a]) { ++bits[a]; }
+			bricks[a] = ((extent[a] - 1) >> bits[a]) + 1;
+		}
+		uint_fast64_t stride = (uint_fast64_t)1 << (bits[0] + bits[1] + bits[2]);
+		for (unsigned int a = 0; a < 3; ++a) {
+			morton_BrickAxisOffsets(extent[a], a, bits, 3, stride, axis[a]);
+			stride *= bricks[a];
+		}
+		elements = (size_t)stride;
+	}
+
+	// Number of elements, including padding
+	inline size_t size() const { return elements; }
+	// log2 of the brick size along x (0), y (1) or z (2)
+	inline unsigned int brickBits(const unsigned int a) const { return bits[a]; }
+	inline size_t brickVolume() const { return (size_t)1 << (bits[0] + bits[1] + bits[2]); }
+
+	// Coordinates must lie inside the grid
+	inline uint_fast64_t offset(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) const {
+		return axis[0][x] + axis[1][y] + axis[2][z];
+	}
+	// offset(x, y, z) = xOffset(x) + yOffset(y) + zOffset(z)
+	inline uint_fast64_t xOffset(const uint_fast32_t x) const { return axis[0][x]; }
+	inline uint_fast64_t yOffset(const uint_fast32_t y) const { return axis[1][y]; }
+	inline uint_fast64_t zOffset(const uint_fast32_t z) const { return axis[2][z]; }
+
+private:
+	unsigned int bits[3];
+	uint_fast32_t bricks[3]; // bricks per axis
+	size_t elements;
+	std::vector<uint_fast64_t> axis[3];
+};
+
+// Same for 2D
+class MortonBrickLayout2D {
+public:
+	MortonBrickLayout2D(const uint_fast32_t w = 0, const uint_fast32_t h = 0) : elements(0) {
+		const uint_fast32_t extent[2] = { w, h };
+		for (unsigned int a = 0; a < 2; ++a) {
+			bits[a] = 0;
+			bricks[a] = 0;
+			axis[a].clear();
+		}
+		if (w == 0 || h == 0) { return; }
+		for (unsigned int a = 0; a < 2; ++a) {
+			while (bits[a] < 31 && ((uint_fast32_t)2 << bits[a]) <= extent[a]) { ++bits[a]; }
+			bricks[a] = ((extent[a] - 1) >> bits[a]) + 1;
+		}
+		uint_fast64_t stride = (uint_fast64_t)1 << (bits[0] + bits[1]);
+		for (unsigned int a = 0; a < 2; ++a) {
+			morton_BrickAxisOffsets(extent[a], a, bits, 2, stride, axis[a]);
+			stride *= bricks[a];
+		}
+		elements = (size_t)stride;
+	}
+
+	inline size_t size() const { return elements; }
+	inline unsigned int brickBits(const unsigned int a) const { return bits[a]; }
+	inline size_t brickVolume() const { return (size_t)1 << (bits[0] + bits[1]); }
+
+	inline uint_fast64_t offset(const uint_fast32_t x, const uint_fast32_t y) const { return axis[0][x] + axis[1][y]; }
+	inline uint_fast64_t xOffset(const uint_fast32_t x) const { return axis[0][x]; }
+	inline uint_fast64_t yOffset(const uint_fast32_t y) const { return axis[1][y]; }
+
+private:
+	unsigned int bits[2];
+	uint_fast32_t bricks[2];
+	size_t elements;
+	std::vector<uint_fast64_t> axis[2];
+};
+
+// Element (x, y, z) lives at offset layout().offset(x, y, z), see MortonBrickLayout3D.
+// When the array is a power-of-two cube, neighbours are reached with the morton3D_Inc/Dec helpers on the offset.
+template<typename T>
+class MortonArray3D {
+public:
+	MortonArray3D() : w(0), h(0), d(0) {}
+	MortonArray3D(const uint_fast32_t width, const uint_fast32_t height, const uint_fast32_t depth, const T& value = T()) {
+		resize(width, height, depth, value);
+	}
+
+	void resize(const uint_fast32_t width, const uint_fast32_t height, const uint_fast32_t depth, const T& value = T()) {
+		w = width; h = height; d = depth;
+		bricks = MortonBrickLayout3D(w, h, d);
+		elements.assign(bricks.size(), value);
+	}
+
+	inline uint_fast32_t width() const { return w; }
+	inline uint_fast32_t height() const { return h; }
+	inline uint_fast32_t depth() const { return d; }
+	inline const MortonBrickLayout3D& layout() const { return bricks; }
+	// Number of elements allocated, including padding
+	inline size_t storageSize() const { return elements.size(); }
+	inline T* data() { return elements.empty() ? 0 : &elements[0]; }
+	inline const T* data() const { return elements.empty() ? 0 : &elements[0]; }
+
+	inline uint_fast64_t offset(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) const {
+		return bricks.offset(x, y, z);
+	}
+
+	inline T& operator()(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) { return elements[(size_t)offset(x, y, z)]; }
+	inline const T& operator()(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) const { return elements[(size_t)offset(x, y, z)]; }
+	inline T& atOffset(const uint_fast64_t m) { return elements[(size_t)m]; }
+	inline const T& atOffset(const uint_fast64_t m) const { return elements[(size_t)m]; }
+
+	void fill(const T& value) { std::fill(elements.begin(), elements.end(), value); }
+
+	// Copy from a row-major buffer (x running fastest, then y, then z)
+	void copyFromRowMajor(const T* src) {
+		for (uint_fast32_t z = 0; z < d; ++z) {
+			for (uint_fast32_t y = 0; y < h; ++y) {
+				const uint_fast64_t row = bricks.yOffset(y) + bricks.zOffset(z);
+				for (uint_fast32_t x = 0; x < w; ++x) { elements[(size_t)(row + bricks.xOffset(x))] = *src++; }
+			}
+		}
+	}
+
+	// Copy to a row-major buffer (x running fastest, then y, then z)
+	void copyToRowMajor(T* dst) const {
+		for (uint_fast32_t z = 0; z < d; ++z) {
+			for (uint_fast32_t y = 0; y < h; ++y) {
+				const uint_fast64_t row = bricks.yOffset(y) + bricks.zOffset(z);
+				for (uint_fast32_t x = 0; x < w; ++x) { *dst++ = elements[(size_t)(row + bricks.xOffset(x))]; }
+			}
+		}
+	}
+
+private:
+	uint_fast32_t w, h, d;
+	MortonBrickLayout3D bricks;
+	std::vector<T> elements;
+};
+
+// Element (x, y) lives at offset layout().offset(x, y), see MortonBrickLayout2D and MortonArray3D.
+template<typename T>
+class MortonArray2D {
+public:
+	MortonArray2D() : w(0), h(0) {}
+	MortonArray2D(const uint_fast32_t width, const uint_fast32_t height, const T& value = T()) {
+		resize(width, height, value);
+	}
+
+	void resize(const uint_fast32_t width, const uint_fast32_t height, const T& value = T()) {
+		w = width; h = height;
+		bricks = MortonBrickLayout2D(w, h);
+		elements.assign(bricks.size(), value);
+	}
+
+	inline uint_fast32_t width() const { return w; }
+	inline uint_fast32_t height() const { return h; }
+	inline const MortonBrickLayout2D& layout() const { return bricks; }
+	// Number of elements allocated, including padding
+	inline size_t storageSize() const { return elements.size(); }
+	inline T* data() { return elements.empty() ? 0 : &elements[0]; }
+	inline const T* data() const { return elements.empty() ? 0 : &elements[0]; }
+
+	inline uint_fast64_t offset(const uint_fast32_t x, const uint_fast32_t y) const {
+		return bricks.offset(x, y);
+	}
+
+	inline T& operator()(const uint_fast32_t x, const uint_fast32_t y) { return elements[(size_t)offset(x, y)]; }
+	inline const T& operator()(const uint_fast32_t x, const uint_fast32_t y) const { return elements[(size_t)offset(x, y)]; }
+	inline T& atOffset(const uint_fast64_t m) { return elements[(size_t)m]; }
+	inline const T& atOffset(const uint_fast64_t m) const { return elements[(size_t)m]; }
+
+	void fill(const T& value) { std::fill(elements.begin(), elements.end(), value); }
+
+	// Copy from a row-major buffer (x running fastest)
+	void copyFromRowMajor(const T* src) {
+		for (uint_fast32_t y = 0; y < h; ++y) {
+			const uint_fast64_t row = bricks.yOffset(y);
+			for (uint_fast32_t x = 0; x < w; ++x) { elements[(size_t)(row + bricks.xOffset(x))] = *src++; }
+		}
+	}
+
+	// Copy to a row-major buffer (x running fastest)
+	void copyToRowMajor(T* dst) const {
+		for (uint_fast32_t y = 0; y < h; ++y) {
+			const uint_fast64_t row = bricks.yOffset(y);
+			for (uint_fast32_t x = 0; x < w; ++x) { *dst++ = elements[(size_t)(row + bricks.xOffset(x))]; }
+		}
+	}
+
+private:
+	uint_fast32_t w, h;
+	MortonBrickLayout2D bricks;
+	std::vector<T> elements;
+};
+
+#endif // MORTON_ARRAY_H_
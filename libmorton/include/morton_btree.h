@@ -0,0 +1,528 @@
+// Libmorton - In-memory B+tree keyed by morton codes, with SIMD key search inside the nodes and box scans
+#ifndef MORTON_BTREE_H_
+#define MORTON_BTREE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include "morton.h"
+
+#if _MSC_VER
+#include <intrin.h>
+#elif defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Every node holds MORTON_BTREE_NODE_BYTES of keys (32 64-bit or 64 32-bit keys), on their own cache lines.
+// Unused key slots hold the all-ones code, so the position of a key in a node is the number of slots that
+// hold a smaller key: a fixed number of SIMD compares over the whole node, with no branch on the key.
+// Key i of an inner node is the largest key under child i, and leaves are linked in key order for scans.
+//
+// Box scans go through the leaves in key order. On a key outside the box, they seek forward to the next
+// code inside it (morton3D_NextInBox or morton2D_NextInBox): within the same or the next leaf when it can
+// be there, from the root otherwise.
+
+static const size_t MORTON_BTREE_NODE_BYTES = 256;
+
+// Number of the N keys that are smaller than key
+template<size_t N, typename morton>
+inline unsigned int morton_CountBelow(const morton* keys, const morton key) {
+	unsigned int count = 0;
+	for (size_t i = 0; i < N; ++i) { count += (keys[i] < key) ? 1 : 0; }
+	return count;
+}
+
+#if defined(__AVX512F__)
+// The keys of a node are sorted, so the compare masks, put together, are a run of low ones: their length is
+// the count. For N <= 64.
+template<size_t N>
+inline unsigned int morton_CountBelow(const uint64_t* keys, const uint64_t key) {
+	const __m512i k = _mm512_set1_epi64((long long)key);
+	uint64_t below = 0;
+	for (size_t i = 0; i < N; i += 8) {
+		below |= (uint64_t)_mm512_cmplt_epu64_mask(_mm512_loadu_si512((const void*)(keys + i)), k) << i;
+	}
+	return morton_ctz<uint64_t>(~below);
+}
+
+template<size_t N>
+inline unsigned int morton_CountBelow(const uint32_t* keys, const uint32_t key) {
+	const __m512i k = _mm512_set1_epi32((int)key);
+	uint64_t below = 0;
+	for (size_t i = 0; i < N; i += 16) {
+		below |= (uint64_t)_mm512_cmplt_epu32_mask(_mm512_loadu_si512((const void*)(keys + i)), k) << i;
+	}
+	return morton_ctz<uint64_t>(~below);
+}
+#elif defined(__AVX2__)
+// AVX2 only compares signed integers: flipping the top bit of both sides orders them as unsigned.
+// Each compare gives -1 per smaller key, subtracted from the per-lane counts.
+template<size_t N>
+inline unsigned int morton_CountBelow(const uint64_t* keys, const uint64_t key) {
+	const __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+	const __m256i k = _mm256_xor_si256(_mm256_set1_epi64x((long long)key), bias);
+	__m256i count = _mm256_setzero_si256();
+	for (size_t i = 0; i < N; i += 4) {
+		count = _mm256_sub_epi64(count, _mm256_cmpgt_epi64(k, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), bias)));
+	}
+	__m128i sum = _mm_add_epi64(_mm256_castsi256_si128(count), _mm256_extracti128_si256(count, 1));
+	sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+	return (unsigned int)_mm_cvtsi128_si32(sum);
+}
+
+template<size_t N>
+inline unsigned int morton_CountBelow(const uint32_t* keys, const uint32_t key) {
+	const __m256i bias = _mm256_set1_epi32((int)0x80000000u);
+	const __m256i k = _mm256_xor_si256(_mm256_set1_epi32((int)key), bias);
+	__m256i count = _mm256_setzero_si256();
+	for (size_t i = 0; i < N; i += 8) {
+		count = _mm256_sub_epi32(count, _mm256_cmpgt_epi32(k, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), bias)));
+	}
+	__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(count), _mm256_extracti128_si256(count, 1));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+	return (unsigned int)_mm_cvtsi128_si32(sum);
+}
+#endif
+
+template<typename morton, typename value>
+class MortonBTree {
+	struct Node;
+	struct Inner;
+	struct Leaf;
+
+public:
+	static const unsigned int NODE_KEYS = (unsigned int)(MORTON_BTREE_NODE_BYTES / sizeof(morton));
+
+	// Position in the leaves, moving forward in key order. Inserts and erases invalidate cursors.
+	// for (MortonBTree<uint64_t, uint32_t>::Cursor c = tree.lowerBound(a); !c.done() && c.key() <= b; c.next()) { ... }
+	class Cursor {
+	public:
+		inline bool done() const { return leaf == 0; }
+		inline morton key() const { return leaf->keys[pos]; }
+		inline const value& data() const { return leaf->values[pos]; }
+		inline void next() {
+			if (++pos == leaf->count) { leaf = leaf->next; pos = 0; }
+		}
+
+		// Move forward to the first key >= to (the cursor does not move back)
+		inline void seek(const morton to) {
+			if (leaf == 0 || to <= leaf->keys[pos]) { return; }
+			if (to > leaf->keys[leaf->count - 1]) {
+				if (leaf->next == 0 || to > leaf->next->keys[leaf->next->count - 1]) { *this = tree->lowerBound(to); return; }
+				leaf = leaf->next;
+			}
+			pos = morton_CountBelow<NODE_KEYS>(leaf->keys, to);
+		}
+
+	private:
+		friend class MortonBTree;
+		Cursor(const MortonBTree* tree, const Leaf* leaf, const unsigned int pos) : tree(tree), leaf(leaf), pos(pos) {}
+		const MortonBTree* tree;
+		const Leaf* leaf;
+		unsigned int pos;
+	};
+
+	// Keys inside the box given by the codes of its minimum and maximum corners, in key order (2D or 3D codes)
+	// for (MortonBTree<uint64_t, uint32_t>::BoxCursor c = tree.boxScan3D(lo, hi); !c.done(); c.next()) { ... }
+	class BoxCursor {
+	public:
+		inline bool done() const { return finished; }
+		inline morton key() const { return cursor.key(); }
+		inline const value& data() const { return cursor.data(); }
+		inline void next() { cursor.next(); settle(); }
+
+	private:
+		friend class MortonBTree;
+		BoxCursor(const Cursor& cursor, const morton lo, const morton hi, const unsigned int dims) : cursor(cursor), lo(lo), hi(hi), dims(dims), finished(false) {
+			settle();
+		}
+
+		// Move to the first key in the box at or after the cursor
+		inline void settle() {
+			for (;;) {
+				if (cursor.done() || cursor.key() > hi) { finished = true; return; }
+				const morton c = cursor.key();
+				if (dims == 3 ? morton3D_InBox<morton>(c, lo, hi) : morton2D_InBox<morton>(c, lo, hi)) { return; }
+				cursor.seek(dims == 3 ? morton3D_NextInBox<morton>(c, lo, hi) : morton2D_NextInBox<morton>(c, lo, hi));
+			}
+		}
+
+		Cursor cursor;
+		morton lo, hi;
+		unsigned int dims;
+		bool finished;
+	};
+
+	MortonBTree() : root(new Leaf()), levels(0), count(0) {}
+	~MortonBTree() { destroy(root, levels); }
+
+	inline size_t size() const { return count; }
+	inline bool empty() const { return count == 0; }
+	// Number of inner node levels above the leaves
+	inline unsigned int height() const { return levels; }
+
+	void clear() {
+		destroy(root, levels);
+		root = new Leaf();
+		levels = 0;
+		count = 0;
+	}
+
+	// Replace the contents by the n (key, value) pairs, keys sorted in increasing order. For a repeated key,
+	// the last value is kept. Leaves are filled to BULK_FILL_NUM / BULK_FILL_DEN, to leave room for inserts.
+	void bulkLoad(const morton* keys, const value* values, const size_t n) {
+		destroy(root, levels);
+		levels = 0;
+		count = 0;
+		for (size_t i = 0; i < n; ++i) {
+			if (i + 1 == n || keys[i] != keys[i + 1]) { ++count; }
+		}
+		const size_t fill = std::max<size_t>(1, NODE_KEYS * BULK_FILL_NUM / BULK_FILL_DEN);
+		// leaves, spreading the keys evenly over them
+		std::vector<Node*> nodes(std::max<size_t>(1, (count + fill - 1) / fill));
+		std::vector<morton> largest(nodes.size());
+		Leaf* previous = 0;
+		for (size_t j = 0, i = 0; j < nodes.size(); ++j) {
+			Leaf* leaf = new Leaf();
+			const size_t take = count * (j + 1) / nodes.size() - count * j / nodes.size();
+			for (size_t k = 0; k < take; ++k, ++i) {
+				while (i + 1 < n && keys[i] == keys[i + 1]) { ++i; }
+				leaf->keys[k] = keys[i];
+				leaf->values[k] = values[i];
+			}
+			leaf->count = (unsigned int)take;
+			largest[j] = take ? leaf->keys[take - 1] : 0;
+			if (previous) { previous->next = leaf; }
+			previous = leaf;
+			nodes[j] = leaf;
+		}
+		// inner levels, with fill + 1 children per node
+		while (nodes.size() > 1) {
+			std::vector<Node*> parents((nodes.size() + fill) / (fill + 1));
+			std::vector<morton> parent_largest(parents.size());
+			for (size_t j = 0, c = 0; j < parents.size(); ++j) {
+				Inner* inner = new Inner();
+				const size_t take = nodes.size() * (j + 1) / parents.size() - nodes.size() * j / parents.size();
+				for (size_t k = 0; k < take; ++k, ++c) {
+					inner->children[k] = nodes[c];
+					if (k + 1 < take) { inner->keys[k] = largest[c]; }
+				}
+				inner->count = (unsigned int)(take - 1);
+				parent_largest[j] = largest[c - 1];
+				parents[j] = inner;
+			}
+			nodes.swap(parents);
+			largest.swap(parent_largest);
+			++levels;
+		}
+		root = nodes[0];
+	}
+
+	// Insert or overwrite. Returns true if the key was not present yet.
+	bool insert(const morton key, const value& v) {
+		morton split_key;
+		Node* split = 0;
+		const bool added = insertAt(root, levels, key, v, split_key, split);
+		if (split) { // the root was split: grow a level
+			Inner* inner = new Inner();
+			inner->keys[0] = split_key;
+			inner->children[0] = root;
+			inner->children[1] = split;
+			inner->count = 1;
+			root = inner;
+			++levels;
+		}
+		if (added) { ++count; }
+		return added;
+	}
+
+	// Remove a key. Returns true if it was present.
+	bool erase(const morton key) {
+		if (!eraseAt(root, levels, key)) { return false; }
+		--count;
+		if (levels > 0 && root->count == 0) { // a single child left: drop a level
+			Inner* old = (Inner*)root;
+			root = old->children[0];
+			delete old;
+			--levels;
+		}
+		return true;
+	}
+
+	inline value* find(const morton key) {
+		return const_cast<value*>(static_cast<const MortonBTree*>(this)->find(key));
+	}
+
+	inline const value* find(const morton key) const {
+		const Leaf* leaf = findLeaf(key);
+		const unsigned int pos = morton_CountBelow<NODE_KEYS>(leaf->keys, key);
+		return (pos < leaf->count && leaf->keys[pos] == key) ? &leaf->values[pos] : 0;
+	}
+
+	inline bool contains(const morton key) const {
+		return find(key) != 0;
+	}
+
+	// Batch lookup. Missing keys get not_found as value. Returns the number of keys found.
+	size_t lookup(const morton* batch_keys, const size_t n, value* out, const value& not_found) const {
+		size_t hits = 0;
+		for (size_t k = 0; k < n; ++k) {
+			const value* v = find(batch_keys[k]);
+			if (v == 0) { out[k] = not_found; }
+			else { out[k] = *v; ++hits; }
+		}
+		return hits;
+	}
+
+	// Cursor on the first key >= key
+	Cursor lowerBound(const morton key) const {
+		const Leaf* leaf = findLeaf(key);
+		const unsigned int pos = morton_CountBelow<NODE_KEYS>(leaf->keys, key);
+		if (pos == leaf->count) { return Cursor(this, leaf->next, 0); } // the next leaf starts above key
+		return Cursor(this, leaf, pos);
+	}
+
+	inline Cursor begin() const { return lowerBound(0); }
+
+	inline BoxCursor boxScan3D(const morton lo, const morton hi) const { return BoxCursor(lowerBound(lo), lo, hi, 3); }
+	inline BoxCursor boxScan2D(const morton lo, const morton hi) const { return BoxCursor(lowerBound(lo), lo, hi, 2); }
+
+	// Bytes used by the nodes
+	size_t memoryUsage() const { return memoryUsage(root, levels); }
+
+private:
+	static const morton EMPTY = (morton) ~(morton)0;
+	static const unsigned int MIN_KEYS = NODE_KEYS / 4; // merge or refill nodes that fall below this
+	static const size_t BULK_FILL_NUM = 7;
+	static const size_t BULK_FILL_DEN = 8;
+
+	// Nodes start on a cache line, so that the keys of a node fill NODE_KEYS * sizeof(morton) / 64 lines
+	struct Node {
+		morton keys[NODE_KEYS];
+		unsigned int count;
+		Node() : count(0) { std::fill(keys, keys + NODE_KEYS, EMPTY); }
+
+		static void* operator new(const size_t bytes) {
+			char* raw = (char*)::operator new(bytes + 64);
+			char* p = raw + 64 - ((uintptr_t)raw & 63); // at least 8 bytes above raw, for the pointer
+			((char**)p)[-1] = raw;
+			return p;
+		}
+		static void operator delete(void* p) {
+			if (p) { ::operator delete(((char**)p)[-1]); }
+		}
+	};
+
+	struct Inner : Node {
+		Node* children[NODE_KEYS + 1];
+	};
+
+	struct Leaf : Node {
+		value values[NODE_KEYS];
+		Leaf* next;
+		Leaf() : next(0) {}
+	};
+
+	Node* root;
+	unsigned int levels;
+	size_t count;
+
+	MortonBTree(const MortonBTree&);
+	MortonBTree& operator=(const MortonBTree&);
+
+	inline const Leaf* findLeaf(const morton key) const {
+		const Node* node = root;
+		for (unsigned int level = levels; level > 0; --level) {
+			node = ((const Inner*)node)->children[morton_CountBelow<NODE_KEYS>(node->keys, key)];
+		}
+		return (const Leaf*)node;
+	}
+
+	static void destroy(Node* node, const unsigned int level) {
+		if (level > 0) {
+			Inner* inner = (Inner*)node;
+			for (unsigned int c = 0; c <= inner->count; ++c) { destroy(inner->children[c], level - 1); }
+			delete inner;
+		}
+		else { delete (Leaf*)node; }
+	}
+
+	static size_t memoryUsage(const Node* node, const unsigned int level) {
+		if (level == 0) { return sizeof(Leaf); }
+		const Inner* inner = (const Inner*)node;
+		size_t bytes = sizeof(Inner);
+		for (unsigned int c = 0; c <= inner->count; ++c) { bytes += memoryUsage(inner->children[c], level - 1); }
+		return bytes;
+	}
+
+	// Insert key at pos and child at pos + 1 into an inner node with room for it
+	static void insertInner(Inner* inner, const unsigned int pos, const morton key, Node* child) {
+		std::copy_backward(inner->keys + pos, inner->keys + inner->count, inner->keys + inner->count + 1);
+		std::copy_backward(inner->children + pos + 1, inner->children + inner->count + 1, inner->children + inner->count + 2);
+		inner->keys[pos] = key;
+		inner->children[pos + 1] = child;
+		++inner->count;
+	}
+
+	// Remove key pos and child pos + 1 from an inner node
+	static void removeInner(Inner* inner, const unsigned int pos) {
+		std::copy(inner->keys + pos + 1, inner->keys + inner->count, inner->keys + pos);
+		std::copy(inner->children + pos + 2, inner->children + inner->count + 1, inner->children + pos + 1);
+		--inner->count;
+		inner->keys[inner->count] = EMPTY;
+	}
+
+	// Insert under node. A node that was full is split: its upper half moves to a new node, returned in split,
+	// with split_key the largest key left in node.
+	bool insertAt(Node* node, const unsigned int level, const morton key, const value& v, morton& split_key, Node*& split) {
+		const unsigned int pos = morton_CountBelow<NODE_KEYS>(node->keys, key);
+		const unsigned int half = NODE_KEYS / 2;
+		if (level == 0) {
+			Leaf* leaf = (Leaf*)node;
+			if (pos < leaf->count && leaf->keys[pos] == key) { leaf->values[pos] = v; return false; }
+			if (leaf->count == NODE_KEYS) {
+				Leaf* right = new Leaf();
+				std::copy(leaf->keys + half, leaf->keys + NODE_KEYS, right->keys);
+				std::copy(leaf->values + half, leaf->values + NODE_KEYS, right->values);
+				std::fill(leaf->keys + half, leaf->keys + NODE_KEYS, EMPTY);
+				std::fill(leaf->values + half, leaf->values + NODE_KEYS, value());
+				right->count = NODE_KEYS - half;
+				leaf->count = half;
+				right->next = leaf->next;
+				leaf->next = right;
+				split_key = leaf->keys[half - 1];
+				split = right;
+				if (pos >= half) { insertLeaf(right, pos - half, key, v); return true; }
+			}
+			insertLeaf(leaf, pos, key, v);
+			return true;
+		}
+
+		Inner* inner = (Inner*)node;
+		morton child_key;
+		Node* child_split = 0;
+		const bool added = insertAt(inner->children[pos], level - 1, key, v, child_key, child_split);
+		if (child_split == 0) { return added; }
+		if (inner->count == NODE_KEYS) { // keys [0, half) stay, key half moves up, the rest moves right
+			Inner* right = new Inner();
+			std::copy(inner->keys + half + 1, inner->keys + NODE_KEYS, right->keys);
+			std::copy(inner->children + half + 1, inner->children + NODE_KEYS + 1, right->children);
+			right->count = NODE_KEYS - half - 1;
+			split_key = inner->keys[half];
+			std::fill(inner->keys + half, inner->keys + NODE_KEYS, EMPTY);
+			inner->count = half;
+			split = right;
+			if (pos > half) { insertInner(right, pos - half - 1, child_key, child_split); return added; }
+		}
+		insertInner(inner, pos, child_key, child_split);
+		return added;
+	}
+
+	static void insertLeaf(Leaf* leaf, const unsigned int pos, const morton key, const value& v) {
+		std::copy_backward(leaf->keys + pos, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+		std::copy_backward(leaf->values + pos, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+		leaf->keys[pos] = key;
+		leaf->values[pos] = v;
+		++leaf->count;
+	}
+
+	bool eraseAt(Node* node, const unsigned int level, const morton key) {
+		const unsigned int pos = morton_CountBelow<NODE_KEYS>(node->keys, key);
+		if (level == 0) {
+			Leaf* leaf = (Leaf*)node;
+			if (pos >= leaf->count || leaf->keys[pos] != key) { return false; }
+			std::copy(leaf->keys + pos + 1, leaf->keys + leaf->count, leaf->keys + pos);
+			std::copy(leaf->values + pos + 1, leaf->values + leaf->count, leaf->values + pos);
+			--leaf->count;
+			leaf->keys[leaf->count] = EMPTY;
+			leaf->values[leaf->count] = value();
+			return true;
+		}
+		Inner* inner = (Inner*)node;
+		if (!eraseAt(inner->children[pos], level - 1, key)) { return false; }
+		if (inner->children[pos]->count < MIN_KEYS) { rebalance(inner, pos, level - 1); }
+		return true;
+	}
+
+	// Child pos of inner fell below MIN_KEYS: merge it with a neighbour if both fit in one node, otherwise
+	// share their keys evenly
+	void rebalance(Inner* inner, const unsigned int pos, const unsigned int level) {
+		const unsigned int l = (pos < inner->count) ? pos : pos - 1; // children l and l + 1
+		if (level == 0) {
+			Leaf* left = (Leaf*)inner->children[l];
+			Leaf* right = (Leaf*)inner->children[l + 1];
+			const unsigned int total = left->count + right->count;
+			if (total <= NODE_KEYS) {
+				std::copy(right->keys, right->keys + right->count, left->keys + left->count);
+				std::copy(right->values, right->values + right->count, left->values + left->count);
+				left->count = total;
+				left->next = right->next;
+				delete right;
+				removeInner(inner, l);
+				return;
+			}
+			const unsigned int want = total / 2;
+			if (left->count < want) { // move the first keys of right to left
+				const unsigned int move = want - left->count;
+				std::copy(right->keys, right->keys + move, left->keys + left->count);
+				std::copy(right->values, right->values + move, left->values + left->count);
+				std::copy(right->keys + move, right->keys + right->count, right->keys);
+				std::copy(right->values + move, right->values + right->count, right->values);
+				std::fill(right->keys + right->count - move, right->keys + right->count, EMPTY);
+				std::fill(right->values + right->count - move, right->values + right->count, value());
+				right->count -= move;
+			}
+			else { // move the last keys of left to right
+				const unsigned int move = left->count - want;
+				std::copy_backward(right->keys, right->keys + right->count, right->keys + right->count + move);
+				std::copy_backward(right->values, right->values + right->count, right->values + right->count + move);
+				std::copy(left->keys + want, left->keys + left->count, right->keys);
+				std::copy(left->values + want, left->values + left->count, right->values);
+				std::fill(left->keys + want, left->keys + left->count, EMPTY);
+				std::fill(left->values + want, left->values + left->count, value());
+				right->count += move;
+			}
+			left->count = want;
+			inner->keys[l] = left->keys[want - 1];
+			return;
+		}
+
+		// inner children: the keys of both, with the separator between them
+		Inner* left = (Inner*)inner->children[l];
+		Inner* right = (Inner*)inner->children[l + 1];
+		const unsigned int total = left->count + 1 + right->count;
+		morton keys[2 * NODE_KEYS + 1];
+		Node* children[2 * NODE_KEYS + 2];
+		std::copy(left->keys, left->keys + left->count, keys);
+		keys[left->count] = inner->keys[l];
+		std::copy(right->keys, right->keys + right->count, keys + left->count + 1);
+		std::copy(left->children, left->children + left->count + 1, children);
+		std::copy(right->children, right->children + right->count + 1, children + left->count + 1);
+		if (total <= NODE_KEYS) {
+			std::copy(keys, keys + total, left->keys);
+			std::copy(children, children + total + 1, left->children);
+			left->count = total;
+			delete right;
+			removeInner(inner, l);
+			return;
+		}
+		const unsigned int want = total / 2; // keys [0, want) left, key want up, the rest right
+		std::fill(left->keys, left->keys + NODE_KEYS, EMPTY);
+		std::fill(right->keys, right->keys + NODE_KEYS, EMPTY);
+		std::copy(keys, keys + want, left->keys);
+		std::copy(children, children + want + 1, left->children);
+		left->count = want;
+		inner->keys[l] = keys[want];
+		std::copy(keys + want + 1, keys + total, right->keys);
+		std::copy(children + want + 1, children + total + 1, right->children);
+		right->count = total - want - 1;
+	}
+};
+
+template<typename morton, typename value> const morton MortonBTree<morton, value>::EMPTY;
+template<typename morton, typename value> const unsigned int MortonBTree<morton, value>::NODE_KEYS;
+
+#endif // MORTON_BTREE_H_
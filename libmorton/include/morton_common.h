@@ -6,65 +6,81 @@
 #include <intrin.h>
 #endif
 
+// Number of leading zero bits of a 32 or 64-bit code (the width is the size of the morton type).
+// Unlike the bit scan intrinsics, 0 is allowed and gives the full width.
+template<typename morton>
+inline unsigned int morton_clz(const morton x) {
+	if (x == 0) { return sizeof(morton) * 8; }
+#if _MSC_VER && _WIN64
+	unsigned long i;
+	if (sizeof(morton) <= 4) { _BitScanReverse(&i, (unsigned long)x); return 31 - i; }
+	_BitScanReverse64(&i, (unsigned __int64)x);
+	return 63 - i;
+#elif _MSC_VER
+	unsigned long i;
+	if (sizeof(morton) > 4 && ((uint_fast64_t)x >> 32) != 0) { _BitScanReverse(&i, (unsigned long)((uint_fast64_t)x >> 32)); return 31 - i; }
+	_BitScanReverse(&i, (unsigned long)x);
+	return (sizeof(morton) * 8 - 1) - i;
+#elif __GNUC__
+	if (sizeof(morton) <= 4) { return __builtin_clz((unsigned int)x); }
+	return __builtin_clzll((unsigned long long)x);
+#else
+	unsigned int n = 0;
+	for (morton top = (morton)1 << (sizeof(morton) * 8 - 1); (x & top) == 0; top >>= 1) { ++n; }
+	return n;
+#endif
+}
+
+// Position of the highest set bit of a 32 or 64-bit code (the width is the size of the morton type), counted
+// from the least significant bit like _BitScanReverse. Returns false, and leaves *firstbit_location alone, if x is 0.
 template<typename morton>
 inline bool findFirstSetBit(const morton x, unsigned long* firstbit_location) {
-#if _MSC_VER && !_WIN64
-	// 32 BIT on 32 BIT
-	if(sizeof(morton) <= 4) { 
-		if (_BitScanReverse(firstbit_location, x) == 0) { return false; }
-		return true;
-	}
-	// 64 BIT on 32 BIT
-	else {
-		*firstbit_location = 0;
-		if (_BitScanReverse(firstbit_location, (x >> 32))) { // check first part
-			firstbit_location += 32;
-		} else if (!_BitScanReverse(firstbit_location, (x & 0xFFFFFFFF))) { // also test last part
-			return 0;
-		}
-		return true;
-	}
-#elif  _MSC_VER && _WIN64
-	// 32 or 64 BIT on 64 BIT
-	if (_BitScanReverse64(firstbit_location, x) == 0) { return false; }
+	if (x == 0) { return false; }
+	*firstbit_location = (unsigned long)(sizeof(morton) * 8 - 1 - morton_clz<morton>(x));
 	return true;
+}
+
+// Number of trailing zero bits of a 32 or 64-bit code. 0 gives the full width.
+template<typename morton>
+inline unsigned int morton_ctz(const morton x) {
+	if (x == 0) { return sizeof(morton) * 8; }
+#if _MSC_VER && _WIN64
+	unsigned long i;
+	_BitScanForward64(&i, (unsigned __int64)x);
+	return i;
+#elif _MSC_VER
+	unsigned long i;
+	if (((uint_fast64_t)x & 0xFFFFFFFF) == 0) { _BitScanForward(&i, (unsigned long)((uint_fast64_t)x >> 32)); return 32 + i; }
+	_BitScanForward(&i, (unsigned long)x);
+	return i;
 #elif __GNUC__
-	unsigned int pos = __builtin_ffs(x);
-	*firstbit_location = pos;
-	return pos;
+	if (sizeof(morton) <= 4) { return __builtin_ctz((unsigned int)x); }
+	return __builtin_ctzll((unsigned long long)x);
+#else
+	unsigned int n = 0;
+	for (morton bit = 1; (x & bit) == 0; bit <<= 1) { ++n; }
+	return n;
 #endif
 }
 
-//inline bool findFirstSetBit32(const uint_fast32_t x, unsigned long* firstbit_location){
-//#if _MSC_VER
-//	if (_BitScanReverse(firstbit_location, x) == 0){return false;}
-//	return true;
-//#elif __GNUC__
-//	unsigned int pos = __builtin_ffs(x);
-//	*firstbit_location = pos;
-//	return pos;
-//#endif
-//	return true;
-//}
-//
-//inline bool findFirstSetBit64(const uint_fast64_t x, unsigned long* firstbit_location){
-//#if _MSC_VER && _WIN64
-//	if (_BitScanReverse64(firstbit_location, x) == 0){return false;}
-//	return true;
-//#elif _MSC_VER && _WIN32
-//	*firstbit_location = 0;
-//	if (_BitScanReverse(firstbit_location, (x >> 32))){ // check first part
-//		firstbit_location += 32;
-//	} else if ( ! _BitScanReverse(firstbit_location, (x & 0xFFFFFFFF))){ // also test last part
-//		return 0;
-//	}
-//	return true;
-//#elif __GNUC__
-//	unsigned int pos = __builtin_ffs(x);
-//	*firstbit_location = pos;
-//	return pos;
-//#endif
-//	return true;
-//}
+// Add 1 to *p as one atomic operation (a full memory barrier) and return the previous value
+inline uint32_t morton_atomicIncrement(volatile uint32_t* p) {
+#if _MSC_VER
+	return (uint32_t)_InterlockedIncrement((volatile long*)p) - 1;
+#elif __GNUC__
+	return __sync_fetch_and_add(p, 1);
+#else
+#error "morton_atomicIncrement needs an atomic builtin (MSVC or GCC/Clang)"
+#endif
+}
+
+// Hint the CPU to pull the cache line holding p into the cache
+inline void morton_prefetch(const void* p) {
+#if _MSC_VER && (_M_IX86 || _M_X64)
+	_mm_prefetch((const char*) p, _MM_HINT_T0);
+#elif __GNUC__
+	__builtin_prefetch(p);
+#endif
+}
 
 #endif
@@ -0,0 +1,179 @@
+// Libmorton - Block delta compression of sorted morton code arrays, with random access by block
+#ifndef MORTON_COMPRESS_H_
+#define MORTON_COMPRESS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "morton_common.h"
+
+// Sorted codes are split into blocks of 128. A block keeps its first code in the block directory and
+// stores the differences between neighbouring codes (the first one is 0), which are small when the
+// codes are dense, bit-packed at the width of the largest difference of the block (frame of reference).
+//
+// The packed values are interleaved over 4 lanes of 64-bit words: value j goes to lane j % 4, and word w
+// of lane l is at words[4 * w + l]. All lanes use the same word and shift for the same row of values,
+// so packing and unpacking are plain loops over the lanes that the compiler turns into vector code.
+// A block takes 4 * ceil(32 * width / 64) words, plus 16 bytes in the directory.
+
+static const size_t MORTON_BLOCK_CODES = 128;
+static const size_t MORTON_BLOCK_LANES = 4;
+
+// Words taken by a block of the given bit width
+inline size_t morton_PackedBlockWords(const unsigned int width) {
+	return MORTON_BLOCK_LANES * ((MORTON_BLOCK_CODES / MORTON_BLOCK_LANES * width + 63) / 64);
+}
+
+// Pack 128 values of at most width bits into morton_PackedBlockWords(width) words
+inline void morton_PackBlock(const uint64_t* values, const unsigned int width, uint64_t* words) {
+	const size_t rows = MORTON_BLOCK_CODES / MORTON_BLOCK_LANES;
+	std::fill(words, words + morton_PackedBlockWords(width), (uint64_t)0);
+	if (width == 0) { return; }
+	for (size_t i = 0; i < rows; ++i) {
+		const size_t bit = i * width, w = (bit >> 6) * MORTON_BLOCK_LANES;
+		const unsigned int s = bit & 63;
+		for (size_t l = 0; l < MORTON_BLOCK_LANES; ++l) { words[w + l] |= values[i * MORTON_BLOCK_LANES + l] << s; }
+		if (s + width > 64) { // the values continue in the next word
+			for (size_t l = 0; l < MORTON_BLOCK_LANES; ++l) { words[w + MORTON_BLOCK_LANES + l] |= values[i * MORTON_BLOCK_LANES + l] >> (64 - s); }
+		}
+	}
+}
+
+// Unpack 128 values of width bits
+inline void morton_UnpackBlock(const uint64_t* words, const unsigned int width, uint64_t* values) {
+	const size_t rows = MORTON_BLOCK_CODES / MORTON_BLOCK_LANES;
+	if (width == 0) { std::fill(values, values + MORTON_BLOCK_CODES, (uint64_t)0); return; }
+	const uint64_t mask = (width == 64) ? ~(uint64_t)0 : (((uint64_t)1 << width) - 1);
+	for (size_t i = 0; i < rows; ++i) {
+		const size_t bit = i * width, w = (bit >> 6) * MORTON_BLOCK_LANES;
+		const unsigned int s = bit & 63;
+		if (s + width > 64) {
+			for (size_t l = 0; l < MORTON_BLOCK_LANES; ++l) {
+				values[i * MORTON_BLOCK_LANES + l] = ((words[w + l] >> s) | (words[w + MORTON_BLOCK_LANES + l] << (64 - s))) & mask;
+			}
+		}
+		else {
+			for (size_t l = 0; l < MORTON_BLOCK_LANES; ++l) { values[i * MORTON_BLOCK_LANES + l] = (words[w + l] >> s) & mask; }
+		}
+	}
+}
+
+// Compressed copy of a sorted array of 64-bit codes (2D or 3D)
+class MortonCompressedCodes {
+public:
+	struct Block {
+		uint64_t first; // first code of the block
+		uint64_t offset_width; // word offset of the packed differences << 8 | bit width
+	};
+
+	MortonCompressedCodes() : n(0) {}
+
+	// codes: n codes in non-decreasing order. Blocks are packed in parallel when OpenMP is enabled.
+	void build(const uint64_t* codes, const size_t count) {
+		n = count;
+		const size_t blocks = (n + MORTON_BLOCK_CODES - 1) / MORTON_BLOCK_CODES;
+		directory.resize(blocks);
+		// widths, then offsets, then the packed words
+#pragma omp parallel for schedule(static)
+		for (long long b = 0; b < (long long)blocks; ++b) {
+			const size_t begin = (size_t)b * MORTON_BLOCK_CODES, end = std::min(n, begin + MORTON_BLOCK_CODES);
+			uint64_t bits = 0;
+			for (size_t i = begin + 1; i < end; ++i) { bits |= codes[i] - codes[i - 1]; }
+			directory[b].first = codes[begin];
+			directory[b].offset_width = 64 - morton_clz<uint64_t>(bits);
+		}
+		size_t total_words = 0;
+		for (size_t b = 0; b < blocks; ++b) {
+			const unsigned int w = (unsigned int)directory[b].offset_width;
+			directory[b].offset_width = ((uint64_t)total_words << 8) | w;
+			total_words += morton_PackedBlockWords(w);
+		}
+		words.resize(total_words);
+#pragma omp parallel for schedule(static)
+		for (long long b = 0; b < (long long)blocks; ++b) {
+			const size_t begin = (size_t)b * MORTON_BLOCK_CODES, end = std::min(n, begin + MORTON_BLOCK_CODES);
+			uint64_t deltas[MORTON_BLOCK_CODES];
+			deltas[0] = 0;
+			for (size_t i = begin + 1; i < end; ++i) { deltas[i - begin] = codes[i] - codes[i - 1]; }
+			std::fill(deltas + (end - begin), deltas + MORTON_BLOCK_CODES, (uint64_t)0); // the last block repeats its last code
+			if (words.empty()) { continue; }
+			morton_PackBlock(deltas, width((size_t)b), &words[offset((size_t)b)]);
+		}
+	}
+
+	inline size_t size() const { return n; }
+	inline size_t blockCount() const { return directory.size(); }
+	inline const Block* blocks() const { return directory.empty() ? 0 : &directory[0]; }
+	inline const uint64_t* data() const { return words.empty() ? 0 : &words[0]; }
+	inline unsigned int width(const size_t block) const { return (unsigned int)(directory[block].offset_width & 0xFF); }
+	inline size_t offset(const size_t block) const { return (size_t)(directory[block].offset_width >> 8); }
+	inline uint64_t firstCode(const size_t block) const { return directory[block].first; }
+	// Bytes of the compressed representation (packed words and block directory)
+	inline size_t compressedSize() const { return words.size() * sizeof(uint64_t) + directory.size() * sizeof(Block); }
+	inline size_t memoryUsage() const { return words.capacity() * sizeof(uint64_t) + directory.capacity() * sizeof(Block); }
+
+	// Decode block b into out (128 codes; the codes past the end of the last block repeat its last code)
+	inline void decodeBlock(const size_t b, uint64_t* out) const {
+		const unsigned int w = width(b);
+		morton_UnpackBlock(w ? &words[offset(b)] : 0, w, out);
+		uint64_t code = directory[b].first;
+		for (size_t i = 0; i < MORTON_BLOCK_CODES; ++i) {
+			code += out[i];
+			out[i] = code;
+		}
+	}
+
+	// Decode codes [begin, end) into out
+	void decode(const size_t begin, const size_t end, uint64_t* out) const {
+		uint64_t block[MORTON_BLOCK_CODES];
+		for (size_t i = begin; i < end;) {
+			const size_t b = i / MORTON_BLOCK_CODES, first = b * MORTON_BLOCK_CODES;
+			const size_t m = std::min(end, first + MORTON_BLOCK_CODES) - i;
+			if (i == first && m == MORTON_BLOCK_CODES) { decodeBlock(b, out); }
+			else {
+				decodeBlock(b, block);
+				std::copy(block + (i - first), block + (i - first) + m, out);
+			}
+			out += m;
+			i += m;
+		}
+	}
+
+	// Decode all codes into out, in parallel when OpenMP is enabled
+	void decodeAll(uint64_t* out) const {
+		const size_t full = n / MORTON_BLOCK_CODES;
+#pragma omp parallel for schedule(static)
+		for (long long b = 0; b < (long long)full; ++b) { decodeBlock((size_t)b, out + (size_t)b * MORTON_BLOCK_CODES); }
+		decode(full * MORTON_BLOCK_CODES, n, out + full * MORTON_BLOCK_CODES);
+	}
+
+	inline uint64_t operator[](const size_t i) const {
+		uint64_t block[MORTON_BLOCK_CODES];
+		decodeBlock(i / MORTON_BLOCK_CODES, block);
+		return block[i % MORTON_BLOCK_CODES];
+	}
+
+	// Position of the first code >= code: a search over the block directory, then one block is decoded
+	size_t lowerBound(const uint64_t code) const {
+		// first block whose first code is >= code: the answer lies in the block before it
+		size_t lo = 0, hi = directory.size();
+		while (lo < hi) {
+			const size_t mid = (lo + hi) / 2;
+			if (directory[mid].first < code) { lo = mid + 1; } else { hi = mid; }
+		}
+		if (lo == 0) { return 0; }
+		uint64_t block[MORTON_BLOCK_CODES];
+		decodeBlock(lo - 1, block);
+		const size_t first = (lo - 1) * MORTON_BLOCK_CODES, m = std::min(MORTON_BLOCK_CODES, n - first);
+		return first + (size_t)(std::lower_bound(block, block + m, code) - block);
+	}
+
+private:
+	size_t n;
+	std::vector<Block> directory;
+	std::vector<uint64_t> words;
+};
+
+#endif // MORTON_COMPRESS_H_
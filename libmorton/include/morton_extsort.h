@@ -0,0 +1,305 @@
+// Libmorton - External-memory (out-of-core) sort of morton codes with a payload, into a point file
+#ifndef MORTON_EXTSORT_H_
+#define MORTON_EXTSORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include "morton.h"
+#include "morton_sort.h"
+#include "morton_quantize.h"
+#include "morton_pointfile.h"
+
+// Sorts more (code, payload) records than fit in memory, in two steps:
+//  1. add(): records are appended to a run buffer. A full run is radix sorted (morton_sort.h) and
+//     written to its own run file on a background thread while the next run is filled, so reading and
+//     encoding the input overlap with writing the runs.
+//  2. finish() / merge(): the runs are merged with a heap of their smallest codes. Every run is read in
+//     blocks, and the next block of every run is read in the background while the current one is merged.
+//     Merged blocks go to the output in the background as well.
+// The sort is stable. If all records fit in one run, no run file is written.
+//
+// Memory: two run buffers of (code, payload, sort index) plus the radix sort buffers of one run, about
+// 2 * (12 + value_size) + 12 bytes per record of a run. The merge splits the same budget over two blocks
+// per run and the output blocks. Run files take as much disk space as the records (8 + value_size bytes each).
+
+static const size_t MORTON_EXTSORT_MINBLOCK = 4096; // records per run or merge block, at least
+static const size_t MORTON_EXTSORT_CHUNK = 65536; // points read and encoded at a time by morton3D_ExternalSortPoints
+
+class MortonExternalSort {
+public:
+	// temp_prefix: path prefix of the run files (prefix.run0, prefix.run1, ...)
+	// memory_bytes: budget for the buffers, value_size: payload bytes per record
+	MortonExternalSort(const std::string& temp_prefix, const size_t memory_bytes, const size_t value_size)
+		: prefix(temp_prefix), value_bytes(value_size), record_bytes(sizeof(uint64_t) + value_size),
+		memory(memory_bytes), total(0), current(0), ok(true) {
+		run_records = std::max(MORTON_EXTSORT_MINBLOCK,
+			memory_bytes / (2 * (sizeof(uint64_t) + sizeof(uint32_t) + value_size) + sizeof(uint64_t) + sizeof(uint32_t)));
+		run_records = (size_t)std::min((uint64_t)run_records, (uint64_t)0xFFFFFFFF); // sorted with 32-bit indices
+	}
+	~MortonExternalSort() {
+		wait(0);
+		wait(1);
+		removeRuns();
+	}
+
+	// Add n records: codes[i] with the value_size bytes at values + i * value_size
+	bool add(const uint64_t* codes, const void* values, size_t n) {
+		const char* v = (const char*)values;
+		while (n > 0 && ok) {
+			RunBuffer& b = buffers[current];
+			if (b.codes.capacity() < run_records) { b.codes.reserve(run_records); b.values.reserve(run_records * value_bytes); }
+			const size_t m = std::min(n, run_records - b.codes.size());
+			b.codes.insert(b.codes.end(), codes, codes + m);
+			b.values.insert(b.values.end(), v, v + m * value_bytes);
+			codes += m;
+			v += m * value_bytes;
+			n -= m;
+			total += m;
+			if (b.codes.size() == run_records) { writeRun(); }
+		}
+		return ok;
+	}
+
+	// Merge all records in code order into f(const uint64_t* codes, const char* values, size_t n), which gets
+	// blocks of records with their payloads packed (value_size bytes each) and returns false to stop.
+	// f is called one block at a time, on a background thread when there are runs to merge. The run files
+	// are removed afterwards.
+	template<typename sink>
+	bool merge(sink f) {
+		if (!ok) { return false; }
+		if (runs.empty()) { // everything fits in one run
+			RunBuffer& b = buffers[current];
+			sortRun(b);
+			const size_t block = std::max(MORTON_EXTSORT_MINBLOCK, (size_t)(1 << 20) / record_bytes);
+			std::vector<char> values(block * value_bytes + 1);
+			for (size_t i = 0; i < b.codes.size() && ok; i += block) {
+				const size_t m = std::min(block, b.codes.size() - i);
+				gather(b, i, m, &values[0]);
+				ok = f(&b.codes[i], &values[0], m);
+			}
+			b = RunBuffer();
+			return ok;
+		}
+		if (!buffers[current].codes.empty()) { writeRun(); }
+		ok = wait(0) && wait(1) && ok;
+		buffers[0] = RunBuffer();
+		buffers[1] = RunBuffer();
+		if (ok) { ok = mergeRuns(f); }
+		removeRuns();
+		return ok;
+	}
+
+	// Merge into a point file with the payload as its one column (no column if value_size is 0)
+	bool finish(const char* path, const unsigned int dims) {
+		MortonPointFileWriter writer;
+		const uint32_t column_size = (uint32_t)value_bytes;
+		if (!ok || !writer.open(path, dims, total, &column_size, (value_bytes > 0) ? 1 : 0)) { ok = false; removeRuns(); return false; }
+		const bool merged = merge([&writer](const uint64_t* codes, const char* values, size_t n) {
+			const void* column = values;
+			return writer.append(codes, n, &column);
+		});
+		return writer.close() && merged;
+	}
+
+	inline uint64_t size() const { return total; }
+	inline size_t runRecords() const { return run_records; }
+	inline size_t runCount() const { return runs.size(); }
+
+private:
+	struct RunBuffer {
+		std::vector<uint64_t> codes;
+		std::vector<char> values;
+		std::vector<uint32_t> order; // position of each sorted code in values
+		std::future<bool> pending; // write of this buffer to its run file
+	};
+	struct RunReader {
+		FILE* file;
+		uint64_t left; // records not read yet
+		std::vector<char> block[2];
+		size_t count[2];
+		int cur; // block being merged
+		size_t pos;
+		std::future<size_t> next; // read of the other block
+		bool failed; // a read returned fewer records than the run has left
+	};
+
+	std::string prefix;
+	size_t value_bytes, record_bytes, memory, run_records;
+	uint64_t total;
+	RunBuffer buffers[2];
+	int current;
+	std::vector<std::string> runs;
+	std::vector<uint64_t> run_sizes; // records per run
+	bool ok;
+
+	MortonExternalSort(const MortonExternalSort&);
+	MortonExternalSort& operator=(const MortonExternalSort&);
+
+	inline bool wait(const int b) {
+		return buffers[b].pending.valid() ? buffers[b].pending.get() : true;
+	}
+
+	void removeRuns() {
+		for (size_t r = 0; r < runs.size(); ++r) { remove(runs[r].c_str()); }
+		runs.clear();
+		run_sizes.clear();
+	}
+
+	void sortRun(RunBuffer& b) {
+		b.order.resize(b.codes.size());
+		for (size_t i = 0; i < b.order.size(); ++i) { b.order[i] = (uint32_t)i; }
+		if (!b.codes.empty()) { morton_RadixSortPairs<uint64_t, uint32_t>(&b.codes[0], &b.order[0], b.codes.size()); }
+	}
+
+	// payloads of the sorted records [begin, begin + n)
+	inline void gather(const RunBuffer& b, const size_t begin, const size_t n, char* values) const {
+		for (size_t i = 0; i < n; ++i) {
+			memcpy(values + i * value_bytes, b.values.data() + (size_t)b.order[begin + i] * value_bytes, value_bytes);
+		}
+	}
+
+	// Sort the current run, start writing it and switch to the other buffer
+	void writeRun() {
+		RunBuffer& b = buffers[current];
+		sortRun(b);
+		runs.push_back(prefix + ".run" + std::to_string((unsigned long long)runs.size()));
+		run_sizes.push_back(b.codes.size());
+		const std::string path = runs.back();
+		b.pending = std::async(std::launch::async, [this, &b, path]() {
+			FILE* file = fopen(path.c_str(), "wb");
+			if (!file) { return false; }
+			setvbuf(file, 0, _IONBF, 0);
+			const size_t block = std::max(MORTON_EXTSORT_MINBLOCK, (size_t)(1 << 20) / record_bytes);
+			std::vector<char> records(block * record_bytes);
+			bool written = true;
+			for (size_t i = 0; i < b.codes.size() && written; i += block) {
+				const size_t m = std::min(block, b.codes.size() - i);
+				for (size_t j = 0; j < m; ++j) {
+					char* r = &records[j * record_bytes];
+					memcpy(r, &b.codes[i + j], sizeof(uint64_t));
+					memcpy(r + sizeof(uint64_t), b.values.data() + (size_t)b.order[i + j] * value_bytes, value_bytes);
+				}
+				written = fwrite(&records[0], record_bytes, m, file) == m;
+			}
+			return (fclose(file) == 0) && written;
+		});
+		current ^= 1;
+		ok = wait(current) && ok; // the other buffer is refilled next
+		buffers[current].codes.clear();
+		buffers[current].values.clear();
+	}
+
+	size_t readBlock(RunReader& r, const int b, const size_t block) {
+		const size_t m = (size_t)std::min((uint64_t)block, r.left);
+		if (m == 0) { return 0; }
+		const size_t got = fread(&r.block[b][0], record_bytes, m, r.file);
+		r.left -= m;
+		if (got != m) { r.failed = true; }
+		return got;
+	}
+
+	template<typename sink>
+	bool mergeRuns(sink f) {
+		const size_t k = runs.size();
+		const size_t block = std::max(MORTON_EXTSORT_MINBLOCK, memory / (2 * (k + 1) * record_bytes));
+		std::vector<RunReader> readers(k);
+		typedef std::pair<uint64_t, uint32_t> entry; // (code, run): equal codes come out in run order
+		std::vector<entry> heap;
+		bool success = true;
+		for (size_t r = 0; r < k; ++r) {
+			RunReader& rr = readers[r];
+			rr.file = fopen(runs[r].c_str(), "rb");
+			if (!rr.file) { success = false; break; }
+			setvbuf(rr.file, 0, _IONBF, 0);
+			rr.left = run_sizes[r];
+			rr.block[0].resize(block * record_bytes);
+			rr.block[1].resize(block * record_bytes);
+			rr.cur = 0;
+			rr.pos = 0;
+			rr.failed = false;
+			rr.count[0] = readBlock(rr, 0, block);
+			if (rr.failed) { success = false; break; }
+			rr.next = std::async(std::launch::async, &MortonExternalSort::readBlock, this, std::ref(rr), 1, block);
+			if (rr.count[0] > 0) { heap.push_back(entry(recordCode(&rr.block[0][0]), (uint32_t)r)); }
+		}
+		std::make_heap(heap.begin(), heap.end(), std::greater<entry>());
+
+		std::vector<uint64_t> out_codes[2];
+		std::vector<char> out_values[2];
+		std::future<bool> out_pending;
+		int out = 0;
+		for (int b = 0; b < 2; ++b) { out_codes[b].resize(block); out_values[b].resize(block * value_bytes + 1); }
+		size_t o = 0;
+		while (success && !heap.empty()) {
+			std::pop_heap(heap.begin(), heap.end(), std::greater<entry>());
+			const entry e = heap.back();
+			heap.pop_back();
+			RunReader& rr = readers[e.second];
+			out_codes[out][o] = e.first;
+			memcpy(&out_values[out][o * value_bytes], &rr.block[rr.cur][rr.pos * record_bytes + sizeof(uint64_t)], value_bytes);
+			if (++rr.pos == rr.count[rr.cur]) {
+				// switch to the block read in the background and start reading the next one
+				rr.cur ^= 1;
+				rr.count[rr.cur] = rr.next.get();
+				rr.pos = 0;
+				if (rr.failed) { success = false; } // a truncated run would end the merge early
+				else if (rr.count[rr.cur] > 0) {
+					rr.next = std::async(std::launch::async, &MortonExternalSort::readBlock, this, std::ref(rr), rr.cur ^ 1, block);
+				}
+			}
+			if (rr.pos < rr.count[rr.cur]) {
+				heap.push_back(entry(recordCode(&rr.block[rr.cur][rr.pos * record_bytes]), e.second));
+				std::push_heap(heap.begin(), heap.end(), std::greater<entry>());
+			}
+			if (++o == block || heap.empty()) {
+				if (out_pending.valid()) { success = out_pending.get(); }
+				const uint64_t* c = &out_codes[out][0];
+				const char* v = &out_values[out][0];
+				out_pending = std::async(std::launch::async, [&f, c, v, o]() { return (bool)f(c, v, o); });
+				out ^= 1;
+				o = 0;
+			}
+		}
+		if (out_pending.valid()) { success = out_pending.get() && success; }
+		for (size_t r = 0; r < k; ++r) {
+			if (readers[r].next.valid()) { readers[r].next.wait(); }
+			if (readers[r].file) { fclose(readers[r].file); }
+			success = success && !readers[r].failed;
+		}
+		return success;
+	}
+
+	static inline uint64_t recordCode(const char* record) {
+		uint64_t code;
+		memcpy(&code, record, sizeof(uint64_t));
+		return code;
+	}
+};
+
+// Sort the points returned by read into a point file of 3D codes with the points (3 reals each) as payload
+// column, encoding them at the given bit depth inside the box (see morton3D_QuantizeEncodePoints).
+// read(real* xyz, size_t max_points) fills up to max_points interleaved points and returns how many it
+// filled, 0 at the end of the input. It runs while the previous run is written.
+template<typename real, typename reader>
+bool morton3D_ExternalSortPoints(reader read, const real* box_min, const real* box_max, const unsigned int bits,
+	const std::string& temp_prefix, const size_t memory_bytes, const char* path) {
+	static_assert(sizeof(uint_fast64_t) == sizeof(uint64_t), "codes are stored as 64-bit integers");
+	MortonExternalSort sorter(temp_prefix, memory_bytes, 3 * sizeof(real));
+	std::vector<real> xyz(MORTON_EXTSORT_CHUNK * 3);
+	std::vector<uint_fast64_t> codes(MORTON_EXTSORT_CHUNK);
+	size_t n;
+	while ((n = read(&xyz[0], MORTON_EXTSORT_CHUNK)) > 0) {
+		morton3D_QuantizeEncodePoints<real>(&xyz[0], n, box_min, box_max, bits, &codes[0]);
+		if (!sorter.add(reinterpret_cast<const uint64_t*>(&codes[0]), &xyz[0], n)) { return false; }
+	}
+	return sorter.finish(path, 3);
+}
+
+#endif // MORTON_EXTSORT_H_
@@ -0,0 +1,218 @@
+// Libmorton - Open-addressing hash map keyed by morton codes
+#ifndef MORTON_HASHMAP_H_
+#define MORTON_HASHMAP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include "morton_common.h"
+
+// Slots are grouped in buckets of 8 keys (one 64-byte cache line for 64-bit keys).
+// The bucket is picked from the morton prefix (the parent cell), the preferred slot
+// inside the bucket by the 3 lowest interleaved bits (the octant inside that cell).
+// The 8 cells of a 2x2x2 block thus share one cache line of keys, and the lowest
+// bits of the prefix are kept as they are, so neighbouring blocks land in
+// neighbouring buckets. Only the higher prefix bits are hashed.
+// Collisions are resolved with linear probing over the slots.
+//
+// The all-ones code marks empty slots. It is also a valid key (e.g. the 2D 32-bit code of (0xFFFF, 0xFFFF)),
+// which is kept outside the table, with a flag and a value of its own.
+template<typename morton, typename value>
+class MortonHashMap {
+public:
+	MortonHashMap(const size_t expected_size = 0) : count(0), has_empty_key(false), empty_key_value() {
+		allocate(slotsFor(expected_size));
+	}
+
+	inline size_t size() const { return count; }
+	inline bool empty() const { return count == 0; }
+	inline size_t capacity() const { return keys.size(); }
+
+	void clear() {
+		std::fill(keys.begin(), keys.end(), EMPTY);
+		count = 0;
+		has_empty_key = false;
+	}
+
+	void reserve(const size_t n) {
+		if (slotsFor(n) > keys.size()) { rehash(slotsFor(n)); }
+	}
+
+	// Insert or overwrite. Returns true if the key was not present yet.
+	inline bool insert(const morton key, const value& v) {
+		if (key == EMPTY) {
+			const bool added = !has_empty_key;
+			has_empty_key = true;
+			empty_key_value = v;
+			if (added) { ++count; }
+			return added;
+		}
+		if ((count + 1) * MAX_LOAD_DEN > keys.size() * MAX_LOAD_NUM) { rehash(keys.size() * 2); }
+		size_t i = homeSlot(key);
+		while (keys[i] != EMPTY) {
+			if (keys[i] == key) { values[i] = v; return false; }
+			i = (i + 1) & slot_mask;
+		}
+		keys[i] = key;
+		values[i] = v;
+		++count;
+		return true;
+	}
+
+	inline value* find(const morton key) {
+		if (key == EMPTY) { return has_empty_key ? &empty_key_value : 0; }
+		const ptrdiff_t i = findSlot(key);
+		return (i < 0) ? 0 : &values[i];
+	}
+
+	inline const value* find(const morton key) const {
+		if (key == EMPTY) { return has_empty_key ? &empty_key_value : 0; }
+		const ptrdiff_t i = findSlot(key);
+		return (i < 0) ? 0 : &values[i];
+	}
+
+	inline bool contains(const morton key) const {
+		if (key == EMPTY) { return has_empty_key; }
+		return findSlot(key) >= 0;
+	}
+
+	// Returns a reference to the value, inserting a default-constructed value if needed
+	inline value& operator[](const morton key) {
+		if (key == EMPTY) {
+			if (!has_empty_key) { insert(key, value()); }
+			return empty_key_value;
+		}
+		ptrdiff_t i = findSlot(key);
+		if (i < 0) {
+			insert(key, value());
+			i = findSlot(key);
+		}
+		return values[i];
+	}
+
+	// Remove a key (backward shift deletion, no tombstones). Returns true if it was present.
+	bool erase(const morton key) {
+		if (key == EMPTY) {
+			if (!has_empty_key) { return false; }
+			has_empty_key = false;
+			--count;
+			return true;
+		}
+		ptrdiff_t found = findSlot(key);
+		if (found < 0) { return false; }
+		size_t hole = (size_t) found;
+		size_t i = (hole + 1) & slot_mask;
+		while (keys[i] != EMPTY) {
+			// move the entry back if its home slot is not in the (cyclic) range (hole, i]
+			const size_t home = homeSlot(keys[i]);
+			if (((i - home) & slot_mask) >= ((i - hole) & slot_mask)) {
+				keys[hole] = keys[i];
+				values[hole] = values[i];
+				hole = i;
+			}
+			i = (i + 1) & slot_mask;
+		}
+		keys[hole] = EMPTY;
+		--count;
+		return true;
+	}
+
+	// Batch insert. Home slots of upcoming keys are prefetched to hide memory latency.
+	void insert(const morton* batch_keys, const value* batch_values, const size_t n) {
+		reserve(count + n);
+		for (size_t k = 0; k < n; ++k) {
+			if (k + PREFETCH_DISTANCE < n) { prefetchSlot(batch_keys[k + PREFETCH_DISTANCE]); }
+			insert(batch_keys[k], batch_values[k]);
+		}
+	}
+
+	// Batch lookup. Missing keys get not_found as value. Returns the number of keys found.
+	size_t lookup(const morton* batch_keys, const size_t n, value* out, const value& not_found) const {
+		size_t hits = 0;
+		for (size_t k = 0; k < n; ++k) {
+			if (k + PREFETCH_DISTANCE < n) { prefetchSlot(batch_keys[k + PREFETCH_DISTANCE]); }
+			const value* v = find(batch_keys[k]);
+			if (v == 0) { out[k] = not_found; }
+			else { out[k] = *v; ++hits; }
+		}
+		return hits;
+	}
+
+	// Call f(key, value) for every entry, in slot order
+	template<typename function>
+	void forEach(function f) const {
+		for (size_t i = 0; i < keys.size(); ++i) {
+			if (keys[i] != EMPTY) { f(keys[i], values[i]); }
+		}
+		if (has_empty_key) { f(EMPTY, empty_key_value); }
+	}
+
+private:
+	static const morton EMPTY = (morton) ~(morton)0;
+	static const size_t BUCKET_BITS = 3; // 8 slots per bucket
+	static const size_t MIN_SLOTS = 64;
+	static const size_t MAX_LOAD_NUM = 7; // grow beyond a load factor of 7/10
+	static const size_t MAX_LOAD_DEN = 10;
+	static const size_t PREFETCH_DISTANCE = 8;
+
+	std::vector<morton> keys;
+	std::vector<value> values;
+	size_t count; // including the all-ones key
+	bool has_empty_key;
+	value empty_key_value;
+	size_t slot_mask;
+	unsigned int hash_shift; // 64 - number of hashed bucket bits, 64 if there are none
+
+	static size_t slotsFor(const size_t n) {
+		size_t slots = MIN_SLOTS;
+		while (n * MAX_LOAD_DEN > slots * MAX_LOAD_NUM) { slots *= 2; }
+		return slots;
+	}
+
+	void allocate(const size_t slots) {
+		keys.assign(slots, EMPTY);
+		values.assign(slots, value());
+		slot_mask = slots - 1;
+		unsigned int slot_bits = 0;
+		while (((size_t)1 << slot_bits) < slots) { ++slot_bits; }
+		// the lowest 3 bits pick the slot, the next 3 bits pick one of 8 neighbouring buckets
+		hash_shift = 64 - (slot_bits - 2 * BUCKET_BITS);
+	}
+
+	inline size_t homeSlot(const morton key) const {
+		const uint_fast64_t prefix = (uint_fast64_t)key >> (2 * BUCKET_BITS);
+		const size_t hashed = (hash_shift >= 64) ? 0 : (size_t)((prefix * 0x9E3779B97F4A7C15ull) >> hash_shift);
+		return ((hashed << (2 * BUCKET_BITS)) | (size_t)(key & ((1 << (2 * BUCKET_BITS)) - 1))) & slot_mask;
+	}
+
+	inline ptrdiff_t findSlot(const morton key) const {
+		size_t i = homeSlot(key);
+		while (keys[i] != EMPTY) {
+			if (keys[i] == key) { return (ptrdiff_t)i; }
+			i = (i + 1) & slot_mask;
+		}
+		return -1;
+	}
+
+	inline void prefetchSlot(const morton key) const {
+		const size_t i = homeSlot(key);
+		morton_prefetch(&keys[i]);
+	}
+
+	void rehash(const size_t slots) {
+		std::vector<morton> old_keys;
+		std::vector<value> old_values;
+		old_keys.swap(keys);
+		old_values.swap(values);
+		allocate(slots);
+		count = has_empty_key ? 1 : 0;
+		for (size_t i = 0; i < old_keys.size(); ++i) {
+			if (old_keys[i] != EMPTY) { insert(old_keys[i], old_values[i]); }
+		}
+	}
+};
+
+template<typename morton, typename value> const morton MortonHashMap<morton, value>::EMPTY;
+
+#endif // MORTON_HASHMAP_H_
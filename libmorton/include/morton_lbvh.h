@@ -0,0 +1,188 @@
+// Libmorton - Linear BVH (LBVH) builder: bounding volume hierarchy from sorted morton codes
+#ifndef MORTON_LBVH_H_
+#define MORTON_LBVH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include "morton.h"
+#include "morton_sort.h"
+#include "morton_quantize.h"
+
+// Build steps (each one is distributed over the threads when OpenMP is enabled):
+//  1. quantize the centroids of the primitive boxes to 21 bits per axis inside their bounding box
+//     (morton_quantize.h) and encode them with morton3D_64_encode
+//  2. radix sort the codes along with the primitive indices (morton_sort.h)
+//  3. build the hierarchy from the common prefixes of the sorted codes (Karras 2012, "Maximizing
+//     parallelism in the construction of BVHs, octrees and k-d trees"): every internal node finds
+//     its range and split on its own. Equal codes are told apart by their position in the array.
+//  4. compute the bounding boxes bottom-up. Of the two children of a node, the one that finishes
+//     last computes the box of the parent and moves on to the grandparent.
+//
+// The result is one flat array of 2n - 1 nodes of 32 bytes: internal nodes 0 .. n - 2 (the root
+// is node 0) followed by one leaf per primitive in morton order (a single primitive is a leaf root).
+
+static const uint32_t MORTON_BVH_LEAF = 0xFFFFFFFF;
+
+struct MortonBVHNode {
+	float lo[3], hi[3]; // bounding box
+	uint32_t left, right; // internal node: child node indices. leaf: primitive index and MORTON_BVH_LEAF
+	MortonBVHNode() {} // left uninitialized: every node is written by the build
+};
+
+class MortonLBVH {
+public:
+	MortonLBVH() : n(0) {}
+
+	// bounds: 6 floats per primitive (min x, y, z, max x, y, z). At most 2^31 primitives.
+	void build(const float* bounds, const size_t count) {
+		n = count;
+		nodes.resize((n == 0) ? 0 : 2 * n - 1);
+		if (n == 0) { return; }
+
+		// 1. centroid bounds (per chunk, then merged) and codes
+		const size_t chunks = 64, chunk_size = (n + chunks - 1) / chunks;
+		std::vector<float> chunk_bounds(chunks * 6);
+#pragma omp parallel for schedule(static, 1)
+		for (long long c = 0; c < (long long)chunks; ++c) {
+			float* cb = &chunk_bounds[(size_t)c * 6];
+			cb[0] = cb[1] = cb[2] = 3.4e38f;
+			cb[3] = cb[4] = cb[5] = -3.4e38f;
+			const size_t end = std::min(n, ((size_t)c + 1) * chunk_size);
+			for (size_t i = (size_t)c * chunk_size; i < end; ++i) {
+				for (int a = 0; a < 3; ++a) {
+					const float centroid = 0.5f * (bounds[i * 6 + a] + bounds[i * 6 + 3 + a]);
+					cb[a] = std::min(cb[a], centroid);
+					cb[3 + a] = std::max(cb[3 + a], centroid);
+				}
+			}
+		}
+		float lo[3] = { 3.4e38f, 3.4e38f, 3.4e38f };
+		float hi[3] = { -3.4e38f, -3.4e38f, -3.4e38f };
+		for (size_t c = 0; c < chunks; ++c) {
+			for (int a = 0; a < 3; ++a) {
+				lo[a] = std::min(lo[a], chunk_bounds[c * 6 + a]);
+				hi[a] = std::max(hi[a], chunk_bounds[c * 6 + 3 + a]);
+			}
+		}
+		const MortonQuantizer<float, 3> quantizer(lo, hi, 21);
+
+		std::vector<uint_fast64_t> codes(n);
+		std::vector<uint32_t> order(n);
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < (long long)n; ++i) {
+			uint_fast32_t q[3];
+			for (int a = 0; a < 3; ++a) {
+				const float centroid = 0.5f * (bounds[i * 6 + a] + bounds[i * 6 + 3 + a]);
+				q[a] = quantizer.quantize(centroid, a);
+			}
+			codes[i] = morton3D_64_encode(q[0], q[1], q[2]);
+			order[i] = (uint32_t)i;
+		}
+
+		// 2. sort
+		morton_RadixSortPairs<uint_fast64_t, uint32_t>(&codes[0], &order[0], n, 63);
+
+		// leaves
+		const size_t first_leaf = n - 1;
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < (long long)n; ++i) {
+			MortonBVHNode& leaf = nodes[first_leaf + i];
+			const float* b = bounds + (size_t)order[i] * 6;
+			for (int a = 0; a < 3; ++a) { leaf.lo[a] = b[a]; leaf.hi[a] = b[3 + a]; }
+			leaf.left = order[i];
+			leaf.right = MORTON_BVH_LEAF;
+		}
+		if (n == 1) { return; }
+
+		// 3. hierarchy
+		std::vector<uint32_t> parents(2 * n - 1);
+		const uint_fast64_t* c = &codes[0];
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < (long long)n - 1; ++i) {
+			// direction of the range that starts at i, and the prefix length it has to beat
+			const int d = (delta(c, i, i + 1) > delta(c, i, i - 1)) ? 1 : -1;
+			const int delta_min = delta(c, i, i - d);
+			long long lmax = 2;
+			while (delta(c, i, i + lmax * d) > delta_min) { lmax *= 2; }
+			long long l = 0;
+			for (long long t = lmax / 2; t >= 1; t /= 2) {
+				if (delta(c, i, i + (l + t) * d) > delta_min) { l += t; }
+			}
+			const long long j = i + l * d;
+			// split: last position that shares more than delta_node bits with i
+			const int delta_node = delta(c, i, j);
+			long long s = 0;
+			for (long long t = l; t > 1;) {
+				t = (t + 1) / 2;
+				if (delta(c, i, i + (s + t) * d) > delta_node) { s += t; }
+			}
+			const long long split = i + s * d + std::min(d, 0);
+			MortonBVHNode& node = nodes[i];
+			node.left = (uint32_t)((std::min(i, j) == split) ? first_leaf + split : split);
+			node.right = (uint32_t)((std::max(i, j) == split + 1) ? first_leaf + split + 1 : split + 1);
+			parents[node.left] = (uint32_t)i;
+			parents[node.right] = (uint32_t)i;
+		}
+
+		// 4. bounds
+		std::vector<uint32_t> visits(n - 1, 0);
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < (long long)n; ++i) {
+			size_t node = first_leaf + i;
+			while (node != 0) {
+				const size_t parent = parents[node];
+				if (morton_atomicIncrement((volatile uint32_t*)&visits[parent]) == 0) { break; } // the other child is not done yet
+				MortonBVHNode& p = nodes[parent];
+				const MortonBVHNode& l = nodes[p.left];
+				const MortonBVHNode& r = nodes[p.right];
+				for (int a = 0; a < 3; ++a) {
+					p.lo[a] = std::min(l.lo[a], r.lo[a]);
+					p.hi[a] = std::max(l.hi[a], r.hi[a]);
+				}
+				node = parent;
+			}
+		}
+	}
+
+	inline size_t size() const { return n; }
+	inline size_t nodeCount() const { return nodes.size(); }
+	inline const MortonBVHNode* data() const { return nodes.empty() ? 0 : &nodes[0]; }
+	inline const MortonBVHNode& node(const size_t i) const { return nodes[i]; }
+	static inline bool isLeaf(const MortonBVHNode& node) { return node.right == MORTON_BVH_LEAF; }
+
+	inline size_t memoryUsage() const { return nodes.capacity() * sizeof(MortonBVHNode); }
+
+	// Call f(primitive index) for every primitive whose box overlaps the given box (6 floats)
+	template<typename function>
+	void overlapping(const float* box, function f) const {
+		if (n == 0) { return; }
+		uint32_t stack[STACKSIZE];
+		unsigned int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const MortonBVHNode& node = nodes[stack[--top]];
+			if (node.lo[0] > box[3] || node.lo[1] > box[4] || node.lo[2] > box[5]
+				|| node.hi[0] < box[0] || node.hi[1] < box[1] || node.hi[2] < box[2]) { continue; }
+			if (isLeaf(node)) { f(node.left); continue; }
+			stack[top++] = node.right;
+			stack[top++] = node.left;
+		}
+	}
+
+private:
+	static const unsigned int STACKSIZE = 128; // the tree is at most 63 + 32 levels deep
+	size_t n;
+	std::vector<MortonBVHNode> nodes;
+
+	// Length of the common prefix of codes i and j, with the positions appended to make equal codes unique.
+	// -1 if j is out of range.
+	inline int delta(const uint_fast64_t* codes, const long long i, const long long j) const {
+		if (j < 0 || j >= (long long)n) { return -1; }
+		if (codes[i] == codes[j]) { return 64 + (int)morton_clz<uint_fast64_t>((uint_fast64_t)(i ^ j)); }
+		return (int)morton_clz<uint_fast64_t>(codes[i] ^ codes[j]);
+	}
+};
+
+#endif // MORTON_LBVH_H_
@@ -0,0 +1,110 @@
+// Libmorton - Level-of-detail pyramids: points per octree cell at every level, counted in one pass
+#ifndef MORTON_LOD_H_
+#define MORTON_LOD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include "morton.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// A cell at level l is named by its 3 * l bit code (morton3D_EncodeLevel). The 8 children of cell c at
+// level l are the cells 8c .. 8c + 7 at level l + 1, so the counts of a level are the sums of 8
+// neighbouring counts of the level below it.
+
+// DENSE PYRAMID : one count per cell, level after level (level 0 first, then its 8 children, ...).
+// Fits the coarse levels: a pyramid down to level 8 has 19M cells.
+
+// Index of the first cell of the given level in a dense pyramid: 1 + 8 + ... + 8^(level - 1)
+inline size_t morton3D_PyramidOffset(const unsigned int level) {
+	return (((size_t)1 << (3 * level)) - 1) / 7;
+}
+
+// Cells in a dense pyramid with levels 0 .. level
+inline size_t morton3D_PyramidSize(const unsigned int level) {
+	return morton3D_PyramidOffset(level + 1);
+}
+
+// Fill the levels level - 1 .. 0 of a dense pyramid from its deepest level
+inline void morton3D_PyramidReduce(uint32_t* counts, const unsigned int level) {
+	for (unsigned int l = level; l-- > 0;) {
+		uint32_t* parents = counts + morton3D_PyramidOffset(l);
+		const uint32_t* children = counts + morton3D_PyramidOffset(l + 1);
+		const long long cells = (long long)1 << (3 * l);
+#pragma omp parallel for schedule(static)
+		for (long long c = 0; c < cells; ++c) {
+			const uint32_t* s = children + 8 * c;
+			parents[c] = s[0] + s[1] + s[2] + s[3] + s[4] + s[5] + s[6] + s[7];
+		}
+	}
+}
+
+// Histogram of the deepest cells. Several threads share the counts through atomic increments; a single
+// thread uses plain ones, which keep many cache misses in flight.
+template<typename morton, typename coord, bool ATOMIC>
+inline void morton3D_PyramidLeafCounts(const coord* x, const coord* y, const coord* z, const size_t n, const unsigned int level,
+	uint32_t* leaves, morton* codes) {
+#pragma omp parallel for schedule(static) if(ATOMIC)
+	for (long long i = 0; i < (long long)n; ++i) {
+		const morton cell = morton3D_EncodeLevel<morton, coord>(x[i], y[i], z[i], level);
+		if (codes) { codes[i] = cell; }
+		if (ATOMIC) { morton_atomicIncrement((volatile uint32_t*)&leaves[cell]); }
+		else { ++leaves[cell]; }
+	}
+}
+
+// Count the points (x[i], y[i], z[i]) of every cell at levels 0 .. level, in one pass over the points:
+// only the cell at the deepest level is encoded per point (morton3D_EncodeLevel), the other levels are
+// summed up from it. counts: morton3D_PyramidSize(level) entries, cleared first. If codes is given,
+// codes[i] receives the code of the deepest cell of point i.
+template<typename morton, typename coord>
+void morton3D_PyramidCounts(const coord* x, const coord* y, const coord* z, const size_t n, const unsigned int level,
+	uint32_t* counts, morton* codes = 0) {
+	std::fill(counts, counts + morton3D_PyramidSize(level), (uint32_t)0);
+	uint32_t* leaves = counts + morton3D_PyramidOffset(level);
+#ifdef _OPENMP
+	if (omp_get_max_threads() > 1) { morton3D_PyramidLeafCounts<morton, coord, true>(x, y, z, n, level, leaves, codes); }
+	else
+#endif
+	{ morton3D_PyramidLeafCounts<morton, coord, false>(x, y, z, n, level, leaves, codes); }
+	morton3D_PyramidReduce(counts, level);
+}
+
+// SPARSE PYRAMID : the non-empty cells of every level, from a sorted array of codes. Fits any depth.
+template<typename morton>
+struct MortonLevelCell {
+	morton cell; // code of the cell at its level
+	size_t first; // position of the first code of the cell in the sorted array
+	size_t count; // number of codes in the cell: [first, first + count)
+};
+
+// cells[l] = the non-empty cells of level l, in morton order, for l = 0 .. level. codes: n full-depth codes
+// in non-decreasing order. One pass over the codes: a cell ends where two neighbouring codes stop sharing it,
+// which morton3D_commonLevel tells for all levels at once. level must be at most morton3D_maxLevel;
+// deeper levels are clamped to it.
+template<typename morton>
+void morton3D_SparsePyramid(const morton* codes, const size_t n, unsigned int level,
+	std::vector<std::vector<MortonLevelCell<morton> > >& cells) {
+	const unsigned int max_level = morton3D_maxLevel<morton>();
+	level = std::min(level, max_level);
+	cells.assign(level + 1, std::vector<MortonLevelCell<morton> >());
+	if (n == 0) { return; }
+	std::vector<size_t> first(level + 1, 0); // first code of the open cell of every level
+	for (size_t i = 1; i <= n; ++i) {
+		// levels deeper than the common level of codes i - 1 and i close their cell (all levels at the end)
+		const unsigned int from = (i == n) ? 0 : std::min(morton3D_commonLevel<morton>(codes[i - 1], codes[i]) + 1, level + 1);
+		for (unsigned int l = from; l <= level; ++l) {
+			MortonLevelCell<morton> c;
+			c.cell = codes[i - 1] >> (3 * (max_level - l));
+			c.first = first[l];
+			c.count = i - first[l];
+			cells[l].push_back(c);
+			first[l] = i;
+		}
+	}
+}
+
+#endif // MORTON_LOD_H_
@@ -0,0 +1,271 @@
+// Libmorton - NUMA-aware parallel encode and sort of 3D points to morton codes
+#ifndef MORTON_NUMA_H_
+#define MORTON_NUMA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include <new>
+#include "morton3D.h"
+#include "morton_sort.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(MORTON_LIBNUMA)
+#include <numa.h>
+#endif
+
+// On a machine with several NUMA nodes (sockets), the points are split in one contiguous part per node.
+// Part k is encoded and sorted into buffers allocated on node k, so all sort passes work in memory of that
+// node. The sorted parts are then merged into the output, which is cut in one range per node: the pages of
+// range k that are not touched yet are bound to node k before the merge writes them, and range k is written
+// by the team that also sorted part k. Pages of the output that the caller already touched stay where they
+// are. The input is read once, from wherever it was loaded.
+//
+// The threads are not pinned by these methods, and the process affinity is left alone. The outer region
+// (one thread per part) asks for proc_bind(spread) and the merge teams for proc_bind(close); run with
+// OMP_PLACES=cores OMP_PROC_BIND=spread,close so that the encode and sort teams also stay on their node.
+//
+// Experimental: this has only been run on single-node machines, where two parts are about 20% slower than
+// one, and has not been measured on a multi-socket machine yet.
+//
+// Node placement needs libnuma: define MORTON_LIBNUMA and link with -lnuma. Without it, or when the kernel
+// has no NUMA support, there is a single part, and the methods are a parallel encode and morton_RadixSort.
+// Nested OpenMP parallelism is enabled during the call, so that each part gets a team of its own.
+
+// Nodes with memory, or a single -1 (no placement) without libnuma
+inline std::vector<int> morton_NumaNodes() {
+	std::vector<int> nodes;
+#if defined(MORTON_LIBNUMA)
+	if (numa_available() >= 0) {
+		for (int node = 0; node <= numa_max_node(); ++node) {
+			if (numa_bitmask_isbitset(numa_all_nodes_ptr, node)) { nodes.push_back(node); }
+		}
+	}
+#endif
+	if (nodes.empty()) { nodes.push_back(-1); }
+	return nodes;
+}
+
+// n elements, not initialized, in memory of the given node (anywhere if node < 0 or without libnuma)
+template<typename T>
+class MortonNodeBuffer {
+public:
+	MortonNodeBuffer() : elements(0), count(0), onnode(false) {}
+	~MortonNodeBuffer() { release(); }
+
+	void allocate(const size_t n, const int node) {
+		release();
+		count = n;
+#if defined(MORTON_LIBNUMA)
+		if (node >= 0 && n > 0) {
+			elements = (T*)numa_alloc_onnode(n * sizeof(T), node);
+			if (elements == 0) { throw std::bad_alloc(); }
+			onnode = true;
+			return;
+		}
+#else
+		(void)node;
+#endif
+		elements = new T[n];
+	}
+
+	inline T* data() const { return elements; }
+
+private:
+	T* elements;
+	size_t count;
+	bool onnode;
+
+	void release() {
+#if defined(MORTON_LIBNUMA)
+		if (onnode) { numa_free(elements, count * sizeof(T)); }
+		else
+#endif
+		{ delete[] elements; }
+		elements = 0;
+		onnode = false;
+	}
+
+	MortonNodeBuffer(const MortonNodeBuffer&);
+	MortonNodeBuffer& operator=(const MortonNodeBuffer&);
+};
+
+// The pages inside [p, p + n) that are not touched yet will be allocated on the node (nothing without libnuma)
+template<typename T>
+inline void morton_NumaPlaceRange(T* p, const size_t n, const int node) {
+#if defined(MORTON_LIBNUMA)
+	if (node < 0 || n == 0) { return; }
+	const uintptr_t page = (uintptr_t)numa_pagesize();
+	const uintptr_t begin = ((uintptr_t)p + page - 1) & ~(page - 1), end = (uintptr_t)(p + n) & ~(page - 1);
+	if (end > begin) { numa_tonode_memory((void*)begin, end - begin, node); }
+#else
+	(void)p; (void)n; (void)node;
+#endif
+}
+
+// Merge the codes between bounds[j * parts + k] and bounds[(j + 1) * parts + k] of every part k into the output,
+// from position out. Equal codes are taken from the lower part first, so the merge is stable.
+template<typename morton, typename index, bool PAIRS>
+inline void morton_NumaMergePiece(const std::vector<morton*>& part_codes, const std::vector<index*>& part_order, const size_t* first, const size_t* end,
+	size_t out, morton* codes, index* order) {
+	const size_t parts = part_codes.size();
+	std::vector<size_t> head(first, first + parts);
+	size_t out_end = out;
+	for (size_t k = 0; k < parts; ++k) { out_end += end[k] - first[k]; }
+	for (; out < out_end; ++out) {
+		size_t best = parts;
+		for (size_t k = 0; k < parts; ++k) {
+			if (head[k] < end[k] && (best == parts || part_codes[k][head[k]] < part_codes[best][head[best]])) { best = k; }
+		}
+		codes[out] = part_codes[best][head[best]];
+		if (PAIRS) { order[out] = part_order[best][head[best]]; }
+		++head[best];
+	}
+}
+
+// Merge the sorted parts into codes (and order). The output is cut in pieces at code values, so that all
+// pieces hold about the same number of codes; part k's team writes the k-th run of pieces, whose pages are
+// bound to part_node[k] first.
+template<typename morton, typename index, bool PAIRS>
+void morton_NumaMergeParts(const std::vector<morton*>& part_codes, const std::vector<index*>& part_order, const std::vector<size_t>& part_size,
+	const std::vector<int>& part_node, morton* codes, index* order) {
+	const size_t parts = part_codes.size();
+	size_t n = 0;
+	morton top = 0;
+	for (size_t k = 0; k < parts; ++k) {
+		n += part_size[k];
+		if (part_size[k] > 0) { top = std::max(top, part_codes[k][part_size[k] - 1]); }
+	}
+#ifdef _OPENMP
+	const int team = std::max(1, omp_get_max_threads() / (int)parts);
+	const size_t part_pieces = std::max<size_t>(1, std::min<size_t>(n / 65536 / parts, 4 * (size_t)team));
+#else
+	const size_t part_pieces = 1;
+#endif
+	const size_t pieces = parts * part_pieces;
+	// bounds[j * parts + k]: first code of part k in piece j, the first code above the piece's top value
+	std::vector<size_t> bounds((pieces + 1) * parts);
+	for (size_t k = 0; k < parts; ++k) { bounds[pieces * parts + k] = part_size[k]; }
+	for (size_t j = 1; j < pieces; ++j) {
+		const size_t target = n * j / pieces;
+		morton lo = 0, hi = top; // smallest value with at least target codes at or below it
+		while (lo < hi) {
+			const morton mid = lo + (hi - lo) / 2;
+			size_t below = 0;
+			for (size_t k = 0; k < parts; ++k) { below += (size_t)(std::upper_bound(part_codes[k], part_codes[k] + part_size[k], mid) - part_codes[k]); }
+			if (below >= target) { hi = mid; }
+			else { lo = mid + 1; }
+		}
+		for (size_t k = 0; k < parts; ++k) { bounds[j * parts + k] = (size_t)(std::upper_bound(part_codes[k], part_codes[k] + part_size[k], lo) - part_codes[k]); }
+	}
+	// out[j]: output position of piece j
+	std::vector<size_t> out(pieces + 1, 0);
+	for (size_t j = 0; j <= pieces; ++j) {
+		for (size_t k = 0; k < parts; ++k) { out[j] += bounds[j * parts + k]; }
+	}
+	for (size_t k = 0; k < parts; ++k) {
+		const size_t begin = out[k * part_pieces], end = out[(k + 1) * part_pieces];
+		morton_NumaPlaceRange<morton>(codes + begin, end - begin, part_node[k]);
+		if (PAIRS) { morton_NumaPlaceRange<index>(order + begin, end - begin, part_node[k]); }
+	}
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+#pragma omp parallel for num_threads(parts) schedule(static, 1) proc_bind(spread)
+#else
+#pragma omp parallel for num_threads(parts) schedule(static, 1)
+#endif
+	for (long long k = 0; k < (long long)parts; ++k) {
+		const long long first_piece = k * (long long)part_pieces;
+#if defined(_OPENMP) && _OPENMP >= 201307
+#pragma omp parallel for num_threads(team) schedule(static) proc_bind(close)
+#elif defined(_OPENMP)
+#pragma omp parallel for num_threads(team) schedule(static)
+#endif
+		for (long long j = first_piece; j < first_piece + (long long)part_pieces; ++j) {
+			morton_NumaMergePiece<morton, index, PAIRS>(part_codes, part_order, &bounds[(size_t)j * parts], &bounds[((size_t)j + 1) * parts], out[(size_t)j], codes, order);
+		}
+	}
+}
+
+template<typename morton, typename coord, typename index, bool PAIRS>
+void morton3D_NumaEncodeSortImpl(const coord* x, const coord* y, const coord* z, const size_t n, morton* codes, index* order,
+	unsigned int parts, const unsigned int key_bits) {
+	const std::vector<int> nodes = morton_NumaNodes();
+	if (parts == 0) { parts = (unsigned int)nodes.size(); }
+	if (parts <= 1 || n < parts) {
+		morton3D_EncodeArray<morton, coord>(x, y, z, n, codes);
+		if (!PAIRS) { morton_RadixSort<morton>(codes, n, key_bits); return; }
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < (long long)n; ++i) { order[i] = (index)i; }
+		morton_RadixSortPairs<morton, index>(codes, order, n, key_bits);
+		return;
+	}
+
+	std::vector<MortonNodeBuffer<morton> > part_code_buffers(parts);
+	std::vector<MortonNodeBuffer<index> > part_order_buffers(parts);
+	std::vector<morton*> part_codes(parts, (morton*)0);
+	std::vector<index*> part_order(parts, (index*)0);
+	std::vector<size_t> part_size(parts);
+	std::vector<int> part_node(parts);
+	for (size_t k = 0; k < parts; ++k) {
+		part_node[k] = nodes[k % nodes.size()];
+		const size_t begin = n * k / parts;
+		part_size[k] = n * (k + 1) / parts - begin;
+		part_code_buffers[k].allocate(part_size[k], part_node[k]);
+		part_codes[k] = part_code_buffers[k].data();
+		if (PAIRS) {
+			part_order_buffers[k].allocate(part_size[k], part_node[k]);
+			part_order[k] = part_order_buffers[k].data();
+		}
+	}
+#ifdef _OPENMP
+	const int threads = omp_get_max_threads();
+	const int levels = omp_get_max_active_levels();
+	omp_set_max_active_levels(std::max(levels, 2));
+#endif
+#if defined(_OPENMP) && _OPENMP >= 201307
+#pragma omp parallel for num_threads(parts) schedule(static, 1) proc_bind(spread)
+#else
+#pragma omp parallel for num_threads(parts) schedule(static, 1)
+#endif
+	for (long long k = 0; k < (long long)parts; ++k) {
+#ifdef _OPENMP
+		omp_set_num_threads(std::max(1, threads / (int)parts));
+#endif
+		const size_t begin = n * (size_t)k / parts, count = part_size[(size_t)k];
+		morton* c = part_codes[(size_t)k];
+		morton3D_EncodeArray<morton, coord>(x + begin, y + begin, z + begin, count, c);
+		if (PAIRS) {
+			index* o = part_order[(size_t)k];
+#pragma omp parallel for schedule(static)
+			for (long long i = 0; i < (long long)count; ++i) { o[i] = (index)(begin + (size_t)i); }
+			morton_RadixSortPairs<morton, index>(c, o, count, key_bits);
+		}
+		else {
+			morton_RadixSort<morton>(c, count, key_bits);
+		}
+	}
+	morton_NumaMergeParts<morton, index, PAIRS>(part_codes, part_order, part_size, part_node, codes, order);
+#ifdef _OPENMP
+	omp_set_max_active_levels(levels);
+#endif
+}
+
+// codes = the sorted codes of the n points (x[i], y[i], z[i]). parts: number of parts, 0 for one per NUMA node.
+// key_bits: number of low bits of the codes that can be non-zero, as for morton_RadixSort.
+template<typename morton, typename coord>
+inline void morton3D_NumaEncodeSort(const coord* x, const coord* y, const coord* z, const size_t n, morton* codes,
+	const unsigned int parts = 0, const unsigned int key_bits = sizeof(morton) * 8) {
+	morton3D_NumaEncodeSortImpl<morton, coord, char, false>(x, y, z, n, codes, 0, parts, key_bits);
+}
+
+// The same, and order[i] = index of the point of codes[i] (points with equal codes keep their input order)
+template<typename morton, typename coord, typename index>
+inline void morton3D_NumaEncodeSortPairs(const coord* x, const coord* y, const coord* z, const size_t n, morton* codes, index* order,
+	const unsigned int parts = 0, const unsigned int key_bits = sizeof(morton) * 8) {
+	morton3D_NumaEncodeSortImpl<morton, coord, index, true>(x, y, z, n, codes, order, parts, key_bits);
+}
+
+#endif // MORTON_NUMA_H_
@@ -0,0 +1,168 @@
+// Libmorton - Linear octree built on top of 64-bit 3D morton codes
+#ifndef MORTON_OCTREE_H_
+#define MORTON_OCTREE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+
+// A node is identified by its level (0 = root, MORTON_OCTREE_MAXLEVEL = single cell)
+// and the full-depth morton code of its minimum corner (the "anchor").
+// Sorting nodes by anchor code gives the Z-order of the tree.
+static const unsigned int MORTON_OCTREE_MAXLEVEL = 21;
+
+// Point location first narrows the binary search using the top bits of the code (5 levels)
+static const unsigned int MORTON_OCTREE_INDEXBITS = 15;
+
+struct MortonOctreeNode {
+	uint_fast64_t code;
+	unsigned int level;
+
+	MortonOctreeNode() : code(0), level(0) {}
+	MortonOctreeNode(const uint_fast64_t code, const unsigned int level) : code(code), level(level) {}
+
+	inline bool operator==(const MortonOctreeNode& other) const { return code == other.code && level == other.level; }
+	inline bool operator!=(const MortonOctreeNode& other) const { return !(*this == other); }
+};
+
+// Bits of the anchor code that lie below the node (all zero in the anchor itself)
+inline uint_fast64_t morton3D_Octree_LevelMask(const unsigned int level) {
+	return ((uint_fast64_t)0x1 << (3 * (MORTON_OCTREE_MAXLEVEL - level))) - 1;
+}
+
+// Last full-depth code that still lies inside the node
+inline uint_fast64_t morton3D_Octree_LastDescendant(const MortonOctreeNode& n) {
+	return n.code | morton3D_Octree_LevelMask(n.level);
+}
+
+inline bool morton3D_Octree_Contains(const MortonOctreeNode& n, const uint_fast64_t code) {
+	return (code & ~morton3D_Octree_LevelMask(n.level)) == n.code;
+}
+
+// Which of the 8 children of its parent this node is (level must be > 0)
+inline unsigned int morton3D_Octree_ChildIndex(const MortonOctreeNode& n) {
+	return (unsigned int)((n.code >> (3 * (MORTON_OCTREE_MAXLEVEL - n.level))) & 0x7);
+}
+
+// The root (level 0) is its own parent
+inline MortonOctreeNode morton3D_Octree_Parent(const MortonOctreeNode& n) {
+	if (n.level == 0) { return n; }
+	return MortonOctreeNode(n.code & ~morton3D_Octree_LevelMask(n.level - 1), n.level - 1);
+}
+
+inline MortonOctreeNode morton3D_Octree_Child(const MortonOctreeNode& n, const unsigned int i) {
+	return MortonOctreeNode(n.code | ((uint_fast64_t)i << (3 * (MORTON_OCTREE_MAXLEVEL - n.level - 1))), n.level + 1);
+}
+
+inline MortonOctreeNode morton3D_Octree_Sibling(const MortonOctreeNode& n, const unsigned int i) {
+	const unsigned int shift = 3 * (MORTON_OCTREE_MAXLEVEL - n.level);
+	return MortonOctreeNode((n.code & ~((uint_fast64_t)0x7 << shift)) | ((uint_fast64_t)i << shift), n.level);
+}
+
+// Linear octree: only the (non-empty) leaves are stored, sorted by anchor code.
+// Codes and levels are kept in separate arrays, so a leaf costs 9 bytes.
+// Internal nodes are implicit: the leaves below a node form a contiguous range.
+// A small table over the top levels (256 KB) narrows down the binary searches.
+class MortonOctree {
+public:
+	MortonOctree() {}
+
+	// Build from an array of sorted full-depth 64-bit 3D morton codes (63 bits: bit 63 must be clear).
+	// A node is split as long as it holds more than max_points_per_leaf codes.
+	// Empty octants produce no leaves.
+	void build(const uint_fast64_t* sorted_codes, const size_t n, const size_t max_points_per_leaf) {
+		assert(n == 0 || (sorted_codes[n - 1] >> INDEX_SHIFT) < INDEX_BUCKETS);
+		codes.clear();
+		levels.clear();
+		if (n > 0) {
+			buildNode(sorted_codes, 0, n, MortonOctreeNode(0, 0), max_points_per_leaf == 0 ? 1 : max_points_per_leaf);
+		}
+		codes.shrink_to_fit();
+		levels.shrink_to_fit();
+		buildIndex();
+	}
+
+	inline size_t size() const { return codes.size(); }
+	inline MortonOctreeNode leaf(const size_t i) const { return MortonOctreeNode(codes[i], levels[i]); }
+	inline const uint_fast64_t* leafCodes() const { return codes.empty() ? 0 : &codes[0]; }
+	inline const uint8_t* leafLevels() const { return levels.empty() ? 0 : &levels[0]; }
+
+	// Index of the leaf containing the given full-depth code, or -1 if it lies in an empty region
+	inline ptrdiff_t locate(const uint_fast64_t code) const {
+		if (codes.empty()) { return -1; }
+		const size_t bucket = (size_t)(code >> INDEX_SHIFT);
+		if (bucket >= INDEX_BUCKETS) { return -1; } // bit 63 set: not a 3D code
+		std::vector<uint_fast64_t>::const_iterator it = std::upper_bound(codes.begin() + index[bucket], codes.begin() + index[bucket + 1], code);
+		if (it == codes.begin()) { return -1; }
+		const size_t i = (it - codes.begin()) - 1;
+		return morton3D_Octree_Contains(leaf(i), code) ? (ptrdiff_t)i : -1;
+	}
+
+	// Index of the given leaf node, or -1 if it is not a leaf of this tree
+	inline ptrdiff_t find(const MortonOctreeNode& n) const {
+		std::vector<uint_fast64_t>::const_iterator it = std::lower_bound(codes.begin(), codes.end(), n.code);
+		if (it == codes.end() || *it != n.code) { return -1; }
+		const size_t i = it - codes.begin();
+		return (levels[i] == n.level) ? (ptrdiff_t)i : -1;
+	}
+
+	// Range [begin, end) of leaves that lie inside the given node (empty if the node is not in the tree)
+	inline void leafRange(const MortonOctreeNode& n, size_t& begin, size_t& end) const {
+		std::vector<uint_fast64_t>::const_iterator first = codes.begin(), last = codes.end();
+		if (n.level * 3 >= MORTON_OCTREE_INDEXBITS && !codes.empty() && (n.code >> INDEX_SHIFT) < INDEX_BUCKETS) {
+			// the node lies inside one bucket of the table
+			const size_t bucket = (size_t)(n.code >> INDEX_SHIFT);
+			first = codes.begin() + index[bucket];
+			last = codes.begin() + index[bucket + 1];
+		}
+		begin = std::lower_bound(first, last, n.code) - codes.begin();
+		end = std::upper_bound(codes.begin() + begin, last, morton3D_Octree_LastDescendant(n)) - codes.begin();
+		if (begin == end && begin > 0 && morton3D_Octree_Contains(leaf(begin - 1), n.code)) {
+			// node lies inside a coarser leaf
+			begin = begin - 1;
+			end = begin + 1;
+		}
+	}
+
+	inline size_t memoryUsage() const {
+		return codes.capacity() * sizeof(uint_fast64_t) + levels.capacity() * sizeof(uint8_t) + index.capacity() * sizeof(size_t);
+	}
+
+private:
+	static const unsigned int INDEX_SHIFT = 3 * MORTON_OCTREE_MAXLEVEL - MORTON_OCTREE_INDEXBITS;
+	static const size_t INDEX_BUCKETS = (size_t)1 << MORTON_OCTREE_INDEXBITS;
+	std::vector<uint_fast64_t> codes;
+	std::vector<uint8_t> levels;
+	std::vector<size_t> index; // index[b] = first leaf with (code >> INDEX_SHIFT) >= b
+
+	void buildIndex() {
+		index.assign(INDEX_BUCKETS + 1, codes.size());
+		size_t b = 0;
+		for (size_t i = 0; i < codes.size(); ++i) {
+			const size_t leaf_bucket = (size_t)(codes[i] >> INDEX_SHIFT);
+			while (b <= leaf_bucket) { index[b++] = i; }
+		}
+	}
+
+	void buildNode(const uint_fast64_t* sorted_codes, const size_t begin, const size_t end, const MortonOctreeNode& n, const size_t max_points_per_leaf) {
+		if (end - begin <= max_points_per_leaf || n.level == MORTON_OCTREE_MAXLEVEL) {
+			codes.push_back(n.code);
+			levels.push_back((uint8_t) n.level);
+			return;
+		}
+		const unsigned int shift = 3 * (MORTON_OCTREE_MAXLEVEL - n.level - 1);
+		size_t child_begin = begin;
+		for (unsigned int i = 0; i < 8 && child_begin < end; ++i) {
+			const size_t child_end = (i == 7) ? end :
+				std::lower_bound(sorted_codes + child_begin, sorted_codes + end, n.code | ((uint_fast64_t)(i + 1) << shift)) - sorted_codes;
+			if (child_end > child_begin) {
+				buildNode(sorted_codes, child_begin, child_end, morton3D_Octree_Child(n, i), max_points_per_leaf);
+			}
+			child_begin = child_end;
+		}
+	}
+};
+
+#endif // MORTON_OCTREE_H_
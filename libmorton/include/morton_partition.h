@@ -0,0 +1,225 @@
+// Libmorton - Balanced partition of (weighted) morton codes into contiguous code ranges
+#ifndef MORTON_PARTITION_H_
+#define MORTON_PARTITION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "morton3D.h"
+#include "morton_common.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Part k holds the codes c with splits[k - 1] <= c < splits[k] (no lower bound for part 0, no upper bound for
+// the last part), so the parts are contiguous code ranges. Each split is the code value that brings the weight
+// below it closest to k / parts of the total. All copies of a code go to the same part. When an octree level
+// is given, the splits are the first codes of cells at that level, so parts are unions of whole cells.
+//
+// The codes can be in any order. A sample of them cuts the code range into buckets. A first parallel pass sums
+// the weight in each bucket, and a second one collects the codes of the buckets the targets fall in. These
+// few codes are sorted to place each split exactly.
+
+static const size_t MORTON_PARTITION_SAMPLES_PER_PART = 64;
+static const size_t MORTON_PARTITION_MINSAMPLES = 256;
+static const size_t MORTON_PARTITION_MAXSAMPLES = 65536;
+
+// Bucket j holds the codes in [sample[j - 1], sample[j]), for the sorted samples. A binary search over all
+// samples would cost more than the rest of the passes: the codes between the first and last sample are looked
+// up in a table over the bits below their common prefix instead. It has about 16 cells per sample, as codes
+// seldom use these bits evenly, which leaves a few samples to search.
+template<typename morton>
+class MortonPartitionBuckets {
+public:
+	explicit MortonPartitionBuckets(const std::vector<morton>& sample) : sample(sample), shift(0) {
+		if (sample.size() < 2 || sample.front() == sample.back()) { return; }
+		const unsigned int span = sizeof(morton) * 8 - morton_clz<morton>(sample.front() ^ sample.back()); // bits below the common prefix
+		unsigned int cellbits = 12;
+		while (cellbits < 18 && ((size_t)1 << cellbits) < 16 * sample.size()) { ++cellbits; }
+		cellbits = std::min(cellbits, span);
+		shift = span - cellbits;
+		base = sample.front() & ~(morton)((span >= sizeof(morton) * 8) ? ~(morton)0 : (((morton)1 << span) - 1));
+		first.resize(((size_t)1 << cellbits) + 1);
+		for (size_t c = 0; c < first.size() - 1; ++c) { // samples below the start of cell c
+			first[c] = (uint32_t)(std::lower_bound(sample.begin(), sample.end(), (morton)(base + ((morton)c << shift))) - sample.begin());
+		}
+		first.back() = (uint32_t)sample.size();
+	}
+
+	// Marks the cells that overlap a bucket with slot[bucket] >= 0, see outside()
+	void mark(const std::vector<long long>& slot) {
+		if (first.empty()) { return; }
+		hot.assign(first.size() - 1, 0);
+		for (size_t c = 0; c < hot.size(); ++c) {
+			for (size_t j = first[c]; j <= first[c + 1] && !hot[c]; ++j) { hot[c] = slot[j] >= 0; }
+		}
+	}
+
+	// True if the key is surely not in a marked bucket
+	bool outside(const morton key) const {
+		return !hot.empty() && key >= sample.front() && key < sample.back() && !hot[(size_t)((key - base) >> shift)];
+	}
+
+	size_t bucket(const morton key) const {
+		if (first.empty()) { return (size_t)(std::upper_bound(sample.begin(), sample.end(), key) - sample.begin()); }
+		if (key < sample.front()) { return 0; }
+		if (key >= sample.back()) { return (size_t)(std::upper_bound(sample.begin(), sample.end(), key) - sample.begin()); }
+		const size_t c = (size_t)((key - base) >> shift);
+		size_t j = first[c], len = first[c + 1] - first[c];
+		while (len > 0) { // upper bound without branching on the key, as keys in random order defeat branch prediction
+			const size_t half = len >> 1;
+			const bool above = sample[j + half] <= key;
+			j = above ? j + half + 1 : j;
+			len = above ? len - half - 1 : half;
+		}
+		return j;
+	}
+
+private:
+	const std::vector<morton>& sample;
+	std::vector<uint32_t> first; // first[c]: number of samples below the start of cell c
+	std::vector<char> hot;
+	morton base; // the common prefix
+	unsigned int shift;
+};
+
+// Weighted: weights[i] is the weight of codes[i], weights can be 0 for weight 1 per code (and are used as such
+// if they add up to 0). part_weights, if not 0, receives the weight of each of the parts.
+template<typename morton, typename weight>
+inline void morton_Partition(const morton* codes, const weight* weights, const size_t n, const unsigned int parts, morton* splits,
+	double* part_weights = 0, const unsigned int level = morton3D_maxLevel<morton>()) {
+	if (parts == 0) { return; }
+	const morton mask = morton3D_ancestorAtLevel<morton>((morton)~(morton)0, std::min(level, morton3D_maxLevel<morton>()));
+#ifdef _OPENMP
+	const size_t threads = (size_t)omp_get_max_threads();
+#else
+	const size_t threads = 1;
+#endif
+
+	// Sample at hashed positions, so that sorted or clustered inputs are sampled evenly
+	const size_t samples = std::min(n, std::max(MORTON_PARTITION_MINSAMPLES, std::min(MORTON_PARTITION_MAXSAMPLES, MORTON_PARTITION_SAMPLES_PER_PART * parts)));
+	std::vector<morton> sample(samples);
+	uint_fast64_t h = 0;
+	for (size_t j = 0; j < samples; ++j) {
+		h += 0x9E3779B97F4A7C15; // splitmix64
+		uint_fast64_t r = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9;
+		r = (r ^ (r >> 27)) * 0x94D049BB133111EB;
+		sample[j] = codes[(size_t)((r ^ (r >> 31)) % n)] & mask;
+	}
+	std::sort(sample.begin(), sample.end());
+	const size_t buckets = samples + 1;
+	MortonPartitionBuckets<morton> lookup(sample);
+
+	// Weight per bucket, summed per thread and then added up. prefix[j]: weight of the codes below bucket j.
+	std::vector<double> local(threads * buckets, 0.0);
+#pragma omp parallel num_threads((int)threads)
+	{
+#ifdef _OPENMP
+		double* w = &local[(size_t)omp_get_thread_num() * buckets];
+#else
+		double* w = &local[0];
+#endif
+#pragma omp for schedule(static)
+		for (long long i = 0; i < (long long)n; ++i) {
+			w[lookup.bucket(codes[i] & mask)] += weights ? (double)weights[i] : 1.0;
+		}
+	}
+	std::vector<double> prefix(buckets + 1, 0.0);
+	for (size_t j = 0; j < buckets; ++j) {
+		double w = 0.0;
+		for (size_t t = 0; t < threads; ++t) { w += local[t * buckets + j]; }
+		prefix[j + 1] = prefix[j] + w;
+	}
+	const double total = prefix[buckets];
+	if (weights != 0 && !(total > 0.0)) {
+		morton_Partition<morton, weight>(codes, 0, n, parts, splits, part_weights, level);
+		return;
+	}
+
+	// The bucket of each target is the last one with less weight below it than the target
+	std::vector<size_t> target_bucket(parts, 0);
+	std::vector<long long> slot(buckets, -1);
+	std::vector<size_t> refined; // buckets to collect
+	for (unsigned int k = 1; k < parts && n > 0; ++k) {
+		const double target = total * k / parts;
+		const size_t j = (size_t)(std::lower_bound(prefix.begin(), prefix.begin() + buckets, target) - prefix.begin()) - 1;
+		target_bucket[k] = j;
+		if (slot[j] < 0) { slot[j] = (long long)refined.size(); refined.push_back(j); }
+	}
+
+	// Collect the codes of these buckets, per thread, then sort them per bucket
+	lookup.mark(slot);
+	std::vector<std::vector<std::pair<morton, double> > > collected(threads * refined.size());
+	if (!refined.empty()) {
+#pragma omp parallel num_threads((int)threads)
+		{
+#ifdef _OPENMP
+			const size_t t = (size_t)omp_get_thread_num();
+#else
+			const size_t t = 0;
+#endif
+#pragma omp for schedule(static)
+			for (long long i = 0; i < (long long)n; ++i) {
+				const morton key = codes[i] & mask;
+				if (lookup.outside(key)) { continue; }
+				const long long s = slot[lookup.bucket(key)];
+				if (s >= 0) { collected[t * refined.size() + (size_t)s].push_back(std::make_pair(key, weights ? (double)weights[i] : 1.0)); }
+			}
+		}
+	}
+	std::vector<std::vector<std::pair<morton, double> > > bucket_codes(refined.size());
+#pragma omp parallel for schedule(dynamic, 1)
+	for (long long s = 0; s < (long long)refined.size(); ++s) {
+		std::vector<std::pair<morton, double> >& list = bucket_codes[(size_t)s];
+		for (size_t t = 0; t < threads; ++t) {
+			const std::vector<std::pair<morton, double> >& part = collected[t * refined.size() + (size_t)s];
+			list.insert(list.end(), part.begin(), part.end());
+		}
+		std::sort(list.begin(), list.end());
+	}
+
+	// Place each split on the closer of the last code value with less weight below it than the target, and the
+	// first one with at least as much (the next bucket's first code, if it is not in this bucket)
+	std::vector<double> below(parts + 1, 0.0);
+	below[parts] = total;
+	for (unsigned int k = 1; k < parts; ++k) {
+		if (n == 0) { splits[k - 1] = 0; continue; }
+		const double target = total * k / parts;
+		const size_t j = target_bucket[k];
+		const std::vector<std::pair<morton, double> >& list = bucket_codes[(size_t)slot[j]];
+		double cumulative = prefix[j];
+		morton lo = list[0].first, hi = 0;
+		double lo_below = cumulative, hi_below = 0.0;
+		bool has_hi = false;
+		for (size_t i = 0; i < list.size();) {
+			const morton value = list[i].first;
+			if (cumulative >= target) { hi = value; hi_below = cumulative; has_hi = true; break; }
+			lo = value; lo_below = cumulative;
+			for (; i < list.size() && list[i].first == value; ++i) { cumulative += list[i].second; }
+		}
+		if (!has_hi && j < samples) { hi = sample[j]; hi_below = prefix[j + 1]; has_hi = true; }
+		const bool take_hi = has_hi && hi_below - target <= target - lo_below;
+		splits[k - 1] = take_hi ? hi : lo;
+		below[k] = take_hi ? hi_below : lo_below;
+	}
+	if (part_weights) {
+		for (unsigned int k = 0; k < parts; ++k) { part_weights[k] = below[k + 1] - below[k]; }
+	}
+}
+
+// Unweighted: each code has weight 1
+template<typename morton>
+inline void morton_Partition(const morton* codes, const size_t n, const unsigned int parts, morton* splits,
+	double* part_weights = 0, const unsigned int level = morton3D_maxLevel<morton>()) {
+	morton_Partition<morton, uint32_t>(codes, (const uint32_t*)0, n, parts, splits, part_weights, level);
+}
+
+// Part of a code, given the parts - 1 splits
+template<typename morton>
+inline unsigned int morton_PartOf(const morton code, const morton* splits, const unsigned int parts) {
+	return (unsigned int)(std::upper_bound(splits, splits + (parts - 1), code) - splits);
+}
+
+#endif // MORTON_PARTITION_H_
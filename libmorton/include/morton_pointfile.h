@@ -0,0 +1,338 @@
+// Libmorton - Memory-mapped file of morton-sorted points: sorted codes, payload columns and a sparse index of code ranges
+#ifndef MORTON_POINTFILE_H_
+#define MORTON_POINTFILE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "morton.h"
+
+#if _MSC_VER
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// File layout (native byte order). Every section starts on a 4096-byte boundary, so it maps to its own pages:
+//   header   MortonPointFileHeader
+//   codes    count 64-bit 2D or 3D morton codes, in non-decreasing order
+//   columns  per payload column, count values of column_size bytes (in the order of the codes)
+//   index    the first code of every run of index_stride codes
+// The reader maps the file and hands out pointers into the mapping: nothing is copied or decoded at open.
+// The index is small (one code per 4 KiB of codes by default), so a lookup touches the index pages and
+// then a single page of codes. A box query only touches the pages that hold codes of the box, and jumps
+// over the gaps between them with morton3D_NextInBox.
+
+static const unsigned int MORTON_POINTFILE_MAXCOLUMNS = 8;
+static const uint32_t MORTON_POINTFILE_VERSION = 1;
+static const uint32_t MORTON_POINTFILE_BYTEORDER = 0x01020304;
+static const uint64_t MORTON_POINTFILE_ALIGN = 4096;
+static const uint64_t MORTON_POINTFILE_STRIDE = 512; // codes per index entry: one 4 KiB page
+static const size_t MORTON_POINTFILE_BUFFER = 1 << 20; // bytes buffered per section by the writer
+
+struct MortonPointFileHeader {
+	char magic[8]; // "MORTONPF"
+	uint32_t version;
+	uint32_t byte_order; // MORTON_POINTFILE_BYTEORDER as written by the writer
+	uint32_t dims; // 2 or 3
+	uint32_t columns;
+	uint64_t count;
+	uint64_t index_stride;
+	uint64_t index_count;
+	uint64_t codes_offset;
+	uint64_t index_offset;
+	uint64_t column_offset[MORTON_POINTFILE_MAXCOLUMNS];
+	uint32_t column_size[MORTON_POINTFILE_MAXCOLUMNS];
+};
+
+inline uint64_t morton_PointFileAlign(const uint64_t offset) {
+	return (offset + MORTON_POINTFILE_ALIGN - 1) & ~(MORTON_POINTFILE_ALIGN - 1);
+}
+
+// Streaming writer: announce the number of points, then append them in code order.
+// Writes go through one buffer per section, so the points can come one by one or in batches.
+class MortonPointFileWriter {
+public:
+	MortonPointFileWriter() : file(0), ok(false) {}
+	~MortonPointFileWriter() { close(); }
+
+	// column_sizes: bytes per value of each of the (at most MORTON_POINTFILE_MAXCOLUMNS) payload columns
+	bool open(const char* path, const unsigned int dims, const uint64_t count, const uint32_t* column_sizes = 0,
+		const unsigned int columns = 0, const uint64_t index_stride = MORTON_POINTFILE_STRIDE) {
+		close();
+		if ((dims != 2 && dims != 3) || columns > MORTON_POINTFILE_MAXCOLUMNS || index_stride == 0) { return false; }
+		memset(&header, 0, sizeof(header));
+		header.version = MORTON_POINTFILE_VERSION;
+		header.byte_order = MORTON_POINTFILE_BYTEORDER;
+		header.dims = dims;
+		header.columns = columns;
+		header.count = count;
+		header.index_stride = index_stride;
+		header.index_count = (count + index_stride - 1) / index_stride;
+		header.codes_offset = morton_PointFileAlign(sizeof(MortonPointFileHeader));
+		uint64_t offset = morton_PointFileAlign(header.codes_offset + count * sizeof(uint64_t));
+		for (unsigned int c = 0; c < columns; ++c) {
+			header.column_size[c] = column_sizes[c];
+			header.column_offset[c] = offset;
+			offset = morton_PointFileAlign(offset + count * column_sizes[c]);
+		}
+		header.index_offset = offset;
+
+		file = fopen(path, "wb");
+		if (!file) { return false; }
+		setvbuf(file, 0, _IONBF, 0);
+		sections.assign(columns + 1, Section());
+		sections[0].offset = header.codes_offset;
+		for (unsigned int c = 0; c < columns; ++c) { sections[c + 1].offset = header.column_offset[c]; }
+		for (size_t s = 0; s < sections.size(); ++s) { sections[s].buffer.reserve(MORTON_POINTFILE_BUFFER); }
+		index.clear();
+		index.reserve((size_t)header.index_count);
+		written = 0;
+		last = 0;
+		ok = true;
+		return true;
+	}
+
+	// Append the next point. values[c] points to the value of column c; it may only be left out if the
+	// file has no columns.
+	inline bool append(const uint64_t code, const void* const* values = 0) {
+		return append(&code, 1, values);
+	}
+
+	// Append n points. columns[c] points to n values of column c (see above).
+	bool append(const uint64_t* codes, const size_t n, const void* const* columns = 0) {
+		if (!ok || written + n > header.count || (columns == 0 && header.columns > 0)) { ok = false; return false; }
+		for (size_t i = 0; i < n; ++i) {
+			if (codes[i] < last) { ok = false; return false; } // out of order
+			last = codes[i];
+			if ((written + i) % header.index_stride == 0) { index.push_back(codes[i]); }
+		}
+		put(sections[0], codes, n * sizeof(uint64_t));
+		for (unsigned int c = 0; c < header.columns; ++c) {
+			put(sections[c + 1], columns[c], n * header.column_size[c]);
+		}
+		written += n;
+		return ok;
+	}
+
+	// Write the index and the header. Fails if fewer points than announced were appended, a point
+	// came out of order or a write failed; the file then has no valid header.
+	bool close() {
+		if (!file) { return false; }
+		bool success = ok && written == header.count;
+		for (size_t s = 0; s < sections.size() && success; ++s) { success = flush(sections[s]); }
+		if (success && !index.empty()) {
+			success = seek(header.index_offset) && fwrite(&index[0], sizeof(uint64_t), index.size(), file) == index.size();
+		}
+		if (success) {
+			memcpy(header.magic, "MORTONPF", 8);
+			success = seek(0) && fwrite(&header, sizeof(header), 1, file) == 1;
+		}
+		success = (fclose(file) == 0) && success;
+		file = 0;
+		ok = false;
+		return success;
+	}
+
+	inline bool good() const { return ok; }
+	inline uint64_t size() const { return written; }
+
+private:
+	struct Section {
+		uint64_t offset; // file position of the next flush
+		std::vector<char> buffer;
+	};
+	FILE* file;
+	bool ok;
+	MortonPointFileHeader header;
+	std::vector<Section> sections;
+	std::vector<uint64_t> index;
+	uint64_t written, last;
+
+	inline bool seek(const uint64_t offset) {
+#if _MSC_VER
+		return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+		return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+	}
+
+	bool flush(Section& s) {
+		if (s.buffer.empty()) { return true; }
+		if (!seek(s.offset) || fwrite(&s.buffer[0], 1, s.buffer.size(), file) != s.buffer.size()) { return false; }
+		s.offset += s.buffer.size();
+		s.buffer.clear();
+		return true;
+	}
+
+	void put(Section& s, const void* data, size_t bytes) {
+		const char* p = (const char*)data;
+		while (bytes > 0 && ok) {
+			const size_t chunk = std::min(bytes, MORTON_POINTFILE_BUFFER - s.buffer.size());
+			s.buffer.insert(s.buffer.end(), p, p + chunk);
+			p += chunk;
+			bytes -= chunk;
+			if (s.buffer.size() == MORTON_POINTFILE_BUFFER) { ok = flush(s); }
+		}
+	}
+};
+
+// Read-only view of a point file, mapped into memory
+class MortonPointFile {
+public:
+	MortonPointFile() : base(0), length(0), header(0), code_data(0), index_data(0) {
+#if _MSC_VER
+		file_handle = INVALID_HANDLE_VALUE;
+		mapping = 0;
+#endif
+	}
+	~MortonPointFile() { close(); }
+
+	// Map the file and check its header
+	bool open(const char* path) {
+		close();
+#if _MSC_VER
+		file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (file_handle == INVALID_HANDLE_VALUE) { return false; }
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart < (LONGLONG)sizeof(MortonPointFileHeader)) { close(); return false; }
+		length = (size_t)file_size.QuadPart;
+		mapping = CreateFileMappingA(file_handle, 0, PAGE_READONLY, 0, 0, 0);
+		if (!mapping) { close(); return false; }
+		base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!base) { close(); return false; }
+#else
+		const int fd = ::open(path, O_RDONLY);
+		if (fd < 0) { return false; }
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MortonPointFileHeader)) { ::close(fd); return false; }
+		length = (size_t)st.st_size;
+		void* p = mmap(0, length, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd); // the mapping keeps the file open
+		if (p == MAP_FAILED) { length = 0; return false; }
+		base = (const char*)p;
+#endif
+		header = (const MortonPointFileHeader*)base;
+		if (!valid()) { close(); return false; }
+		code_data = (const uint64_t*)(base + header->codes_offset);
+		index_data = (const uint64_t*)(base + header->index_offset);
+		return true;
+	}
+
+	void close() {
+#if _MSC_VER
+		if (base) { UnmapViewOfFile(base); }
+		if (mapping) { CloseHandle(mapping); }
+		if (file_handle != INVALID_HANDLE_VALUE) { CloseHandle(file_handle); }
+		mapping = 0;
+		file_handle = INVALID_HANDLE_VALUE;
+#else
+		if (base) { munmap((void*)base, length); }
+#endif
+		base = 0;
+		length = 0;
+		header = 0;
+		code_data = 0;
+		index_data = 0;
+	}
+
+	inline bool isOpen() const { return base != 0; }
+	inline size_t size() const { return header ? (size_t)header->count : 0; }
+	inline unsigned int dims() const { return header->dims; }
+	inline unsigned int columnCount() const { return header->columns; }
+	inline size_t columnSize(const unsigned int c) const { return header->column_size[c]; }
+	// Bytes mapped (the pages are only read when touched)
+	inline size_t mappedSize() const { return length; }
+
+	inline const uint64_t* codes() const { return code_data; }
+	inline uint64_t code(const size_t i) const { return code_data[i]; }
+	inline const void* column(const unsigned int c) const { return base + header->column_offset[c]; }
+	template<typename T>
+	inline const T* column(const unsigned int c) const { return (const T*)(base + header->column_offset[c]); }
+
+	// Position of the first code >= code, searching from position from on
+	size_t lowerBound(const uint64_t code, const size_t from = 0) const {
+		const size_t n = size(), stride = (size_t)header->index_stride;
+		if (from >= n) { return n; }
+		// first run whose first code is >= code: the answer lies in the run before it
+		const uint64_t* k = std::lower_bound(index_data + from / stride, index_data + header->index_count, code);
+		const size_t run = (size_t)(k - index_data);
+		if (run == 0) { return from; }
+		const size_t begin = std::max(from, (run - 1) * stride), end = std::min(n, run * stride);
+		if (begin >= end) { return begin; }
+		return (size_t)(std::lower_bound(code_data + begin, code_data + end, code) - code_data);
+	}
+
+	// Positions [begin, end) of the codes in [lo, hi]
+	inline void codeRange(const uint64_t lo, const uint64_t hi, size_t& begin, size_t& end) const {
+		begin = lowerBound(lo);
+		end = (hi == ~(uint64_t)0) ? size() : lowerBound(hi + 1, begin);
+	}
+
+	// Call f(position) for every point of a 3D file inside the box of cells [lo, hi] (inclusive), in code order
+	template<typename function>
+	void boxQuery3D(const uint_fast32_t* lo, const uint_fast32_t* hi, function f) const {
+		const uint64_t zlo = morton3D_64_encode(lo[0], lo[1], lo[2]), zhi = morton3D_64_encode(hi[0], hi[1], hi[2]);
+		boxQuery(zlo, zhi, f, morton3D_InBox<uint64_t>, morton3D_NextInBox<uint64_t>);
+	}
+
+	// Call f(position) for every point of a 2D file inside the box of cells [lo, hi] (inclusive), in code order
+	template<typename function>
+	void boxQuery2D(const uint_fast32_t* lo, const uint_fast32_t* hi, function f) const {
+		const uint64_t zlo = morton2D_64_encode(lo[0], lo[1]), zhi = morton2D_64_encode(hi[0], hi[1]);
+		boxQuery(zlo, zhi, f, morton2D_InBox<uint64_t>, morton2D_NextInBox<uint64_t>);
+	}
+
+private:
+	const char* base;
+	size_t length;
+	const MortonPointFileHeader* header;
+	const uint64_t* code_data;
+	const uint64_t* index_data;
+#if _MSC_VER
+	HANDLE file_handle;
+	HANDLE mapping;
+#endif
+
+	MortonPointFile(const MortonPointFile&);
+	MortonPointFile& operator=(const MortonPointFile&);
+
+	bool valid() const {
+		if (memcmp(header->magic, "MORTONPF", 8) != 0 || header->version != MORTON_POINTFILE_VERSION
+			|| header->byte_order != MORTON_POINTFILE_BYTEORDER || (header->dims != 2 && header->dims != 3)
+			|| header->columns > MORTON_POINTFILE_MAXCOLUMNS || header->index_stride == 0
+			|| header->index_count != (header->count + header->index_stride - 1) / header->index_stride) { return false; }
+		const uint64_t n = header->count;
+		if (header->codes_offset % sizeof(uint64_t) != 0 || header->index_offset % sizeof(uint64_t) != 0
+			|| header->codes_offset + n * sizeof(uint64_t) > length
+			|| header->index_offset + header->index_count * sizeof(uint64_t) > length) { return false; }
+		for (unsigned int c = 0; c < header->columns; ++c) {
+			if (header->column_offset[c] + n * header->column_size[c] > length) { return false; }
+		}
+		return true;
+	}
+
+	template<typename function, typename inbox, typename nextinbox>
+	void boxQuery(const uint64_t zlo, const uint64_t zhi, function f, inbox in_box, nextinbox next_in_box) const {
+		const size_t n = size();
+		size_t i = lowerBound(zlo);
+		while (i < n) {
+			const uint64_t c = code_data[i];
+			if (c > zhi) { break; }
+			if (in_box(c, zlo, zhi)) { f(i); ++i; continue; }
+			// left the box: skip to the next code that can lie inside it
+			i = lowerBound(next_in_box(c, zlo, zhi), i);
+		}
+	}
+};
+
+#endif // MORTON_POINTFILE_H_
@@ -0,0 +1,173 @@
+// Libmorton - Encode float/double coordinates inside a bounding box to morton codes, and back to cell centres
+#ifndef MORTON_QUANTIZE_H_
+#define MORTON_QUANTIZE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <type_traits>
+#include "morton.h"
+
+// The box [box_min, box_max] is split into 2^bits cells per axis (bits <= 21 in 3D, <= 32 in 2D),
+// so the codes use the lowest 3 * bits (2 * bits) bits. A coordinate v goes to cell
+// (v - box_min) * (2^bits / (box_max - box_min)), rounded down and clamped to [0, 2^bits - 1]:
+// points outside the box land in the nearest border cell, and NaN in cell 0.
+//
+// The scale factors are computed once per call, so there are no divides per point, and every
+// function is one branch-free loop (quantize, then encode, or decode and scale) that the
+// compiler can vectorize. Loops are distributed over the threads when OpenMP is enabled.
+// Coordinates come either as separate x, y, z arrays or as interleaved xyz points.
+
+// Per-axis constants for one box and bit depth
+template<typename real, unsigned int DIM>
+struct MortonQuantizer {
+	// 3D cells fit in 32 bits, which keeps the conversion vectorizable. 2D goes up to 32 bits per axis.
+	typedef typename std::conditional<(DIM == 3), int32_t, int64_t>::type cellint;
+	real lo[DIM], scale[DIM], cell[DIM];
+	real maxcell;
+	cellint maxq; // maxcell can round up in float
+
+	MortonQuantizer(const real* box_min, const real* box_max, const unsigned int bits) {
+		const real cells = (real)((uint_fast64_t)1 << bits);
+		maxcell = cells - 1;
+		maxq = (cellint)(((int64_t)1 << bits) - 1);
+		for (unsigned int a = 0; a < DIM; ++a) {
+			const real extent = box_max[a] - box_min[a];
+			lo[a] = box_min[a];
+			scale[a] = (extent > 0) ? cells / extent : 0;
+			cell[a] = extent / cells;
+		}
+	}
+
+	inline uint_fast32_t quantize(const real v, const unsigned int axis) const {
+		const real t = (v - lo[axis]) * scale[axis];
+		const real low = (t >= (real)0) ? t : (real)0; // also NaN, which std::max would pass through
+		return (uint_fast32_t)(uint32_t)std::min((cellint)std::min(low, maxcell), maxq);
+	}
+
+	inline real centre(const uint_fast32_t q, const unsigned int axis) const {
+		return lo[axis] + ((real)(cellint)q + (real)0.5) * cell[axis];
+	}
+};
+
+// The magic bits encoders vectorize when compiling for AVX2. Otherwise the loops stay scalar,
+// and the LUT encoders of morton.h are faster.
+inline uint_fast64_t morton3D_QuantizedEncode(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) {
+#if defined(__AVX2__)
+	return morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y, z);
+#else
+	return morton3D_64_encode(x, y, z);
+#endif
+}
+
+inline uint_fast64_t morton2D_QuantizedEncode(const uint_fast32_t x, const uint_fast32_t y) {
+#if defined(__AVX2__)
+	return morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y);
+#else
+	return morton2D_64_encode(x, y);
+#endif
+}
+
+// codes[i] = code of (x[i], y[i], z[i])
+template<typename real>
+inline void morton3D_QuantizeEncode(const real* x, const real* y, const real* z, const size_t n,
+	const real* box_min, const real* box_max, const unsigned int bits, uint_fast64_t* codes) {
+	const MortonQuantizer<real, 3> q(box_min, box_max, bits);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		codes[i] = morton3D_QuantizedEncode(q.quantize(x[i], 0), q.quantize(y[i], 1), q.quantize(z[i], 2));
+	}
+}
+
+// codes[i] = code of (xyz[3i], xyz[3i + 1], xyz[3i + 2])
+template<typename real>
+inline void morton3D_QuantizeEncodePoints(const real* xyz, const size_t n,
+	const real* box_min, const real* box_max, const unsigned int bits, uint_fast64_t* codes) {
+	const MortonQuantizer<real, 3> q(box_min, box_max, bits);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		codes[i] = morton3D_QuantizedEncode(q.quantize(xyz[3 * i], 0), q.quantize(xyz[3 * i + 1], 1), q.quantize(xyz[3 * i + 2], 2));
+	}
+}
+
+// (x[i], y[i], z[i]) = centre of the cell of codes[i]
+template<typename real>
+inline void morton3D_DecodeCellCentres(const uint_fast64_t* codes, const size_t n,
+	const real* box_min, const real* box_max, const unsigned int bits, real* x, real* y, real* z) {
+	const MortonQuantizer<real, 3> q(box_min, box_max, bits);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		uint_fast32_t cx, cy, cz;
+		morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(codes[i], cx, cy, cz);
+		x[i] = q.centre(cx, 0);
+		y[i] = q.centre(cy, 1);
+		z[i] = q.centre(cz, 2);
+	}
+}
+
+// (xyz[3i], xyz[3i + 1], xyz[3i + 2]) = centre of the cell of codes[i]
+template<typename real>
+inline void morton3D_DecodeCellCentrePoints(const uint_fast64_t* codes, const size_t n,
+	const real* box_min, const real* box_max, const unsigned int bits, real* xyz) {
+	const MortonQuantizer<real, 3> q(box_min, box_max, bits);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		uint_fast32_t cx, cy, cz;
+		morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(codes[i], cx, cy, cz);
+		xyz[3 * i] = q.centre(cx, 0);
+		xyz[3 * i + 1] = q.centre(cy, 1);
+		xyz[3 * i + 2] = q.centre(cz, 2);
+	}
+}
+
+// codes[i] = code of (x[i], y[i])
+template<typename real>
+inline void morton2D_QuantizeEncode(const real* x, const real* y, const size_t n,
+	const real* box_min, const real* box_max, const unsigned int bits, uint_fast64_t* codes) {
+	const MortonQuantizer<real, 2> q(box_min, box_max, bits);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		codes[i] = morton2D_QuantizedEncode(q.quantize(x[i], 0), q.quantize(y[i], 1));
+	}
+}
+
+// codes[i] = code of (xy[2i], xy[2i + 1])
+template<typename real>
+inline void morton2D_QuantizeEncodePoints(const real* xy, const size_t n,
+	const real* box_min, const real* box_max, const unsigned int bits, uint_fast64_t* codes) {
+	const MortonQuantizer<real, 2> q(box_min, box_max, bits);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		codes[i] = morton2D_QuantizedEncode(q.quantize(xy[2 * i], 0), q.quantize(xy[2 * i + 1], 1));
+	}
+}
+
+// (x[i], y[i]) = centre of the cell of codes[i]
+template<typename real>
+inline void morton2D_DecodeCellCentres(const uint_fast64_t* codes, const size_t n,
+	const real* box_min, const real* box_max, const unsigned int bits, real* x, real* y) {
+	const MortonQuantizer<real, 2> q(box_min, box_max, bits);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		uint_fast32_t cx, cy;
+		morton2D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(codes[i], cx, cy);
+		x[i] = q.centre(cx, 0);
+		y[i] = q.centre(cy, 1);
+	}
+}
+
+// (xy[2i], xy[2i + 1]) = centre of the cell of codes[i]
+template<typename real>
+inline void morton2D_DecodeCellCentrePoints(const uint_fast64_t* codes, const size_t n,
+	const real* box_min, const real* box_max, const unsigned int bits, real* xy) {
+	const MortonQuantizer<real, 2> q(box_min, box_max, bits);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long)n; ++i) {
+		uint_fast32_t cx, cy;
+		morton2D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(codes[i], cx, cy);
+		xy[2 * i] = q.centre(cx, 0);
+		xy[2 * i + 1] = q.centre(cy, 1);
+	}
+}
+
+#endif // MORTON_QUANTIZE_H_
@@ -0,0 +1,95 @@
+// Libmorton - Parallel LSD radix sort for morton codes (optionally with a payload per code)
+#ifndef MORTON_SORT_H_
+#define MORTON_SORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+
+// Codes are sorted 11 bits at a time, from the lowest digit up, so 64-bit 3D codes (63 bits)
+// take 6 passes and 32-bit 3D codes 3 passes. Pass key_bits to skip the digits above the
+// highest bit in use. Passes in which all codes share the same digit are skipped.
+//
+// Every pass counts digits per chunk of the input, computes where each chunk writes each
+// digit, and then scatters the chunks independently, so the sort is stable and both steps
+// are distributed over the threads when OpenMP is enabled.
+
+static const unsigned int MORTON_SORT_DIGITBITS = 11;
+static const size_t MORTON_SORT_MAXCHUNKS = 64;
+static const size_t MORTON_SORT_MINCHUNK = 65536; // codes per chunk, at least
+
+template<typename morton, typename value, bool PAIRS>
+void morton_RadixSortImpl(morton* keys, value* values, const size_t n, const unsigned int key_bits) {
+	if (n < 2) { return; }
+	const size_t buckets = (size_t)1 << MORTON_SORT_DIGITBITS;
+	const size_t chunks = std::min(MORTON_SORT_MAXCHUNKS, (n + MORTON_SORT_MINCHUNK - 1) / MORTON_SORT_MINCHUNK);
+	const size_t chunk_size = (n + chunks - 1) / chunks;
+	std::vector<morton> key_buffer(n);
+	std::vector<value> value_buffer(PAIRS ? n : 0);
+	std::vector<size_t> offsets(chunks * buckets);
+	morton* src_keys = keys;
+	morton* dst_keys = &key_buffer[0];
+	value* src_values = values;
+	value* dst_values = PAIRS ? &value_buffer[0] : 0;
+
+	for (unsigned int shift = 0; shift < key_bits; shift += MORTON_SORT_DIGITBITS) {
+		const morton* sk = src_keys;
+#pragma omp parallel for schedule(static, 1)
+		for (long long c = 0; c < (long long)chunks; ++c) {
+			size_t* count = &offsets[(size_t)c * buckets];
+			std::fill(count, count + buckets, (size_t)0);
+			const size_t end = std::min(n, ((size_t)c + 1) * chunk_size);
+			for (size_t i = (size_t)c * chunk_size; i < end; ++i) {
+				++count[(size_t)(sk[i] >> shift) & (buckets - 1)];
+			}
+		}
+		// turn the counts into write positions: digit-major, chunk-minor
+		size_t position = 0;
+		bool single_digit = false;
+		for (size_t b = 0; b < buckets; ++b) {
+			const size_t first = position;
+			for (size_t c = 0; c < chunks; ++c) {
+				const size_t count = offsets[c * buckets + b];
+				offsets[c * buckets + b] = position;
+				position += count;
+			}
+			if (position - first == n) { single_digit = true; break; }
+		}
+		if (single_digit) { continue; }
+
+		morton* dk = dst_keys;
+		const value* sv = src_values;
+		value* dv = dst_values;
+#pragma omp parallel for schedule(static, 1)
+		for (long long c = 0; c < (long long)chunks; ++c) {
+			size_t* next = &offsets[(size_t)c * buckets];
+			const size_t end = std::min(n, ((size_t)c + 1) * chunk_size);
+			for (size_t i = (size_t)c * chunk_size; i < end; ++i) {
+				const size_t o = next[(size_t)(sk[i] >> shift) & (buckets - 1)]++;
+				dk[o] = sk[i];
+				if (PAIRS) { dv[o] = sv[i]; }
+			}
+		}
+		std::swap(src_keys, dst_keys);
+		std::swap(src_values, dst_values);
+	}
+	if (src_keys != keys) {
+		std::copy(src_keys, src_keys + n, keys);
+		if (PAIRS) { std::copy(src_values, src_values + n, values); }
+	}
+}
+
+// Sort n codes in place. key_bits: number of low bits that can be non-zero (e.g. 63 for 64-bit 3D codes).
+template<typename morton>
+inline void morton_RadixSort(morton* keys, const size_t n, const unsigned int key_bits = sizeof(morton) * 8) {
+	morton_RadixSortImpl<morton, char, false>(keys, 0, n, key_bits);
+}
+
+// Sort n codes in place and move values[i] along with keys[i] (stable)
+template<typename morton, typename value>
+inline void morton_RadixSortPairs(morton* keys, value* values, const size_t n, const unsigned int key_bits = sizeof(morton) * 8) {
+	morton_RadixSortImpl<morton, value, true>(keys, values, n, key_bits);
+}
+
+#endif // MORTON_SORT_H_
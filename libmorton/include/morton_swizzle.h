@@ -0,0 +1,144 @@
+// Libmorton - Convert buffers between row-major and morton order (swizzle/unswizzle)
+#ifndef MORTON_SWIZZLE_H_
+#define MORTON_SWIZZLE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "morton_array.h"
+
+// The morton-ordered buffers use the same layout as MortonArray2D/MortonArray3D:
+// element (x, y, z) lives at MortonBrickLayout3D(w, h, d).offset(x, y, z) (Z-ordered bricks laid out
+// row-major, see morton_array.h), so they must hold morton3D_SwizzledSize(w, h, d) elements
+// (morton2D_SwizzledSize(w, h) in 2D). The row-major buffers have x running fastest.
+//
+// The volume is processed in tiles of 16^3 elements (64^2 in 2D), cut short at the borders of the volume,
+// so a flat volume gets flat tiles. The offset of an element is the sum of its x offset, looked up once
+// per tile, and the offset of its row. Only the tiles inside the volume are visited; when OpenMP is
+// enabled, they are distributed over the threads.
+//
+// element_size can be anything: sizes 1, 2, 4, 8 and 16 bytes get a specialized copy.
+
+static const unsigned int MORTON3D_SWIZZLE_TILEBITS = 4;
+static const unsigned int MORTON2D_SWIZZLE_TILEBITS = 6;
+
+inline size_t morton3D_SwizzledSize(const uint_fast32_t w, const uint_fast32_t h, const uint_fast32_t d) {
+	return MortonBrickLayout3D(w, h, d).size();
+}
+
+inline size_t morton2D_SwizzledSize(const uint_fast32_t w, const uint_fast32_t h) {
+	return MortonBrickLayout2D(w, h).size();
+}
+
+// Copy one element. SIZE == 0 means the size is only known at runtime.
+template<size_t SIZE>
+inline void morton_CopyElement(char* dst, const char* src, const size_t element_size) {
+	memcpy(dst, src, SIZE ? SIZE : element_size);
+}
+
+// Copy one tile (nx * ny * nz elements) starting at (x0, y0, z0)
+template<size_t SIZE, bool SWIZZLE>
+inline void morton3D_SwizzleTile(char* rowmajor, char* mortonorder, const size_t element_size, const uint_fast32_t w, const uint_fast32_t h, const MortonBrickLayout3D& layout,
+	const uint_fast32_t x0, const uint_fast32_t y0, const uint_fast32_t z0, const uint_fast32_t nx, const uint_fast32_t ny, const uint_fast32_t nz) {
+	uint_fast64_t x_offsets[1 << MORTON3D_SWIZZLE_TILEBITS];
+	for (uint_fast32_t i = 0; i < nx; ++i) { x_offsets[i] = layout.xOffset(x0 + i); }
+	for (uint_fast32_t lz = 0; lz < nz; ++lz) {
+		for (uint_fast32_t ly = 0; ly < ny; ++ly) {
+			char* tile_row = mortonorder + (size_t)(layout.yOffset(y0 + ly) + layout.zOffset(z0 + lz)) * element_size;
+			char* row = rowmajor + ((((size_t)(z0 + lz) * h) + (y0 + ly)) * w + x0) * element_size;
+			for (uint_fast32_t lx = 0; lx < nx; ++lx) {
+				char* m = tile_row + (size_t)x_offsets[lx] * element_size;
+				if (SWIZZLE) { morton_CopyElement<SIZE>(m, row + lx * element_size, element_size); }
+				else { morton_CopyElement<SIZE>(row + lx * element_size, m, element_size); }
+			}
+		}
+	}
+}
+
+// SWIZZLE: rowmajor -> morton, otherwise morton -> rowmajor
+template<size_t SIZE, bool SWIZZLE>
+inline void morton3D_SwizzleTiles(char* rowmajor, char* mortonorder, const size_t element_size, const uint_fast32_t w, const uint_fast32_t h, const uint_fast32_t d) {
+	const MortonBrickLayout3D layout(w, h, d);
+	const uint_fast32_t T = 1 << MORTON3D_SWIZZLE_TILEBITS;
+	const uint_fast32_t tw = (w + T - 1) / T, th = (h + T - 1) / T, td = (d + T - 1) / T;
+	const long long tiles = (long long)tw * th * td;
+#pragma omp parallel for schedule(static)
+	for (long long t = 0; t < tiles; ++t) {
+		const uint_fast32_t x0 = (uint_fast32_t)(t % tw) * T, y0 = (uint_fast32_t)((t / tw) % th) * T, z0 = (uint_fast32_t)(t / ((long long)tw * th)) * T;
+		morton3D_SwizzleTile<SIZE, SWIZZLE>(rowmajor, mortonorder, element_size, w, h, layout, x0, y0, z0,
+			(w - x0 < T) ? w - x0 : T, (h - y0 < T) ? h - y0 : T, (d - z0 < T) ? d - z0 : T);
+	}
+}
+
+// SWIZZLE: rowmajor -> morton, otherwise morton -> rowmajor
+template<size_t SIZE, bool SWIZZLE>
+inline void morton2D_SwizzleTiles(char* rowmajor, char* mortonorder, const size_t element_size, const uint_fast32_t w, const uint_fast32_t h) {
+	const MortonBrickLayout2D layout(w, h);
+	const uint_fast32_t T = 1 << MORTON2D_SWIZZLE_TILEBITS;
+	const uint_fast32_t tw = (w + T - 1) / T, th = (h + T - 1) / T;
+	const long long tiles = (long long)tw * th;
+#pragma omp parallel for schedule(static)
+	for (long long t = 0; t < tiles; ++t) {
+		const uint_fast32_t x0 = (uint_fast32_t)(t % tw) * T, y0 = (uint_fast32_t)(t / tw) * T;
+		const uint_fast32_t nx = (w - x0 < T) ? w - x0 : T, ny = (h - y0 < T) ? h - y0 : T;
+		uint_fast64_t x_offsets[1 << MORTON2D_SWIZZLE_TILEBITS];
+		for (uint_fast32_t i = 0; i < nx; ++i) { x_offsets[i] = layout.xOffset(x0 + i); }
+		for (uint_fast32_t ly = 0; ly < ny; ++ly) {
+			const uint_fast64_t rowbase = layout.yOffset(y0 + ly);
+			char* row = rowmajor + ((size_t)(y0 + ly) * w + x0) * element_size;
+			for (uint_fast32_t lx = 0; lx < nx; ++lx) {
+				char* m = mortonorder + (size_t)(rowbase + x_offsets[lx]) * element_size;
+				if (SWIZZLE) { morton_CopyElement<SIZE>(m, row + lx * element_size, element_size); }
+				else { morton_CopyElement<SIZE>(row + lx * element_size, m, element_size); }
+			}
+		}
+	}
+}
+
+template<bool SWIZZLE>
+inline void morton3D_SwizzleDispatch(char* rowmajor, char* mortonorder, const size_t element_size, const uint_fast32_t w, const uint_fast32_t h, const uint_fast32_t d) {
+	if (w == 0 || h == 0 || d == 0) { return; }
+	switch (element_size) {
+	case 1: morton3D_SwizzleTiles<1, SWIZZLE>(rowmajor, mortonorder, element_size, w, h, d); break;
+	case 2: morton3D_SwizzleTiles<2, SWIZZLE>(rowmajor, mortonorder, element_size, w, h, d); break;
+	case 4: morton3D_SwizzleTiles<4, SWIZZLE>(rowmajor, mortonorder, element_size, w, h, d); break;
+	case 8: morton3D_SwizzleTiles<8, SWIZZLE>(rowmajor, mortonorder, element_size, w, h, d); break;
+	case 16: morton3D_SwizzleTiles<16, SWIZZLE>(rowmajor, mortonorder, element_size, w, h, d); break;
+	default: morton3D_SwizzleTiles<0, SWIZZLE>(rowmajor, mortonorder, element_size, w, h, d); break;
+	}
+}
+
+template<bool SWIZZLE>
+inline void morton2D_SwizzleDispatch(char* rowmajor, char* mortonorder, const size_t element_size, const uint_fast32_t w, const uint_fast32_t h) {
+	if (w == 0 || h == 0) { return; }
+	switch (element_size) {
+	case 1: morton2D_SwizzleTiles<1, SWIZZLE>(rowmajor, mortonorder, element_size, w, h); break;
+	case 2: morton2D_SwizzleTiles<2, SWIZZLE>(rowmajor, mortonorder, element_size, w, h); break;
+	case 4: morton2D_SwizzleTiles<4, SWIZZLE>(rowmajor, mortonorder, element_size, w, h); break;
+	case 8: morton2D_SwizzleTiles<8, SWIZZLE>(rowmajor, mortonorder, element_size, w, h); break;
+	case 16: morton2D_SwizzleTiles<16, SWIZZLE>(rowmajor, mortonorder, element_size, w, h); break;
+	default: morton2D_SwizzleTiles<0, SWIZZLE>(rowmajor, mortonorder, element_size, w, h); break;
+	}
+}
+
+// Row-major (src) to morton order (dst)
+inline void morton3D_Swizzle(const void* src, void* dst, const size_t element_size, const uint_fast32_t w, const uint_fast32_t h, const uint_fast32_t d) {
+	morton3D_SwizzleDispatch<true>((char*) const_cast<void*>(src), (char*) dst, element_size, w, h, d);
+}
+
+// Morton order (src) to row-major (dst)
+inline void morton3D_Unswizzle(const void* src, void* dst, const size_t element_size, const uint_fast32_t w, const uint_fast32_t h, const uint_fast32_t d) {
+	morton3D_SwizzleDispatch<false>((char*) dst, (char*) const_cast<void*>(src), element_size, w, h, d);
+}
+
+// Row-major (src) to morton order (dst)
+inline void morton2D_Swizzle(const void* src, void* dst, const size_t element_size, const uint_fast32_t w, const uint_fast32_t h) {
+	morton2D_SwizzleDispatch<true>((char*) const_cast<void*>(src), (char*) dst, element_size, w, h);
+}
+
+// Morton order (src) to row-major (dst)
+inline void morton2D_Unswizzle(const void* src, void* dst, const size_t element_size, const uint_fast32_t w, const uint_fast32_t h) {
+	morton2D_SwizzleDispatch<false>((char*) dst, (char*) const_cast<void*>(src), element_size, w, h);
+}
+
+#endif // MORTON_SWIZZLE_H_
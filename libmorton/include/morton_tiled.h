@@ -0,0 +1,242 @@
+// Libmorton - Hybrid tiled layouts: tiles in Z-order, elements inside a tile in morton or row-major order
+#ifndef MORTON_TILED_H_
+#define MORTON_TILED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include "morton.h"
+#include "morton_array.h"
+
+// Order of the elements inside a tile
+enum MortonTileOrder { MORTON_TILE_MORTON, MORTON_TILE_ROWMAJOR };
+
+// Addressing inside 2^TILEBITS x 2^TILEBITS x 2^TILEBITS tiles (TILEBITS <= 8).
+// The offset inside a tile comes from the 256-entry encode LUTs (MORTON_TILE_MORTON)
+// or is plain row-major with x running fastest (MORTON_TILE_ROWMAJOR).
+// Pick TILEBITS so a tile matches a cache line (4x4x4 bytes), a page (16x16x16 bytes), ...
+template<unsigned int TILEBITS, MortonTileOrder ORDER>
+struct MortonTileLayout3D {
+	static_assert(TILEBITS >= 1 && TILEBITS <= 8, "tiles are at most 256 elements wide");
+	static const uint_fast32_t TILE_SIZE = 1 << TILEBITS; // elements per axis
+	static const uint_fast32_t TILE_VOLUME = 1 << (3 * TILEBITS);
+	static const uint_fast32_t TILE_MASK = TILE_SIZE - 1;
+
+	static inline uint_fast32_t tileOffset(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) {
+		if (ORDER == MORTON_TILE_MORTON) {
+			return Morton3D_encode_z_256[z & TILE_MASK] | Morton3D_encode_y_256[y & TILE_MASK] | Morton3D_encode_x_256[x & TILE_MASK];
+		}
+		return (x & TILE_MASK) | ((y & TILE_MASK) << TILEBITS) | ((z & TILE_MASK) << (2 * TILEBITS));
+	}
+};
+
+// Same for 2D, with 2^TILEBITS x 2^TILEBITS tiles (TILEBITS <= 8)
+template<unsigned int TILEBITS, MortonTileOrder ORDER>
+struct MortonTileLayout2D {
+	static_assert(TILEBITS >= 1 && TILEBITS <= 8, "tiles are at most 256 elements wide");
+	static const uint_fast32_t TILE_SIZE = 1 << TILEBITS; // elements per axis
+	static const uint_fast32_t TILE_VOLUME = 1 << (2 * TILEBITS);
+	static const uint_fast32_t TILE_MASK = TILE_SIZE - 1;
+
+	static inline uint_fast32_t tileOffset(const uint_fast32_t x, const uint_fast32_t y) {
+		if (ORDER == MORTON_TILE_MORTON) {
+			return Morton2D_encode_y_256[y & TILE_MASK] | Morton2D_encode_x_256[x & TILE_MASK];
+		}
+		return (x & TILE_MASK) | ((y & TILE_MASK) << TILEBITS);
+	}
+};
+
+// Dense 3D array stored in tiles, with MortonTileLayout3D inside each tile. Each tile is a contiguous block
+// of TILE_VOLUME elements. The grid of tiles is ordered with MortonBrickLayout3D: the tiles follow the
+// Z-order curve of rectangular bricks of tiles (one or two bricks per axis), so a flat or elongated grid
+// keeps Z-order along its long axes, and padding stays below 2x per axis on top of the partial tiles.
+// For a power-of-two cube of tiles, the tile index is the morton code of the tile coordinates.
+template<typename T, unsigned int TILEBITS, MortonTileOrder ORDER>
+class MortonTiledArray3D {
+public:
+	typedef MortonTileLayout3D<TILEBITS, ORDER> layout;
+
+	MortonTiledArray3D() : w(0), h(0), d(0) {}
+	MortonTiledArray3D(const uint_fast32_t width, const uint_fast32_t height, const uint_fast32_t depth, const T& value = T()) {
+		resize(width, height, depth, value);
+	}
+
+	void resize(const uint_fast32_t width, const uint_fast32_t height, const uint_fast32_t depth, const T& value = T()) {
+		w = width; h = height; d = depth;
+		const uint_fast32_t ts = layout::TILE_SIZE;
+		tiles = MortonBrickLayout3D((w + ts - 1) / ts, (h + ts - 1) / ts, (d + ts - 1) / ts);
+		elements.assign(tiles.size() * layout::TILE_VOLUME, value);
+	}
+
+	inline uint_fast32_t width() const { return w; }
+	inline uint_fast32_t height() const { return h; }
+	inline uint_fast32_t depth() const { return d; }
+	// Number of elements allocated, including padding
+	inline size_t storageSize() const { return elements.size(); }
+	inline size_t tileCount() const { return elements.size() / layout::TILE_VOLUME; }
+	inline T* data() { return elements.empty() ? 0 : &elements[0]; }
+	inline const T* data() const { return elements.empty() ? 0 : &elements[0]; }
+
+	// Index of the tile holding element (x, y, z): its position along the Z-order of the tile bricks
+	inline uint_fast64_t tileIndex(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) const {
+		return tiles.offset(x >> TILEBITS, y >> TILEBITS, z >> TILEBITS);
+	}
+
+	inline void split(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z, uint_fast64_t& tile, uint_fast32_t& offset) const {
+		tile = tileIndex(x, y, z);
+		offset = layout::tileOffset(x, y, z);
+	}
+
+	inline uint_fast64_t address(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) const {
+		return (tileIndex(x, y, z) << (3 * TILEBITS)) | layout::tileOffset(x, y, z);
+	}
+
+	// First element of the tile with the given tile index
+	inline T* tile(const uint_fast64_t tileindex) { return &elements[(size_t)tileindex * layout::TILE_VOLUME]; }
+	inline const T* tile(const uint_fast64_t tileindex) const { return &elements[(size_t)tileindex * layout::TILE_VOLUME]; }
+
+	inline T& operator()(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) { return elements[(size_t)address(x, y, z)]; }
+	inline const T& operator()(const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) const { return elements[(size_t)address(x, y, z)]; }
+
+	void fill(const T& value) { std::fill(elements.begin(), elements.end(), value); }
+
+	// Copy from a row-major buffer (x running fastest, then y, then z)
+	void copyFromRowMajor(const T* src) {
+		for (uint_fast32_t z = 0; z < d; ++z) {
+			for (uint_fast32_t y = 0; y < h; ++y) {
+				for (uint_fast32_t x0 = 0; x0 < w; x0 += layout::TILE_SIZE) {
+					const uint_fast32_t n = (w - x0 < layout::TILE_SIZE) ? w - x0 : layout::TILE_SIZE;
+					T* t = tile(tileIndex(x0, y, z));
+					if (ORDER == MORTON_TILE_ROWMAJOR) {
+						std::copy(src, src + n, t + layout::tileOffset(0, y, z));
+						src += n;
+					}
+					else {
+						const uint_fast32_t yz = layout::tileOffset(0, y, z);
+						for (uint_fast32_t lx = 0; lx < n; ++lx) { t[yz | Morton3D_encode_x_256[lx]] = *src++; }
+					}
+				}
+			}
+		}
+	}
+
+	// Copy to a row-major buffer (x running fastest, then y, then z)
+	void copyToRowMajor(T* dst) const {
+		for (uint_fast32_t z = 0; z < d; ++z) {
+			for (uint_fast32_t y = 0; y < h; ++y) {
+				for (uint_fast32_t x0 = 0; x0 < w; x0 += layout::TILE_SIZE) {
+					const uint_fast32_t n = (w - x0 < layout::TILE_SIZE) ? w - x0 : layout::TILE_SIZE;
+					const T* t = tile(tileIndex(x0, y, z));
+					if (ORDER == MORTON_TILE_ROWMAJOR) {
+						const T* row = t + layout::tileOffset(0, y, z);
+						dst = std::copy(row, row + n, dst);
+					}
+					else {
+						const uint_fast32_t yz = layout::tileOffset(0, y, z);
+						for (uint_fast32_t lx = 0; lx < n; ++lx) { *dst++ = t[yz | Morton3D_encode_x_256[lx]]; }
+					}
+				}
+			}
+		}
+	}
+
+private:
+	uint_fast32_t w, h, d;
+	MortonBrickLayout3D tiles;
+	std::vector<T> elements;
+};
+
+// Dense 2D array stored in tiles, with MortonTileLayout2D inside each tile and the grid of tiles ordered
+// with MortonBrickLayout2D. See MortonTiledArray3D.
+template<typename T, unsigned int TILEBITS, MortonTileOrder ORDER>
+class MortonTiledArray2D {
+public:
+	typedef MortonTileLayout2D<TILEBITS, ORDER> layout;
+
+	MortonTiledArray2D() : w(0), h(0) {}
+	MortonTiledArray2D(const uint_fast32_t width, const uint_fast32_t height, const T& value = T()) {
+		resize(width, height, value);
+	}
+
+	void resize(const uint_fast32_t width, const uint_fast32_t height, const T& value = T()) {
+		w = width; h = height;
+		const uint_fast32_t ts = layout::TILE_SIZE;
+		tiles = MortonBrickLayout2D((w + ts - 1) / ts, (h + ts - 1) / ts);
+		elements.assign(tiles.size() * layout::TILE_VOLUME, value);
+	}
+
+	inline uint_fast32_t width() const { return w; }
+	inline uint_fast32_t height() const { return h; }
+	// Number of elements allocated, including padding
+	inline size_t storageSize() const { return elements.size(); }
+	inline size_t tileCount() const { return elements.size() / layout::TILE_VOLUME; }
+	inline T* data() { return elements.empty() ? 0 : &elements[0]; }
+	inline const T* data() const { return elements.empty() ? 0 : &elements[0]; }
+
+	// Index of the tile holding element (x, y): its position along the Z-order of the tile bricks
+	inline uint_fast64_t tileIndex(const uint_fast32_t x, const uint_fast32_t y) const {
+		return tiles.offset(x >> TILEBITS, y >> TILEBITS);
+	}
+
+	inline void split(const uint_fast32_t x, const uint_fast32_t y, uint_fast64_t& tile, uint_fast32_t& offset) const {
+		tile = tileIndex(x, y);
+		offset = layout::tileOffset(x, y);
+	}
+
+	inline uint_fast64_t address(const uint_fast32_t x, const uint_fast32_t y) const {
+		return (tileIndex(x, y) << (2 * TILEBITS)) | layout::tileOffset(x, y);
+	}
+
+	// First element of the tile with the given tile index
+	inline T* tile(const uint_fast64_t tileindex) { return &elements[(size_t)tileindex * layout::TILE_VOLUME]; }
+	inline const T* tile(const uint_fast64_t tileindex) const { return &elements[(size_t)tileindex * layout::TILE_VOLUME]; }
+
+	inline T& operator()(const uint_fast32_t x, const uint_fast32_t y) { return elements[(size_t)address(x, y)]; }
+	inline const T& operator()(const uint_fast32_t x, const uint_fast32_t y) const { return elements[(size_t)address(x, y)]; }
+
+	void fill(const T& value) { std::fill(elements.begin(), elements.end(), value); }
+
+	// Copy from a row-major buffer (x running fastest)
+	void copyFromRowMajor(const T* src) {
+		for (uint_fast32_t y = 0; y < h; ++y) {
+			for (uint_fast32_t x0 = 0; x0 < w; x0 += layout::TILE_SIZE) {
+				const uint_fast32_t n = (w - x0 < layout::TILE_SIZE) ? w - x0 : layout::TILE_SIZE;
+				T* t = tile(tileIndex(x0, y));
+				if (ORDER == MORTON_TILE_ROWMAJOR) {
+					std::copy(src, src + n, t + layout::tileOffset(0, y));
+					src += n;
+				}
+				else {
+					const uint_fast32_t yo = layout::tileOffset(0, y);
+					for (uint_fast32_t lx = 0; lx < n; ++lx) { t[yo | Morton2D_encode_x_256[lx]] = *src++; }
+				}
+			}
+		}
+	}
+
+	// Copy to a row-major buffer (x running fastest)
+	void copyToRowMajor(T* dst) const {
+		for (uint_fast32_t y = 0; y < h; ++y) {
+			for (uint_fast32_t x0 = 0; x0 < w; x0 += layout::TILE_SIZE) {
+				const uint_fast32_t n = (w - x0 < layout::TILE_SIZE) ? w - x0 : layout::TILE_SIZE;
+				const T* t = tile(tileIndex(x0, y));
+				if (ORDER == MORTON_TILE_ROWMAJOR) {
+					const T* row = t + layout::tileOffset(0, y);
+					dst = std::copy(row, row + n, dst);
+				}
+				else {
+					const uint_fast32_t yo = layout::tileOffset(0, y);
+					for (uint_fast32_t lx = 0; lx < n; ++lx) { *dst++ = t[yo | Morton2D_encode_x_256[lx]]; }
+				}
+			}
+		}
+	}
+
+private:
+	uint_fast32_t w, h;
+	MortonBrickLayout2D tiles;
+	std::vector<T> elements;
+};
+
+#endif // MORTON_TILED_H_
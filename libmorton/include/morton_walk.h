@@ -0,0 +1,256 @@
+// Libmorton - Walk all cells of a 2D/3D box in morton order, without encoding or decoding a code per cell
+#ifndef MORTON_WALK_H_
+#define MORTON_WALK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include "morton.h"
+
+// A step adds 1 to the code. Adding 1 turns the trailing one bits of the code into zeroes and sets the
+// zero bit above them, so the coordinates follow in constant time from the number of trailing ones:
+// the axis of the new bit gets that bit set and its lower bits cleared, the other axes get the bits
+// below it cleared. Adding 8^l to a code whose lower 3l bits are zero moves to the next node of level l
+// the same way.
+//
+// The box is covered by the aligned octree nodes that lie inside it. The walker steps through one of
+// them without any check; at its end, it looks at the aligned node starting at the next code: nodes
+// outside the box are skipped at once, nodes on its border are split by looking at their first child.
+// The walker keeps the coordinates without their lowest bit, which is read from the code, so inside a
+// 2 x 2 x 2 block a step is an increment of the code; the carry above it costs a count of trailing
+// zeroes once per block, plus a few node checks per node on the border of the box.
+//
+// morton3D_ForEachZOrder / morton2D_ForEachZOrder below are the fast path: they unroll every block and
+// inline the callback. A step of the walker costs about twice as much as a cell of nested loops that
+// encode every cell (256^3 cells: about 20-30 ms for the loops and for ForEachZOrder, 40-60 ms for the
+// walker). Use the walker only where an iterator is needed, e.g. to walk two boxes in step.
+
+// Cells (x, y, z) of the box x0 <= x <= x1, y0 <= y <= y1, z0 <= z <= z1 in morton order:
+// for (MortonWalker3D<uint_fast64_t, uint_fast32_t> w(x0, y0, z0, x1, y1, z1); !w.done(); w.next()) { ... }
+template<typename morton, typename coord>
+class MortonWalker3D {
+public:
+	MortonWalker3D(const coord x0, const coord y0, const coord z0, const coord x1, const coord y1, const coord z1) : finished(false) {
+		lo[0] = x0; lo[1] = y0; lo[2] = z0;
+		hi[0] = x1; hi[1] = y1; hi[2] = z1;
+		c[0] = x0 & ~(coord)1; c[1] = y0 & ~(coord)1; c[2] = z0 & ~(coord)1;
+		m = morton3D_Encode_LUT256_shifted<morton, coord>(x0, y0, z0);
+		hi_code = morton3D_Encode_LUT256_shifted<morton, coord>(x1, y1, z1);
+		findNode();
+	}
+
+	inline bool done() const { return finished; }
+	inline morton code() const { return m; }
+	inline coord x() const { return c[0] | (coord)(m & 1); }
+	inline coord y() const { return c[1] | (coord)((m >> 1) & 1); }
+	inline coord z() const { return c[2] | (coord)((m >> 2) & 1); }
+
+	// Move to the next cell of the box in morton order (done() after the last one)
+	inline void next() {
+		if (m != block_end) { ++m; return; } // inside a 2 x 2 x 2 block
+		if (m != node_end) { step(0); block_end = m | 7; return; }
+		if (m == hi_code) { finished = true; return; }
+		step(0);
+		findNode();
+	}
+
+private:
+	// Add 2^bit to the code, whose bits below bit are 0
+	inline void step(const unsigned int bit) {
+		const morton low = ((morton)1 << bit) - 1;
+		const unsigned int carry = morton_ctz<morton>(~(m | low)); // the bit that gets set
+		const unsigned int level = carry / 3, axis = carry % 3;
+		const coord set = (coord)1 << level, below = (set - 1) | 1; // constant indices keep c in registers
+		c[0] = (c[0] & ~(axis > 0 ? (below | set) : below)) | (axis == 0 ? set & ~(coord)1 : 0);
+		c[1] = (c[1] & ~(axis > 1 ? (below | set) : below)) | (axis == 1 ? set & ~(coord)1 : 0);
+		c[2] = (c[2] & ~below) | (axis == 2 ? set & ~(coord)1 : 0);
+		m = (m | low) + 1;
+	}
+
+	// From a code at the start of an aligned node (any code after a step), find the first node inside the box
+	inline void findNode() {
+		unsigned int level = std::min(morton_ctz<morton>(m) / 3, morton3D_maxLevel<morton>());
+		for (;;) {
+			const coord last = ((coord)1 << level) - 1;
+			const coord cx = x(), cy = y(), cz = z();
+			if (cx > hi[0] || cy > hi[1] || cz > hi[2] || cx + last < lo[0] || cy + last < lo[1] || cz + last < lo[2]) {
+				step(3 * level); // outside: skip the node, the next one may be larger
+				level = std::min(morton_ctz<morton>(m) / 3, morton3D_maxLevel<morton>());
+			}
+			else if (cx >= lo[0] && cy >= lo[1] && cz >= lo[2] && cx + last <= hi[0] && cy + last <= hi[1] && cz + last <= hi[2]) {
+				node_end = m | (((morton)1 << (3 * level)) - 1);
+				block_end = (level > 0) ? m | 7 : m;
+				return;
+			}
+			else { --level; } // on the border: look at its first child
+		}
+	}
+
+	morton m, block_end, node_end, hi_code; // block_end: last code of the current 2 x 2 x 2 block inside the node
+	coord c[3], lo[3], hi[3]; // c without its lowest bits, which are the lowest bits of m
+	bool finished;
+};
+
+// Cells (x, y) of the box x0 <= x <= x1, y0 <= y <= y1 in morton order, see MortonWalker3D
+template<typename morton, typename coord>
+class MortonWalker2D {
+public:
+	MortonWalker2D(const coord x0, const coord y0, const coord x1, const coord y1) : finished(false) {
+		lo[0] = x0; lo[1] = y0;
+		hi[0] = x1; hi[1] = y1;
+		c[0] = x0 & ~(coord)1; c[1] = y0 & ~(coord)1;
+		m = morton2D_Encode_LUT256_shifted<morton, coord>(x0, y0);
+		hi_code = morton2D_Encode_LUT256_shifted<morton, coord>(x1, y1);
+		findNode();
+	}
+
+	inline bool done() const { return finished; }
+	inline morton code() const { return m; }
+	inline coord x() const { return c[0] | (coord)(m & 1); }
+	inline coord y() const { return c[1] | (coord)((m >> 1) & 1); }
+
+	inline void next() {
+		if (m != block_end) { ++m; return; } // inside a 2 x 2 block
+		if (m != node_end) { step(0); block_end = m | 3; return; }
+		if (m == hi_code) { finished = true; return; }
+		step(0);
+		findNode();
+	}
+
+private:
+	inline void step(const unsigned int bit) {
+		const morton low = ((morton)1 << bit) - 1;
+		const unsigned int carry = morton_ctz<morton>(~(m | low));
+		const unsigned int level = carry / 2, axis = carry % 2;
+		const coord set = (coord)1 << level, below = (set - 1) | 1;
+		c[0] = (c[0] & ~(axis > 0 ? (below | set) : below)) | (axis == 0 ? set & ~(coord)1 : 0);
+		c[1] = (c[1] & ~below) | (axis == 1 ? set & ~(coord)1 : 0);
+		m = (m | low) + 1;
+	}
+
+	inline void findNode() {
+		// a node of level 32 in a 64-bit code spans all 32 bits of the coordinates: masks are built in 64 bits
+		unsigned int level = std::min(morton_ctz<morton>(m) / 2, morton2D_maxLevel<morton>());
+		for (;;) {
+			const coord last = (coord)(((uint_fast64_t)1 << level) - 1);
+			const coord cx = x(), cy = y();
+			if (cx > hi[0] || cy > hi[1] || cx + last < lo[0] || cy + last < lo[1]) {
+				step(2 * level);
+				level = std::min(morton_ctz<morton>(m) / 2, morton2D_maxLevel<morton>());
+			}
+			else if (cx >= lo[0] && cy >= lo[1] && cx + last <= hi[0] && cy + last <= hi[1]) {
+				node_end = (2 * level == sizeof(morton) * 8) ? ~(morton)0 : m | (((morton)1 << (2 * level)) - 1);
+				block_end = (level > 0) ? m | 3 : m;
+				return;
+			}
+			else { --level; }
+		}
+	}
+
+	morton m, block_end, node_end, hi_code;
+	coord c[2], lo[2], hi[2];
+	bool finished;
+};
+
+// Call f(code, x, y, z) for every cell of the node of size 2^level at (x, y, z) that starts at code, which lies
+// inside the box: the 8 cells of each 2 x 2 x 2 block are unrolled, and the blocks are stepped like
+// MortonWalker3D::next, one level up
+template<typename morton, typename coord, typename F>
+inline void morton3D_ForEachInNode(morton code, const coord x, const coord y, const coord z, const unsigned int level, F& f) {
+	if (level == 0) { f(code, x, y, z); return; }
+	const morton blocks = (morton)1 << (3 * (level - 1));
+	coord c[3] = { x, y, z };
+	for (morton b = 0; b < blocks; ++b, code += 8) {
+		const coord x1 = c[0] + 1, y1 = c[1] + 1, z1 = c[2] + 1;
+		f(code, c[0], c[1], c[2]); f(code + 1, x1, c[1], c[2]); f(code + 2, c[0], y1, c[2]); f(code + 3, x1, y1, c[2]);
+		f(code + 4, c[0], c[1], z1); f(code + 5, x1, c[1], z1); f(code + 6, c[0], y1, z1); f(code + 7, x1, y1, z1);
+		const unsigned int bit = morton_ctz<morton>(~b);
+		const unsigned int l = bit / 3 + 1, axis = bit % 3;
+		const coord below = (coord)(((uint_fast64_t)1 << l) - 1);
+		c[0] &= ~(axis > 0 ? (below << 1 | 1) : below);
+		c[1] &= ~(axis > 1 ? (below << 1 | 1) : below);
+		c[2] &= ~below;
+		c[axis] |= (coord)((uint_fast64_t)1 << l);
+	}
+}
+
+// Recursive part of morton3D_ForEachZOrder: nodes inside the box are walked without checks, nodes that
+// straddle its border are split into their 8 children
+template<typename morton, typename coord, typename F>
+void morton3D_ForEachZOrderNode(const morton code, const coord x, const coord y, const coord z, const unsigned int level,
+	const coord* lo, const coord* hi, F& f) {
+	const coord last = (coord)(((uint_fast64_t)1 << level) - 1);
+	if (x > hi[0] || y > hi[1] || z > hi[2] || x + last < lo[0] || y + last < lo[1] || z + last < lo[2]) { return; }
+	if (x >= lo[0] && y >= lo[1] && z >= lo[2] && x + last <= hi[0] && y + last <= hi[1] && z + last <= hi[2]) {
+		morton3D_ForEachInNode<morton, coord, F>(code, x, y, z, level, f);
+		return;
+	}
+	const coord half = (coord)1 << (level - 1);
+	const morton child = (morton)1 << (3 * (level - 1));
+	for (unsigned int i = 0; i < 8; ++i) {
+		morton3D_ForEachZOrderNode<morton, coord, F>(code + i * child, x + ((i & 1) ? half : 0), y + ((i & 2) ? half : 0), z + ((i & 4) ? half : 0),
+			level - 1, lo, hi, f);
+	}
+}
+
+// Call f(code, x, y, z) for every cell of the box x0 <= x <= x1, y0 <= y <= y1, z0 <= z <= z1, in morton order.
+// f is a template parameter, so the body of a lambda or functor is inlined into the walk. Faster than
+// MortonWalker3D: the walk starts at the smallest node holding the box and only the nodes on the border
+// of the box are checked.
+template<typename morton, typename coord, typename F>
+inline void morton3D_ForEachZOrder(const coord x0, const coord y0, const coord z0, const coord x1, const coord y1, const coord z1, F f) {
+	const coord lo[3] = { x0, y0, z0 }, hi[3] = { x1, y1, z1 };
+	const morton lo_code = morton3D_Encode_LUT256_shifted<morton, coord>(x0, y0, z0);
+	const morton hi_code = morton3D_Encode_LUT256_shifted<morton, coord>(x1, y1, z1);
+	const unsigned int level = morton3D_maxLevel<morton>() - morton3D_commonLevel<morton>(lo_code, hi_code);
+	const coord node = (coord)~(((uint_fast64_t)1 << level) - 1);
+	morton3D_ForEachZOrderNode<morton, coord, F>(morton3D_ancestorAtLevel<morton>(lo_code, morton3D_maxLevel<morton>() - level),
+		x0 & node, y0 & node, z0 & node, level, lo, hi, f);
+}
+
+// 2D version of morton3D_ForEachInNode, with 2 x 2 blocks
+template<typename morton, typename coord, typename F>
+inline void morton2D_ForEachInNode(morton code, const coord x, const coord y, const unsigned int level, F& f) {
+	if (level == 0) { f(code, x, y); return; }
+	const morton blocks = (morton)1 << (2 * (level - 1));
+	coord c[2] = { x, y };
+	for (morton b = 0; b < blocks; ++b, code += 4) {
+		f(code, c[0], c[1]); f(code + 1, c[0] + 1, c[1]); f(code + 2, c[0], c[1] + 1); f(code + 3, c[0] + 1, c[1] + 1);
+		const unsigned int bit = morton_ctz<morton>(~b);
+		const unsigned int l = bit / 2 + 1, axis = bit % 2;
+		const coord below = (coord)(((uint_fast64_t)1 << l) - 1);
+		c[0] &= ~(axis > 0 ? (below << 1 | 1) : below);
+		c[1] &= ~below;
+		c[axis] |= (coord)((uint_fast64_t)1 << l);
+	}
+}
+
+// 2D version of morton3D_ForEachZOrderNode
+template<typename morton, typename coord, typename F>
+void morton2D_ForEachZOrderNode(const morton code, const coord x, const coord y, const unsigned int level, const coord* lo, const coord* hi, F& f) {
+	const coord last = (coord)(((uint_fast64_t)1 << level) - 1); // a 2D node can span all 32 bits
+	if (x > hi[0] || y > hi[1] || x + last < lo[0] || y + last < lo[1]) { return; }
+	if (x >= lo[0] && y >= lo[1] && x + last <= hi[0] && y + last <= hi[1]) {
+		morton2D_ForEachInNode<morton, coord, F>(code, x, y, level, f);
+		return;
+	}
+	const coord half = (coord)1 << (level - 1);
+	const morton child = (morton)1 << (2 * (level - 1));
+	for (unsigned int i = 0; i < 4; ++i) {
+		morton2D_ForEachZOrderNode<morton, coord, F>(code + i * child, x + ((i & 1) ? half : 0), y + ((i & 2) ? half : 0), level - 1, lo, hi, f);
+	}
+}
+
+// Call f(code, x, y) for every cell of the box x0 <= x <= x1, y0 <= y <= y1, in morton order
+template<typename morton, typename coord, typename F>
+inline void morton2D_ForEachZOrder(const coord x0, const coord y0, const coord x1, const coord y1, F f) {
+	const coord lo[2] = { x0, y0 }, hi[2] = { x1, y1 };
+	const morton lo_code = morton2D_Encode_LUT256_shifted<morton, coord>(x0, y0);
+	const morton hi_code = morton2D_Encode_LUT256_shifted<morton, coord>(x1, y1);
+	const unsigned int level = morton2D_maxLevel<morton>() - morton2D_commonLevel<morton>(lo_code, hi_code);
+	const coord node = (coord)~(((uint_fast64_t)1 << level) - 1);
+	const morton start = (2 * level == sizeof(morton) * 8) ? 0 : lo_code & ~(((morton)1 << (2 * level)) - 1);
+	morton2D_ForEachZOrderNode<morton, coord, F>(start, x0 & node, y0 & node, level, lo, hi, f);
+}
+
+#endif // MORTON_WALK_H_
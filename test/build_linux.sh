@@ -1 +1 @@
-g++ -O3 -m64 -std=c++11 -I ../libmorton/include/ libmorton_test.cpp -o libmorton_test
+g++ -O3 -m64 -std=c++11 -fopenmp -I ../libmorton/include/ libmorton_test.cpp -o libmorton_test
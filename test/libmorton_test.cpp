@@ -8,6 +8,8 @@
 
 // Standard headers
 #include <cstdlib>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <chrono>
@@ -16,6 +18,9 @@
 #include <vector>
 #include <iomanip>
 #include <bitset>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
 
 using namespace std;
 using namespace std::chrono;
@@ -25,6 +30,30 @@ size_t MAX;
 unsigned int times;
 size_t total;
 size_t RAND_POOL_SIZE = 9000;
+size_t OCTREE_PERF_POINTS = 10000000;
+size_t HASHMAP_PERF_CELLS = 1000000;
+size_t KNN_PERF_POINTS = 2000000;
+size_t HIERARCHY_PERF_CODES = 10000000;
+size_t LBVH_PERF_PRIMITIVES = 10000000;
+size_t QUANTIZE_PERF_POINTS = 10000000;
+size_t POINTFILE_PERF_POINTS = 10000000;
+size_t EXTSORT_PERF_POINTS = 10000000; // 12-byte points: 4.5e9 for 50 GB of input
+size_t EXTSORT_PERF_MEMORY = 32 << 20; // several runs to merge
+size_t COMPRESS_PERF_CODES = 10000000;
+size_t LOD_PERF_POINTS = 10000000;
+size_t ET_PERF_POINTS = 10000000;
+size_t M2D32_PERF_POINTS = 10000000;
+size_t EXACT_PERF_POINTS = 20000000;
+size_t PACKED_PERF_POINTS = 20000000;
+size_t ANISO_PERF_POINTS = 20000000;
+size_t PACKEDLUT_PERF_CODES = 20000000;
+size_t NUMA_PERF_POINTS = 10000000;
+size_t PARTITION_PERF_CODES = 10000000;
+size_t BTREE_PERF_KEYS = 5000000;
+uint_fast32_t ARRAY_PERF_SIZE = 512;
+uint_fast32_t SWIZZLE_PERF_SIZE = 256;
+uint_fast32_t TILED_PERF_SIZE = 512;
+uint_fast32_t WALK_PERF_SIZE = 256;
 
 // Runningsums
 vector<uint_fast64_t> running_sums;
@@ -229,6 +258,8 @@ static void check3D_DecodeCorrectness() {
 	ok &= check3D_DecodeFunction<uint_fast64_t, uint_fast32_t>("64bit 3D Shifted LUT256 ET", &morton3D_Decode_LUT256_shifted_ET<uint_fast64_t, uint_fast32_t>);
 	ok &= check3D_DecodeFunction<uint_fast64_t, uint_fast32_t>("64bit 3D LUT256 ", &morton3D_Decode_LUT256<uint_fast64_t, uint_fast32_t>);
 	ok &= check3D_DecodeFunction<uint_fast64_t, uint_fast32_t>("64bit 3D LUT256 ET", &morton3D_Decode_LUT256_ET<uint_fast64_t, uint_fast32_t>);
+	ok &= check3D_DecodeFunction<uint_fast64_t, uint_fast32_t>("64bit 3D Packed LUT4096", &morton3D_Decode_LUT4096_packed<uint_fast64_t, uint_fast32_t>);
+	ok &= check3D_DecodeFunction<uint_fast64_t, uint_fast32_t>("64bit 3D Packed LUT32768", &morton3D_Decode_LUT32768_packed<uint_fast64_t, uint_fast32_t>);
 	ok &= check3D_DecodeFunction<uint_fast64_t, uint_fast32_t>("64bit 3D Magicbits", &morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>);
 	ok &= check3D_DecodeFunction<uint_fast64_t, uint_fast32_t>("64bit 3D For", &morton3D_Decode_for<uint_fast64_t, uint_fast32_t>);
 	ok &= check3D_DecodeFunction<uint_fast64_t, uint_fast32_t>("64bit 3D For ET", &morton3D_Decode_for_ET<uint_fast64_t, uint_fast32_t>);
@@ -237,6 +268,8 @@ static void check3D_DecodeCorrectness() {
 	ok &= check3D_DecodeFunction<uint_fast32_t, uint_fast16_t>("32bit 3D Shifted LUT256 ET", &morton3D_Decode_LUT256_shifted_ET<uint_fast32_t, uint_fast16_t>);
 	ok &= check3D_DecodeFunction<uint_fast32_t, uint_fast16_t>("32bit 3D LUT256 ", &morton3D_Decode_LUT256<uint_fast32_t, uint_fast16_t>);
 	ok &= check3D_DecodeFunction<uint_fast32_t, uint_fast16_t>("32bit 3D LUT256 ET", &morton3D_Decode_LUT256_ET<uint_fast32_t, uint_fast16_t>);
+	ok &= check3D_DecodeFunction<uint_fast32_t, uint_fast16_t>("32bit 3D Packed LUT4096", &morton3D_Decode_LUT4096_packed<uint_fast32_t, uint_fast16_t>);
+	ok &= check3D_DecodeFunction<uint_fast32_t, uint_fast16_t>("32bit 3D Packed LUT32768", &morton3D_Decode_LUT32768_packed<uint_fast32_t, uint_fast16_t>);
 	ok &= check3D_DecodeFunction<uint_fast32_t, uint_fast16_t>("32bit 3D Magicbits", &morton3D_Decode_magicbits<uint_fast32_t, uint_fast16_t>);
 	ok &= check3D_DecodeFunction<uint_fast32_t, uint_fast16_t>("32bit 3D For", &morton3D_Decode_for<uint_fast32_t, uint_fast16_t>);
 	ok &= check3D_DecodeFunction<uint_fast32_t, uint_fast16_t>("32bit 3D For ET", &morton3D_Decode_for_ET<uint_fast32_t, uint_fast16_t>);
@@ -244,6 +277,194 @@ static void check3D_DecodeCorrectness() {
 	else { printf("    One or more methods failed. \n"); }
 }
 
+// Signed encode/decode with the given unsigned methods: agrees with the offset coordinates, round trips,
+// and codes along an axis grow with the coordinate. bits: 21 for 64-bit codes, 10 for 32-bit codes
+template <typename morton, typename coord, morton(*encode)(const coord, const coord, const coord), void(*decode)(const morton, coord&, coord&, coord&), unsigned int bits>
+static bool check3D_SignedFunctions(string method_tested) {
+	typedef typename std::make_signed<coord>::type scoord;
+	const scoord lo = -(scoord)((scoord)1 << (bits - 1)), hi = ((scoord)1 << (bits - 1)) - 1;
+	const coord offset = (coord)1 << (bits - 1);
+	bool ok = true;
+	for (size_t i = 0; i < 10000; i++) {
+		scoord c[3];
+		for (int a = 0; a < 3; a++) {
+			c[a] = (i < 8) ? (((i >> a) & 1) ? hi : lo) : (scoord)(rand_cmwc() % ((uint_fast32_t)1 << bits)) + lo;
+		}
+		const morton m = morton3D_EncodeSigned<morton, coord, encode, bits>(c[0], c[1], c[2]);
+		ok &= m == morton3D_Encode_magicbits<morton, coord>((coord)(c[0] + (scoord)offset), (coord)(c[1] + (scoord)offset), (coord)(c[2] + (scoord)offset));
+		scoord x, y, z;
+		morton3D_DecodeSigned<morton, coord, decode, bits>(m, x, y, z);
+		ok &= x == c[0] && y == c[1] && z == c[2];
+		if (c[0] < hi) { ok &= morton3D_EncodeSigned<morton, coord, encode, bits>(c[0] + 1, c[1], c[2]) > m; }
+	}
+	ok &= morton3D_EncodeSigned<morton, coord, encode, bits>(lo, lo, lo) == 0;
+	ok &= morton3D_EncodeSigned<morton, coord, encode, bits>(-1, -1, -1) < morton3D_EncodeSigned<morton, coord, encode, bits>(0, 0, 0);
+	if (!ok) { cout << endl << "    Problem with signed encode/decode using " << method_tested << endl; }
+	return ok;
+}
+
+static void checkSignedCorrectness() {
+	printf("++ Checking correctness of signed coordinate encoding/decoding ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	ok &= check3D_SignedFunctions<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256_shifted<uint_fast64_t, uint_fast32_t>, morton3D_Decode_LUT256_shifted<uint_fast64_t, uint_fast32_t>, 21>("64bit 3D Shifted LUT256");
+	ok &= check3D_SignedFunctions<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256<uint_fast64_t, uint_fast32_t>, morton3D_Decode_LUT256<uint_fast64_t, uint_fast32_t>, 21>("64bit 3D LUT256");
+	ok &= check3D_SignedFunctions<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256_shifted_ET<uint_fast64_t, uint_fast32_t>, morton3D_Decode_LUT256_shifted_ET<uint_fast64_t, uint_fast32_t>, 21>("64bit 3D Shifted LUT256 ET");
+	ok &= check3D_SignedFunctions<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256_ET<uint_fast64_t, uint_fast32_t>, morton3D_Decode_LUT256_ET<uint_fast64_t, uint_fast32_t>, 21>("64bit 3D LUT256 ET");
+	ok &= check3D_SignedFunctions<uint_fast64_t, uint_fast32_t, morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>, morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>, 21>("64bit 3D Magicbits");
+	ok &= check3D_SignedFunctions<uint_fast64_t, uint_fast32_t, morton3D_Encode_for<uint_fast64_t, uint_fast32_t>, morton3D_Decode_for<uint_fast64_t, uint_fast32_t>, 21>("64bit 3D For");
+	ok &= check3D_SignedFunctions<uint_fast64_t, uint_fast32_t, morton3D_Encode_for_ET<uint_fast64_t, uint_fast32_t>, morton3D_Decode_for_ET<uint_fast64_t, uint_fast32_t>, 21>("64bit 3D For ET");
+	ok &= check3D_SignedFunctions<uint_fast32_t, uint_fast16_t, morton3D_Encode_LUT256_shifted<uint_fast32_t, uint_fast16_t>, morton3D_Decode_LUT256_shifted<uint_fast32_t, uint_fast16_t>, 10>("32bit 3D Shifted LUT256");
+	ok &= check3D_SignedFunctions<uint_fast32_t, uint_fast16_t, morton3D_Encode_LUT256<uint_fast32_t, uint_fast16_t>, morton3D_Decode_LUT256<uint_fast32_t, uint_fast16_t>, 10>("32bit 3D LUT256");
+	ok &= check3D_SignedFunctions<uint_fast32_t, uint_fast16_t, morton3D_Encode_LUT256_shifted_ET<uint_fast32_t, uint_fast16_t>, morton3D_Decode_LUT256_shifted_ET<uint_fast32_t, uint_fast16_t>, 10>("32bit 3D Shifted LUT256 ET");
+	ok &= check3D_SignedFunctions<uint_fast32_t, uint_fast16_t, morton3D_Encode_LUT256_ET<uint_fast32_t, uint_fast16_t>, morton3D_Decode_LUT256_ET<uint_fast32_t, uint_fast16_t>, 10>("32bit 3D LUT256 ET");
+	ok &= check3D_SignedFunctions<uint_fast32_t, uint_fast16_t, morton3D_Encode_magicbits<uint_fast32_t, uint_fast16_t>, morton3D_Decode_magicbits<uint_fast32_t, uint_fast16_t>, 10>("32bit 3D Magicbits");
+	ok &= check3D_SignedFunctions<uint_fast32_t, uint_fast16_t, morton3D_Encode_for<uint_fast32_t, uint_fast16_t>, morton3D_Decode_for<uint_fast32_t, uint_fast16_t>, 10>("32bit 3D For");
+	ok &= check3D_SignedFunctions<uint_fast32_t, uint_fast16_t, morton3D_Encode_for_ET<uint_fast32_t, uint_fast16_t>, morton3D_Decode_for_ET<uint_fast32_t, uint_fast16_t>, 10>("32bit 3D For ET");
+
+	// default methods
+	for (size_t i = 0; i < 10000; i++) {
+		const int_fast32_t x = (int_fast32_t)(rand_cmwc() & 0x1fffff) - (1 << 20), y = (int_fast32_t)(rand_cmwc() & 0x1fffff) - (1 << 20), z = (int_fast32_t)(rand_cmwc() & 0x1fffff) - (1 << 20);
+		int_fast32_t dx, dy, dz;
+		morton3D_64_decode_signed(morton3D_64_encode_signed(x, y, z), dx, dy, dz);
+		ok &= dx == x && dy == y && dz == z;
+		const int_fast16_t sx = (int_fast16_t)(rand_cmwc() & 0x3ff) - 512, sy = (int_fast16_t)(rand_cmwc() & 0x3ff) - 512, sz = (int_fast16_t)(rand_cmwc() & 0x3ff) - 512;
+		int_fast16_t ex, ey, ez;
+		morton3D_32_decode_signed(morton3D_32_encode_signed(sx, sy, sz), ex, ey, ez);
+		ok &= ex == sx && ey == sy && ez == sz;
+		// 2D: the full 32 / 16 bits
+		const int_fast32_t x2 = (int_fast32_t)(int32_t)(rand_cmwc() ^ (rand_cmwc() << 16)), y2 = (int_fast32_t)(int32_t)(rand_cmwc() ^ (rand_cmwc() << 16));
+		int_fast32_t dx2, dy2;
+		morton2D_64_decode_signed(morton2D_64_encode_signed(x2, y2), dx2, dy2);
+		ok &= dx2 == x2 && dy2 == y2;
+		ok &= morton2D_64_encode_signed(x2, y2) == morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>((uint32_t)x2 ^ 0x80000000u, (uint32_t)y2 ^ 0x80000000u);
+		const int_fast16_t x3 = (int_fast16_t)(int16_t)rand_cmwc(), y3 = (int_fast16_t)(int16_t)rand_cmwc();
+		int_fast16_t dx3, dy3;
+		morton2D_32_decode_signed(morton2D_32_encode_signed(x3, y3), dx3, dy3);
+		ok &= dx3 == x3 && dy3 == y3;
+	}
+	ok &= morton2D_64_encode_signed(INT32_MIN, INT32_MIN) == 0 && morton2D_64_encode_signed(-1, 5) < morton2D_64_encode_signed(0, 5);
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Early termination methods against the full ones, on coordinates of every magnitude
+template <typename morton, typename coord, morton(*full)(coord, coord, coord), morton(*et)(coord, coord, coord),
+	void(*full_decode)(morton, coord&, coord&, coord&), void(*et_decode)(morton, coord&, coord&, coord&)>
+static bool check3D_EarlyTermination(const unsigned int bits) {
+	bool ok = true;
+	for (unsigned int b = 0; b <= bits; b++) {
+		const coord mask = (coord)(((uint_fast64_t)1 << b) - 1);
+		for (size_t i = 0; i < 2000; i++) {
+			const coord x = (coord)rand_cmwc() & mask, y = (coord)rand_cmwc() & mask, z = (coord)rand_cmwc() & mask;
+			const morton m = full(x, y, z);
+			ok &= et(x, y, z) == m;
+			coord fx, fy, fz, ex, ey, ez;
+			full_decode(m, fx, fy, fz);
+			et_decode(m, ex, ey, ez);
+			ok &= ex == fx && ey == fy && ez == fz && ex == x && ey == y && ez == z;
+		}
+	}
+	return ok;
+}
+
+template <typename morton, typename coord, morton(*full)(coord, coord), morton(*et)(coord, coord)>
+static bool check2D_EarlyTermination(const unsigned int bits) {
+	bool ok = true;
+	for (unsigned int b = 0; b <= bits; b++) {
+		const coord mask = (coord)(((uint_fast64_t)1 << b) - 1);
+		for (size_t i = 0; i < 2000; i++) {
+			const coord x = (coord)(rand_cmwc() ^ (rand_cmwc() << 16)) & mask, y = (coord)(rand_cmwc() ^ (rand_cmwc() << 16)) & mask;
+			ok &= et(x, y) == full(x, y);
+		}
+	}
+	return ok;
+}
+
+static void checkEarlyTermination() {
+	printf("++ Checking correctness of early termination methods ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	unsigned long bit = 0;
+	for (unsigned int b = 0; b < 64; b++) {
+		ok &= findFirstSetBit<uint_fast64_t>((uint_fast64_t)1 << b, &bit) && bit == b;
+		ok &= findFirstSetBit<uint_fast64_t>(((uint_fast64_t)1 << b) | 1, &bit) && bit == b;
+	}
+	for (unsigned int b = 0; b < 32; b++) {
+		ok &= findFirstSetBit<uint32_t>((uint32_t)1 << b, &bit) && bit == b;
+	}
+	ok &= !findFirstSetBit<uint_fast64_t>(0, &bit) && !findFirstSetBit<uint32_t>(0, &bit);
+
+	ok &= check3D_EarlyTermination<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256_shifted<uint_fast64_t, uint_fast32_t>, morton3D_Encode_LUT256_shifted_ET<uint_fast64_t, uint_fast32_t>,
+		morton3D_Decode_LUT256_shifted<uint_fast64_t, uint_fast32_t>, morton3D_Decode_LUT256_shifted_ET<uint_fast64_t, uint_fast32_t> >(21);
+	ok &= check3D_EarlyTermination<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256<uint_fast64_t, uint_fast32_t>, morton3D_Encode_LUT256_ET<uint_fast64_t, uint_fast32_t>,
+		morton3D_Decode_LUT256<uint_fast64_t, uint_fast32_t>, morton3D_Decode_LUT256_ET<uint_fast64_t, uint_fast32_t> >(21);
+	ok &= check3D_EarlyTermination<uint_fast64_t, uint_fast32_t, morton3D_Encode_for<uint_fast64_t, uint_fast32_t>, morton3D_Encode_for_ET<uint_fast64_t, uint_fast32_t>,
+		morton3D_Decode_for<uint_fast64_t, uint_fast32_t>, morton3D_Decode_for_ET<uint_fast64_t, uint_fast32_t> >(21);
+	ok &= check3D_EarlyTermination<uint_fast32_t, uint_fast16_t, morton3D_Encode_LUT256_shifted<uint_fast32_t, uint_fast16_t>, morton3D_Encode_LUT256_shifted_ET<uint_fast32_t, uint_fast16_t>,
+		morton3D_Decode_LUT256_shifted<uint_fast32_t, uint_fast16_t>, morton3D_Decode_LUT256_shifted_ET<uint_fast32_t, uint_fast16_t> >(10);
+	ok &= check3D_EarlyTermination<uint_fast32_t, uint_fast16_t, morton3D_Encode_LUT256<uint_fast32_t, uint_fast16_t>, morton3D_Encode_LUT256_ET<uint_fast32_t, uint_fast16_t>,
+		morton3D_Decode_LUT256<uint_fast32_t, uint_fast16_t>, morton3D_Decode_LUT256_ET<uint_fast32_t, uint_fast16_t> >(10);
+	ok &= check3D_EarlyTermination<uint_fast32_t, uint_fast16_t, morton3D_Encode_for<uint_fast32_t, uint_fast16_t>, morton3D_Encode_for_ET<uint_fast32_t, uint_fast16_t>,
+		morton3D_Decode_for<uint_fast32_t, uint_fast16_t>, morton3D_Decode_for_ET<uint_fast32_t, uint_fast16_t> >(10);
+
+	ok &= check2D_EarlyTermination<uint_fast64_t, uint_fast32_t, morton2D_Encode_LUT256_shifted<uint_fast64_t, uint_fast32_t>, morton2D_Encode_LUT256_shifted_ET<uint_fast64_t, uint_fast32_t> >(32);
+	ok &= check2D_EarlyTermination<uint_fast64_t, uint_fast32_t, morton2D_Encode_LUT256<uint_fast64_t, uint_fast32_t>, morton2D_Encode_LUT256_ET<uint_fast64_t, uint_fast32_t> >(32);
+	ok &= check2D_EarlyTermination<uint_fast32_t, uint_fast16_t, morton2D_Encode_LUT256_shifted<uint_fast32_t, uint_fast16_t>, morton2D_Encode_LUT256_shifted_ET<uint_fast32_t, uint_fast16_t> >(16);
+	ok &= check2D_EarlyTermination<uint_fast32_t, uint_fast16_t, morton2D_Encode_LUT256<uint_fast32_t, uint_fast16_t>, morton2D_Encode_LUT256_ET<uint_fast32_t, uint_fast16_t> >(16);
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Encode / decode n points with coordinates of at most bits bits through the given method
+template <typename morton, typename coord, morton(*encode)(coord, coord, coord)>
+static double EarlyTermination_Encode_Perf(const vector<coord>& x, const vector<coord>& y, const vector<coord>& z, vector<morton>& codes) {
+	Timer timer = Timer();
+	timer.start();
+	for (size_t i = 0; i < codes.size(); i++) { codes[i] = encode(x[i], y[i], z[i]); }
+	timer.stop();
+	morton runningsum = 0;
+	for (size_t i = 0; i < codes.size(); i++) { runningsum += codes[i]; }
+	running_sums.push_back(runningsum);
+	return timer.elapsed_time_milliseconds;
+}
+
+template <typename morton, typename coord, void(*decode)(morton, coord&, coord&, coord&)>
+static double EarlyTermination_Decode_Perf(const vector<morton>& codes) {
+	Timer timer = Timer();
+	coord runningsum = 0;
+	timer.start();
+	for (size_t i = 0; i < codes.size(); i++) {
+		coord x, y, z;
+		decode(codes[i], x, y, z);
+		runningsum += x + y + z;
+	}
+	timer.stop();
+	running_sums.push_back(runningsum);
+	return timer.elapsed_time_milliseconds;
+}
+
+static void EarlyTermination_Perf(size_t n) {
+	cout << "++ Encoding and decoding " << n << " random points with small coordinates, full LUT vs early termination (64-bit)" << endl;
+	const unsigned int magnitudes[4] = { 4, 8, 12, 21 };
+	vector<uint_fast32_t> x(n), y(n), z(n);
+	vector<uint_fast64_t> codes(n);
+	for (size_t m = 0; m < 4; m++) {
+		init_randcmwc(42);
+		const uint_fast32_t mask = ((uint_fast32_t)1 << magnitudes[m]) - 1;
+		for (size_t i = 0; i < n; i++) { x[i] = rand_cmwc() & mask; y[i] = rand_cmwc() & mask; z[i] = rand_cmwc() & mask; }
+		cout << "    " << std::setw(2) << magnitudes[m] << "-bit coordinates:" << std::fixed << std::setprecision(3) << endl;
+		cout << "      Encode LUT256 preshifted:    " << EarlyTermination_Encode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256_shifted<uint_fast64_t, uint_fast32_t> >(x, y, z, codes) << " ms" << endl;
+		cout << "      Encode LUT256 preshifted ET: " << EarlyTermination_Encode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256_shifted_ET<uint_fast64_t, uint_fast32_t> >(x, y, z, codes) << " ms" << endl;
+		cout << "      Encode LUT256:               " << EarlyTermination_Encode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256<uint_fast64_t, uint_fast32_t> >(x, y, z, codes) << " ms" << endl;
+		cout << "      Encode LUT256 ET:            " << EarlyTermination_Encode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Encode_LUT256_ET<uint_fast64_t, uint_fast32_t> >(x, y, z, codes) << " ms" << endl;
+		cout << "      Decode LUT256 preshifted:    " << EarlyTermination_Decode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Decode_LUT256_shifted<uint_fast64_t, uint_fast32_t> >(codes) << " ms" << endl;
+		cout << "      Decode LUT256 preshifted ET: " << EarlyTermination_Decode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Decode_LUT256_shifted_ET<uint_fast64_t, uint_fast32_t> >(codes) << " ms" << endl;
+		cout << "      Decode LUT256:               " << EarlyTermination_Decode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Decode_LUT256<uint_fast64_t, uint_fast32_t> >(codes) << " ms" << endl;
+		cout << "      Decode LUT256 ET:            " << EarlyTermination_Decode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Decode_LUT256_ET<uint_fast64_t, uint_fast32_t> >(codes) << " ms" << endl;
+	}
+}
+
 static void Encode_3D_Perf() {
 	cout << "++ Encoding " << MAX << "^3 morton codes (" << total << " in total)" << endl;
 	cout << "    64-bit LUT256 preshifted:    " << testEncode_3D_Perf<uint_fast64_t, uint_fast32_t>(&morton3D_Encode_LUT256_shifted<uint_fast64_t, uint_fast32_t>, times) << endl;
@@ -270,6 +491,8 @@ static void Decode_3D_Perf(){
 	cout << "    64-bit LUT256 preshifted ET: " << testDecode_3D_Perf<uint_fast64_t, uint_fast32_t>(&morton3D_Decode_LUT256_shifted_ET<uint_fast64_t, uint_fast32_t>, times) << endl;
 	cout << "    64-bit LUT256:               " << testDecode_3D_Perf<uint_fast64_t, uint_fast32_t>(&morton3D_Decode_LUT256<uint_fast64_t, uint_fast32_t>, times) << endl;
 	cout << "    64-bit LUT256 ET:            " << testDecode_3D_Perf<uint_fast64_t, uint_fast32_t>(&morton3D_Decode_LUT256_ET<uint_fast64_t, uint_fast32_t>, times) << endl;
+	cout << "    64-bit LUT4096 packed:        " << testDecode_3D_Perf<uint_fast64_t, uint_fast32_t>(&morton3D_Decode_LUT4096_packed<uint_fast64_t, uint_fast32_t>, times) << endl;
+	cout << "    64-bit LUT32768 packed:       " << testDecode_3D_Perf<uint_fast64_t, uint_fast32_t>(&morton3D_Decode_LUT32768_packed<uint_fast64_t, uint_fast32_t>, times) << endl;
 	cout << "    64-bit Magicbits:            " << testDecode_3D_Perf<uint_fast64_t, uint_fast32_t>(&morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>, times) << endl;
 	cout << "    64-bit For:                  " << testDecode_3D_Perf<uint_fast64_t, uint_fast32_t>(&morton3D_Decode_for<uint_fast64_t, uint_fast32_t>, times) << endl;
 	cout << "    64-bit For ET:               " << testDecode_3D_Perf<uint_fast64_t, uint_fast32_t>(&morton3D_Decode_for_ET<uint_fast64_t, uint_fast32_t>, times) << endl;
@@ -279,12 +502,2595 @@ static void Decode_3D_Perf(){
 	cout << "    32-bit LUT256 preshifted ET: " << testDecode_3D_Perf<uint_fast32_t, uint_fast16_t>(&morton3D_Decode_LUT256_shifted_ET<uint_fast32_t, uint_fast16_t>, times) << endl;
 	cout << "    32-bit LUT256:               " << testDecode_3D_Perf<uint_fast32_t, uint_fast16_t>(&morton3D_Decode_LUT256<uint_fast32_t, uint_fast16_t>, times) << endl;
 	cout << "    32-bit LUT256 ET:            " << testDecode_3D_Perf<uint_fast32_t, uint_fast16_t>(&morton3D_Decode_LUT256_ET<uint_fast32_t, uint_fast16_t>, times) << endl;
+	cout << "    32-bit LUT4096 packed:        " << testDecode_3D_Perf<uint_fast32_t, uint_fast16_t>(&morton3D_Decode_LUT4096_packed<uint_fast32_t, uint_fast16_t>, times) << endl;
+	cout << "    32-bit LUT32768 packed:       " << testDecode_3D_Perf<uint_fast32_t, uint_fast16_t>(&morton3D_Decode_LUT32768_packed<uint_fast32_t, uint_fast16_t>, times) << endl;
 	cout << "    32-bit Magicbits:            " << testDecode_3D_Perf<uint_fast32_t, uint_fast16_t>(&morton3D_Decode_magicbits<uint_fast32_t, uint_fast16_t>, times) << endl;
 	cout << "    32-bit For:                  " << testDecode_3D_Perf<uint_fast32_t, uint_fast16_t>(&morton3D_Decode_for<uint_fast32_t, uint_fast16_t>, times) << endl;
 	cout << "    32-bit For ET:               " << testDecode_3D_Perf<uint_fast32_t, uint_fast16_t>(&morton3D_Decode_for_ET<uint_fast32_t, uint_fast16_t>, times) << endl;
 //#endif
 }
 
+static void checkMortonArithmetic() {
+	printf("++ Checking correctness of morton arithmetic ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	for (size_t i = 0; i < 100000; i++) {
+		uint_fast32_t x = (rand_cmwc() % 0x1ffffe) + 1, y = (rand_cmwc() % 0x1ffffe) + 1, z = (rand_cmwc() % 0x1ffffe) + 1;
+		uint_fast32_t dx = rand_cmwc() % x, dy = rand_cmwc() % y, dz = rand_cmwc() % z;
+		uint_fast64_t m = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y, z);
+		uint_fast64_t d = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(dx, dy, dz);
+		ok &= morton3D_IncX<uint_fast64_t>(m) == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x + 1, y, z);
+		ok &= morton3D_IncY<uint_fast64_t>(m) == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y + 1, z);
+		ok &= morton3D_IncZ<uint_fast64_t>(m) == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y, z + 1);
+		ok &= morton3D_DecX<uint_fast64_t>(m) == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x - 1, y, z);
+		ok &= morton3D_DecY<uint_fast64_t>(m) == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y - 1, z);
+		ok &= morton3D_DecZ<uint_fast64_t>(m) == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y, z - 1);
+		ok &= morton3D_Sub<uint_fast64_t>(m, d) == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x - dx, y - dy, z - dz);
+		ok &= morton3D_Add<uint_fast64_t>(morton3D_Sub<uint_fast64_t>(m, d), d) == m;
+
+		uint_fast64_t m2 = morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y);
+		uint_fast64_t d2 = morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(dx, dy);
+		ok &= morton2D_IncX<uint_fast64_t>(m2) == morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x + 1, y);
+		ok &= morton2D_IncY<uint_fast64_t>(m2) == morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y + 1);
+		ok &= morton2D_DecX<uint_fast64_t>(m2) == morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x - 1, y);
+		ok &= morton2D_DecY<uint_fast64_t>(m2) == morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x, y - 1);
+		ok &= morton2D_Sub<uint_fast64_t>(m2, d2) == morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x - dx, y - dy);
+		ok &= morton2D_Add<uint_fast64_t>(morton2D_Sub<uint_fast64_t>(m2, d2), d2) == m2;
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Deepest level at which the cells of two coordinate triples coincide (levels of the given number of bits)
+static unsigned int commonLevel_naive(uint_fast32_t xa, uint_fast32_t ya, uint_fast32_t za, uint_fast32_t xb, uint_fast32_t yb, uint_fast32_t zb, unsigned int bits) {
+	unsigned int level = 0;
+	while (level < bits) {
+		const unsigned int shift = bits - level - 1;
+		if ((xa >> shift) != (xb >> shift) || (ya >> shift) != (yb >> shift) || (za >> shift) != (zb >> shift)) { break; }
+		++level;
+	}
+	return level;
+}
+
+static void checkMortonHierarchy() {
+	printf("++ Checking correctness of clz/ctz and common ancestor levels ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	ok &= morton_clz<uint32_t>(0) == 32 && morton_ctz<uint32_t>(0) == 32;
+	ok &= morton_clz<uint_fast64_t>(0) == 64 && morton_ctz<uint_fast64_t>(0) == 64;
+	for (unsigned int b = 0; b < 64; b++) {
+		const uint_fast64_t bit = (uint_fast64_t)1 << b;
+		ok &= morton_clz<uint_fast64_t>(bit) == 63 - b && morton_ctz<uint_fast64_t>(bit) == b;
+		ok &= morton_clz<uint_fast64_t>(bit | 1) == 63 - b && morton_ctz<uint_fast64_t>(bit | ((uint_fast64_t)1 << 63)) == b;
+		if (b < 32) { ok &= morton_clz<uint32_t>((uint32_t)bit) == 31 - b && morton_ctz<uint32_t>((uint32_t)bit) == b; }
+	}
+	ok &= morton3D_maxLevel<uint_fast64_t>() == 21 && morton3D_maxLevel<uint32_t>() == 10;
+	ok &= morton2D_maxLevel<uint_fast64_t>() == 32 && morton2D_maxLevel<uint32_t>() == 16;
+	for (size_t i = 0; i < 100000; i++) {
+		// share a random number of top bits, so all levels get tested
+		const unsigned int keep = rand_cmwc() % 22;
+		const uint_fast32_t mask = (keep == 0) ? 0 : ((uint_fast32_t)0x1fffff << (21 - keep)) & 0x1fffff;
+		uint_fast32_t xa = rand_cmwc() & 0x1fffff, ya = rand_cmwc() & 0x1fffff, za = rand_cmwc() & 0x1fffff;
+		uint_fast32_t xb = (xa & mask) | (rand_cmwc() & 0x1fffff & ~mask), yb = (ya & mask) | (rand_cmwc() & 0x1fffff & ~mask), zb = (za & mask) | (rand_cmwc() & 0x1fffff & ~mask);
+		uint_fast64_t a = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(xa, ya, za);
+		uint_fast64_t b = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(xb, yb, zb);
+		const unsigned int level = morton3D_commonLevel<uint_fast64_t>(a, b);
+		ok &= level == commonLevel_naive(xa, ya, za, xb, yb, zb, 21);
+		ok &= morton3D_ancestorAtLevel<uint_fast64_t>(a, level) == morton3D_ancestorAtLevel<uint_fast64_t>(b, level);
+		const unsigned int l = rand_cmwc() % 22, s = 21 - l;
+		ok &= morton3D_ancestorAtLevel<uint_fast64_t>(a, l) == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(xa >> s << s, ya >> s << s, za >> s << s);
+
+		// 32-bit codes: 10 bits per axis
+		uint32_t a32 = (uint32_t)morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(xa >> 11, ya >> 11, za >> 11);
+		uint32_t b32 = (uint32_t)morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(xb >> 11, yb >> 11, zb >> 11);
+		ok &= morton3D_commonLevel<uint32_t>(a32, b32) == commonLevel_naive(xa >> 11, ya >> 11, za >> 11, xb >> 11, yb >> 11, zb >> 11, 10);
+
+		// 2D: 32 bits per axis in 64-bit codes
+		uint_fast64_t a2 = morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(xa << 11, ya << 11);
+		uint_fast64_t b2 = morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(xb << 11, yb << 11);
+		ok &= morton2D_commonLevel<uint_fast64_t>(a2, b2) == commonLevel_naive(xa << 11, ya << 11, 0, xb << 11, yb << 11, 0, 32);
+		const unsigned int l2 = rand_cmwc() % 33;
+		const uint_fast32_t m2 = (l2 == 0) ? 0 : (uint_fast32_t)(0xffffffffu << (32 - l2));
+		ok &= morton2D_ancestorAtLevel<uint_fast64_t>(a2, l2) == morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>((xa << 11) & m2, (ya << 11) & m2);
+	}
+	// batch form
+	vector<uint_fast64_t> codes(1000);
+	for (size_t i = 0; i < codes.size(); i++) { codes[i] = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x3ff, 7); }
+	sort(codes.begin(), codes.end());
+	vector<uint8_t> levels(codes.size() - 1);
+	morton3D_commonLevels<uint_fast64_t>(&codes[0], codes.size(), &levels[0]);
+	for (size_t i = 0; i + 1 < codes.size(); i++) { ok &= levels[i] == morton3D_commonLevel<uint_fast64_t>(codes[i], codes[i + 1]); }
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void MortonHierarchy_Perf(size_t n) {
+	cout << "++ Common ancestor levels of neighbouring pairs in " << n << " sorted morton codes" << endl;
+	init_randcmwc(42);
+	vector<uint_fast64_t> codes(n);
+	for (size_t i = 0; i < n; i++) {
+		codes[i] = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff);
+	}
+	sort(codes.begin(), codes.end());
+	vector<uint8_t> levels(n);
+	uint_fast64_t runningsum = 0;
+	Timer timer = Timer();
+	timer.start();
+	for (unsigned int t = 0; t < times; t++) {
+		morton3D_commonLevels<uint_fast64_t>(&codes[0], n, &levels[0]);
+		runningsum += levels[t % (n - 1)];
+	}
+	timer.stop();
+	running_sums.push_back(runningsum);
+	const double ms = timer.elapsed_time_milliseconds / times;
+	cout << "    morton3D_commonLevels: " << std::fixed << std::setprecision(3) << ms << " ms per pass ("
+		<< ((ms > 0) ? (n - 1) / (ms * 1000.0) : 0.0) << " million pairs per second)" << endl;
+}
+
+static void checkMortonArray() {
+	printf("++ Checking correctness of morton arrays ... ");
+	bool ok = true;
+	const uint_fast32_t w = 37, h = 20, d = 9;
+	vector<uint_fast32_t> rowmajor(w * h * d), back(w * h * d);
+	for (size_t i = 0; i < rowmajor.size(); i++) { rowmajor[i] = (uint_fast32_t) i; }
+	MortonArray3D<uint_fast32_t> a3(w, h, d);
+	a3.copyFromRowMajor(&rowmajor[0]);
+	vector<bool> used(a3.storageSize(), false);
+	for (uint_fast32_t z = 0; z < d; z++) for (uint_fast32_t y = 0; y < h; y++) for (uint_fast32_t x = 0; x < w; x++) {
+		ok &= a3(x, y, z) == x + w * (y + h * z);
+		ok &= a3.atOffset(a3.offset(x, y, z)) == a3(x, y, z);
+		ok &= a3.offset(x, y, z) < a3.storageSize() && !used[(size_t)a3.offset(x, y, z)];
+		if (a3.offset(x, y, z) < a3.storageSize()) { used[(size_t)a3.offset(x, y, z)] = true; }
+	}
+	a3.copyToRowMajor(&back[0]);
+	ok &= back == rowmajor;
+	// 32x16x8 bricks, 2x2x2 of them. Levels 0-2 interleave x, y and z, level 3 x and y, level 4 x only:
+	// bits of x go to 0, 3, 6, 9, 11, bits of y to 1, 4, 7, 10, bits of z to 2, 5, 8
+	ok &= a3.storageSize() == 8 * 4096;
+	ok &= a3.offset(9, 10, 3) == 0x635 && a3.offset(33, 0, 0) == 4097 && a3.offset(0, 16, 8) == 4096 * 6;
+
+	MortonArray2D<uint_fast32_t> a2(w, h);
+	a2.copyFromRowMajor(&rowmajor[0]);
+	for (uint_fast32_t y = 0; y < h; y++) for (uint_fast32_t x = 0; x < w; x++) {
+		ok &= a2(x, y) == x + w * y;
+		ok &= a2.atOffset(a2.offset(x, y)) == a2(x, y);
+	}
+	back.assign(w * h, 0);
+	a2.copyToRowMajor(&back[0]);
+	ok &= equal(back.begin(), back.end(), rowmajor.begin());
+	ok &= a2.storageSize() == 4 * 512;
+
+	// power-of-two cubes are a single brick, offsets are the morton codes
+	MortonArray3D<uint_fast32_t> cube(16, 16, 16);
+	ok &= cube.storageSize() == 4096 && cube.offset(5, 11, 7) == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(5, 11, 7);
+
+	// flat and elongated extents: padding stays within 2x per axis instead of following the far corner code
+	const uint_fast32_t extents[][3] = { { 1025, 1, 1 }, { 1, 1, 100000 }, { 4096, 4096, 4 }, { 3, 777, 5 }, { 1000, 1000, 1 }, { 2, 3, 1000 } };
+	for (size_t e = 0; e < sizeof(extents) / sizeof(extents[0]); e++) {
+		const uint_fast32_t ew = extents[e][0], eh = extents[e][1], ed = extents[e][2];
+		const MortonBrickLayout3D l3(ew, eh, ed);
+		ok &= l3.size() >= (size_t)ew * eh * ed && l3.size() <= 8 * (size_t)ew * eh * ed;
+		const MortonBrickLayout2D l2(ew, eh);
+		ok &= l2.size() >= (size_t)ew * eh && l2.size() <= 4 * (size_t)ew * eh;
+	}
+	MortonArray3D<uint_fast32_t> flat(3, 777, 5);
+	rowmajor.resize(3 * 777 * 5); back.assign(rowmajor.size(), 0);
+	for (size_t i = 0; i < rowmajor.size(); i++) { rowmajor[i] = (uint_fast32_t) i; }
+	flat.copyFromRowMajor(&rowmajor[0]);
+	flat.copyToRowMajor(&back[0]);
+	ok &= back == rowmajor && flat(2, 500, 4) == 2 + 3 * (500 + 777 * 4);
+	ok &= flat.storageSize() <= 8 * rowmajor.size();
+
+	// flat grids keep Z-order along their long axes: 2x2 (2x2x2) blocks inside a brick are consecutive
+	const MortonBrickLayout3D plane(1000, 1000, 1), slab(4096, 4096, 4);
+	ok &= plane.brickBits(0) == 9 && plane.brickBits(1) == 9 && plane.brickBits(2) == 0 && slab.size() == (size_t)4096 * 4096 * 4;
+	for (size_t i = 0; i < 10000; i++) {
+		const uint_fast32_t x = 2 * (rand_cmwc() % 499), y = 2 * (rand_cmwc() % 499);
+		const uint_fast64_t m = plane.offset(x, y, 0);
+		ok &= plane.offset(x + 1, y, 0) == m + 1 && plane.offset(x, y + 1, 0) == m + 2 && plane.offset(x + 1, y + 1, 0) == m + 3;
+		if (x + 2 < 512) { ok &= plane.offset(x + 2, y, 0) / plane.brickVolume() == m / plane.brickVolume(); }
+		const uint_fast32_t sx = 2 * (rand_cmwc() % 2048), sy = 2 * (rand_cmwc() % 2048), sz = 2 * (rand_cmwc() % 2);
+		const uint_fast64_t sm = slab.offset(sx, sy, sz);
+		ok &= slab.offset(sx + 1, sy, sz) == sm + 1 && slab.offset(sx, sy + 1, sz) == sm + 2 && slab.offset(sx + 1, sy + 1, sz + 1) == sm + 7;
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// 7-point stencil (convolution-style access) and z-column sweeps over a volume, row-major vs morton-ordered storage
+static void MortonArray_Perf(uint_fast32_t n) {
+	cout << "++ 7-point stencil and z-column sweeps over a " << n << "^3 volume" << endl;
+	vector<float> rowmajor((size_t)n * n * n);
+	for (size_t i = 0; i < rowmajor.size(); i++) { rowmajor[i] = (float)(i % 1024); }
+	MortonArray3D<float> volume(n, n, n);
+	volume.copyFromRowMajor(&rowmajor[0]);
+	const size_t sx = 1, sy = n, sz = (size_t)n * n;
+
+	// row-major storage: x, y and z neighbours are 1, n and n^2 elements apart
+	Timer rowmajor_timer = Timer();
+	float rowmajor_sum = 0;
+	rowmajor_timer.start();
+	for (size_t t = 0; t < times; t++) {
+		for (uint_fast32_t z = 1; z < n - 1; z++) for (uint_fast32_t y = 1; y < n - 1; y++) {
+			const float* p = &rowmajor[z * sz + y * sy + 1];
+			for (uint_fast32_t x = 1; x < n - 1; x++, p++) {
+				rowmajor_sum += 6 * p[0] - p[-(ptrdiff_t)sx] - p[sx] - p[-(ptrdiff_t)sy] - p[sy] - p[-(ptrdiff_t)sz] - p[sz];
+			}
+		}
+	}
+	rowmajor_timer.stop();
+
+	// morton storage, visited in Z-order 8x8x8 blocks at a time: neighbours through in-code increments
+	// (a power-of-two cube is a single brick, so the increments are valid across the whole volume)
+	uint_fast32_t lx[512], ly[512], lz[512];
+	for (uint_fast32_t l = 0; l < 512; l++) { morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(l, lx[l], ly[l], lz[l]); }
+	Timer morton_timer = Timer();
+	float morton_sum = 0;
+	const float* v = volume.data();
+	morton_timer.start();
+	for (size_t t = 0; t < times; t++) {
+		for (uint_fast32_t bz = 0; bz < n; bz += 8) for (uint_fast32_t by = 0; by < n; by += 8) for (uint_fast32_t bx = 0; bx < n; bx += 8) {
+			const uint_fast64_t base = volume.offset(bx, by, bz);
+			for (uint_fast32_t l = 0; l < 512; l++) {
+				const uint_fast32_t x = bx + lx[l], y = by + ly[l], z = bz + lz[l];
+				if (x == 0 || y == 0 || z == 0 || x >= n - 1 || y >= n - 1 || z >= n - 1) { continue; }
+				const uint_fast64_t m = base | l;
+				morton_sum += 6 * v[m] - v[morton3D_DecX(m)] - v[morton3D_IncX(m)] - v[morton3D_DecY(m)] - v[morton3D_IncY(m)] - v[morton3D_DecZ(m)] - v[morton3D_IncZ(m)];
+			}
+		}
+	}
+	morton_timer.stop();
+
+	// marching along z (x and y fixed): a full slice apart in row-major storage
+	Timer rowmajor_z_timer = Timer(), morton_z_timer = Timer();
+	rowmajor_z_timer.start();
+	for (size_t t = 0; t < times; t++) {
+		for (uint_fast32_t y = 0; y < n; y++) for (uint_fast32_t x = 0; x < n; x++) {
+			const float* p = &rowmajor[y * sy + x];
+			for (uint_fast32_t z = 0; z < n; z++, p += sz) { rowmajor_sum += *p; }
+		}
+	}
+	rowmajor_z_timer.stop();
+	morton_z_timer.start();
+	for (size_t t = 0; t < times; t++) {
+		for (uint_fast32_t y = 0; y < n; y++) for (uint_fast32_t x = 0; x < n; x++) {
+			uint_fast64_t m = volume.offset(x, y, 0);
+			for (uint_fast32_t z = 0; z < n; z++, m = morton3D_IncZ(m)) { morton_sum += v[m]; }
+		}
+	}
+	morton_z_timer.stop();
+	running_sums.push_back((uint_fast64_t)(rowmajor_sum + morton_sum));
+	cout << "    Row-major:    stencil " << std::fixed << std::setprecision(3) << rowmajor_timer.elapsed_time_milliseconds / times << " ms, z-columns " << rowmajor_z_timer.elapsed_time_milliseconds / times << " ms" << endl;
+	cout << "    MortonArray:  stencil " << morton_timer.elapsed_time_milliseconds / times << " ms, z-columns " << morton_z_timer.elapsed_time_milliseconds / times << " ms ("
+		<< volume.storageSize() << " elements allocated for " << rowmajor.size() << ")" << endl;
+}
+
+static bool checkSwizzle(size_t element_size, uint_fast32_t w, uint_fast32_t h, uint_fast32_t d) {
+	bool ok = true;
+	vector<char> rowmajor(element_size * w * h * d), back(rowmajor.size());
+	for (size_t i = 0; i < rowmajor.size(); i++) { rowmajor[i] = (char)rand_cmwc(); }
+	// 3D
+	vector<char> swizzled(element_size * morton3D_SwizzledSize(w, h, d));
+	morton3D_Swizzle(&rowmajor[0], &swizzled[0], element_size, w, h, d);
+	const MortonBrickLayout3D layout3D(w, h, d);
+	for (uint_fast32_t z = 0; z < d; z++) for (uint_fast32_t y = 0; y < h; y++) for (uint_fast32_t x = 0; x < w; x++) {
+		uint_fast64_t m = layout3D.offset(x, y, z);
+		ok &= memcmp(&swizzled[m * element_size], &rowmajor[(x + w * (y + h * z)) * element_size], element_size) == 0;
+	}
+	morton3D_Unswizzle(&swizzled[0], &back[0], element_size, w, h, d);
+	ok &= back == rowmajor;
+	// 2D, using the first slice
+	swizzled.assign(element_size * morton2D_SwizzledSize(w, h), 0);
+	morton2D_Swizzle(&rowmajor[0], &swizzled[0], element_size, w, h);
+	const MortonBrickLayout2D layout2D(w, h);
+	for (uint_fast32_t y = 0; y < h; y++) for (uint_fast32_t x = 0; x < w; x++) {
+		uint_fast64_t m = layout2D.offset(x, y);
+		ok &= memcmp(&swizzled[m * element_size], &rowmajor[(x + w * y) * element_size], element_size) == 0;
+	}
+	back.assign(back.size(), 0);
+	morton2D_Unswizzle(&swizzled[0], &back[0], element_size, w, h);
+	ok &= memcmp(&back[0], &rowmajor[0], element_size * w * h) == 0;
+	if (!ok) { cout << endl << "    Incorrect swizzle of " << w << "x" << h << "x" << d << " buffer with " << element_size << " byte elements" << endl; }
+	return ok;
+}
+
+static void checkSwizzleCorrectness() {
+	printf("++ Checking correctness of swizzle/unswizzle ... ");
+	init_randcmwc(42);
+	bool ok = true;
+	ok &= checkSwizzle(1, 37, 20, 9);
+	ok &= checkSwizzle(3, 37, 20, 9);
+	ok &= checkSwizzle(4, 16, 16, 16);
+	ok &= checkSwizzle(8, 100, 70, 33);
+	ok &= checkSwizzle(16, 5, 130, 17);
+	ok &= checkSwizzle(4, 1025, 3, 2);
+	ok &= checkSwizzle(2, 1, 300, 40);
+	ok &= morton3D_SwizzledSize(1025, 1, 1) == 2048 && morton3D_SwizzledSize(4096, 4096, 4) == (size_t)4096 * 4096 * 4;
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void Swizzle_Perf(uint_fast32_t w, uint_fast32_t h, uint_fast32_t d) {
+	cout << "++ Swizzling a " << w << "x" << h << "x" << d << " volume of floats" << endl;
+	const size_t elements = (size_t)w * h * d;
+	const double gigabytes = 2.0 * elements * sizeof(float) / (1024.0 * 1024.0 * 1024.0); // read + write
+	vector<float> rowmajor(elements), back(elements);
+	vector<float> swizzled(morton3D_SwizzledSize(w, h, d));
+	const MortonBrickLayout3D layout(w, h, d);
+	for (size_t i = 0; i < elements; i++) { rowmajor[i] = (float)i; }
+
+	Timer memcpy_timer = Timer(), naive_timer = Timer(), swizzle_timer = Timer(), unswizzle_timer = Timer();
+	for (size_t t = 0; t < times; t++) {
+		memcpy_timer.start();
+		memcpy(&back[0], &rowmajor[0], elements * sizeof(float));
+		memcpy_timer.stop();
+		naive_timer.start();
+		for (uint_fast32_t z = 0, i = 0; z < d; z++) for (uint_fast32_t y = 0; y < h; y++) for (uint_fast32_t x = 0; x < w; x++) {
+			swizzled[(size_t)layout.offset(x, y, z)] = rowmajor[i++];
+		}
+		naive_timer.stop();
+		swizzle_timer.start();
+		morton3D_Swizzle(&rowmajor[0], &swizzled[0], sizeof(float), w, h, d);
+		swizzle_timer.stop();
+		unswizzle_timer.start();
+		morton3D_Unswizzle(&swizzled[0], &back[0], sizeof(float), w, h, d);
+		unswizzle_timer.stop();
+	}
+	running_sums.push_back((uint_fast64_t)back[elements - 1]);
+	cout << std::fixed << std::setprecision(3);
+	cout << "    memcpy (reference):     " << memcpy_timer.elapsed_time_milliseconds / times << " ms, " << gigabytes * times * 1000.0 / memcpy_timer.elapsed_time_milliseconds << " GB/s" << endl;
+	cout << "    Per-element offset:     " << naive_timer.elapsed_time_milliseconds / times << " ms, " << gigabytes * times * 1000.0 / naive_timer.elapsed_time_milliseconds << " GB/s" << endl;
+	cout << "    morton3D_Swizzle:       " << swizzle_timer.elapsed_time_milliseconds / times << " ms, " << gigabytes * times * 1000.0 / swizzle_timer.elapsed_time_milliseconds << " GB/s" << endl;
+	cout << "    morton3D_Unswizzle:     " << unswizzle_timer.elapsed_time_milliseconds / times << " ms, " << gigabytes * times * 1000.0 / unswizzle_timer.elapsed_time_milliseconds << " GB/s" << endl;
+}
+
+template <unsigned int TILEBITS, MortonTileOrder ORDER>
+static bool checkTiledArray(uint_fast32_t w, uint_fast32_t h, uint_fast32_t d) {
+	typedef MortonTileLayout3D<TILEBITS, ORDER> layout3D;
+	typedef MortonTileLayout2D<TILEBITS, ORDER> layout2D;
+	bool ok = true;
+	const uint_fast32_t T = 1 << TILEBITS, tw = (w + T - 1) / T, th = (h + T - 1) / T, td = (d + T - 1) / T;
+	vector<uint_fast32_t> rowmajor(w * h * d), back(w * h * d);
+	for (size_t i = 0; i < rowmajor.size(); i++) { rowmajor[i] = (uint_fast32_t)i; }
+	MortonTiledArray3D<uint_fast32_t, TILEBITS, ORDER> a3(w, h, d);
+	a3.copyFromRowMajor(&rowmajor[0]);
+	const MortonBrickLayout3D tiles3D(tw, th, td);
+	for (uint_fast32_t z = 0; z < d; z++) for (uint_fast32_t y = 0; y < h; y++) for (uint_fast32_t x = 0; x < w; x++) {
+		const uint_fast32_t lx = x % T, ly = y % T, lz = z % T;
+		uint_fast64_t tile;
+		uint_fast32_t offset;
+		a3.split(x, y, z, tile, offset);
+		ok &= tile == tiles3D.offset(x / T, y / T, z / T) && tile < a3.tileCount();
+		ok &= offset == ((ORDER == MORTON_TILE_MORTON) ? morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(lx, ly, lz) : lx + T * (ly + T * lz));
+		ok &= offset == layout3D::tileOffset(x, y, z);
+		ok &= a3(x, y, z) == x + w * (y + h * z);
+		ok &= a3.tile(tile)[offset] == a3(x, y, z);
+	}
+	a3.copyToRowMajor(&back[0]);
+	ok &= back == rowmajor;
+	// the tile count follows the tile grid, not the morton code of the far tile
+	ok &= a3.tileCount() == tiles3D.size() && a3.tileCount() >= (size_t)tw * th * td && a3.tileCount() <= 8 * (size_t)tw * th * td;
+
+	MortonTiledArray2D<uint_fast32_t, TILEBITS, ORDER> a2(w, h);
+	a2.copyFromRowMajor(&rowmajor[0]);
+	const MortonBrickLayout2D tiles2D(tw, th);
+	for (uint_fast32_t y = 0; y < h; y++) for (uint_fast32_t x = 0; x < w; x++) {
+		const uint_fast32_t lx = x % T, ly = y % T;
+		ok &= a2.tileIndex(x, y) == tiles2D.offset(x / T, y / T);
+		ok &= layout2D::tileOffset(x, y) == ((ORDER == MORTON_TILE_MORTON) ? morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(lx, ly) : lx + T * ly);
+		ok &= a2(x, y) == x + w * y;
+	}
+	back.assign(w * h, 0);
+	a2.copyToRowMajor(&back[0]);
+	ok &= equal(back.begin(), back.end(), rowmajor.begin());
+	ok &= a2.tileCount() == tiles2D.size() && a2.tileCount() <= 4 * (size_t)tw * th;
+	if (!ok) { cout << endl << "    Incorrect tiled array with " << (1 << TILEBITS) << " wide tiles" << endl; }
+	return ok;
+}
+
+static void checkTiledArrays() {
+	printf("++ Checking correctness of tiled morton arrays ... ");
+	bool ok = true;
+	ok &= checkTiledArray<1, MORTON_TILE_MORTON>(37, 20, 9);
+	ok &= checkTiledArray<2, MORTON_TILE_MORTON>(37, 20, 9);
+	ok &= checkTiledArray<3, MORTON_TILE_ROWMAJOR>(37, 20, 9);
+	ok &= checkTiledArray<4, MORTON_TILE_ROWMAJOR>(16, 48, 17);
+	ok &= checkTiledArray<8, MORTON_TILE_MORTON>(300, 3, 2);
+	ok &= checkTiledArray<2, MORTON_TILE_MORTON>(1000, 4, 3);
+	ok &= checkTiledArray<1, MORTON_TILE_ROWMAJOR>(2, 500, 33);
+	// non-cubic tile grids: exact tile counts
+	ok &= MortonTiledArray3D<char, 2, MORTON_TILE_MORTON>(4100, 4, 4).tileCount() == 2048; // two 1024x1x1 bricks, far tile code was 2^30
+	ok &= MortonTiledArray3D<char, 2, MORTON_TILE_MORTON>(64, 64, 8).tileCount() == 16 * 16 * 2; // one brick
+	ok &= MortonTiledArray3D<char, 3, MORTON_TILE_ROWMAJOR>(37, 20, 9).tileCount() == 4 * 16; // 5x3x2 tiles in 2x2x1 bricks of 4x2x2
+	ok &= MortonTiledArray2D<char, 4, MORTON_TILE_MORTON>(16 * 100, 16 * 3).tileCount() == 4 * 128; // 100x3 tiles in 2x2 bricks of 64x2
+	// a flat grid of tiles keeps Z-order in x and y: 2x2 blocks of tiles are consecutive
+	const MortonTiledArray3D<char, 2, MORTON_TILE_MORTON> slab(256, 256, 4);
+	ok &= slab.tileCount() == 64 * 64;
+	for (uint_fast32_t ty = 0; ty < 64; ty += 2) for (uint_fast32_t tx = 0; tx < 64; tx += 2) {
+		const uint_fast64_t t = slab.tileIndex(4 * tx, 4 * ty, 0);
+		ok &= slab.tileIndex(4 * tx + 4, 4 * ty, 0) == t + 1 && slab.tileIndex(4 * tx, 4 * ty + 4, 0) == t + 2 && slab.tileIndex(4 * tx + 4, 4 * ty + 4, 0) == t + 3;
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Nearest-neighbour ray marching in random directions: coherent accesses, but not along x
+template <typename volume>
+static double rayMarch_Perf(const volume& v, uint_fast32_t n, size_t rays, float& sum) {
+	Timer timer = Timer();
+	init_randcmwc(42);
+	timer.start();
+	for (size_t r = 0; r < rays; r++) {
+		float dx = (rand_cmwc() % 2001) / 1000.0f - 1.0f, dy = (rand_cmwc() % 2001) / 1000.0f - 1.0f, dz = (rand_cmwc() % 2001) / 1000.0f - 1.0f;
+		const float len = sqrt(dx * dx + dy * dy + dz * dz) + 1e-6f;
+		dx /= len; dy /= len; dz /= len;
+		float px = n / 2.0f, py = n / 2.0f, pz = n / 2.0f;
+		while (px >= 0 && py >= 0 && pz >= 0 && px < n && py < n && pz < n) {
+			sum += v((uint_fast32_t)px, (uint_fast32_t)py, (uint_fast32_t)pz);
+			px += dx; py += dy; pz += dz;
+		}
+	}
+	timer.stop();
+	return timer.elapsed_time_milliseconds;
+}
+
+struct RowMajorVolume {
+	const vector<float>& data;
+	uint_fast32_t n;
+	RowMajorVolume(const vector<float>& data, uint_fast32_t n) : data(data), n(n) {}
+	inline float operator()(uint_fast32_t x, uint_fast32_t y, uint_fast32_t z) const { return data[x + (size_t)n * (y + (size_t)n * z)]; }
+};
+
+template <unsigned int TILEBITS, MortonTileOrder ORDER>
+static void TiledArray_RayMarch_Perf(const vector<float>& rowmajor, uint_fast32_t n, size_t rays, float& sum) {
+	MortonTiledArray3D<float, TILEBITS, ORDER> v(n, n, n);
+	v.copyFromRowMajor(&rowmajor[0]);
+	cout << "    " << (1 << TILEBITS) << "^3 tiles, " << ((ORDER == MORTON_TILE_MORTON) ? "morton" : "row-major") << " inside: " << rayMarch_Perf(v, n, rays, sum) << " ms" << endl;
+}
+
+static void TiledArray_Perf(uint_fast32_t n) {
+	const size_t rays = 200000;
+	cout << "++ Marching " << rays << " rays through a " << n << "^3 volume" << endl;
+	vector<float> rowmajor((size_t)n * n * n);
+	for (size_t i = 0; i < rowmajor.size(); i++) { rowmajor[i] = (float)(i % 1024); }
+	float sum = 0;
+	cout << std::fixed << std::setprecision(3);
+	cout << "    Row-major:                " << rayMarch_Perf(RowMajorVolume(rowmajor, n), n, rays, sum) << " ms" << endl;
+	MortonArray3D<float> m(n, n, n);
+	m.copyFromRowMajor(&rowmajor[0]);
+	cout << "    MortonArray3D:            " << rayMarch_Perf(m, n, rays, sum) << " ms" << endl;
+	TiledArray_RayMarch_Perf<2, MORTON_TILE_MORTON>(rowmajor, n, rays, sum);
+	TiledArray_RayMarch_Perf<2, MORTON_TILE_ROWMAJOR>(rowmajor, n, rays, sum);
+	TiledArray_RayMarch_Perf<3, MORTON_TILE_MORTON>(rowmajor, n, rays, sum);
+	TiledArray_RayMarch_Perf<3, MORTON_TILE_ROWMAJOR>(rowmajor, n, rays, sum);
+	TiledArray_RayMarch_Perf<4, MORTON_TILE_MORTON>(rowmajor, n, rays, sum);
+	TiledArray_RayMarch_Perf<4, MORTON_TILE_ROWMAJOR>(rowmajor, n, rays, sum);
+	running_sums.push_back((uint_fast64_t)sum);
+}
+
+static void checkOctree() {
+	printf("++ Checking correctness of linear octree ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	// flat, dense point set so we get leaves on many different levels
+	vector<uint_fast64_t> codes;
+	for (size_t i = 0; i < 20000; i++) {
+		codes.push_back(morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(rand_cmwc() % 1024, rand_cmwc() % 1024, rand_cmwc() % 64));
+	}
+	sort(codes.begin(), codes.end());
+	MortonOctree tree;
+	tree.build(&codes[0], codes.size(), 16);
+	if (morton3D_Octree_Parent(MortonOctreeNode(0, 0)) != MortonOctreeNode(0, 0)) {
+		cout << endl << "    The root is not its own parent" << endl;
+		ok = false;
+	}
+
+	for (size_t i = 0; i < tree.size(); i++) {
+		MortonOctreeNode n = tree.leaf(i);
+		// leaves are sorted and disjoint
+		if (i + 1 < tree.size() && morton3D_Octree_LastDescendant(n) >= tree.leaf(i + 1).code) {
+			cout << endl << "    Leaf " << i << " overlaps its successor" << endl;
+			ok = false;
+		}
+		// leaves respect the split criterion
+		size_t count = upper_bound(codes.begin(), codes.end(), morton3D_Octree_LastDescendant(n)) - lower_bound(codes.begin(), codes.end(), n.code);
+		if (count == 0 || (count > 16 && n.level != MORTON_OCTREE_MAXLEVEL)) {
+			cout << endl << "    Leaf " << i << " holds " << count << " points" << endl;
+			ok = false;
+		}
+		// node arithmetic
+		if (n.level > 0) {
+			unsigned int c = morton3D_Octree_ChildIndex(n);
+			if (morton3D_Octree_Child(morton3D_Octree_Parent(n), c) != n || morton3D_Octree_Sibling(n, c) != n
+				|| morton3D_Octree_Parent(morton3D_Octree_Sibling(n, (c + 1) % 8)) != morton3D_Octree_Parent(n)) {
+				cout << endl << "    Incorrect parent/child/sibling of leaf " << i << endl;
+				ok = false;
+			}
+		}
+		if (tree.find(n) != (ptrdiff_t)i) {
+			cout << endl << "    Leaf " << i << " not found" << endl;
+			ok = false;
+		}
+	}
+	// point location
+	for (size_t i = 0; i < codes.size(); i++) {
+		ptrdiff_t l = tree.locate(codes[i]);
+		if (l < 0 || !morton3D_Octree_Contains(tree.leaf(l), codes[i])) {
+			cout << endl << "    Incorrect location of code " << codes[i] << endl;
+			ok = false;
+		}
+	}
+	if (tree.locate(morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(4096, 0, 0)) != -1) {
+		cout << endl << "    Code in empty region was located in a leaf" << endl;
+		ok = false;
+	}
+	if (tree.locate((uint_fast64_t)1 << 63) != -1 || tree.locate(~(uint_fast64_t)0) != -1) {
+		cout << endl << "    Code with bit 63 set was located in a leaf" << endl;
+		ok = false;
+	}
+	size_t begin, end;
+	tree.leafRange(MortonOctreeNode(0, 0), begin, end);
+	if (begin != 0 || end != tree.size()) {
+		cout << endl << "    Root does not span all leaves" << endl;
+		ok = false;
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void Octree_Perf(size_t n) {
+	cout << "++ Building linear octree from " << n << " random sorted morton codes" << endl;
+	init_randcmwc(42);
+	vector<uint_fast64_t> codes(n);
+	for (size_t i = 0; i < n; i++) {
+		codes[i] = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff);
+	}
+	sort(codes.begin(), codes.end());
+
+	MortonOctree tree;
+	Timer build_timer = Timer();
+	build_timer.start();
+	tree.build(&codes[0], n, 64);
+	build_timer.stop();
+
+	Timer locate_timer = Timer();
+	uint_fast64_t runningsum = 0;
+	locate_timer.start();
+	for (size_t i = 0; i < n; i++) {
+		runningsum += tree.locate(codes[(i * 7919) % n]);
+	}
+	locate_timer.stop();
+	running_sums.push_back(runningsum);
+
+	cout << "    Build:          " << std::fixed << std::setprecision(3) << build_timer.elapsed_time_milliseconds << " ms (" << tree.size() << " leaves, "
+		<< (double)tree.memoryUsage() / tree.size() << " bytes per leaf)" << endl;
+	cout << "    Point location: " << locate_timer.elapsed_time_milliseconds << " ms" << endl;
+}
+
+static void checkHashMap() {
+	printf("++ Checking correctness of morton hash map ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	MortonHashMap<uint_fast64_t, uint_fast32_t> hashmap;
+	map<uint_fast64_t, uint_fast32_t> control;
+	for (uint_fast32_t i = 0; i < 50000; i++) {
+		uint_fast64_t key = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(rand_cmwc() % 64, rand_cmwc() % 64, rand_cmwc() % 64);
+		if (rand_cmwc() % 4 == 0) {
+			if (hashmap.erase(key) != (control.erase(key) == 1)) { ok = false; }
+		}
+		else {
+			if (hashmap.insert(key, i) != (control.find(key) == control.end())) { ok = false; }
+			control[key] = i;
+		}
+	}
+	if (hashmap.size() != control.size()) { ok = false; }
+	for (map<uint_fast64_t, uint_fast32_t>::iterator it = control.begin(); it != control.end(); ++it) {
+		const uint_fast32_t* v = hashmap.find(it->first);
+		if (v == 0 || *v != it->second) { ok = false; }
+	}
+	// batch lookup of every cell in the domain
+	vector<uint_fast64_t> keys(64 * 64 * 64);
+	vector<uint_fast32_t> values(keys.size());
+	for (size_t i = 0; i < keys.size(); i++) { keys[i] = i; }
+	if (hashmap.lookup(&keys[0], keys.size(), &values[0], 0xFFFFFFFF) != control.size()) { ok = false; }
+	for (size_t i = 0; i < keys.size(); i++) {
+		bool present = control.find(keys[i]) != control.end();
+		if (present != (values[i] != 0xFFFFFFFF) || (present && values[i] != control[keys[i]])) { ok = false; }
+	}
+	if (!ok) { cout << endl << "    Hash map contents do not match std::map" << endl; }
+	// the all-ones code is a valid 2D 32-bit key, next to the empty slot marker
+	MortonHashMap<uint32_t, uint_fast32_t> map2D;
+	const uint32_t corner = morton2D_32_Encode_magicbits(0xFFFF, 0xFFFF);
+	bool edge_ok = corner == 0xFFFFFFFF && !map2D.contains(corner) && map2D.find(corner) == 0;
+	for (uint32_t i = 0; i < 1000; i++) { map2D.insert(i * 7919u, i); }
+	edge_ok &= map2D.insert(corner, 5) && !map2D.insert(corner, 6) && map2D.size() == 1001;
+	for (uint32_t i = 1000; i < 5000; i++) { map2D.insert(i * 7919u, i); } // rehashes keep the key
+	edge_ok &= map2D.contains(corner) && *map2D.find(corner) == 6 && map2D[corner] == 6 && map2D.size() == 5001;
+	uint_fast32_t found = 0;
+	edge_ok &= map2D.lookup(&corner, 1, &found, 0) == 1 && found == 6;
+	size_t visited = 0;
+	map2D.forEach([&](const uint32_t key, const uint_fast32_t v) { visited += (key == corner && v == 6) ? 1000000 : 1; });
+	edge_ok &= visited == 1000000 + 5000;
+	edge_ok &= map2D.erase(corner) && !map2D.erase(corner) && !map2D.contains(corner) && map2D.size() == 5000;
+	for (uint32_t i = 0; i < 5000; i++) { edge_ok &= map2D.find(i * 7919u) != 0 && *map2D.find(i * 7919u) == i; }
+	map2D[corner] = 9;
+	edge_ok &= map2D.size() == 5001 && *map2D.find(corner) == 9;
+	map2D.clear();
+	edge_ok &= map2D.empty() && !map2D.contains(corner);
+	if (!edge_ok) { cout << endl << "    Incorrect handling of the all-ones key" << endl; }
+	ok &= edge_ok;
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Occupancy grid on a sphere shell, queried with a 3x3x3 stencil around every occupied cell (in Z-order)
+static void HashMap_Perf(size_t cells) {
+	cout << "++ Stencil lookups in a sparse occupancy grid of " << cells << " cells" << endl;
+	init_randcmwc(42);
+	vector<uint_fast64_t> keys;
+	const double r = sqrt((double)cells / 12.0);
+	while (keys.size() < cells) {
+		double t = (rand_cmwc() % 100000) / 100000.0 * 6.2831853, p = acos(1.0 - 2.0 * ((rand_cmwc() % 100000) / 100000.0));
+		keys.push_back(morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>((uint_fast32_t)(1024 + r * sin(p) * cos(t)), (uint_fast32_t)(1024 + r * sin(p) * sin(t)), (uint_fast32_t)(1024 + r * cos(p))));
+	}
+	sort(keys.begin(), keys.end());
+	vector<uint_fast32_t> values(cells, 1);
+	vector<uint_fast64_t> stencils(27 * cells);
+	for (size_t i = 0, s = 0; i < cells; i++) {
+		uint_fast32_t x, y, z;
+		morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(keys[i], x, y, z);
+		for (int dx = -1; dx <= 1; dx++) for (int dy = -1; dy <= 1; dy++) for (int dz = -1; dz <= 1; dz++) {
+			stencils[s++] = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(x + dx, y + dy, z + dz);
+		}
+	}
+
+	MortonHashMap<uint_fast64_t, uint_fast32_t> hashmap;
+	unordered_map<uint_fast64_t, uint_fast32_t> control;
+	Timer insert_timer = Timer(), control_insert_timer = Timer();
+	insert_timer.start();
+	hashmap.insert(&keys[0], &values[0], cells);
+	insert_timer.stop();
+	control_insert_timer.start();
+	for (size_t i = 0; i < cells; i++) { control[keys[i]] = values[i]; }
+	control_insert_timer.stop();
+
+	Timer lookup_timer = Timer(), control_lookup_timer = Timer();
+	vector<uint_fast32_t> found(stencils.size());
+	uint_fast64_t runningsum = 0;
+	lookup_timer.start();
+	runningsum += hashmap.lookup(&stencils[0], stencils.size(), &found[0], 0);
+	lookup_timer.stop();
+	control_lookup_timer.start();
+	for (size_t j = 0; j < stencils.size(); j++) { runningsum += control.count(stencils[j]); }
+	control_lookup_timer.stop();
+	running_sums.push_back(runningsum);
+	cout << "    MortonHashMap:      insert " << std::fixed << std::setprecision(3) << insert_timer.elapsed_time_milliseconds << " ms, stencil lookups " << lookup_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    std::unordered_map: insert " << control_insert_timer.elapsed_time_milliseconds << " ms, stencil lookups " << control_lookup_timer.elapsed_time_milliseconds << " ms" << endl;
+}
+
+static uint_fast64_t dist2_3D(uint_fast64_t a, uint_fast64_t b) {
+	uint_fast32_t ax, ay, az, bx, by, bz;
+	morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(a, ax, ay, az);
+	morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(b, bx, by, bz);
+	return morton3D_KNN_AxisDist(ax, bx) + morton3D_KNN_AxisDist(ay, by) + morton3D_KNN_AxisDist(az, bz);
+}
+
+// Compare a kNN result against brute force: same distances, and the indices match the distances
+static bool checkKNNResult(const vector<uint_fast64_t>& codes, uint_fast64_t query, size_t exclude, size_t k, const size_t* indices, const uint_fast64_t* dist2) {
+	vector<uint_fast64_t> all;
+	for (size_t i = 0; i < codes.size(); i++) {
+		if (i != exclude) { all.push_back(dist2_3D(query, codes[i])); }
+	}
+	sort(all.begin(), all.end());
+	for (size_t j = 0; j < k; j++) {
+		if (j >= all.size()) {
+			if (indices[j] != codes.size() || dist2[j] != MORTON_KNN_NONE) { return false; }
+		}
+		else if (dist2[j] != all[j] || indices[j] == exclude || dist2_3D(query, codes[indices[j]]) != dist2[j]) { return false; }
+	}
+	return true;
+}
+
+static void checkKNN() {
+	printf("++ Checking correctness of morton kNN search ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	// clustered points with duplicates, plus a few far away ones
+	vector<uint_fast64_t> codes;
+	for (size_t i = 0; i < 20000; i++) {
+		uint_fast32_t cx = (i % 7) * 50000, cy = (i % 5) * 1000, cz = 0;
+		codes.push_back(morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(cx + rand_cmwc() % 300, cy + rand_cmwc() % 300, cz + rand_cmwc() % 40));
+	}
+	for (size_t i = 0; i < 20; i++) {
+		codes.push_back(morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff));
+	}
+	sort(codes.begin(), codes.end());
+	const size_t k = 10, nq = 300;
+	vector<uint_fast64_t> queries;
+	for (size_t i = 0; i < nq; i++) {
+		queries.push_back((i % 2) ? codes[rand_cmwc() % codes.size()] + 1 : morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(rand_cmwc() % 400000, rand_cmwc() % 6000, rand_cmwc() % 100));
+	}
+	vector<size_t> indices(nq * k);
+	vector<uint_fast64_t> dist2(nq * k);
+	MortonKNN knn;
+	knn.build(&codes[0], codes.size());
+	knn.query(&queries[0], nq, k, &indices[0], &dist2[0]);
+	for (size_t i = 0; i < nq; i++) {
+		if (!checkKNNResult(codes, queries[i], codes.size(), k, &indices[i * k], &dist2[i * k])) {
+			cout << endl << "    Incorrect neighbours of query code " << queries[i] << endl;
+			ok = false;
+		}
+	}
+	const size_t first = 12345;
+	knn.queryPoints(first, nq, k, &indices[0], &dist2[0]);
+	for (size_t i = 0; i < nq; i++) {
+		if (!checkKNNResult(codes, codes[first + i], first + i, k, &indices[i * k], &dist2[i * k])) {
+			cout << endl << "    Incorrect neighbours of point " << first + i << endl;
+			ok = false;
+		}
+	}
+	// fewer points than neighbours asked for
+	vector<uint_fast64_t> few(codes.begin(), codes.begin() + 5);
+	knn.build(&few[0], few.size());
+	knn.queryPoints(0, few.size(), k, &indices[0], &dist2[0]);
+	for (size_t i = 0; i < few.size(); i++) {
+		if (!checkKNNResult(few, few[i], i, k, &indices[i * k], &dist2[i * k])) {
+			cout << endl << "    Incorrect neighbours in a set of " << few.size() << " points" << endl;
+			ok = false;
+		}
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Plain kd-tree to compare against: median split, axes in turn, implicit nodes over the reordered points
+// (node i has children 2i and 2i + 1, splits[i] is its split coordinate)
+struct KdTree {
+	struct Point { uint_fast32_t c[3]; size_t id; };
+	vector<Point> points;
+	vector<uint_fast32_t> splits;
+	static const size_t LEAFSIZE = 16;
+
+	void build(const vector<uint_fast64_t>& codes) {
+		points.resize(codes.size());
+		for (size_t i = 0; i < codes.size(); i++) {
+			morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(codes[i], points[i].c[0], points[i].c[1], points[i].c[2]);
+			points[i].id = i;
+		}
+		splits.assign(4 * (points.size() / LEAFSIZE) + 2, 0);
+		buildNode(1, 0, points.size(), 0);
+	}
+
+	void buildNode(size_t node, size_t begin, size_t end, unsigned int axis) {
+		if (end - begin <= LEAFSIZE) { return; }
+		const size_t mid = (begin + end) / 2;
+		nth_element(points.begin() + begin, points.begin() + mid, points.begin() + end,
+			[axis](const Point& a, const Point& b) { return a.c[axis] < b.c[axis]; });
+		splits[node] = points[mid].c[axis];
+		buildNode(2 * node, begin, mid, (axis + 1) % 3);
+		buildNode(2 * node + 1, mid, end, (axis + 1) % 3);
+	}
+
+	void search(size_t node, size_t begin, size_t end, unsigned int axis, MortonKNNQuery& q) const {
+		if (end - begin <= LEAFSIZE) {
+			for (size_t i = begin; i < end; i++) {
+				const Point& p = points[i];
+				if (p.id != q.exclude) { q.offer(p.id, morton3D_KNN_AxisDist(q.x, p.c[0]) + morton3D_KNN_AxisDist(q.y, p.c[1]) + morton3D_KNN_AxisDist(q.z, p.c[2])); }
+			}
+			return;
+		}
+		const size_t mid = (begin + end) / 2;
+		const uint_fast32_t split = splits[node], qc = (axis == 0) ? q.x : ((axis == 1) ? q.y : q.z);
+		const uint_fast64_t d = morton3D_KNN_AxisDist(qc, split);
+		if (qc < split) {
+			search(2 * node, begin, mid, (axis + 1) % 3, q);
+			if (d < q.worst()) { search(2 * node + 1, mid, end, (axis + 1) % 3, q); }
+		}
+		else {
+			search(2 * node + 1, mid, end, (axis + 1) % 3, q);
+			if (d < q.worst()) { search(2 * node, begin, mid, (axis + 1) % 3, q); }
+		}
+	}
+
+	void query(uint_fast64_t code, size_t exclude, size_t k, size_t* indices, uint_fast64_t* dist2) const {
+		MortonKNNQuery q;
+		morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(code, q.x, q.y, q.z);
+		q.exclude = exclude;
+		q.k = k;
+		q.found = 0;
+		q.indices = indices;
+		q.dist2 = dist2;
+		search(1, 0, points.size(), 0, q);
+	}
+};
+
+// surface: points on a noisy sphere, otherwise spread uniformly through the whole volume
+static void KNN_Perf(size_t n, const bool surface) {
+	const size_t k = 8, chunk = 1000000;
+	cout << "++ " << k << " nearest neighbours of every point in a " << n << " point cloud (" << (surface ? "noisy sphere" : "uniform volume") << ")" << endl;
+	init_randcmwc(42);
+	vector<uint_fast64_t> codes(n);
+	for (size_t i = 0; i < n; i++) {
+		if (!surface) {
+			codes[i] = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff);
+			continue;
+		}
+		double u = (rand_cmwc() % 100000) / 50000.0 - 1.0, phi = (rand_cmwc() % 100000) / 100000.0 * 6.283185307179586;
+		double radius = 500000.0 + rand_cmwc() % 64, s = sqrt(1.0 - u * u);
+		codes[i] = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>((uint_fast32_t)(1048576 + radius * s * cos(phi)),
+			(uint_fast32_t)(1048576 + radius * s * sin(phi)), (uint_fast32_t)(1048576 + radius * u));
+	}
+	MortonKNN knn;
+	Timer sort_timer = Timer();
+	sort_timer.start();
+	sort(codes.begin(), codes.end());
+	knn.build(&codes[0], n);
+	sort_timer.stop();
+	KdTree kdtree;
+	Timer kdtree_build_timer = Timer();
+	kdtree_build_timer.start();
+	kdtree.build(codes);
+	kdtree_build_timer.stop();
+
+	vector<size_t> indices(chunk * k);
+	vector<uint_fast64_t> dist2(chunk * k);
+	uint_fast64_t runningsum = 0;
+	Timer morton_timer = Timer();
+	Timer kdtree_timer = Timer();
+	for (size_t first = 0; first < n; first += chunk) {
+		const size_t count = min(chunk, n - first);
+		morton_timer.start();
+		knn.queryPoints(first, count, k, &indices[0], &dist2[0]);
+		morton_timer.stop();
+		for (size_t i = 0; i < count * k; i += k) { runningsum += dist2[i + k - 1]; }
+		kdtree_timer.start();
+#pragma omp parallel for schedule(dynamic, 256)
+		for (long long i = 0; i < (long long)count; i++) {
+			kdtree.query(codes[first + i], first + i, k, &indices[i * k], &dist2[i * k]);
+		}
+		kdtree_timer.stop();
+		for (size_t i = 0; i < count * k; i += k) { runningsum -= dist2[i + k - 1]; }
+	}
+	running_sums.push_back(runningsum); // 0 if both agree on every k-th distance
+	cout << "    Morton order: sort + build " << std::fixed << std::setprecision(3) << sort_timer.elapsed_time_milliseconds << " ms, queries " << morton_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    kd-tree:      build        " << kdtree_build_timer.elapsed_time_milliseconds << " ms, queries " << kdtree_timer.elapsed_time_milliseconds << " ms" << endl;
+}
+
+template <typename real>
+static bool checkQuantize(const unsigned int bits) {
+	bool ok = true;
+	const size_t n = 10000;
+	const real box_min[3] = { (real)-10.5, (real)0, (real)1000 }, box_max[3] = { (real)20.25, (real)1, (real)1000.5 };
+	vector<real> x(n), y(n), z(n), xyz(3 * n);
+	for (size_t i = 0; i < n; i++) {
+		// a few points outside the box, to test clamping
+		x[i] = box_min[0] + (box_max[0] - box_min[0]) * ((real)(rand_cmwc() % 1100000) / (real)1000000 - (real)0.05);
+		y[i] = box_min[1] + (box_max[1] - box_min[1]) * ((real)(rand_cmwc() % 1000000) / (real)1000000);
+		z[i] = box_min[2] + (box_max[2] - box_min[2]) * ((real)(rand_cmwc() % 1000000) / (real)1000000);
+		xyz[3 * i] = x[i]; xyz[3 * i + 1] = y[i]; xyz[3 * i + 2] = z[i];
+	}
+	vector<uint_fast64_t> codes(n), codes_aos(n), codes_again(n);
+	morton3D_QuantizeEncode<real>(&x[0], &y[0], &z[0], n, box_min, box_max, bits, &codes[0]);
+	morton3D_QuantizeEncodePoints<real>(&xyz[0], n, box_min, box_max, bits, &codes_aos[0]);
+	ok &= codes == codes_aos;
+	vector<real> cx(n), cy(n), cz(n), cxyz(3 * n);
+	morton3D_DecodeCellCentres<real>(&codes[0], n, box_min, box_max, bits, &cx[0], &cy[0], &cz[0]);
+	morton3D_DecodeCellCentrePoints<real>(&codes[0], n, box_min, box_max, bits, &cxyz[0]);
+	// cell centres encode to the same cell
+	morton3D_QuantizeEncode<real>(&cx[0], &cy[0], &cz[0], n, box_min, box_max, bits, &codes_again[0]);
+	ok &= codes == codes_again;
+	const uint_fast32_t maxcell = (1u << bits) - 1;
+	for (size_t i = 0; i < n; i++) {
+		ok &= cxyz[3 * i] == cx[i] && cxyz[3 * i + 1] == cy[i] && cxyz[3 * i + 2] == cz[i];
+		// within one cell of the exact (double, divide) cell index, and clamped to the box
+		uint_fast32_t qx, qy, qz;
+		morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t>(codes[i], qx, qy, qz);
+		const double exact = floor(((double)x[i] - box_min[0]) / ((double)box_max[0] - box_min[0]) * (maxcell + 1.0));
+		const double clamped = min((double)maxcell, max(0.0, exact));
+		ok &= qx <= maxcell && qy <= maxcell && qz <= maxcell && fabs((double)qx - clamped) <= 1.0;
+	}
+	// 2D, with the full 32 bits per axis for double
+	const unsigned int bits2 = (sizeof(real) == 8) ? 32 : 2 * bits;
+	morton2D_QuantizeEncode<real>(&x[0], &y[0], n, box_min, box_max, bits2, &codes[0]);
+	morton2D_QuantizeEncodePoints<real>(&xyz[0], n, box_min, box_max, bits2, &codes_aos[0]); // xy of (x, y, z) points: only compare first
+	ok &= codes[0] == morton2D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(MortonQuantizer<real, 2>(box_min, box_max, bits2).quantize(x[0], 0), MortonQuantizer<real, 2>(box_min, box_max, bits2).quantize(y[0], 1));
+	morton2D_DecodeCellCentres<real>(&codes[0], n, box_min, box_max, bits2, &cx[0], &cy[0]);
+	morton2D_QuantizeEncode<real>(&cx[0], &cy[0], n, box_min, box_max, bits2, &codes_again[0]);
+	if (sizeof(real) == 8) { ok &= codes == codes_again; }
+	vector<real> cxy(2 * n);
+	morton2D_DecodeCellCentrePoints<real>(&codes[0], n, box_min, box_max, bits2, &cxy[0]);
+	for (size_t i = 0; i < n; i++) { ok &= cxy[2 * i] == cx[i] && cxy[2 * i + 1] == cy[i]; }
+	return ok;
+}
+
+static void checkQuantizeCorrectness() {
+	printf("++ Checking correctness of float/double quantization ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	ok &= checkQuantize<float>(10);
+	ok &= checkQuantize<float>(16);
+	ok &= checkQuantize<double>(21);
+	ok &= checkQuantize<double>(3);
+	// degenerate box: everything in cell 0
+	const float flat_min[3] = { 1, 1, 1 }, flat_max[3] = { 1, 2, 3 }, p[3] = { 1, 1.5f, 5 };
+	uint_fast64_t code;
+	morton3D_QuantizeEncodePoints<float>(p, 1, flat_min, flat_max, 21, &code);
+	ok &= code == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(0, 1 << 20, (1 << 21) - 1);
+	// NaN: cell 0
+	const float unit_min[3] = { 0, 0, 0 }, unit_max[3] = { 1, 1, 1 }, nan_p[3] = { NAN, 0.5f, -NAN };
+	morton3D_QuantizeEncodePoints<float>(nan_p, 1, unit_min, unit_max, 21, &code);
+	ok &= code == morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(0, 1 << 20, 0);
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void Quantize_Perf(size_t n) {
+	cout << "++ Quantizing and encoding " << n << " float points (21 bits per axis)" << endl;
+	init_randcmwc(42);
+	vector<float> x(n), y(n), z(n);
+	for (size_t i = 0; i < n; i++) {
+		x[i] = (float)(rand_cmwc() % 1000000) * 0.001f;
+		y[i] = (float)(rand_cmwc() % 1000000) * 0.002f;
+		z[i] = (float)(rand_cmwc() % 1000000) * 0.003f - 50.0f;
+	}
+	const float box_min[3] = { 0, 0, -50 }, box_max[3] = { 1000, 2000, 2950 };
+	vector<uint_fast64_t> codes(n);
+	uint_fast64_t runningsum = 0;
+
+	// the usual caller-side version: divide per coordinate, then the default encoder
+	Timer naive_timer = Timer();
+	naive_timer.start();
+	for (unsigned int t = 0; t < times; t++) {
+		for (size_t i = 0; i < n; i++) {
+			const uint_fast32_t qx = (uint_fast32_t)min(2097151.0f, max(0.0f, (x[i] - box_min[0]) / (box_max[0] - box_min[0]) * 2097152.0f));
+			const uint_fast32_t qy = (uint_fast32_t)min(2097151.0f, max(0.0f, (y[i] - box_min[1]) / (box_max[1] - box_min[1]) * 2097152.0f));
+			const uint_fast32_t qz = (uint_fast32_t)min(2097151.0f, max(0.0f, (z[i] - box_min[2]) / (box_max[2] - box_min[2]) * 2097152.0f));
+			codes[i] = morton3D_64_encode(qx, qy, qz);
+		}
+		runningsum += codes[t % n];
+	}
+	naive_timer.stop();
+
+	Timer fused_timer = Timer();
+	fused_timer.start();
+	for (unsigned int t = 0; t < times; t++) {
+		morton3D_QuantizeEncode<float>(&x[0], &y[0], &z[0], n, box_min, box_max, 21, &codes[0]);
+		runningsum += codes[t % n];
+	}
+	fused_timer.stop();
+
+	Timer decode_timer = Timer();
+	decode_timer.start();
+	for (unsigned int t = 0; t < times; t++) {
+		morton3D_DecodeCellCentres<float>(&codes[0], n, box_min, box_max, 21, &x[0], &y[0], &z[0]);
+		runningsum += (uint_fast64_t)x[t % n];
+	}
+	decode_timer.stop();
+	running_sums.push_back(runningsum);
+
+	cout << "    Divide + morton3D_64_encode:  " << std::fixed << std::setprecision(3) << naive_timer.elapsed_time_milliseconds / times << " ms" << endl;
+	cout << "    morton3D_QuantizeEncode:      " << fused_timer.elapsed_time_milliseconds / times << " ms" << endl;
+	cout << "    morton3D_DecodeCellCentres:   " << decode_timer.elapsed_time_milliseconds / times << " ms" << endl;
+}
+
+static void checkRadixSort() {
+	printf("++ Checking correctness of morton radix sort ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	const size_t sizes[4] = { 0, 1, 1000, 300000 };
+	for (size_t s = 0; s < 4; s++) {
+		const size_t n = sizes[s];
+		vector<uint_fast64_t> keys(n), expected(n);
+		vector<uint32_t> values(n);
+		for (size_t i = 0; i < n; i++) {
+			// few distinct high digits, so some passes are skipped and equal keys show up
+			keys[i] = morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x3f, rand_cmwc() % 3);
+			values[i] = (uint32_t)i;
+		}
+		vector<uint_fast64_t> original(keys);
+		expected = keys;
+		sort(expected.begin(), expected.end());
+		vector<uint_fast64_t> keys_only(keys);
+		morton_RadixSort<uint_fast64_t>(keys_only.empty() ? 0 : &keys_only[0], n, 63);
+		morton_RadixSortPairs<uint_fast64_t, uint32_t>(keys.empty() ? 0 : &keys[0], values.empty() ? 0 : &values[0], n, 63);
+		ok &= keys_only == expected && keys == expected;
+		for (size_t i = 0; i < n; i++) {
+			ok &= original[values[i]] == keys[i];
+			if (i > 0 && keys[i] == keys[i - 1]) { ok &= values[i] > values[i - 1]; } // stable
+		}
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Random small boxes: clustered around a few centres, with some exact duplicates
+static void makeBoxes(size_t n, vector<float>& bounds) {
+	bounds.resize(n * 6);
+	for (size_t i = 0; i < n; i++) {
+		float* b = &bounds[i * 6];
+		if (i > 0 && rand_cmwc() % 10 == 0) { std::copy(b - 6, b, b); continue; }
+		const float cx = (float)(rand_cmwc() % 4) * 100.0f, cy = (float)(rand_cmwc() % 3) * 50.0f;
+		for (int a = 0; a < 3; a++) {
+			const float c = ((a == 0) ? cx : (a == 1) ? cy : 0.0f) + (float)(rand_cmwc() % 100000) / 1000.0f;
+			const float r = (float)(rand_cmwc() % 1000) / 1000.0f;
+			b[a] = c - r;
+			b[3 + a] = c + r;
+		}
+	}
+}
+
+static bool checkLBVHTree(const MortonLBVH& bvh, const vector<float>& bounds) {
+	const size_t n = bvh.size();
+	if (bvh.nodeCount() != ((n == 0) ? 0 : 2 * n - 1)) { return false; }
+	vector<int> seen(n, 0), reached(bvh.nodeCount(), 0);
+	for (size_t i = 0; i < bvh.nodeCount(); i++) {
+		const MortonBVHNode& node = bvh.node(i);
+		if (MortonLBVH::isLeaf(node) != (i + 1 >= n)) { return false; }
+		if (MortonLBVH::isLeaf(node)) {
+			if (node.left >= n) { return false; }
+			seen[node.left]++;
+			for (int a = 0; a < 3; a++) {
+				if (node.lo[a] != bounds[node.left * 6 + a] || node.hi[a] != bounds[node.left * 6 + 3 + a]) { return false; }
+			}
+			continue;
+		}
+		if (node.left >= bvh.nodeCount() || node.right >= bvh.nodeCount() || node.left == 0 || node.right == 0) { return false; }
+		reached[node.left]++;
+		reached[node.right]++;
+		const MortonBVHNode& l = bvh.node(node.left);
+		const MortonBVHNode& r = bvh.node(node.right);
+		for (int a = 0; a < 3; a++) {
+			if (node.lo[a] != min(l.lo[a], r.lo[a]) || node.hi[a] != max(l.hi[a], r.hi[a])) { return false; }
+		}
+	}
+	// every node except the root has exactly one parent, every primitive sits in one leaf
+	for (size_t i = 1; i < reached.size(); i++) { if (reached[i] != 1) { return false; } }
+	for (size_t i = 0; i < n; i++) { if (seen[i] != 1) { return false; } }
+	return true;
+}
+
+static void checkLBVH() {
+	printf("++ Checking correctness of linear BVH ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	const size_t sizes[5] = { 0, 1, 2, 17, 20000 };
+	for (size_t s = 0; s < 5; s++) {
+		vector<float> bounds;
+		makeBoxes(sizes[s], bounds);
+		MortonLBVH bvh;
+		bvh.build(bounds.empty() ? 0 : &bounds[0], sizes[s]);
+		if (!checkLBVHTree(bvh, bounds)) {
+			cout << endl << "    Invalid tree for " << sizes[s] << " primitives" << endl;
+			ok = false;
+			continue;
+		}
+		// box queries against brute force
+		for (size_t q = 0; q < 50; q++) {
+			float box[6];
+			for (int a = 0; a < 3; a++) {
+				box[a] = (float)(rand_cmwc() % 500) - 50.0f;
+				box[3 + a] = box[a] + (float)(rand_cmwc() % 20);
+			}
+			vector<uint32_t> found, expected;
+			bvh.overlapping(box, [&found](uint32_t p) { found.push_back(p); });
+			for (size_t i = 0; i < sizes[s]; i++) {
+				const float* b = &bounds[i * 6];
+				if (b[0] <= box[3] && b[1] <= box[4] && b[2] <= box[5] && b[3] >= box[0] && b[4] >= box[1] && b[5] >= box[2]) { expected.push_back((uint32_t)i); }
+			}
+			sort(found.begin(), found.end());
+			if (found != expected) {
+				cout << endl << "    Incorrect box query for " << sizes[s] << " primitives" << endl;
+				ok = false;
+				break;
+			}
+		}
+	}
+	// all centroids equal: the tree is split on the primitive order alone
+	vector<float> same(1000 * 6, 1.0f);
+	MortonLBVH bvh;
+	bvh.build(&same[0], 1000);
+	ok &= checkLBVHTree(bvh, same);
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void LBVH_Perf(size_t n) {
+	cout << "++ Building a linear BVH over " << n << " primitives (small triangles on a sphere)" << endl;
+	init_randcmwc(42);
+	vector<float> bounds(n * 6);
+	for (size_t i = 0; i < n; i++) {
+		// random direction, then a box of up to 1/1000 of the radius around it
+		float d[3], len = 0;
+		do {
+			len = 0;
+			for (int a = 0; a < 3; a++) { d[a] = (float)(rand_cmwc() % 2000001) / 1000000.0f - 1.0f; len += d[a] * d[a]; }
+		} while (len > 1.0f || len < 0.01f);
+		len = sqrt(len);
+		for (int a = 0; a < 3; a++) {
+			const float c = 1000.0f * d[a] / len;
+			bounds[i * 6 + a] = c - (float)(rand_cmwc() % 1000) / 1000.0f;
+			bounds[i * 6 + 3 + a] = c + (float)(rand_cmwc() % 1000) / 1000.0f;
+		}
+	}
+	MortonLBVH bvh;
+	Timer timer = Timer();
+	timer.start();
+	bvh.build(&bounds[0], n);
+	timer.stop();
+
+	// sort alone, for reference
+	vector<uint_fast64_t> codes(n);
+	vector<uint32_t> order(n);
+	for (size_t i = 0; i < n; i++) {
+		codes[i] = morton3D_64_encode(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff);
+		order[i] = (uint32_t)i;
+	}
+	Timer sort_timer = Timer();
+	sort_timer.start();
+	morton_RadixSortPairs<uint_fast64_t, uint32_t>(&codes[0], &order[0], n, 63);
+	sort_timer.stop();
+	running_sums.push_back(bvh.node(0).left + codes[n / 2] + order[n / 3]);
+
+	cout << "    Build:      " << std::fixed << std::setprecision(3) << timer.elapsed_time_milliseconds << " ms ("
+		<< bvh.nodeCount() << " nodes, " << (double)bvh.memoryUsage() / (1024 * 1024) << " MB)" << endl;
+	cout << "    Radix sort: " << sort_timer.elapsed_time_milliseconds << " ms (of which the build uses one)" << endl;
+}
+
+static const char* POINTFILE_TEST_PATH = "libmorton_pointfile_test.tmp";
+
+// Positions of the codes inside the box, by brute force
+template<bool (*inbox)(const uint64_t, const uint64_t, const uint64_t)>
+static vector<size_t> boxQuery_naive(const vector<uint64_t>& codes, uint64_t lo, uint64_t hi) {
+	vector<size_t> result;
+	for (size_t i = 0; i < codes.size(); i++) {
+		if (inbox(codes[i], lo, hi)) { result.push_back(i); }
+	}
+	return result;
+}
+
+static void checkPointFile() {
+	printf("++ Checking correctness of memory-mapped point files ... ");
+	bool ok = true;
+	init_randcmwc(42);
+
+	// 3D: codes with two payload columns (position, id), written one by one and in batches
+	const size_t n = 100000;
+	vector<uint64_t> codes(n);
+	vector<uint32_t> ids(n);
+	for (size_t i = 0; i < n; i++) {
+		codes[i] = morton3D_64_encode(rand_cmwc() % 200, rand_cmwc() % 200, rand_cmwc() % 200);
+		ids[i] = (uint32_t)i;
+	}
+	morton_RadixSortPairs<uint64_t, uint32_t>(&codes[0], &ids[0], n, 63);
+	vector<float> positions(n * 3);
+	for (size_t i = 0; i < n; i++) {
+		uint_fast32_t x, y, z;
+		morton3D_64_decode(codes[i], x, y, z);
+		positions[i * 3] = (float)x; positions[i * 3 + 1] = (float)y; positions[i * 3 + 2] = (float)z;
+	}
+	const uint32_t column_sizes[2] = { 3 * sizeof(float), sizeof(uint32_t) };
+	MortonPointFileWriter writer;
+	ok &= writer.open(POINTFILE_TEST_PATH, 3, n, column_sizes, 2);
+	for (size_t i = 0; i < 1000; i++) {
+		const void* values[2] = { &positions[i * 3], &ids[i] };
+		ok &= writer.append(codes[i], values);
+	}
+	for (size_t i = 1000; i < n; i += 7777) {
+		const void* columns[2] = { &positions[i * 3], &ids[i] };
+		ok &= writer.append(&codes[i], std::min((size_t)7777, n - i), columns);
+	}
+	ok &= writer.close();
+
+	MortonPointFile file;
+	ok &= file.open(POINTFILE_TEST_PATH) && file.size() == n && file.dims() == 3 && file.columnCount() == 2;
+	if (ok) {
+		ok &= std::equal(codes.begin(), codes.end(), file.codes());
+		ok &= std::equal(positions.begin(), positions.end(), file.column<float>(0));
+		ok &= std::equal(ids.begin(), ids.end(), file.column<uint32_t>(1));
+		for (size_t t = 0; t < 1000; t++) {
+			const uint64_t key = (t % 2) ? codes[rand_cmwc() % n] : morton3D_64_encode(rand_cmwc() % 201, rand_cmwc() % 201, rand_cmwc() % 201);
+			const size_t from = rand_cmwc() % n;
+			ok &= file.lowerBound(key) == (size_t)(std::lower_bound(codes.begin(), codes.end(), key) - codes.begin());
+			ok &= file.lowerBound(key, from) == (size_t)(std::lower_bound(codes.begin() + from, codes.end(), key) - codes.begin());
+		}
+		for (size_t t = 0; t < 200; t++) {
+			uint_fast32_t lo[3], hi[3];
+			for (int a = 0; a < 3; a++) {
+				const uint_fast32_t p = rand_cmwc() % 210, q = rand_cmwc() % 210;
+				lo[a] = std::min(p, q);
+				hi[a] = (t % 4 == 0) ? lo[a] + rand_cmwc() % 8 : std::max(p, q);
+			}
+			vector<size_t> found;
+			file.boxQuery3D(lo, hi, [&](size_t i) { found.push_back(i); });
+			ok &= found == boxQuery_naive<morton3D_InBox<uint64_t> >(codes, morton3D_64_encode(lo[0], lo[1], lo[2]), morton3D_64_encode(hi[0], hi[1], hi[2]));
+		}
+	}
+	file.close();
+
+	// 2D: no payload, a small index stride
+	const size_t n2 = 50000;
+	vector<uint64_t> codes2(n2);
+	for (size_t i = 0; i < n2; i++) { codes2[i] = morton2D_64_encode(rand_cmwc() % 1000, rand_cmwc() % 1000); }
+	sort(codes2.begin(), codes2.end());
+	ok &= writer.open(POINTFILE_TEST_PATH, 2, n2, 0, 0, 64) && writer.append(&codes2[0], n2) && writer.close();
+	ok &= file.open(POINTFILE_TEST_PATH) && file.size() == n2 && file.dims() == 2;
+	if (ok) {
+		for (size_t t = 0; t < 200; t++) {
+			uint_fast32_t lo[2], hi[2];
+			for (int a = 0; a < 2; a++) {
+				const uint_fast32_t p = rand_cmwc() % 1000, q = rand_cmwc() % 1000;
+				lo[a] = std::min(p, q);
+				hi[a] = std::max(p, q);
+			}
+			vector<size_t> found;
+			file.boxQuery2D(lo, hi, [&](size_t i) { found.push_back(i); });
+			ok &= found == boxQuery_naive<morton2D_InBox<uint64_t> >(codes2, morton2D_64_encode(lo[0], lo[1]), morton2D_64_encode(hi[0], hi[1]));
+		}
+		size_t begin, end;
+		file.codeRange(codes2[100], codes2[200], begin, end);
+		ok &= begin <= 100 && end > 200 && codes2[begin] == codes2[100] && (end == n2 || codes2[end] > codes2[200]);
+	}
+	file.close();
+
+	// codes out of order, or fewer points than announced, leave no readable file
+	const uint64_t unsorted[3] = { 5, 9, 7 };
+	ok &= writer.open(POINTFILE_TEST_PATH, 3, 3) && !writer.append(unsorted, 3) && !writer.close();
+	ok &= !file.open(POINTFILE_TEST_PATH);
+	ok &= writer.open(POINTFILE_TEST_PATH, 3, 4) && writer.append(unsorted, 2) && !writer.close();
+	ok &= !file.open(POINTFILE_TEST_PATH);
+	// a file with columns needs their values
+	const uint32_t column_size = 4;
+	ok &= writer.open(POINTFILE_TEST_PATH, 3, 2, &column_size, 1) && !writer.append(unsorted[0]) && !writer.append(unsorted, 2) && !writer.close();
+	ok &= !file.open(POINTFILE_TEST_PATH);
+	remove(POINTFILE_TEST_PATH);
+	ok &= !file.open(POINTFILE_TEST_PATH);
+
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void PointFile_Perf(size_t n) {
+	cout << "++ Storing " << n << " sorted 3D points (one 12-byte payload column) in a memory-mapped point file" << endl;
+	init_randcmwc(42);
+	vector<uint64_t> codes(n);
+	vector<uint32_t> order(n);
+	for (size_t i = 0; i < n; i++) {
+		codes[i] = morton3D_64_encode(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff);
+		order[i] = (uint32_t)i;
+	}
+	// what the file saves at startup: encoding is done, but the sort has to be redone
+	Timer sort_timer = Timer();
+	sort_timer.start();
+	morton_RadixSortPairs<uint64_t, uint32_t>(&codes[0], &order[0], n, 63);
+	sort_timer.stop();
+	vector<float> positions(n * 3);
+	for (size_t i = 0; i < n * 3; i++) { positions[i] = (float)(i % 1000); }
+
+	const uint32_t column_size = 3 * sizeof(float);
+	const void* column = &positions[0];
+	Timer write_timer = Timer();
+	write_timer.start();
+	MortonPointFileWriter writer;
+	bool ok = writer.open(POINTFILE_TEST_PATH, 3, n, &column_size, 1) && writer.append(&codes[0], n, &column) && writer.close();
+	write_timer.stop();
+
+	Timer open_timer = Timer();
+	open_timer.start();
+	MortonPointFile file;
+	ok &= file.open(POINTFILE_TEST_PATH);
+	open_timer.stop();
+
+	// boxes of 1/16 of the extent per axis
+	const size_t queries = 1000;
+	size_t found = 0;
+	float sum = 0;
+	Timer query_timer = Timer();
+	query_timer.start();
+	for (size_t q = 0; q < queries && ok; q++) {
+		uint_fast32_t lo[3], hi[3];
+		for (int a = 0; a < 3; a++) { lo[a] = rand_cmwc() % (0x200000 - 0x20000); hi[a] = lo[a] + 0x20000 - 1; }
+		const float* p = file.column<float>(0);
+		file.boxQuery3D(lo, hi, [&](size_t i) { found++; sum += p[i * 3]; });
+	}
+	query_timer.stop();
+	file.close();
+	remove(POINTFILE_TEST_PATH);
+	running_sums.push_back(found + (uint_fast64_t)sum + order[n / 2]);
+
+	if (!ok) { cout << "    Could not write or map " << POINTFILE_TEST_PATH << endl; return; }
+	cout << "    Radix sort:  " << std::fixed << std::setprecision(3) << sort_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    Write:       " << write_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    Open (map):  " << open_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    Box queries: " << query_timer.elapsed_time_milliseconds / queries << " ms per box (" << (double)found / queries << " points per box)" << endl;
+}
+
+static const char* EXTSORT_TEST_PREFIX = "libmorton_extsort_test";
+
+static void checkExternalSort() {
+	printf("++ Checking correctness of external morton sort ... ");
+	bool ok = true;
+	init_randcmwc(42);
+
+	// many runs and few distinct codes (the merge has to keep equal codes in input order), then a single run
+	const size_t sizes[2] = { 300000, 5000 };
+	for (size_t s = 0; s < 2; s++) {
+		const size_t n = sizes[s], run = 20000;
+		vector<uint64_t> codes(n);
+		vector<uint32_t> ids(n);
+		vector<pair<uint64_t, uint32_t> > expected(n);
+		for (size_t i = 0; i < n; i++) {
+			codes[i] = morton3D_64_encode(rand_cmwc() % 64, rand_cmwc() % 64, rand_cmwc() % 4);
+			ids[i] = (uint32_t)i;
+			expected[i] = make_pair(codes[i], ids[i]);
+		}
+		stable_sort(expected.begin(), expected.end(), [](const pair<uint64_t, uint32_t>& a, const pair<uint64_t, uint32_t>& b) { return a.first < b.first; });
+		MortonExternalSort sorter(EXTSORT_TEST_PREFIX, run * (2 * (12 + sizeof(uint32_t)) + 12), sizeof(uint32_t));
+		ok &= sorter.runRecords() == run;
+		for (size_t i = 0; i < n; i += 777) { ok &= sorter.add(&codes[i], &ids[i], std::min((size_t)777, n - i)); }
+		ok &= sorter.size() == n && sorter.runCount() == n / run;
+		vector<pair<uint64_t, uint32_t> > merged;
+		ok &= sorter.merge([&merged](const uint64_t* c, const char* v, size_t m) {
+			for (size_t i = 0; i < m; i++) {
+				uint32_t id;
+				memcpy(&id, v + i * sizeof(uint32_t), sizeof(uint32_t));
+				merged.push_back(make_pair(c[i], id));
+			}
+			return true;
+		});
+		ok &= merged == expected;
+		FILE* run0 = fopen((string(EXTSORT_TEST_PREFIX) + ".run0").c_str(), "rb"); // removed after the merge
+		ok &= run0 == 0;
+		if (run0) { fclose(run0); }
+	}
+
+	// a run file that lost records on disk fails the merge instead of dropping them
+	{
+		const size_t n = 50000, run = 20000;
+		vector<uint64_t> codes(n);
+		vector<uint32_t> ids(n);
+		for (size_t i = 0; i < n; i++) { codes[i] = morton3D_64_encode(rand_cmwc() % 64, rand_cmwc() % 64, rand_cmwc() % 4); ids[i] = (uint32_t)i; }
+		MortonExternalSort sorter(EXTSORT_TEST_PREFIX, run * (2 * (12 + sizeof(uint32_t)) + 12), sizeof(uint32_t));
+		ok &= sorter.add(&codes[0], &ids[0], n); // run0 is complete on disk once run1 has been started
+		const string run0_path = string(EXTSORT_TEST_PREFIX) + ".run0";
+		vector<char> run0(run * 12);
+		FILE* file = fopen(run0_path.c_str(), "rb");
+		ok &= file != 0 && fread(&run0[0], 1, run0.size(), file) == run0.size();
+		if (file) { fclose(file); }
+		file = fopen(run0_path.c_str(), "wb");
+		ok &= file != 0 && fwrite(&run0[0], 1, run0.size() / 2, file) == run0.size() / 2;
+		if (file) { fclose(file); }
+		size_t merged = 0;
+		ok &= !sorter.merge([&merged](const uint64_t*, const char*, size_t m) { merged += m; return true; });
+		ok &= merged < n;
+	}
+
+	// points, quantized and encoded on the way in, sorted into a point file
+	const size_t n = 100000;
+	vector<float> points(n * 3);
+	for (size_t i = 0; i < n * 3; i++) { points[i] = (float)(rand_cmwc() % 100000) / 100.0f; }
+	const float box_min[3] = { 0, 0, 0 }, box_max[3] = { 1000, 1000, 1000 };
+	size_t next = 0;
+	ok &= morton3D_ExternalSortPoints<float>([&](float* xyz, size_t max_points) {
+		const size_t m = std::min(max_points, n - next);
+		std::copy(&points[next * 3], &points[next * 3] + m * 3, xyz);
+		next += m;
+		return m;
+	}, box_min, box_max, 16, EXTSORT_TEST_PREFIX, 1 << 20, POINTFILE_TEST_PATH);
+	vector<uint_fast64_t> codes(n);
+	morton3D_QuantizeEncodePoints<float>(&points[0], n, box_min, box_max, 16, &codes[0]);
+	vector<pair<uint64_t, size_t> > expected(n);
+	for (size_t i = 0; i < n; i++) { expected[i] = make_pair(codes[i], i); }
+	stable_sort(expected.begin(), expected.end(), [](const pair<uint64_t, size_t>& a, const pair<uint64_t, size_t>& b) { return a.first < b.first; });
+	MortonPointFile file;
+	ok &= file.open(POINTFILE_TEST_PATH) && file.size() == n && file.columnCount() == 1 && file.columnSize(0) == 3 * sizeof(float);
+	if (ok) {
+		for (size_t i = 0; i < n; i++) {
+			ok &= file.code(i) == expected[i].first;
+			ok &= std::equal(&points[expected[i].second * 3], &points[expected[i].second * 3] + 3, file.column<float>(0) + i * 3);
+		}
+	}
+	file.close();
+	remove(POINTFILE_TEST_PATH);
+
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void ExternalSort_Perf(size_t n, size_t memory) {
+	cout << "++ External sort of " << n << " 3D points (" << std::fixed << std::setprecision(2) << (double)n * 12 / (1 << 30)
+		<< " GB of float xyz) with " << (memory >> 20) << " MB of buffers" << endl;
+	init_randcmwc(42);
+	const float box_min[3] = { 0, 0, 0 }, box_max[3] = { 1000, 1000, 1000 };
+	vector<float> xyz(MORTON_EXTSORT_CHUNK * 3);
+	vector<uint_fast64_t> codes(MORTON_EXTSORT_CHUNK);
+	MortonExternalSort sorter(EXTSORT_TEST_PREFIX, memory, 3 * sizeof(float));
+	bool ok = true;
+
+	// synthetic input, generated chunk by chunk
+	Timer run_timer = Timer();
+	run_timer.start();
+	for (size_t done = 0; done < n && ok; done += MORTON_EXTSORT_CHUNK) {
+		const size_t m = std::min(MORTON_EXTSORT_CHUNK, n - done);
+		for (size_t i = 0; i < m * 3; i++) { xyz[i] = (float)(rand_cmwc() & 0xfffff) * (1000.0f / 0x100000); }
+		morton3D_QuantizeEncodePoints<float>(&xyz[0], m, box_min, box_max, 21, &codes[0]);
+		ok &= sorter.add(reinterpret_cast<const uint64_t*>(&codes[0]), &xyz[0], m);
+	}
+	run_timer.stop();
+	Timer merge_timer = Timer();
+	merge_timer.start();
+	ok &= sorter.finish(POINTFILE_TEST_PATH, 3);
+	merge_timer.stop();
+
+	MortonPointFile file;
+	ok &= file.open(POINTFILE_TEST_PATH) && file.size() == n;
+	if (ok) { running_sums.push_back(file.code(n / 2) + file.code(n - 1)); }
+	file.close();
+	remove(POINTFILE_TEST_PATH);
+
+	if (!ok) { cout << "    Could not write the runs or the output" << endl; return; }
+	const double mb = (double)n * 12 / (1 << 20);
+	cout << "    Runs (generate, encode, sort, write): " << std::setprecision(3) << run_timer.elapsed_time_milliseconds << " ms ("
+		<< (n + sorter.runRecords() - 1) / sorter.runRecords() << " runs of up to " << sorter.runRecords() << " points)" << endl;
+	cout << "    Merge into a point file:              " << merge_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    Throughput:                           " << std::setprecision(1)
+		<< mb / ((run_timer.elapsed_time_milliseconds + merge_timer.elapsed_time_milliseconds) / 1000.0) << " MB/s of input" << endl;
+}
+
+static bool checkCompressedCodes(const vector<uint64_t>& codes) {
+	MortonCompressedCodes compressed;
+	compressed.build(codes.empty() ? 0 : &codes[0], codes.size());
+	const size_t n = codes.size();
+	bool ok = compressed.size() == n && compressed.blockCount() == (n + MORTON_BLOCK_CODES - 1) / MORTON_BLOCK_CODES;
+	vector<uint64_t> decoded(n + 1);
+	compressed.decodeAll(&decoded[0]);
+	ok &= std::equal(codes.begin(), codes.end(), decoded.begin());
+	for (size_t t = 0; t < 200 && n > 0; t++) {
+		const size_t i = rand_cmwc() % n, j = i + rand_cmwc() % (n - i + 1);
+		ok &= compressed[i] == codes[i];
+		compressed.decode(i, j, &decoded[0]);
+		ok &= std::equal(codes.begin() + i, codes.begin() + j, decoded.begin());
+		const uint64_t key = (t % 2) ? codes[rand_cmwc() % n] : codes[rand_cmwc() % n] + 1;
+		ok &= compressed.lowerBound(key) == (size_t)(std::lower_bound(codes.begin(), codes.end(), key) - codes.begin());
+	}
+	return ok;
+}
+
+static void checkCompression() {
+	printf("++ Checking correctness of sorted code compression ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	// packing at every width
+	for (unsigned int width = 0; width <= 64; width++) {
+		uint64_t values[MORTON_BLOCK_CODES], unpacked[MORTON_BLOCK_CODES];
+		for (size_t i = 0; i < MORTON_BLOCK_CODES; i++) {
+			const uint64_t v = ((uint64_t)rand_cmwc() << 32) ^ rand_cmwc();
+			values[i] = (width == 64) ? v : v & (((uint64_t)1 << width) - 1);
+		}
+		vector<uint64_t> words(morton_PackedBlockWords(width) + 1);
+		morton_PackBlock(values, width, &words[0]);
+		morton_UnpackBlock(&words[0], width, unpacked);
+		ok &= std::equal(values, values + MORTON_BLOCK_CODES, unpacked);
+	}
+	const size_t sizes[5] = { 0, 1, 127, 128, 100001 };
+	for (size_t s = 0; s < 5; s++) {
+		const size_t n = sizes[s];
+		vector<uint64_t> codes(n);
+		// sparse codes, dense codes with duplicates, and the full 64-bit range
+		for (size_t i = 0; i < n; i++) { codes[i] = morton3D_64_encode(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff); }
+		sort(codes.begin(), codes.end());
+		ok &= checkCompressedCodes(codes);
+		for (size_t i = 0; i < n; i++) { codes[i] = morton3D_64_encode(rand_cmwc() % 50, rand_cmwc() % 50, rand_cmwc() % 50); }
+		sort(codes.begin(), codes.end());
+		ok &= checkCompressedCodes(codes);
+		if (n > 1) { codes[0] = 0; codes[n - 1] = ~(uint64_t)0; }
+		ok &= checkCompressedCodes(codes);
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void Compression_Perf(size_t n) {
+	cout << "++ Compressing " << n << " sorted 3D codes" << endl;
+	init_randcmwc(42);
+	vector<uint64_t> codes(n), decoded(n);
+	for (int dense = 0; dense < 2; dense++) {
+		// random points in the whole space, or 60% of the cells of a 256^3 grid
+		if (dense) {
+			size_t i = 0;
+			for (uint_fast64_t c = 0; i < n; c++) { if (rand_cmwc() % 10 < 6) { codes[i++] = c; } }
+		}
+		else {
+			for (size_t i = 0; i < n; i++) { codes[i] = morton3D_64_encode(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff); }
+			morton_RadixSort<uint64_t>(&codes[0], n, 63);
+		}
+		MortonCompressedCodes compressed;
+		Timer build_timer = Timer();
+		build_timer.start();
+		compressed.build(&codes[0], n);
+		build_timer.stop();
+		Timer decode_timer = Timer();
+		decode_timer.start();
+		compressed.decodeAll(&decoded[0]);
+		decode_timer.stop();
+		Timer copy_timer = Timer();
+		copy_timer.start();
+		std::copy(codes.begin(), codes.end(), decoded.begin());
+		copy_timer.stop();
+		running_sums.push_back(decoded[n / 2] + compressed.lowerBound(codes[n / 3]));
+		cout << (dense ? "    Dense:  " : "    Sparse: ") << std::fixed << std::setprecision(2)
+			<< (double)compressed.compressedSize() * 8 / n << " bits per code. Build "
+			<< std::setprecision(3) << build_timer.elapsed_time_milliseconds << " ms, decode "
+			<< decode_timer.elapsed_time_milliseconds << " ms (copying the raw codes: " << copy_timer.elapsed_time_milliseconds << " ms)" << endl;
+	}
+}
+
+static void checkLevelOfDetail() {
+	printf("++ Checking correctness of level-of-detail encoding and pyramids ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	// level codes against the ancestors of the full codes
+	for (size_t i = 0; i < 100000; i++) {
+		const uint_fast32_t x = rand_cmwc() & 0x1fffff, y = rand_cmwc() & 0x1fffff, z = rand_cmwc() & 0x1fffff;
+		const unsigned int l = rand_cmwc() % 22;
+		const uint_fast64_t code = morton3D_64_encode(x, y, z);
+		ok &= morton3D_EncodeLevel<uint_fast64_t, uint_fast32_t>(x, y, z, l) == morton3D_ancestorAtLevel<uint_fast64_t>(code, l) >> (3 * (21 - l));
+		const uint32_t x32 = x & 0x3ff, y32 = y & 0x3ff, z32 = z & 0x3ff;
+		const unsigned int l32 = l % 11;
+		const uint32_t code32 = morton3D_Encode_for<uint32_t, uint32_t>(x32, y32, z32);
+		ok &= morton3D_EncodeLevel<uint32_t, uint32_t>(x32, y32, z32, l32) == morton3D_ancestorAtLevel<uint32_t>(code32, l32) >> (3 * (10 - l32));
+	}
+
+	// clustered points, so some cells are dense and many are empty
+	const size_t n = 200000;
+	const unsigned int level = 5;
+	vector<uint_fast32_t> x(n), y(n), z(n);
+	vector<uint_fast64_t> codes(n);
+	for (size_t i = 0; i < n; i++) {
+		const uint_fast32_t cluster = (rand_cmwc() % 4) << 19;
+		x[i] = cluster + (rand_cmwc() & 0x7ffff); y[i] = rand_cmwc() & 0x1fffff; z[i] = cluster + (rand_cmwc() & 0x7ffff);
+		codes[i] = morton3D_64_encode(x[i], y[i], z[i]);
+	}
+	vector<uint32_t> counts(morton3D_PyramidSize(level));
+	vector<uint_fast64_t> leaf_codes(n);
+	morton3D_PyramidCounts<uint_fast64_t, uint_fast32_t>(&x[0], &y[0], &z[0], n, level, &counts[0], &leaf_codes[0]);
+	for (unsigned int l = 0; l <= level; l++) {
+		vector<uint32_t> expected((size_t)1 << (3 * l), 0);
+		for (size_t i = 0; i < n; i++) { expected[codes[i] >> (3 * (21 - l))]++; }
+		ok &= std::equal(expected.begin(), expected.end(), counts.begin() + morton3D_PyramidOffset(l));
+	}
+	for (size_t i = 0; i < n; i++) { ok &= leaf_codes[i] == codes[i] >> (3 * (21 - level)); }
+
+	// sparse pyramid down to the deepest level, against the dense counts and the sorted codes
+	sort(codes.begin(), codes.end());
+	vector<vector<MortonLevelCell<uint_fast64_t> > > cells;
+	morton3D_SparsePyramid<uint_fast64_t>(&codes[0], n, 21, cells);
+	ok &= cells.size() == 22;
+	for (unsigned int l = 0; l <= 21 && ok; l++) {
+		size_t next = 0;
+		for (size_t c = 0; c < cells[l].size(); c++) {
+			const MortonLevelCell<uint_fast64_t>& cell = cells[l][c];
+			ok &= cell.first == next && cell.count > 0; // the cells tile the array, in order
+			ok &= (codes[cell.first] >> (3 * (21 - l))) == cell.cell && (codes[cell.first + cell.count - 1] >> (3 * (21 - l))) == cell.cell;
+			if (cell.first + cell.count < n) { ok &= (codes[cell.first + cell.count] >> (3 * (21 - l))) != cell.cell; }
+			if (l <= level) { ok &= counts[morton3D_PyramidOffset(l) + (size_t)cell.cell] == cell.count; }
+			next += cell.count;
+		}
+		ok &= next == n;
+	}
+	vector<vector<MortonLevelCell<uint_fast64_t> > > empty;
+	morton3D_SparsePyramid<uint_fast64_t>((uint_fast64_t*)0, 0, 3, empty);
+	ok &= empty.size() == 4 && empty[3].empty();
+	// levels past the deepest one are clamped
+	vector<vector<MortonLevelCell<uint_fast64_t> > > clamped;
+	morton3D_SparsePyramid<uint_fast64_t>(&codes[0], n, 30, clamped);
+	ok &= clamped.size() == 22 && clamped[21].size() == cells[21].size();
+	ok &= morton3D_EncodeLevel<uint_fast64_t, uint_fast32_t>(x[0], y[0], z[0], 25) == morton3D_64_encode(x[0], y[0], z[0]);
+	ok &= morton3D_EncodeLevel<uint32_t, uint32_t>(1023, 5, 512, 11) == morton3D_Encode_for<uint32_t, uint32_t>(1023, 5, 512);
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void LevelOfDetail_Perf(size_t n) {
+	const unsigned int level = 7;
+	cout << "++ Counting " << n << " points per cell on octree levels 0 to " << level << endl;
+	init_randcmwc(42);
+	vector<uint_fast32_t> x(n), y(n), z(n);
+	for (size_t i = 0; i < n; i++) { x[i] = rand_cmwc() & 0x1fffff; y[i] = rand_cmwc() & 0x1fffff; z[i] = rand_cmwc() & 0x1fffff; }
+	vector<uint32_t> counts(morton3D_PyramidSize(level)), shifted_counts(morton3D_PyramidSize(level));
+	vector<uint_fast64_t> codes(n);
+	morton3D_PyramidCounts<uint_fast64_t, uint_fast32_t>(&x[0], &y[0], &z[0], n, level, &shifted_counts[0], &codes[0]); // touch all pages once
+	std::fill(shifted_counts.begin(), shifted_counts.end(), 0);
+
+	// full codes, then every level by shifting them
+	Timer shift_timer = Timer();
+	shift_timer.start();
+	for (size_t i = 0; i < n; i++) { codes[i] = morton3D_64_encode(x[i], y[i], z[i]); }
+	for (unsigned int l = 0; l <= level; l++) {
+		uint32_t* c = &shifted_counts[morton3D_PyramidOffset(l)];
+		const unsigned int shift = 3 * (21 - l);
+		for (size_t i = 0; i < n; i++) { c[codes[i] >> shift]++; }
+	}
+	shift_timer.stop();
+
+	Timer level_timer = Timer();
+	level_timer.start();
+	morton3D_PyramidCounts<uint_fast64_t, uint_fast32_t>(&x[0], &y[0], &z[0], n, level, &counts[0], &codes[0]);
+	level_timer.stop();
+	running_sums.push_back(counts[morton3D_PyramidOffset(level) + 17] + shifted_counts[9] + codes[n / 2]);
+	cout << "    Full encode + shift per level: " << std::fixed << std::setprecision(3) << shift_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    Level encode + one pass:       " << level_timer.elapsed_time_milliseconds << " ms" << endl;
+}
+
+// Walks of random boxes against all cells of the box, encoded and sorted
+template <typename morton, typename coord>
+static bool check3D_ZOrderWalk(const coord base_mask) {
+	bool ok = true;
+	for (size_t t = 0; t < 200; t++) {
+		const coord x0 = (coord)rand_cmwc() & base_mask, y0 = (coord)rand_cmwc() & base_mask, z0 = (coord)rand_cmwc() & base_mask;
+		const coord x1 = x0 + (coord)(rand_cmwc() % 19), y1 = y0 + (coord)(rand_cmwc() % 19), z1 = z0 + (coord)(rand_cmwc() % 19);
+		vector<morton> expected;
+		for (coord x = x0; x <= x1; x++) {
+			for (coord y = y0; y <= y1; y++) {
+				for (coord z = z0; z <= z1; z++) { expected.push_back(morton3D_Encode_for<morton, coord>(x, y, z)); }
+			}
+		}
+		std::sort(expected.begin(), expected.end());
+		size_t i = 0;
+		for (MortonWalker3D<morton, coord> w(x0, y0, z0, x1, y1, z1); !w.done(); w.next(), i++) {
+			ok &= i < expected.size() && w.code() == expected[i] && morton3D_Encode_for<morton, coord>(w.x(), w.y(), w.z()) == w.code();
+		}
+		ok &= i == expected.size();
+		size_t calls = 0;
+		morton3D_ForEachZOrder<morton, coord>(x0, y0, z0, x1, y1, z1, [&](const morton code, const coord x, const coord y, const coord z) {
+			ok &= calls < expected.size() && code == expected[calls] && morton3D_Encode_for<morton, coord>(x, y, z) == code;
+			calls++;
+		});
+		ok &= calls == expected.size();
+	}
+	return ok;
+}
+
+template <typename morton, typename coord>
+static bool check2D_ZOrderWalk(const coord base_mask) {
+	bool ok = true;
+	for (size_t t = 0; t < 200; t++) {
+		const coord x0 = (coord)rand_cmwc() & base_mask, y0 = (coord)rand_cmwc() & base_mask;
+		const coord x1 = x0 + (coord)(rand_cmwc() % 70), y1 = y0 + (coord)(rand_cmwc() % 70);
+		vector<morton> expected;
+		for (coord x = x0; x <= x1; x++) {
+			for (coord y = y0; y <= y1; y++) { expected.push_back(morton2D_Encode_magicbits<morton, coord>(x, y)); }
+		}
+		std::sort(expected.begin(), expected.end());
+		size_t i = 0;
+		morton2D_ForEachZOrder<morton, coord>(x0, y0, x1, y1, [&](const morton code, const coord x, const coord y) {
+			ok &= i < expected.size() && code == expected[i] && morton2D_Encode_magicbits<morton, coord>(x, y) == code;
+			i++;
+		});
+		ok &= i == expected.size();
+	}
+	return ok;
+}
+
+static void checkZOrderWalk() {
+	printf("++ Checking correctness of z-order box walks ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	ok &= check3D_ZOrderWalk<uint_fast64_t, uint_fast32_t>(0xfffff);
+	ok &= check3D_ZOrderWalk<uint_fast64_t, uint_fast32_t>(0x3f);
+	ok &= check3D_ZOrderWalk<uint_fast32_t, uint_fast16_t>(0x1ff);
+	ok &= check2D_ZOrderWalk<uint_fast64_t, uint_fast32_t>(0x7fffffff);
+	ok &= check2D_ZOrderWalk<uint_fast64_t, uint_fast32_t>(0x3f);
+	ok &= check2D_ZOrderWalk<uint_fast32_t, uint_fast16_t>(0x7fff);
+	// the whole grid of a 32-bit code, and single cells
+	size_t cells = 0;
+	uint_fast32_t previous = 0;
+	morton3D_ForEachZOrder<uint_fast32_t, uint_fast16_t>(0, 0, 0, 1023, 1023, 1023, [&](const uint_fast32_t code, const uint_fast16_t, const uint_fast16_t, const uint_fast16_t) {
+		ok &= code == cells++;
+		previous = code;
+	});
+	ok &= cells == ((size_t)1 << 30) && previous == 0x3fffffff;
+	// 2D boxes across the middle of the full 32-bit range
+	cells = 0;
+	morton2D_ForEachZOrder<uint_fast64_t, uint_fast32_t>(0x7ffffffe, 0x7ffffffe, 0x80000001, 0x80000001, [&](const uint_fast64_t code, const uint_fast32_t x, const uint_fast32_t y) {
+		ok &= code == morton2D_64_encode(x, y);
+		cells++;
+	});
+	ok &= cells == 16;
+	cells = 0;
+	for (MortonWalker2D<uint_fast64_t, uint_fast32_t> w2(0x7fffffff, 0xfffffffe, 0x80000000, 0xffffffff); !w2.done(); w2.next()) {
+		ok &= w2.code() == morton2D_64_encode(w2.x(), w2.y());
+		cells++;
+	}
+	ok &= cells == 4;
+	MortonWalker3D<uint_fast64_t, uint_fast32_t> single(5, 6, 7, 5, 6, 7);
+	ok &= !single.done() && single.code() == morton3D_64_encode(5, 6, 7);
+	single.next();
+	ok &= single.done();
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Sweep a box cell by cell: nested loops that encode every cell, against the z-order walk
+static void ZOrderWalk_Perf(const uint_fast32_t w, const uint_fast32_t h, const uint_fast32_t d) {
+	cout << "++ Visiting the " << w << " x " << h << " x " << d << " cells of a box at (1000, 2000, 3000)" << endl;
+	const uint_fast32_t x0 = 1000, y0 = 2000, z0 = 3000;
+	uint_fast64_t sum = 0;
+	Timer loop_timer = Timer();
+	loop_timer.start();
+	for (uint_fast32_t z = z0; z < z0 + d; z++) {
+		for (uint_fast32_t y = y0; y < y0 + h; y++) {
+			for (uint_fast32_t x = x0; x < x0 + w; x++) { sum += morton3D_64_encode(x, y, z) ^ (x + y + z); }
+		}
+	}
+	loop_timer.stop();
+	running_sums.push_back(sum);
+
+	sum = 0;
+	Timer walker_timer = Timer();
+	walker_timer.start();
+	for (MortonWalker3D<uint_fast64_t, uint_fast32_t> walk(x0, y0, z0, x0 + w - 1, y0 + h - 1, z0 + d - 1); !walk.done(); walk.next()) {
+		sum += walk.code() ^ (walk.x() + walk.y() + walk.z());
+	}
+	walker_timer.stop();
+	running_sums.push_back(sum);
+
+	sum = 0;
+	Timer foreach_timer = Timer();
+	foreach_timer.start();
+	morton3D_ForEachZOrder<uint_fast64_t, uint_fast32_t>(x0, y0, z0, x0 + w - 1, y0 + h - 1, z0 + d - 1, [&sum](const uint_fast64_t code, const uint_fast32_t x, const uint_fast32_t y, const uint_fast32_t z) {
+		sum += code ^ (x + y + z);
+	});
+	foreach_timer.stop();
+	running_sums.push_back(sum);
+	cout << "    Loops + encode per cell: " << std::fixed << std::setprecision(3) << loop_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    MortonWalker3D:          " << walker_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    morton3D_ForEachZOrder:  " << foreach_timer.elapsed_time_milliseconds << " ms" << endl;
+}
+
+// 32-bit 2D kernels against the generic templates, on a grid of 2^16 x 2^8 points and a batch with a scalar tail
+static void check2D_32Kernels() {
+	printf("++ Checking correctness of 32-bit 2D kernels ... ");
+	bool ok = true;
+	for (uint_fast32_t x = 0; x <= 0xFFFF; x++) {
+		for (uint_fast32_t y = 0; y <= 0xFFFF; y += 257) {
+			const uint32_t m = (uint32_t)morton2D_Encode_magicbits<uint_fast32_t, uint_fast16_t>(x, y);
+			uint16_t dx, dy;
+			ok &= morton2D_32_Encode_magicbits((uint16_t)x, (uint16_t)y) == m;
+			ok &= morton2D_32_Encode_LUT256_shifted((uint16_t)x, (uint16_t)y) == m;
+			morton2D_32_Decode_magicbits(m, dx, dy);
+			ok &= dx == x && dy == y;
+#if defined(__BMI2__)
+			ok &= morton2D_32_Encode_BMI2((uint16_t)x, (uint16_t)y) == m;
+			morton2D_32_Decode_BMI2(m, dx, dy);
+			ok &= dx == x && dy == y;
+#endif
+		}
+	}
+	init_randcmwc(42);
+	const size_t n = 1000 * MORTON2D_32_BATCH + 7;
+	vector<uint16_t> x(n), y(n), dx(n), dy(n);
+	vector<uint32_t> codes(n);
+	for (size_t i = 0; i < n; i++) { x[i] = (uint16_t)rand_cmwc(); y[i] = (uint16_t)rand_cmwc(); }
+	morton2D_32_EncodeArray(&x[0], &y[0], n, &codes[0]);
+	morton2D_32_DecodeArray(&codes[0], n, &dx[0], &dy[0]);
+	for (size_t i = 0; i < n; i++) {
+		ok &= codes[i] == morton2D_32_encode(x[i], y[i]) && dx[i] == x[i] && dy[i] == y[i];
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Tile coordinates to codes and back: the generic 32-bit templates per point against the exact-width kernels
+static void Morton2D32_Perf(size_t n) {
+	cout << "++ Encoding and decoding " << n << " 2D points with 16-bit coordinates (batch of " << MORTON2D_32_BATCH << " codes)" << endl;
+	init_randcmwc(42);
+	vector<uint16_t> x(n), y(n), dx(n), dy(n);
+	vector<uint32_t> codes(n);
+	for (size_t i = 0; i < n; i++) { x[i] = (uint16_t)rand_cmwc(); y[i] = (uint16_t)rand_cmwc(); }
+	morton2D_32_EncodeArray(&x[0], &y[0], n, &codes[0]); // touch all pages once
+	morton2D_32_DecodeArray(&codes[0], n, &dx[0], &dy[0]);
+
+	Timer lut_timer = Timer();
+	lut_timer.start();
+	for (size_t i = 0; i < n; i++) { codes[i] = (uint32_t)morton2D_Encode_LUT256_shifted<uint_fast32_t, uint_fast16_t>(x[i], y[i]); }
+	lut_timer.stop();
+	running_sums.push_back(codes[n / 2]);
+	Timer magic_timer = Timer();
+	magic_timer.start();
+	for (size_t i = 0; i < n; i++) { codes[i] = morton2D_32_Encode_magicbits(x[i], y[i]); }
+	magic_timer.stop();
+	running_sums.push_back(codes[n / 3]);
+	Timer array_timer = Timer();
+	array_timer.start();
+	morton2D_32_EncodeArray(&x[0], &y[0], n, &codes[0]);
+	array_timer.stop();
+	running_sums.push_back(codes[n / 4]);
+
+	Timer generic_decode_timer = Timer();
+	generic_decode_timer.start();
+	for (size_t i = 0; i < n; i++) {
+		uint_fast16_t a, b;
+		morton2D_Decode_magicbits<uint_fast32_t, uint_fast16_t>(codes[i], a, b);
+		dx[i] = (uint16_t)a; dy[i] = (uint16_t)b;
+	}
+	generic_decode_timer.stop();
+	running_sums.push_back(dx[n / 2] + dy[n / 3]);
+	Timer magic_decode_timer = Timer();
+	magic_decode_timer.start();
+	for (size_t i = 0; i < n; i++) { morton2D_32_Decode_magicbits(codes[i], dx[i], dy[i]); }
+	magic_decode_timer.stop();
+	running_sums.push_back(dx[n / 4] + dy[n / 5]);
+	Timer array_decode_timer = Timer();
+	array_decode_timer.start();
+	morton2D_32_DecodeArray(&codes[0], n, &dx[0], &dy[0]);
+	array_decode_timer.stop();
+	running_sums.push_back(dx[n / 6] + dy[n / 7]);
+	cout << "    Encode: generic LUT256_shifted " << std::fixed << std::setprecision(3) << lut_timer.elapsed_time_milliseconds << " ms, 32-bit magicbits "
+		<< magic_timer.elapsed_time_milliseconds << " ms, EncodeArray " << array_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    Decode: generic magicbits " << generic_decode_timer.elapsed_time_milliseconds << " ms, 32-bit magicbits "
+		<< magic_decode_timer.elapsed_time_milliseconds << " ms, DecodeArray " << array_decode_timer.elapsed_time_milliseconds << " ms" << endl;
+#if defined(__BMI2__)
+	Timer bmi_timer = Timer();
+	bmi_timer.start();
+	for (size_t i = 0; i < n; i++) { codes[i] = morton2D_32_Encode_BMI2(x[i], y[i]); }
+	bmi_timer.stop();
+	running_sums.push_back(codes[n / 5]);
+	Timer bmi_decode_timer = Timer();
+	bmi_decode_timer.start();
+	for (size_t i = 0; i < n; i++) { morton2D_32_Decode_BMI2(codes[i], dx[i], dy[i]); }
+	bmi_decode_timer.stop();
+	running_sums.push_back(dx[n / 8] + dy[n / 9]);
+	cout << "    BMI2: encode " << bmi_timer.elapsed_time_milliseconds << " ms, decode " << bmi_decode_timer.elapsed_time_milliseconds << " ms" << endl;
+#endif
+}
+
+// Every encode/decode method instantiated on exact-width types (morton = uint32_t / uint64_t, coord = uint16_t / uint32_t),
+// against the same method on the uint_fast types. The 2D methods are also checked against magic bits.
+template <typename morton, typename coord, typename fast_morton, typename fast_coord>
+static bool checkExactWidthMethods(const unsigned int bits3D) {
+	bool ok = true;
+	morton (*encode3D[])(coord, coord, coord) = { morton3D_Encode_for<morton, coord>, morton3D_Encode_for_ET<morton, coord>, morton3D_Encode_magicbits<morton, coord>,
+		morton3D_Encode_LUT256_shifted<morton, coord>, morton3D_Encode_LUT256_shifted_ET<morton, coord>, morton3D_Encode_LUT256<morton, coord>, morton3D_Encode_LUT256_ET<morton, coord> };
+	void (*decode3D[])(morton, coord&, coord&, coord&) = { morton3D_Decode_for<morton, coord>, morton3D_Decode_for_ET<morton, coord>, morton3D_Decode_magicbits<morton, coord>,
+		morton3D_Decode_LUT256_shifted<morton, coord>, morton3D_Decode_LUT256_shifted_ET<morton, coord>, morton3D_Decode_LUT256<morton, coord>, morton3D_Decode_LUT256_ET<morton, coord> };
+	morton (*encode2D[])(coord, coord) = { morton2D_Encode_for<morton, coord>, morton2D_Encode_magicbits<morton, coord>, morton2D_Encode_LUT256_shifted<morton, coord>,
+		morton2D_Encode_LUT256_shifted_ET<morton, coord>, morton2D_Encode_LUT256<morton, coord>, morton2D_Encode_LUT256_ET<morton, coord> };
+	void (*decode2D[])(morton, coord&, coord&) = { morton2D_Decode_for<morton, coord>, morton2D_Decode_magicbits<morton, coord> };
+	const coord mask3D = (coord)(((uint_fast64_t)1 << bits3D) - 1);
+	for (size_t t = 0; t < 100000; t++) {
+		const unsigned int shift = t % (bits3D + 1); // small coordinates too, for the early termination methods
+		const coord x = (coord)((rand_cmwc() & mask3D) >> shift), y = (coord)((rand_cmwc() & mask3D) >> (shift / 2)), z = (coord)((rand_cmwc() & mask3D) >> (shift / 3));
+		const fast_morton m = morton3D_Encode_LUT256_shifted<fast_morton, fast_coord>(x, y, z);
+		for (size_t f = 0; f < 7; f++) {
+			coord dx, dy, dz;
+			decode3D[f]((morton)m, dx, dy, dz);
+			ok &= encode3D[f](x, y, z) == m && dx == x && dy == y && dz == z;
+		}
+		const coord x2 = (coord)(((uint_fast64_t)rand_cmwc() << 32 | rand_cmwc()) >> (shift + 64 - sizeof(morton) * 4));
+		const coord y2 = (coord)(((uint_fast64_t)rand_cmwc() << 32 | rand_cmwc()) >> (shift / 2 + 64 - sizeof(morton) * 4));
+		const fast_morton m2 = morton2D_Encode_magicbits<fast_morton, fast_coord>(x2, y2);
+		for (size_t f = 0; f < 6; f++) { ok &= encode2D[f](x2, y2) == m2; }
+		for (size_t f = 0; f < 2; f++) {
+			coord dx, dy;
+			decode2D[f]((morton)m2, dx, dy);
+			ok &= dx == x2 && dy == y2;
+		}
+	}
+	return ok;
+}
+
+static void checkExactWidth() {
+	printf("++ Checking correctness of exact-width methods and overloads ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	ok &= checkExactWidthMethods<uint32_t, uint16_t, uint_fast32_t, uint_fast16_t>(10);
+	ok &= checkExactWidthMethods<uint64_t, uint32_t, uint_fast64_t, uint_fast32_t>(21);
+	ok &= checkExactWidthMethods<uint_fast32_t, uint_fast16_t, uint_fast32_t, uint_fast16_t>(10);
+	// reference values: bit i of x goes to bit 2i (2D) or 3i (3D)
+	ok &= morton2D_Encode_for<uint_fast32_t, uint_fast16_t>(3, 5) == 39 && morton2D_Encode_for<uint_fast64_t, uint_fast32_t>(0xffffffff, 0) == 0x5555555555555555;
+	ok &= morton3D_Encode_magicbits<uint32_t, uint16_t>(3, 5, 0) == 0x8b && morton2D_Encode_magicbits<uint32_t, uint16_t>(0xffff, 0) == 0x55555555;
+
+	// morton.h: exact-width overloads, with the same results as the uint_fast functions
+	const size_t n = 10007;
+	vector<uint16_t> x16(n), y16(n), z16(n);
+	vector<uint32_t> x32(n), y32(n), z32(n), codes32(n);
+	vector<uint64_t> codes64(n);
+	for (size_t i = 0; i < n; i++) {
+		x16[i] = (uint16_t)rand_cmwc(); y16[i] = (uint16_t)rand_cmwc(); z16[i] = (uint16_t)(rand_cmwc() & 0x3ff);
+		x32[i] = rand_cmwc(); y32[i] = rand_cmwc(); z32[i] = rand_cmwc() & 0x1fffff;
+	}
+	for (size_t i = 0; i < n; i++) {
+		const uint16_t x = x16[i], y = y16[i], z = z16[i], x10 = x16[i] & 0x3ff, y10 = y16[i] & 0x3ff;
+		const uint32_t X = x32[i], Y = y32[i], Z = z32[i], X21 = x32[i] & 0x1fffff, Y21 = y32[i] & 0x1fffff;
+		uint16_t a, b, c;
+		uint32_t A, B, C;
+		const uint32_t m2 = morton2D_32_encode(x, y), m3 = morton3D_32_encode(x10, y10, z);
+		const uint64_t M2 = morton2D_64_encode(X, Y), M3 = morton3D_64_encode(X21, Y21, Z);
+		ok &= m2 == morton2D_32_encode((uint_fast16_t)x, (uint_fast16_t)y) && m3 == morton3D_32_encode((uint_fast16_t)x10, (uint_fast16_t)y10, (uint_fast16_t)z);
+		ok &= M2 == morton2D_64_encode((uint_fast32_t)X, (uint_fast32_t)Y) && M3 == morton3D_64_encode((uint_fast32_t)X21, (uint_fast32_t)Y21, (uint_fast32_t)Z);
+		morton2D_32_decode(m2, a, b);
+		ok &= a == x && b == y;
+		morton3D_32_decode(m3, a, b, c);
+		ok &= a == x10 && b == y10 && c == z;
+		morton2D_64_decode(M2, A, B);
+		ok &= A == X && B == Y;
+		morton3D_64_decode(M3, A, B, C);
+		ok &= A == X21 && B == Y21 && C == Z;
+	}
+	ok &= morton3D_64_encode(1, 0, 0) == 1 && morton2D_32_encode(0, 1) == 2; // int literals still resolve
+
+	// array APIs, with the default and an explicit method
+	vector<uint16_t> dx16(n), dy16(n), dz16(n);
+	vector<uint32_t> dx32(n), dy32(n), dz32(n);
+	for (size_t i = 0; i < n; i++) { x16[i] &= 0x3ff; y16[i] &= 0x3ff; x32[i] &= 0x1fffff; y32[i] &= 0x1fffff; }
+	morton3D_EncodeArray<uint32_t, uint16_t>(&x16[0], &y16[0], &z16[0], n, &codes32[0]);
+	morton3D_DecodeArray<uint32_t, uint16_t, morton3D_Decode_magicbits<uint32_t, uint16_t> >(&codes32[0], n, &dx16[0], &dy16[0], &dz16[0]);
+	morton3D_EncodeArray<uint64_t, uint32_t, morton3D_Encode_magicbits<uint64_t, uint32_t> >(&x32[0], &y32[0], &z32[0], n, &codes64[0]);
+	morton3D_DecodeArray<uint64_t, uint32_t>(&codes64[0], n, &dx32[0], &dy32[0], &dz32[0]);
+	for (size_t i = 0; i < n; i++) {
+		ok &= codes32[i] == morton3D_32_encode(x16[i], y16[i], z16[i]) && dx16[i] == x16[i] && dy16[i] == y16[i] && dz16[i] == z16[i];
+		ok &= codes64[i] == morton3D_64_encode(x32[i], y32[i], z32[i]) && dx32[i] == x32[i] && dy32[i] == y32[i] && dz32[i] == z32[i];
+	}
+	morton2D_EncodeArray<uint64_t, uint32_t>(&x32[0], &y32[0], n, &codes64[0]);
+	morton2D_DecodeArray<uint64_t, uint32_t>(&codes64[0], n, &dx32[0], &dy32[0]);
+	for (size_t i = 0; i < n; i++) { ok &= codes64[i] == morton2D_64_encode(x32[i], y32[i]) && dx32[i] == x32[i] && dy32[i] == y32[i]; }
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Encode and decode n 3D points through arrays of the uint_fast types and of the exact-width ones: the same
+// work on 32 or 20 bytes per point (64-bit codes) and 32 or 10 bytes per point (32-bit codes) on x86-64 Linux.
+template <typename morton, typename coord>
+static double ExactWidth_Pass_Perf(const vector<coord>& x, const vector<coord>& y, const vector<coord>& z, vector<morton>& codes, vector<coord>& d) {
+	const size_t n = x.size();
+	Timer timer = Timer();
+	timer.start();
+	morton3D_EncodeArray<morton, coord>(&x[0], &y[0], &z[0], n, &codes[0]);
+	morton3D_DecodeArray<morton, coord>(&codes[0], n, &d[0], &d[n], &d[2 * n]);
+	timer.stop();
+	running_sums.push_back(codes[n / 2] + d[n / 3] + d[2 * n + n / 5]);
+	return timer.elapsed_time_milliseconds;
+}
+
+template <typename morton, typename coord, typename fast_morton, typename fast_coord>
+static void ExactWidth_Perf(size_t n, const unsigned int bits) {
+	init_randcmwc(42);
+	vector<coord> x(n), y(n), z(n), d(3 * n);
+	for (size_t i = 0; i < n; i++) { x[i] = (coord)(rand_cmwc() & ((1u << bits) - 1)); y[i] = (coord)(rand_cmwc() & ((1u << bits) - 1)); z[i] = (coord)(rand_cmwc() & ((1u << bits) - 1)); }
+	vector<fast_coord> fx(x.begin(), x.end()), fy(y.begin(), y.end()), fz(z.begin(), z.end()), fd(3 * n);
+	vector<morton> codes(n);
+	vector<fast_morton> fast_codes(n);
+	ExactWidth_Pass_Perf<morton, coord>(x, y, z, codes, d); // touch all pages once
+	ExactWidth_Pass_Perf<fast_morton, fast_coord>(fx, fy, fz, fast_codes, fd);
+	const size_t fast_bytes = n * (4 * sizeof(fast_coord) + 2 * sizeof(fast_morton)), exact_bytes = n * (4 * sizeof(coord) + 2 * sizeof(morton));
+	const double fast_ms = ExactWidth_Pass_Perf<fast_morton, fast_coord>(fx, fy, fz, fast_codes, fd);
+	const double exact_ms = ExactWidth_Pass_Perf<morton, coord>(x, y, z, codes, d);
+	cout << "++ Encoding + decoding " << n << " 3D points in arrays, " << sizeof(morton) * 8 << "-bit codes" << endl;
+	cout << "    uint_fast types:   " << std::fixed << std::setprecision(3) << fast_ms << " ms, " << (fast_bytes >> 20) << " MB moved" << endl;
+	cout << "    exact-width types: " << exact_ms << " ms, " << (exact_bytes >> 20) << " MB moved" << endl;
+}
+
+// Constant expressions: magic bits encode/decode, morton arithmetic and level helpers are evaluated at compile time,
+// so these fail the build, not the run
+static_assert(morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(3, 5, 0) == 0x8b, "3D magic bits encode");
+static_assert(morton3D_Encode_magicbits<uint32_t, uint16_t>(1023, 0, 1023) == 0x2db6db6d, "3D magic bits encode, 32-bit");
+static_assert(morton3D_Encode_magicbits<uint64_t, uint32_t>(0x1fffff, 0x1fffff, 0x1fffff) == 0x7fffffffffffffff, "3D magic bits encode, 64-bit");
+static_assert(morton3D_DecodeCoord_magicbits<uint64_t, uint32_t>(morton3D_Encode_magicbits<uint64_t, uint32_t>(123456, 654321, 1048575), 0) == 123456
+	&& morton3D_DecodeCoord_magicbits<uint64_t, uint32_t>(morton3D_Encode_magicbits<uint64_t, uint32_t>(123456, 654321, 1048575), 1) == 654321
+	&& morton3D_DecodeCoord_magicbits<uint64_t, uint32_t>(morton3D_Encode_magicbits<uint64_t, uint32_t>(123456, 654321, 1048575), 2) == 1048575, "3D magic bits decode");
+static_assert(morton3D_DecodeCoord_magicbits<uint32_t, uint16_t>(0x3fffffff, 2) == 1023, "3D magic bits decode, 32-bit");
+static_assert(morton2D_Encode_magicbits<uint_fast32_t, uint_fast16_t>(3, 5) == 39 && morton2D_32_Encode_magicbits(3, 5) == 39, "2D magic bits encode");
+static_assert(morton2D_Encode_magicbits<uint64_t, uint32_t>(0xffffffff, 0) == 0x5555555555555555, "2D magic bits encode, 64-bit");
+static_assert(morton2D_DecodeCoord_magicbits<uint64_t, uint32_t>(0xAAAAAAAAAAAAAAAA, 1) == 0xffffffff
+	&& morton2D_DecodeCoord_magicbits<uint32_t, uint16_t>(39, 0) == 3 && morton2D_DecodeCoord_magicbits<uint32_t, uint16_t>(39, 1) == 5, "2D magic bits decode");
+static_assert(morton3D_IncX<uint64_t>(morton3D_Encode_magicbits<uint64_t, uint32_t>(7, 3, 3)) == morton3D_Encode_magicbits<uint64_t, uint32_t>(8, 3, 3)
+	&& morton3D_DecZ<uint32_t>(morton3D_Encode_magicbits<uint32_t, uint16_t>(1, 2, 512)) == morton3D_Encode_magicbits<uint32_t, uint16_t>(1, 2, 511), "3D increment/decrement");
+static_assert(morton3D_Add<uint64_t>(morton3D_Encode_magicbits<uint64_t, uint32_t>(100, 200, 300), morton3D_Encode_magicbits<uint64_t, uint32_t>(28, 56, 212)) == morton3D_Encode_magicbits<uint64_t, uint32_t>(128, 256, 512)
+	&& morton3D_Sub<uint64_t>(morton3D_Encode_magicbits<uint64_t, uint32_t>(128, 256, 512), morton3D_Encode_magicbits<uint64_t, uint32_t>(28, 56, 212)) == morton3D_Encode_magicbits<uint64_t, uint32_t>(100, 200, 300), "3D add/subtract");
+static_assert(morton2D_IncY<uint32_t>(morton2D_32_Encode_magicbits(9, 255)) == morton2D_32_Encode_magicbits(9, 256)
+	&& morton2D_Sub<uint32_t>(morton2D_32_Encode_magicbits(1000, 7), morton2D_32_Encode_magicbits(1, 7)) == morton2D_32_Encode_magicbits(999, 0), "2D arithmetic");
+static_assert(morton3D_maxLevel<uint64_t>() == 21 && morton3D_maxLevel<uint32_t>() == 10, "maximum levels");
+static_assert(morton3D_ancestorAtLevel<uint64_t>(morton3D_Encode_magicbits<uint64_t, uint32_t>(0x1fffff, 5, 0x100001), 1) == morton3D_Encode_magicbits<uint64_t, uint32_t>(0x100000, 0, 0x100000), "ancestor at level");
+static_assert(morton2D_maxLevel<uint64_t>() == 32 && morton2D_maxLevel<uint32_t>() == 16, "2D maximum levels");
+static_assert(morton2D_ancestorAtLevel<uint32_t>(morton2D_32_Encode_magicbits(0xffff, 0x8001), 1) == morton2D_32_Encode_magicbits(0x8000, 0x8000)
+	&& morton2D_ancestorAtLevel<uint64_t>(0xffffffffffffffff, 0) == 0 && morton2D_ancestorAtLevel<uint64_t>(0x1234, 32) == 0x1234, "2D ancestor at level");
+
+// Neighbour offsets as compile-time tables, applied with morton3D_Add at run time
+static void checkConstexpr() {
+	printf("++ Checking correctness of constant expression methods ... ");
+	static constexpr uint_fast64_t offsets[6] = { morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(1, 0, 0), morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(0, 1, 0),
+		morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(0, 0, 1), morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(2, 2, 0),
+		morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(0, 3, 3), morton3D_Encode_magicbits<uint_fast64_t, uint_fast32_t>(5, 6, 7) };
+	static constexpr uint_fast32_t deltas[6][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 2, 2, 0 }, { 0, 3, 3 }, { 5, 6, 7 } };
+	bool ok = true;
+	init_randcmwc(42);
+	for (size_t t = 0; t < 10000; t++) {
+		const uint_fast32_t x = rand_cmwc() & 0xfffff, y = rand_cmwc() & 0xfffff, z = rand_cmwc() & 0xfffff;
+		const uint_fast64_t m = morton3D_64_encode(x, y, z);
+		for (size_t i = 0; i < 6; i++) {
+			const uint_fast64_t n = morton3D_Add<uint_fast64_t>(m, offsets[i]);
+			ok &= n == morton3D_64_encode(x + deltas[i][0], y + deltas[i][1], z + deltas[i][2]);
+			ok &= morton3D_DecodeCoord_magicbits<uint_fast64_t, uint_fast32_t>(n, 0) == x + deltas[i][0] && morton3D_DecodeCoord_magicbits<uint_fast64_t, uint_fast32_t>(n, 2) == z + deltas[i][2];
+		}
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void checkPacked() {
+	printf("++ Checking correctness of packed word methods ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	vector<uint32_t> words10(1000), codes10(1000), back10(1000);
+	vector<uint64_t> words21(1000), codes21(1000), back21(1000);
+	vector<uint16_t> x(1000), y(1000), z(1000), dx(1000), dy(1000), dz(1000);
+	vector<uint64_t> codes16(1000);
+	for (size_t i = 0; i < 1000; i++) {
+		const uint32_t x10 = rand_cmwc() & 0x3FF, y10 = rand_cmwc() & 0x3FF, z10 = rand_cmwc() & 0x3FF;
+		const uint64_t x21 = rand_cmwc() & 0x1FFFFF, y21 = rand_cmwc() & 0x1FFFFF, z21 = rand_cmwc() & 0x1FFFFF;
+		words10[i] = x10 | y10 << 10 | z10 << 20 | (uint32_t)(rand_cmwc() & 3) << 30; // the top bits are ignored
+		words21[i] = x21 | y21 << 21 | z21 << 42 | (uint64_t)(rand_cmwc() & 1) << 63;
+		x[i] = (uint16_t)rand_cmwc(); y[i] = (uint16_t)rand_cmwc(); z[i] = (uint16_t)rand_cmwc();
+		const uint32_t m10 = morton3D_32_encode((uint16_t)x10, (uint16_t)y10, (uint16_t)z10);
+		const uint64_t m21 = morton3D_64_encode((uint32_t)x21, (uint32_t)y21, (uint32_t)z21);
+		ok &= morton3D_32_EncodePacked10_magicbits(words10[i]) == m10 && morton3D_32_EncodePacked10(words10[i]) == m10;
+		ok &= morton3D_32_DecodePacked10_magicbits(m10) == (words10[i] & 0x3FFFFFFF) && morton3D_32_DecodePacked10(m10) == (words10[i] & 0x3FFFFFFF);
+		ok &= morton3D_64_EncodePacked21_magicbits(words21[i]) == m21 && morton3D_64_EncodePacked21(words21[i]) == m21;
+		ok &= morton3D_64_DecodePacked21_magicbits(m21) == (words21[i] & 0x7FFFFFFFFFFFFFFF) && morton3D_64_DecodePacked21(m21) == (words21[i] & 0x7FFFFFFFFFFFFFFF);
+	}
+	morton3D_32_EncodePacked10Array(&words10[0], 1000, &codes10[0]);
+	morton3D_32_DecodePacked10Array(&codes10[0], 1000, &back10[0]);
+	morton3D_64_EncodePacked21Array(&words21[0], 1000, &codes21[0]);
+	morton3D_64_DecodePacked21Array(&codes21[0], 1000, &back21[0]);
+	morton3D_64_EncodeSoA16Array(&x[0], &y[0], &z[0], 1000, &codes16[0]);
+	morton3D_64_DecodeSoA16Array(&codes16[0], 1000, &dx[0], &dy[0], &dz[0]);
+	for (size_t i = 0; i < 1000; i++) {
+		ok &= codes10[i] == morton3D_32_EncodePacked10_magicbits(words10[i]) && back10[i] == (words10[i] & 0x3FFFFFFF);
+		ok &= codes21[i] == morton3D_64_EncodePacked21_magicbits(words21[i]) && back21[i] == (words21[i] & 0x7FFFFFFFFFFFFFFF);
+		ok &= codes16[i] == morton3D_64_encode((uint32_t)x[i], (uint32_t)y[i], (uint32_t)z[i]) && dx[i] == x[i] && dy[i] == y[i] && dz[i] == z[i];
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Ingest of packed words: unpack, encode and repack, against the direct packed methods
+static void Packed_Perf(size_t n) {
+	cout << "++ Encoding and decoding " << n << " packed 10:10:10 and 21:21:21 words" << endl;
+	init_randcmwc(42);
+	vector<uint32_t> words10(n), codes10(n);
+	vector<uint64_t> words21(n), codes21(n);
+	for (size_t i = 0; i < n; i++) {
+		words10[i] = (uint32_t)rand_cmwc() & 0x3FFFFFFF;
+		words21[i] = ((uint64_t)rand_cmwc() << 32 | rand_cmwc()) & 0x7FFFFFFFFFFFFFFF;
+	}
+	morton3D_32_EncodePacked10Array(&words10[0], n, &codes10[0]); // touch all pages once
+	morton3D_64_EncodePacked21Array(&words21[0], n, &codes21[0]);
+
+	Timer unpack10_timer = Timer();
+	unpack10_timer.start();
+	for (size_t i = 0; i < n; i++) {
+		codes10[i] = morton3D_32_encode((uint16_t)(words10[i] & 0x3FF), (uint16_t)((words10[i] >> 10) & 0x3FF), (uint16_t)(words10[i] >> 20));
+	}
+	unpack10_timer.stop();
+	running_sums.push_back(codes10[n / 2]);
+	Timer array10_timer = Timer();
+	array10_timer.start();
+	morton3D_32_EncodePacked10Array(&words10[0], n, &codes10[0]);
+	array10_timer.stop();
+	running_sums.push_back(codes10[n / 3]);
+	Timer repack10_timer = Timer();
+	repack10_timer.start();
+	for (size_t i = 0; i < n; i++) {
+		uint16_t x, y, z;
+		morton3D_32_decode(codes10[i], x, y, z);
+		words10[i] = (uint32_t)x | (uint32_t)y << 10 | (uint32_t)z << 20;
+	}
+	repack10_timer.stop();
+	running_sums.push_back(words10[n / 2]);
+	Timer decode10_timer = Timer();
+	decode10_timer.start();
+	morton3D_32_DecodePacked10Array(&codes10[0], n, &words10[0]);
+	decode10_timer.stop();
+	running_sums.push_back(words10[n / 3]);
+
+	Timer unpack21_timer = Timer();
+	unpack21_timer.start();
+	for (size_t i = 0; i < n; i++) {
+		codes21[i] = morton3D_64_encode((uint32_t)(words21[i] & 0x1FFFFF), (uint32_t)((words21[i] >> 21) & 0x1FFFFF), (uint32_t)(words21[i] >> 42));
+	}
+	unpack21_timer.stop();
+	running_sums.push_back(codes21[n / 2]);
+	Timer array21_timer = Timer();
+	array21_timer.start();
+	morton3D_64_EncodePacked21Array(&words21[0], n, &codes21[0]);
+	array21_timer.stop();
+	running_sums.push_back(codes21[n / 3]);
+	Timer repack21_timer = Timer();
+	repack21_timer.start();
+	for (size_t i = 0; i < n; i++) {
+		uint32_t x, y, z;
+		morton3D_64_decode(codes21[i], x, y, z);
+		words21[i] = (uint64_t)x | (uint64_t)y << 21 | (uint64_t)z << 42;
+	}
+	repack21_timer.stop();
+	running_sums.push_back(words21[n / 2]);
+	Timer decode21_timer = Timer();
+	decode21_timer.start();
+	morton3D_64_DecodePacked21Array(&codes21[0], n, &words21[0]);
+	decode21_timer.stop();
+	running_sums.push_back(words21[n / 3]);
+	cout << "    10:10:10 encode: unpack + morton3D_32_encode " << std::fixed << std::setprecision(3) << unpack10_timer.elapsed_time_milliseconds
+		<< " ms, EncodePacked10Array " << array10_timer.elapsed_time_milliseconds << " ms. Decode: morton3D_32_decode + repack "
+		<< repack10_timer.elapsed_time_milliseconds << " ms, DecodePacked10Array " << decode10_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    21:21:21 encode: unpack + morton3D_64_encode " << unpack21_timer.elapsed_time_milliseconds
+		<< " ms, EncodePacked21Array " << array21_timer.elapsed_time_milliseconds << " ms. Decode: morton3D_64_decode + repack "
+		<< repack21_timer.elapsed_time_milliseconds << " ms, DecodePacked21Array " << decode21_timer.elapsed_time_milliseconds << " ms" << endl;
+}
+
+// A layout which is not level by level: per level z, y, x instead of x, y, z
+struct ZYXLayout {
+	static const unsigned int XBITS = 20, YBITS = 20, ZBITS = 20, BITS = 60;
+	static constexpr unsigned int axis(const unsigned int i) { return 2 - (i % 3); }
+};
+
+static_assert(morton3D_EncodeAniso_magicbits<uint64_t, morton3D_LevelLayout<24, 24, 16>, uint32_t>(1 << 23, 0, 0) == (uint64_t)1 << 62, "The top bit of a 24/24/16 code is x");
+static_assert(morton3D_EncodeAniso_magicbits<uint64_t, morton3D_LevelLayout<24, 24, 16, false>, uint32_t>(0, 0, 1) == (uint64_t)1 << 18, "A high aligned 16-bit z starts at level 8, after 8 levels of x and y");
+
+// Reference: place the bits one by one, following layout::axis
+template <typename morton, typename layout>
+static morton anisoReference(const uint64_t x, const uint64_t y, const uint64_t z) {
+	const uint64_t c[3] = { x, y, z };
+	unsigned int used[3] = { 0, 0, 0 };
+	morton m = 0;
+	for (unsigned int i = 0; i < layout::BITS; i++) {
+		const unsigned int a = layout::axis(i);
+		m |= (morton)((c[a] >> used[a]++) & 1) << i;
+	}
+	return m;
+}
+
+template <typename morton, typename layout>
+static bool checkAnisoLayout() {
+	bool ok = true;
+	for (size_t t = 0; t < 10000; t++) {
+		const uint64_t r = (uint64_t)rand_cmwc() << 32 | rand_cmwc();
+		const uint64_t x = r & (((uint64_t)1 << layout::XBITS) - 1), y = (r >> 7) & (((uint64_t)1 << layout::YBITS) - 1), z = (r >> 3) & (((uint64_t)1 << layout::ZBITS) - 1);
+		const morton m = morton3D_EncodeAniso_magicbits<morton, layout, uint64_t>(x, y, z);
+		ok &= m == anisoReference<morton, layout>(x, y, z) && m == morton3D_EncodeAniso<morton, layout, uint64_t>(x, y, z);
+		ok &= m == morton3D_EncodeAniso_magicbits<morton, layout, uint64_t>(x | ~(((uint64_t)1 << layout::XBITS) - 1), y, z); // bits above the axis are ignored
+		uint64_t dx, dy, dz;
+		morton3D_DecodeAniso_magicbits<morton, layout, uint64_t>(m, dx, dy, dz);
+		ok &= dx == x && dy == y && dz == z;
+		morton3D_DecodeAniso<morton, layout, uint64_t>(m, dx, dy, dz);
+		ok &= dx == x && dy == y && dz == z;
+	}
+	return ok;
+}
+
+static void checkAniso() {
+	printf("++ Checking correctness of anisotropic layouts ... ");
+	init_randcmwc(42);
+	bool ok = checkAnisoLayout<uint64_t, morton3D_LevelLayout<24, 24, 16> >() && checkAnisoLayout<uint64_t, morton3D_LevelLayout<24, 24, 16, false> >()
+		&& checkAnisoLayout<uint64_t, morton3D_LevelLayout<30, 20, 3, false> >() && checkAnisoLayout<uint32_t, morton3D_LevelLayout<12, 12, 8> >()
+		&& checkAnisoLayout<uint32_t, morton3D_LevelLayout<16, 16, 0> >() && checkAnisoLayout<uint64_t, ZYXLayout>();
+	// Equal axes give the usual codes
+	for (size_t t = 0; t < 10000; t++) {
+		const uint32_t x = rand_cmwc() & 0x1FFFFF, y = rand_cmwc() & 0x1FFFFF, z = rand_cmwc() & 0x1FFFFF;
+		ok &= morton3D_EncodeAniso<uint64_t, morton3D_LevelLayout<21, 21, 21>, uint32_t>(x, y, z) == morton3D_64_encode(x, y, z);
+		ok &= morton3D_EncodeAniso<uint32_t, morton3D_LevelLayout<10, 10, 10>, uint16_t>(x & 0x3FF, y & 0x3FF, z & 0x3FF) == morton3D_32_encode((uint16_t)(x & 0x3FF), (uint16_t)(y & 0x3FF), (uint16_t)(z & 0x3FF));
+		ok &= morton3D_EncodeAniso<uint32_t, morton3D_LevelLayout<16, 16, 0>, uint16_t>((uint16_t)x, (uint16_t)y, 0) == morton2D_32_encode((uint16_t)x, (uint16_t)y);
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+static void Aniso_Perf(size_t n) {
+	cout << "++ Encoding and decoding " << n << " points with 24/24/16 bits per axis, against 21/21/21 bits" << endl;
+	typedef morton3D_LevelLayout<24, 24, 16> layout;
+	init_randcmwc(42);
+	vector<uint32_t> x(n), y(n), z(n);
+	vector<uint64_t> codes(n);
+	for (size_t i = 0; i < n; i++) { x[i] = rand_cmwc() & 0xFFFFFF; y[i] = rand_cmwc() & 0xFFFFFF; z[i] = rand_cmwc() & 0xFFFF; }
+	for (size_t i = 0; i < n; i++) { codes[i] = 0; } // touch all pages once
+
+	Timer iso_timer = Timer();
+	iso_timer.start();
+	for (size_t i = 0; i < n; i++) { codes[i] = morton3D_64_encode(x[i] & 0x1FFFFF, y[i] & 0x1FFFFF, z[i]); }
+	iso_timer.stop();
+	running_sums.push_back(codes[n / 2]);
+	Timer magic_timer = Timer();
+	magic_timer.start();
+	for (size_t i = 0; i < n; i++) { codes[i] = morton3D_EncodeAniso_magicbits<uint64_t, layout, uint32_t>(x[i], y[i], z[i]); }
+	magic_timer.stop();
+	running_sums.push_back(codes[n / 3]);
+	Timer aniso_timer = Timer();
+	aniso_timer.start();
+	for (size_t i = 0; i < n; i++) { codes[i] = morton3D_EncodeAniso<uint64_t, layout, uint32_t>(x[i], y[i], z[i]); }
+	aniso_timer.stop();
+	running_sums.push_back(codes[n / 4]);
+
+	uint64_t sum = 0;
+	Timer magic_decode_timer = Timer();
+	magic_decode_timer.start();
+	for (size_t i = 0; i < n; i++) {
+		uint32_t a, b, c;
+		morton3D_DecodeAniso_magicbits<uint64_t, layout, uint32_t>(codes[i], a, b, c);
+		sum += a ^ b ^ c;
+	}
+	magic_decode_timer.stop();
+	Timer aniso_decode_timer = Timer();
+	aniso_decode_timer.start();
+	for (size_t i = 0; i < n; i++) {
+		uint32_t a, b, c;
+		morton3D_DecodeAniso<uint64_t, layout, uint32_t>(codes[i], a, b, c);
+		sum += a ^ b ^ c;
+	}
+	aniso_decode_timer.stop();
+	running_sums.push_back(sum);
+	cout << "    Encode: morton3D_64_encode (21/21/21) " << std::fixed << std::setprecision(3) << iso_timer.elapsed_time_milliseconds << " ms, EncodeAniso_magicbits "
+		<< magic_timer.elapsed_time_milliseconds << " ms, EncodeAniso " << aniso_timer.elapsed_time_milliseconds << " ms" << endl;
+	cout << "    Decode: DecodeAniso_magicbits " << magic_decode_timer.elapsed_time_milliseconds << " ms, DecodeAniso " << aniso_decode_timer.elapsed_time_milliseconds << " ms" << endl;
+}
+
+// Decode of random codes (unlike the linear order of Decode_3D_Perf, the table entries are not reused)
+template <typename morton, typename coord, void (*decode)(const morton, coord&, coord&, coord&)>
+static double RandomDecode_Perf(const vector<morton>& codes, uint64_t& sum) {
+	Timer timer = Timer();
+	timer.start();
+	for (size_t i = 0; i < codes.size(); i++) {
+		coord x, y, z;
+		decode(codes[i], x, y, z);
+		sum += x ^ y ^ z;
+	}
+	timer.stop();
+	return timer.elapsed_time_milliseconds;
+}
+
+static void PackedLUT_Decode_Perf(size_t n) {
+	cout << "++ Decoding " << n << " random 3D codes with the packed LUTs" << endl;
+	init_randcmwc(42);
+	vector<uint_fast64_t> codes(n);
+	vector<uint_fast32_t> codes32(n);
+	for (size_t i = 0; i < n; i++) {
+		codes[i] = ((uint_fast64_t)rand_cmwc() << 32 | rand_cmwc()) & 0x7FFFFFFFFFFFFFFF;
+		codes32[i] = rand_cmwc() & 0x3FFFFFFF;
+	}
+	uint_fast32_t wx, wy, wz; // build the tables before timing
+	morton3D_Decode_LUT4096_packed<uint_fast64_t, uint_fast32_t>(0, wx, wy, wz);
+	morton3D_Decode_LUT32768_packed<uint_fast64_t, uint_fast32_t>(0, wx, wy, wz);
+	uint64_t sum = 0;
+	const double lut_shifted = RandomDecode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Decode_LUT256_shifted<uint_fast64_t, uint_fast32_t> >(codes, sum);
+	const double magic = RandomDecode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Decode_magicbits<uint_fast64_t, uint_fast32_t> >(codes, sum);
+	const double packed12 = RandomDecode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Decode_LUT4096_packed<uint_fast64_t, uint_fast32_t> >(codes, sum);
+	const double packed15 = RandomDecode_Perf<uint_fast64_t, uint_fast32_t, morton3D_Decode_LUT32768_packed<uint_fast64_t, uint_fast32_t> >(codes, sum);
+	const double lut_shifted32 = RandomDecode_Perf<uint_fast32_t, uint_fast16_t, morton3D_Decode_LUT256_shifted<uint_fast32_t, uint_fast16_t> >(codes32, sum);
+	const double magic32 = RandomDecode_Perf<uint_fast32_t, uint_fast16_t, morton3D_Decode_magicbits<uint_fast32_t, uint_fast16_t> >(codes32, sum);
+	const double packed12_32 = RandomDecode_Perf<uint_fast32_t, uint_fast16_t, morton3D_Decode_LUT4096_packed<uint_fast32_t, uint_fast16_t> >(codes32, sum);
+	const double packed15_32 = RandomDecode_Perf<uint_fast32_t, uint_fast16_t, morton3D_Decode_LUT32768_packed<uint_fast32_t, uint_fast16_t> >(codes32, sum);
+	running_sums.push_back(sum);
+	cout << "    64-bit: LUT256 preshifted " << std::fixed << std::setprecision(3) << lut_shifted << " ms, Magicbits " << magic << " ms, LUT4096 packed "
+		<< packed12 << " ms, LUT32768 packed " << packed15 << " ms" << endl;
+	cout << "    32-bit: LUT256 preshifted " << lut_shifted32 << " ms, Magicbits " << magic32 << " ms, LUT4096 packed "
+		<< packed12_32 << " ms, LUT32768 packed " << packed15_32 << " ms" << endl;
+}
+
+static void checkNumaSort() {
+	printf("++ Checking correctness of NUMA-aware encode and sort ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	const size_t sizes[4] = { 0, 2, 1000, 300000 };
+	const unsigned int parts[4] = { 0, 1, 2, 5 }; // forced parts run the split and merge on a single node
+	for (size_t s = 0; s < 4; s++) {
+		const size_t n = sizes[s];
+		vector<uint32_t> x(n + 1), y(n + 1), z(n + 1); // + 1: &x[0] is valid for n = 0
+		for (size_t i = 0; i < n; i++) { x[i] = rand_cmwc() & 0x1fffff; y[i] = rand_cmwc() & 0x3f; z[i] = rand_cmwc() % 3; } // with equal codes
+		vector<uint64_t> expected(n);
+		vector<uint32_t> expected_order(n);
+		for (size_t i = 0; i < n; i++) { expected[i] = morton3D_64_encode(x[i], y[i], z[i]); expected_order[i] = (uint32_t)i; }
+		if (n > 0) { morton_RadixSortPairs<uint64_t, uint32_t>(&expected[0], &expected_order[0], n, 63); }
+		for (size_t p = 0; p < 4; p++) {
+			vector<uint64_t> codes(n + 1), pair_codes(n + 1);
+			vector<uint32_t> order(n + 1);
+			morton3D_NumaEncodeSort<uint64_t, uint32_t>(&x[0], &y[0], &z[0], n, &codes[0], parts[p], 63);
+			morton3D_NumaEncodeSortPairs<uint64_t, uint32_t, uint32_t>(&x[0], &y[0], &z[0], n, &pair_codes[0], &order[0], parts[p], 63);
+			ok &= std::equal(expected.begin(), expected.end(), codes.begin()) && std::equal(expected.begin(), expected.end(), pair_codes.begin());
+			ok &= std::equal(expected_order.begin(), expected_order.end(), order.begin()); // stable, as the radix sort
+		}
+	}
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Encode and sort (with the order of the points) of n points, in one part and in one part per NUMA node
+static void Numa_Perf(size_t n) {
+	const size_t nodes = morton_NumaNodes().size();
+	cout << "++ Encoding and sorting " << n << " points, NUMA nodes: " << nodes << endl;
+	init_randcmwc(42);
+	vector<uint32_t> x(n), y(n), z(n);
+	for (size_t i = 0; i < n; i++) { x[i] = rand_cmwc() & 0x1fffff; y[i] = rand_cmwc() & 0x1fffff; z[i] = rand_cmwc() & 0x1fffff; }
+	uint64_t* codes = new uint64_t[n];
+	uint32_t* order = new uint32_t[n];
+
+	Timer plain_timer = Timer();
+	plain_timer.start();
+	morton3D_NumaEncodeSortPairs<uint64_t, uint32_t, uint32_t>(&x[0], &y[0], &z[0], n, codes, order, 1, 63);
+	plain_timer.stop();
+	running_sums.push_back(codes[n / 2] + order[n / 3]);
+	Timer numa_timer = Timer();
+	numa_timer.start();
+	morton3D_NumaEncodeSortPairs<uint64_t, uint32_t, uint32_t>(&x[0], &y[0], &z[0], n, codes, order, 0, 63);
+	numa_timer.stop();
+	running_sums.push_back(codes[n / 4] + order[n / 5]);
+	Timer split_timer = Timer();
+	split_timer.start();
+	morton3D_NumaEncodeSortPairs<uint64_t, uint32_t, uint32_t>(&x[0], &y[0], &z[0], n, codes, order, 2, 63);
+	split_timer.stop();
+	running_sums.push_back(codes[n / 6] + order[n / 7]);
+	cout << "    One part: " << std::fixed << std::setprecision(3) << plain_timer.elapsed_time_milliseconds << " ms, one part per node: "
+		<< numa_timer.elapsed_time_milliseconds << " ms, two parts: " << split_timer.elapsed_time_milliseconds << " ms" << endl;
+	delete[] codes;
+	delete[] order;
+}
+
+// Reference splits: sort everything, then the closer of the last value below the target and the first at or above it
+static vector<uint64_t> partitionReference(const vector<uint64_t>& codes, const vector<uint32_t>& weights, const unsigned int parts, const uint64_t mask) {
+	vector<pair<uint64_t, uint32_t> > sorted(codes.size());
+	double total = 0.0;
+	for (size_t i = 0; i < codes.size(); i++) { sorted[i] = make_pair(codes[i] & mask, weights[i]); total += weights[i]; }
+	sort(sorted.begin(), sorted.end());
+	vector<uint64_t> splits;
+	for (unsigned int k = 1; k < parts; k++) {
+		const double target = total * k / parts;
+		double below = 0.0, lo_below = 0.0;
+		uint64_t lo = sorted[0].first;
+		size_t i = 0;
+		while (i < sorted.size() && below < target) {
+			lo = sorted[i].first; lo_below = below;
+			for (const uint64_t value = sorted[i].first; i < sorted.size() && sorted[i].first == value; i++) { below += sorted[i].second; }
+		}
+		splits.push_back((i < sorted.size() && below - target <= target - lo_below) ? sorted[i].first : lo);
+	}
+	return splits;
+}
+
+static void checkPartition() {
+	printf("++ Checking correctness of morton range partitioning ... ");
+	bool ok = true;
+	init_randcmwc(42);
+	const size_t sizes[4] = { 1, 7, 5000, 400000 };
+	const unsigned int part_counts[3] = { 1, 3, 16 };
+	for (size_t s = 0; s < 4; s++) {
+		const size_t n = sizes[s];
+		vector<uint64_t> codes(n);
+		vector<uint32_t> weights(n), ones(n, 1);
+		for (size_t i = 0; i < n; i++) {
+			// clustered, with duplicates and a few heavy codes
+			codes[i] = morton3D_64_encode(rand_cmwc() & 0xfff, (rand_cmwc() & 0xff) + 0x1000, rand_cmwc() % 5);
+			weights[i] = (i % 97 == 0) ? 1000 : rand_cmwc() % 10;
+		}
+		for (size_t p = 0; p < 3; p++) {
+			const unsigned int parts = part_counts[p];
+			for (unsigned int level = 17; level <= 21; level += 4) {
+				const uint64_t mask = morton3D_ancestorAtLevel<uint64_t>(~(uint64_t)0, level);
+				vector<uint64_t> splits(parts), unweighted(parts);
+				vector<double> part_weights(parts);
+				morton_Partition<uint64_t, uint32_t>(&codes[0], &weights[0], n, parts, &splits[0], &part_weights[0], level);
+				morton_Partition<uint64_t>(&codes[0], n, parts, &unweighted[0], 0, level);
+				const vector<uint64_t> expected = partitionReference(codes, weights, parts, mask), expected_unweighted = partitionReference(codes, ones, parts, mask);
+				ok &= std::equal(expected.begin(), expected.end(), splits.begin()) && std::equal(expected_unweighted.begin(), expected_unweighted.end(), unweighted.begin());
+				vector<double> counted(parts, 0.0);
+				for (size_t i = 0; i < n; i++) { counted[morton_PartOf<uint64_t>(codes[i], &splits[0], parts)] += weights[i]; }
+				for (unsigned int k = 0; k < parts; k++) {
+					ok &= counted[k] == part_weights[k];
+					if (k + 1 < parts) { ok &= (splits[k] & ~mask) == 0; } // aligned to the level
+				}
+			}
+		}
+	}
+	uint64_t none[1] = { 5 };
+	morton_Partition<uint64_t>(0, 0, 2, none); // no codes
+	ok &= none[0] == 0;
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Partition of unsorted codes, against sorting them and cutting the sorted array
+static void Partition_Perf(size_t n) {
+	const unsigned int parts = 64;
+	cout << "++ Partitioning " << n << " unsorted codes in " << parts << " ranges" << endl;
+	init_randcmwc(42);
+	vector<uint64_t> codes(n), splits(parts);
+	vector<uint32_t> weights(n);
+	for (size_t i = 0; i < n; i++) {
+		codes[i] = morton3D_64_encode(rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fffff, rand_cmwc() & 0x1fff);
+		weights[i] = 1 + rand_cmwc() % 8;
+	}
+	Timer sort_timer = Timer();
+	sort_timer.start();
+	vector<uint64_t> sorted(codes);
+	morton_RadixSort<uint64_t>(&sorted[0], n, 63);
+	for (unsigned int k = 1; k < parts; k++) { splits[k - 1] = sorted[n * k / parts]; }
+	sort_timer.stop();
+	running_sums.push_back(splits[parts / 2]);
+	Timer partition_timer = Timer();
+	partition_timer.start();
+	morton_Partition<uint64_t>(&codes[0], n, parts, &splits[0]);
+	partition_timer.stop();
+	running_sums.push_back(splits[parts / 3]);
+	Timer weighted_timer = Timer();
+	weighted_timer.start();
+	morton_Partition<uint64_t, uint32_t>(&codes[0], &weights[0], n, parts, &splits[0], 0, 15);
+	weighted_timer.stop();
+	running_sums.push_back(splits[parts / 4]);
+	cout << "    Radix sort and cut: " << std::fixed << std::setprecision(3) << sort_timer.elapsed_time_milliseconds << " ms, morton_Partition: "
+		<< partition_timer.elapsed_time_milliseconds << " ms, weighted and aligned to level 15: " << weighted_timer.elapsed_time_milliseconds << " ms" << endl;
+}
+
+// Random inserts and erases against std::map, then erase most keys again, so that nodes get merged
+template<typename morton>
+static bool checkBTreeOps(const uint64_t range) {
+	bool ok = true;
+	MortonBTree<morton, uint32_t> tree;
+	map<morton, uint32_t> control;
+	for (uint32_t i = 0; i < 300000; i++) {
+		const morton key = (morton)((((uint64_t)rand_cmwc() << 32) | rand_cmwc()) % range);
+		if (rand_cmwc() % 3 == 0) { ok &= tree.erase(key) == (control.erase(key) == 1); }
+		else {
+			ok &= tree.insert(key, i) == (control.find(key) == control.end());
+			control[key] = i;
+		}
+	}
+	ok &= tree.insert((morton)~(morton)0, 7) && tree.find((morton)~(morton)0) != 0 && *tree.find((morton)~(morton)0) == 7; // the padding code is a valid key
+	ok &= tree.erase((morton)~(morton)0) && !tree.contains((morton)~(morton)0);
+	for (int pass = 0; pass < 2; pass++) {
+		ok &= tree.size() == control.size();
+		typename map<morton, uint32_t>::const_iterator it = control.begin();
+		for (typename MortonBTree<morton, uint32_t>::Cursor c = tree.begin(); !c.done(); c.next(), ++it) {
+			if (it == control.end() || c.key() != it->first || c.data() != it->second) { ok = false; break; }
+		}
+		ok &= it == control.end();
+		for (int q = 0; q < 2000; q++) {
+			const morton key = (morton)((((uint64_t)rand_cmwc() << 32) | rand_cmwc()) % range);
+			const typename MortonBTree<morton, uint32_t>::Cursor c = tree.lowerBound(key);
+			const typename map<morton, uint32_t>::const_iterator m = control.lower_bound(key);
+			ok &= (m == control.end()) ? c.done() : (!c.done() && c.key() == m->first);
+			const uint32_t* v = tree.find(key);
+			ok &= (control.count(key) == 1) ? (v != 0 && *v == control[key]) : v == 0;
+		}
+		// keep one key in 20
+		vector<morton> keys;
+		for (it = control.begin(); it != control.end(); ++it) { keys.push_back(it->first); }
+		for (size_t i = 0; i < keys.size(); i++) { std::swap(keys[i], keys[i + rand_cmwc() % (keys.size() - i)]); }
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (i % 20 != 0) { ok &= tree.erase(keys[i]); control.erase(keys[i]); }
+		}
+	}
+	return ok;
+}
+
+// Bulk load of sorted keys with repeats (the last value wins), then box scans against filtering every key
+template<typename morton>
+static bool checkBTreeBoxes(const unsigned int dims) {
+	bool ok = true;
+	const uint_fast32_t side = (dims == 3) ? 64 : 512;
+	vector<morton> keys(100000);
+	for (size_t i = 0; i < keys.size(); i++) { keys[i] = (morton)(rand_cmwc() % (dims == 3 ? side * side * side : side * side)); }
+	sort(keys.begin(), keys.end());
+	vector<uint32_t> values(keys.size());
+	map<morton, uint32_t> control;
+	for (size_t i = 0; i < keys.size(); i++) { values[i] = (uint32_t)i; control[keys[i]] = (uint32_t)i; }
+	MortonBTree<morton, uint32_t> tree;
+	tree.bulkLoad(&keys[0], &values[0], keys.size());
+	ok &= tree.size() == control.size() && tree.height() >= 2;
+	for (typename map<morton, uint32_t>::const_iterator it = control.begin(); it != control.end(); ++it) {
+		const uint32_t* v = tree.find(it->first);
+		ok &= v != 0 && *v == it->second;
+	}
+	for (int b = 0; b < 300; b++) {
+		uint_fast32_t lo[3], hi[3];
+		for (unsigned int d = 0; d < 3; d++) {
+			lo[d] = rand_cmwc() % side;
+			hi[d] = std::min(side - 1, lo[d] + rand_cmwc() % (side / 4));
+		}
+		const morton zlo = (dims == 3) ? morton3D_Encode_magicbits<morton, uint_fast32_t>(lo[0], lo[1], lo[2]) : morton2D_Encode_magicbits<morton, uint_fast32_t>(lo[0], lo[1]);
+		const morton zhi = (dims == 3) ? morton3D_Encode_magicbits<morton, uint_fast32_t>(hi[0], hi[1], hi[2]) : morton2D_Encode_magicbits<morton, uint_fast32_t>(hi[0], hi[1]);
+		vector<morton> expected, found;
+		for (typename map<morton, uint32_t>::const_iterator it = control.begin(); it != control.end(); ++it) {
+			if (dims == 3 ? morton3D_InBox<morton>(it->first, zlo, zhi) : morton2D_InBox<morton>(it->first, zlo, zhi)) { expected.push_back(it->first); }
+		}
+		for (typename MortonBTree<morton, uint32_t>::BoxCursor c = (dims == 3) ? tree.boxScan3D(zlo, zhi) : tree.boxScan2D(zlo, zhi); !c.done(); c.next()) {
+			found.push_back(c.key());
+			ok &= c.data() == control[c.key()];
+		}
+		ok &= found == expected;
+	}
+	MortonBTree<morton, uint32_t> empty_tree;
+	empty_tree.bulkLoad(&keys[0], &values[0], 0);
+	ok &= empty_tree.empty() && empty_tree.begin().done() && empty_tree.boxScan3D(0, 100).done();
+	return ok;
+}
+
+static void checkBTree() {
+	printf("++ Checking correctness of morton B+tree ... ");
+	init_randcmwc(42);
+	bool ok = checkBTreeOps<uint64_t>(100000) && checkBTreeOps<uint64_t>(~(uint64_t)0) && checkBTreeOps<uint32_t>(100000) && checkBTreeOps<uint32_t>(0xFFFFFFFFull);
+	ok = ok && checkBTreeBoxes<uint64_t>(3) && checkBTreeBoxes<uint64_t>(2) && checkBTreeBoxes<uint32_t>(3) && checkBTreeBoxes<uint32_t>(2);
+	if (ok) { printf(" Passed. \n"); }
+	else { printf("    One or more methods failed. \n"); }
+}
+
+// Bulk load, then a mix of lookups, inserts and erases, then box scans, against std::map with the same box skips
+static void BTree_Perf(size_t n) {
+	cout << "++ Morton B+tree of " << n << " keys: bulk load, mixed operations and box scans" << endl;
+	init_randcmwc(42);
+	vector<uint64_t> keys(n), ops(2 * n);
+	for (size_t i = 0; i < n; i++) { keys[i] = morton3D_64_encode(rand_cmwc() & 0xffff, rand_cmwc() & 0xffff, rand_cmwc() & 0xffff); }
+	for (size_t i = 0; i < ops.size(); i++) { ops[i] = morton3D_64_encode(rand_cmwc() & 0xffff, rand_cmwc() & 0xffff, rand_cmwc() & 0xffff); }
+	sort(keys.begin(), keys.end());
+	vector<uint32_t> values(n, 1);
+	MortonBTree<uint64_t, uint32_t> tree;
+	map<uint64_t, uint32_t> control;
+	Timer load_timer = Timer(), control_load_timer = Timer();
+	load_timer.start();
+	tree.bulkLoad(&keys[0], &values[0], n);
+	load_timer.stop();
+	control_load_timer.start();
+	for (size_t i = 0; i < n; i++) { control.insert(control.end(), make_pair(keys[i], values[i])); }
+	control_load_timer.stop();
+
+	// half lookups, a quarter inserts, a quarter erases
+	uint_fast64_t runningsum = 0, control_runningsum = 0;
+	Timer mixed_timer = Timer(), control_mixed_timer = Timer();
+	mixed_timer.start();
+	for (size_t i = 0; i < ops.size(); i++) {
+		const uint64_t key = ops[i];
+		switch (key & 3) {
+		case 0: tree.insert(key, 2); break;
+		case 1: runningsum += tree.erase(key); break;
+		default: runningsum += tree.contains(key); break;
+		}
+	}
+	mixed_timer.stop();
+	control_mixed_timer.start();
+	for (size_t i = 0; i < ops.size(); i++) {
+		const uint64_t key = ops[i];
+		switch (key & 3) {
+		case 0: control[key] = 2; break;
+		case 1: control_runningsum += control.erase(key); break;
+		default: control_runningsum += control.count(key); break;
+		}
+	}
+	control_mixed_timer.stop();
+
+	Timer box_timer = Timer(), control_box_timer = Timer();
+	vector<uint64_t> boxes(2 * 1000);
+	for (size_t b = 0; b < boxes.size(); b += 2) {
+		const uint_fast32_t x = rand_cmwc() & 0xefff, y = rand_cmwc() & 0xefff, z = rand_cmwc() & 0xefff;
+		boxes[b] = morton3D_64_encode(x, y, z);
+		boxes[b + 1] = morton3D_64_encode(x + 0xfff, y + 0xfff, z + 0xfff);
+	}
+	box_timer.start();
+	for (size_t b = 0; b < boxes.size(); b += 2) {
+		for (MortonBTree<uint64_t, uint32_t>::BoxCursor c = tree.boxScan3D(boxes[b], boxes[b + 1]); !c.done(); c.next()) { runningsum += c.data(); }
+	}
+	box_timer.stop();
+	control_box_timer.start();
+	for (size_t b = 0; b < boxes.size(); b += 2) {
+		map<uint64_t, uint32_t>::const_iterator it = control.lower_bound(boxes[b]);
+		while (it != control.end() && it->first <= boxes[b + 1]) {
+			if (morton3D_InBox<uint64_t>(it->first, boxes[b], boxes[b + 1])) { control_runningsum += it->second; ++it; }
+			else { it = control.lower_bound(morton3D_NextInBox<uint64_t>(it->first, boxes[b], boxes[b + 1])); }
+		}
+	}
+	control_box_timer.stop();
+	running_sums.push_back(runningsum);
+	if (runningsum != control_runningsum) { cout << "    Results differ from std::map" << endl; }
+	cout << "    MortonBTree: bulk load " << std::fixed << std::setprecision(3) << load_timer.elapsed_time_milliseconds << " ms, " << ops.size() << " mixed operations "
+		<< mixed_timer.elapsed_time_milliseconds << " ms, 1000 box scans " << box_timer.elapsed_time_milliseconds << " ms (" << (double)tree.memoryUsage() / tree.size() << " bytes per key)" << endl;
+	cout << "    std::map:    sorted inserts " << control_load_timer.elapsed_time_milliseconds << " ms, " << ops.size() << " mixed operations "
+		<< control_mixed_timer.elapsed_time_milliseconds << " ms, 1000 box scans " << control_box_timer.elapsed_time_milliseconds << " ms" << endl;
+}
+
 void printHeader(){
 	cout << "LIBMORTON TEST SUITE" << endl;
 	cout << "--------------------" << endl;
@@ -322,6 +3128,32 @@ int main(int argc, char *argv[]) {
 	cout << "++ Checking all methods for correctness" << endl;
 	check3D_EncodeCorrectness();
 	check3D_DecodeCorrectness();
+	checkSignedCorrectness();
+	checkEarlyTermination();
+	checkMortonArithmetic();
+	checkMortonHierarchy();
+	checkMortonArray();
+	checkSwizzleCorrectness();
+	checkTiledArrays();
+	checkOctree();
+	checkHashMap();
+	checkKNN();
+	checkQuantizeCorrectness();
+	checkRadixSort();
+	checkLBVH();
+	checkPointFile();
+	checkExternalSort();
+	checkCompression();
+	checkLevelOfDetail();
+	checkZOrderWalk();
+	check2D_32Kernels();
+	checkExactWidth();
+	checkConstexpr();
+	checkPacked();
+	checkAniso();
+	checkNumaSort();
+	checkPartition();
+	checkBTree();
 	cout << "++ Running each performance test " << times << " times and averaging results" << endl;
 	for (int i = 128; i <= 512; i = i * 2){
 		MAX = i;
@@ -330,4 +3162,32 @@ int main(int argc, char *argv[]) {
 		Decode_3D_Perf();
 		printRunningSums();
 	}
+	EarlyTermination_Perf(ET_PERF_POINTS);
+	Morton2D32_Perf(M2D32_PERF_POINTS);
+	ExactWidth_Perf<uint32_t, uint16_t, uint_fast32_t, uint_fast16_t>(EXACT_PERF_POINTS, 10);
+	ExactWidth_Perf<uint64_t, uint32_t, uint_fast64_t, uint_fast32_t>(EXACT_PERF_POINTS, 21);
+	Packed_Perf(PACKED_PERF_POINTS);
+	Aniso_Perf(ANISO_PERF_POINTS);
+	PackedLUT_Decode_Perf(PACKEDLUT_PERF_CODES);
+	Numa_Perf(NUMA_PERF_POINTS);
+	Partition_Perf(PARTITION_PERF_CODES);
+	BTree_Perf(BTREE_PERF_KEYS);
+	MortonArray_Perf(ARRAY_PERF_SIZE);
+	Swizzle_Perf(SWIZZLE_PERF_SIZE, SWIZZLE_PERF_SIZE, SWIZZLE_PERF_SIZE);
+	Swizzle_Perf(SWIZZLE_PERF_SIZE * 16, SWIZZLE_PERF_SIZE * 16, 1);
+	TiledArray_Perf(TILED_PERF_SIZE);
+	Octree_Perf(OCTREE_PERF_POINTS);
+	HashMap_Perf(HASHMAP_PERF_CELLS);
+	KNN_Perf(KNN_PERF_POINTS, true);
+	KNN_Perf(KNN_PERF_POINTS, false);
+	MortonHierarchy_Perf(HIERARCHY_PERF_CODES);
+	Quantize_Perf(QUANTIZE_PERF_POINTS);
+	LBVH_Perf(LBVH_PERF_PRIMITIVES);
+	PointFile_Perf(POINTFILE_PERF_POINTS);
+	ExternalSort_Perf(EXTSORT_PERF_POINTS, EXTSORT_PERF_MEMORY);
+	Compression_Perf(COMPRESS_PERF_CODES);
+	LevelOfDetail_Perf(LOD_PERF_POINTS);
+	ZOrderWalk_Perf(WALK_PERF_SIZE, WALK_PERF_SIZE, WALK_PERF_SIZE);
+	ZOrderWalk_Perf(WALK_PERF_SIZE + 45, WALK_PERF_SIZE - 57, WALK_PERF_SIZE - 6);
+	printRunningSums();
 }
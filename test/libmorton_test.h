@@ -11,6 +11,26 @@
 #include "../libmorton/include/morton_LUT_generators.h"
 #include "../libmorton/include/morton2D.h"
 #include "../libmorton/include/morton3D.h"
+#include "../libmorton/include/morton_octree.h"
+#include "../libmorton/include/morton_hashmap.h"
+#include "../libmorton/include/morton_array.h"
+#include "../libmorton/include/morton_swizzle.h"
+#include "../libmorton/include/morton_tiled.h"
+#include "../libmorton/include/morton_knn.h"
+#include "../libmorton/include/morton_sort.h"
+#include "../libmorton/include/morton_quantize.h"
+#include "../libmorton/include/morton_lbvh.h"
+#include "../libmorton/include/morton_pointfile.h"
+#include "../libmorton/include/morton_extsort.h"
+#include "../libmorton/include/morton_compress.h"
+#include "../libmorton/include/morton_lod.h"
+#include "../libmorton/include/morton_walk.h"
+#include "../libmorton/include/morton2D_32.h"
+#include "../libmorton/include/morton3D_packed.h"
+#include "../libmorton/include/morton3D_aniso.h"
+#include "../libmorton/include/morton_numa.h"
+#include "../libmorton/include/morton_partition.h"
+#include "../libmorton/include/morton_btree.h"
 
 
 